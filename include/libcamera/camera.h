@@ -11,8 +11,10 @@
 #include <memory>
 #include <optional>
 #include <set>
+#include <stddef.h>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
@@ -56,6 +58,13 @@ public:
 	bool isValid() const;
 };
 
+struct BufferPoolUsage {
+	std::string name;
+	std::string allocator;
+	unsigned int count;
+	size_t size;
+};
+
 class CameraConfiguration
 {
 public:
@@ -151,6 +160,8 @@ public:
 	int start(const ControlList *controls = nullptr);
 	int stop();
 
+	std::vector<BufferPoolUsage> internalBufferUsage();
+
 private:
 	LIBCAMERA_DISABLE_COPY(Camera)
 
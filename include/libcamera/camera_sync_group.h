@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Synchronized capture across multiple cameras
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/signal.h>
+
+namespace libcamera {
+
+class Camera;
+class ControlList;
+class Request;
+
+class CameraSyncGroup : public Extensible
+{
+	LIBCAMERA_DECLARE_PRIVATE()
+
+public:
+	struct Frame {
+		std::vector<Request *> requests;
+		int64_t skew;
+	};
+
+	CameraSyncGroup(const std::vector<std::shared_ptr<Camera>> &cameras);
+	~CameraSyncGroup();
+
+	const std::vector<std::shared_ptr<Camera>> &cameras() const;
+
+	void setTolerance(std::chrono::nanoseconds tolerance);
+	std::chrono::nanoseconds tolerance() const;
+
+	std::chrono::nanoseconds frameDuration() const;
+
+	int start(const ControlList *controls = nullptr);
+	int stop();
+
+	Signal<const Frame &> frameCompleted;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(CameraSyncGroup)
+};
+
+} /* namespace libcamera */
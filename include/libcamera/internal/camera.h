@@ -41,6 +41,15 @@ public:
 
 	uint32_t requestSequence_;
 
+	struct BufferUsage {
+		unsigned int maxQueuedRequests;
+		int64_t maxLatency;
+		int64_t frameInterval;
+		int64_t lastTimestamp;
+	};
+
+	BufferUsage bufferUsage_;
+
 	const CameraControlValidator *validator() const { return validator_.get(); }
 
 private:
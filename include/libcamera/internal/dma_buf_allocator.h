@@ -34,6 +34,7 @@ public:
 	DmaBufAllocator(DmaBufAllocatorFlags flags = DmaBufAllocatorFlag::CmaHeap);
 	~DmaBufAllocator();
 	bool isValid() const { return providerHandle_.isValid(); }
+	const char *deviceNode() const { return deviceNode_; }
 	UniqueFD alloc(const char *name, std::size_t size);
 
 	int exportBuffers(unsigned int count,
@@ -48,6 +49,7 @@ private:
 	UniqueFD allocFromUDmaBuf(const char *name, std::size_t size);
 	UniqueFD providerHandle_;
 	DmaBufAllocatorFlag type_;
+	const char *deviceNode_ = nullptr;
 };
 
 class DmaSyncer final
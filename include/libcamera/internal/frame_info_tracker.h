@@ -0,0 +1,279 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Tracker of per-frame information for pipeline handlers
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/framebuffer.h>
+#include <libcamera/request.h>
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(FrameInfoTracker)
+
+struct FrameInfo {
+	uint32_t frame;
+	Request *request;
+};
+
+template<typename Info>
+class FrameInfoTracker
+{
+	static_assert(std::is_base_of_v<FrameInfo, Info>,
+		      "Info must be derived from FrameInfo");
+
+public:
+	explicit FrameInfoTracker(unsigned int capacity = 1)
+		: lastFrame_(0), size_(0)
+	{
+		reset(capacity);
+	}
+
+	void reset(unsigned int capacity)
+	{
+		slots_.clear();
+		for (unsigned int i = 0; i < std::max(capacity, 1U); i++)
+			slots_.push_back(std::make_unique<Slot>());
+
+		requests_.assign(slots_.size(), nullptr);
+		size_ = 0;
+	}
+
+	Info *create(uint32_t frame, Request *request)
+	{
+		if (lookup(frame) || lookup(request)) {
+			LOG(FrameInfoTracker, Error)
+				<< "Frame " << frame << " or request "
+				<< request->sequence() << " already tracked";
+			return nullptr;
+		}
+
+		if (size_ && !before(lastFrame_, frame))
+			LOG(FrameInfoTracker, Warning)
+				<< "Frame " << frame << " created after frame "
+				<< lastFrame_;
+
+		if (slots_[frame % slots_.size()]->active ||
+		    requests_[request->sequence() % requests_.size()])
+			grow(frame, request);
+
+		Slot &slot = *slots_[frame % slots_.size()];
+		slot.info = Info{};
+		slot.info.frame = frame;
+		slot.info.request = request;
+		slot.active = true;
+
+		requests_[request->sequence() % requests_.size()] = &slot.info;
+
+		lastFrame_ = frame;
+		size_++;
+
+		return &slot.info;
+	}
+
+	void destroy(Info *info)
+	{
+		Slot &slot = *slots_[info->frame % slots_.size()];
+		if (!slot.active || &slot.info != info) {
+			LOG(FrameInfoTracker, Error)
+				<< "Frame " << info->frame
+				<< " not tracked, already destroyed or overwritten";
+			return;
+		}
+
+		/* Frames are expected to complete in creation order. */
+		const Info *older = nullptr;
+		for (const std::unique_ptr<Slot> &other : slots_) {
+			if (!other->active || !before(other->info.frame, info->frame))
+				continue;
+
+			if (!older || before(other->info.frame, older->frame))
+				older = &other->info;
+		}
+
+		if (older)
+			LOG(FrameInfoTracker, Warning)
+				<< "Frame " << info->frame
+				<< " completed before frame " << older->frame;
+
+		requests_[info->request->sequence() % requests_.size()] = nullptr;
+		slot.active = false;
+		size_--;
+	}
+
+	void clear()
+	{
+		for (std::unique_ptr<Slot> &slot : slots_)
+			slot->active = false;
+
+		std::fill(requests_.begin(), requests_.end(), nullptr);
+		size_ = 0;
+	}
+
+	Info *find(uint32_t frame)
+	{
+		Info *info = lookup(frame);
+		if (info)
+			return info;
+
+		/*
+		 * The slot of the frame is used by another frame. If that frame
+		 * is older, it should have been destroyed already. Otherwise the
+		 * frame has been destroyed and the lookup is stale.
+		 */
+		Slot &slot = *slots_[frame % slots_.size()];
+		if (slot.active)
+			LOG(FrameInfoTracker, Warning)
+				<< "Frame " << frame << " looked up while tracking "
+				<< (before(slot.info.frame, frame) ? "older" : "newer")
+				<< " frame " << slot.info.frame;
+
+		return nullptr;
+	}
+
+	Info *find(const Request *request)
+	{
+		Info *info = lookup(request);
+		if (info)
+			return info;
+
+		info = requests_[request->sequence() % requests_.size()];
+		if (info)
+			LOG(FrameInfoTracker, Warning)
+				<< "Request " << request->sequence()
+				<< " looked up while tracking request "
+				<< info->request->sequence();
+
+		return nullptr;
+	}
+
+	Info *find(const FrameBuffer *buffer)
+	{
+		Request *request = buffer->request();
+		if (!request)
+			return nullptr;
+
+		return find(request);
+	}
+
+	template<typename Func>
+	void forEach(Func &&func)
+	{
+		for (std::unique_ptr<Slot> &slot : slots_) {
+			if (slot->active)
+				func(slot->info);
+		}
+	}
+
+	bool empty() const { return !size_; }
+	size_t size() const { return size_; }
+	size_t capacity() const { return slots_.size(); }
+
+private:
+	struct Slot {
+		Info info{};
+		bool active = false;
+	};
+
+	/* Compare frame numbers, accounting for wrap-around. */
+	static bool before(uint32_t a, uint32_t b)
+	{
+		return static_cast<int32_t>(a - b) < 0;
+	}
+
+	Info *lookup(uint32_t frame)
+	{
+		Slot &slot = *slots_[frame % slots_.size()];
+		if (!slot.active || slot.info.frame != frame)
+			return nullptr;
+
+		return &slot.info;
+	}
+
+	Info *lookup(const Request *request)
+	{
+		Info *info = requests_[request->sequence() % requests_.size()];
+		if (!info || info->request != request)
+			return nullptr;
+
+		return info;
+	}
+
+	bool fits(size_t capacity, uint32_t frame, const Request *request) const
+	{
+		std::vector<bool> frames(capacity, false);
+		std::vector<bool> requests(capacity, false);
+
+		frames[frame % capacity] = true;
+		requests[request->sequence() % capacity] = true;
+
+		for (const std::unique_ptr<Slot> &slot : slots_) {
+			if (!slot->active)
+				continue;
+
+			size_t frameIndex = slot->info.frame % capacity;
+			size_t requestIndex = slot->info.request->sequence() % capacity;
+			if (frames[frameIndex] || requests[requestIndex])
+				return false;
+
+			frames[frameIndex] = true;
+			requests[requestIndex] = true;
+		}
+
+		return true;
+	}
+
+	void grow(uint32_t frame, const Request *request)
+	{
+		size_t capacity = slots_.size() * 2;
+		while (!fits(capacity, frame, request))
+			capacity *= 2;
+
+		LOG(FrameInfoTracker, Debug)
+			<< "Growing capacity from " << slots_.size() << " to "
+			<< capacity << " for frame " << frame;
+
+		/*
+		 * Move the active slots to their new index without moving the
+		 * entries in memory, to keep pointers to them valid.
+		 */
+		std::vector<std::unique_ptr<Slot>> slots =
+			std::exchange(slots_, std::vector<std::unique_ptr<Slot>>(capacity));
+		requests_.assign(capacity, nullptr);
+
+		for (std::unique_ptr<Slot> &slot : slots) {
+			if (!slot->active)
+				continue;
+
+			Info *info = &slot->info;
+			slots_[info->frame % capacity] = std::move(slot);
+			requests_[info->request->sequence() % capacity] = info;
+		}
+
+		for (std::unique_ptr<Slot> &slot : slots_) {
+			if (!slot)
+				slot = std::make_unique<Slot>();
+		}
+	}
+
+	std::vector<std::unique_ptr<Slot>> slots_;
+	std::vector<Info *> requests_;
+
+	uint32_t lastFrame_;
+	size_t size_;
+};
+
+} /* namespace libcamera */
@@ -35,10 +35,19 @@ public:
 	static std::unique_ptr<T> createIPA(PipelineHandler *pipe,
 					    uint32_t minVersion,
 					    uint32_t maxVersion)
+	{
+		return createIPA<T>(pipe, pipe->name(), minVersion, maxVersion);
+	}
+
+	template<typename T>
+	static std::unique_ptr<T> createIPA(PipelineHandler *pipe,
+					    const char *pipelineName,
+					    uint32_t minVersion,
+					    uint32_t maxVersion)
 	{
 		CameraManager *cm = pipe->cameraManager();
 		IPAManager *self = cm->_d()->ipaManager();
-		IPAModule *m = self->module(pipe, minVersion, maxVersion);
+		IPAModule *m = self->module(pipelineName, minVersion, maxVersion);
 		if (!m)
 			return nullptr;
 
@@ -63,7 +72,7 @@ private:
 		      std::vector<std::string> &files);
 	unsigned int addDir(const char *libDir, unsigned int maxDepth = 0);
 
-	IPAModule *module(PipelineHandler *pipe, uint32_t minVersion,
+	IPAModule *module(const char *pipelineName, uint32_t minVersion,
 			  uint32_t maxVersion);
 
 	bool isSignatureValid(IPAModule *ipa) const;
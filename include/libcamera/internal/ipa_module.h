@@ -38,6 +38,8 @@ public:
 
 	bool match(PipelineHandler *pipe,
 		   uint32_t minVersion, uint32_t maxVersion) const;
+	bool match(const char *pipelineName,
+		   uint32_t minVersion, uint32_t maxVersion) const;
 
 protected:
 	std::string logPrefix() const override;
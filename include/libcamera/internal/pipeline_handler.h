@@ -20,6 +20,7 @@
 
 namespace libcamera {
 
+struct BufferPoolUsage;
 class Camera;
 class CameraConfiguration;
 class CameraManager;
@@ -34,7 +35,8 @@ class PipelineHandler : public std::enable_shared_from_this<PipelineHandler>,
 			public Object
 {
 public:
-	PipelineHandler(CameraManager *manager);
+	PipelineHandler(CameraManager *manager,
+			unsigned int maxQueuedRequestsDevice = kDefaultMaxQueuedRequestsDevice);
 	virtual ~PipelineHandler();
 
 	virtual bool match(DeviceEnumerator *enumerator) = 0;
@@ -55,6 +57,8 @@ public:
 	void stop(Camera *camera);
 	bool hasPendingRequests(const Camera *camera) const;
 
+	virtual std::vector<BufferPoolUsage> internalBufferUsage(Camera *camera);
+
 	void registerRequest(Request *request);
 	void queueRequest(Request *request);
 
@@ -70,6 +74,8 @@ public:
 
 	CameraManager *cameraManager() const { return manager_; }
 
+	unsigned int maxQueuedRequestsDevice() const { return maxQueuedRequestsDevice_; }
+
 protected:
 	void registerCamera(std::shared_ptr<Camera> camera);
 	void hotplugMediaDevice(MediaDevice *media);
@@ -83,6 +89,8 @@ protected:
 	CameraManager *manager_;
 
 private:
+	static constexpr unsigned int kDefaultMaxQueuedRequestsDevice = 32;
+
 	void unlockMediaDevices();
 
 	void mediaDeviceDisconnected(MediaDevice *media);
@@ -90,11 +98,14 @@ private:
 
 	void doQueueRequest(Request *request);
 	void doQueueRequests();
+	void updateBufferUsage(Request *request, int64_t timestamp,
+			       int64_t latency);
 
 	std::vector<std::shared_ptr<MediaDevice>> mediaDevices_;
 	std::vector<std::weak_ptr<Camera>> cameras_;
 
 	std::queue<Request *> waitingRequests_;
+	const unsigned int maxQueuedRequestsDevice_;
 
 	const char *name_;
 	unsigned int useCount_;
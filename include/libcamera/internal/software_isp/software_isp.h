@@ -50,6 +50,10 @@ class SoftwareIsp : public Object
 public:
 	SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor,
 		    ControlInfoMap *ipaControls);
+	SoftwareIsp(PipelineHandler *pipe, const std::string &sensorModel,
+		    const IPACameraSensorInfo &sensorInfo,
+		    const ControlInfoMap &sensorControls,
+		    ControlInfoMap *ipaControls);
 	~SoftwareIsp();
 
 	int loadConfiguration([[maybe_unused]] const std::string &filename) { return 0; }
@@ -89,6 +93,10 @@ public:
 	Signal<const ControlList &> setSensorControls;
 
 private:
+	void init(PipelineHandler *pipe, const std::string &sensorModel,
+		  const IPACameraSensorInfo &sensorInfo,
+		  const ControlInfoMap &sensorControls,
+		  ControlInfoMap *ipaControls);
 	void saveIspParams();
 	void setSensorCtrls(const ControlList &sensorControls);
 	void statsReady(uint32_t frame, uint32_t bufferId);
@@ -8,12 +8,14 @@
 #pragma once
 
 #include <array>
+#include <list>
 #include <memory>
 #include <optional>
 #include <ostream>
 #include <queue>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -132,6 +134,9 @@ public:
 	int get(const FrameBuffer &buffer);
 	void put(unsigned int index);
 
+	uint64_t hits() const { return hitCounter_; }
+	uint64_t misses() const { return missCounter_; }
+
 private:
 	class Entry
 	{
@@ -141,8 +146,11 @@ private:
 
 		bool operator==(const FrameBuffer &buffer) const;
 
+		int key() const { return planes_.empty() ? -1 : planes_[0].fd; }
+
 		bool free_;
 		uint64_t lastUsed_;
+		std::list<unsigned int>::iterator lru_;
 
 	private:
 		struct Plane {
@@ -160,8 +168,11 @@ private:
 
 	uint64_t lastUsedCounter_;
 	std::vector<Entry> cache_;
-	/* \todo Expose the miss counter through an instrumentation API. */
-	unsigned int missCounter_;
+	std::unordered_map<int, unsigned int> index_;
+	std::list<unsigned int> lru_;
+	std::list<unsigned int> used_;
+	uint64_t hitCounter_;
+	uint64_t missCounter_;
 };
 
 class V4L2DeviceFormat
@@ -218,6 +229,9 @@ public:
 	int importBuffers(unsigned int count);
 	int releaseBuffers();
 
+	uint64_t bufferCacheHits() const;
+	uint64_t bufferCacheMisses() const;
+
 	int queueBuffer(FrameBuffer *buffer);
 	Signal<FrameBuffer *> bufferReady;
 
@@ -244,6 +258,12 @@ private:
 		Stopped,
 	};
 
+	struct DequeueStats {
+		uint64_t wakeups = 0;
+		uint64_t buffers = 0;
+		unsigned int maxBuffers = 0;
+	};
+
 	int initFormats();
 
 	int getFormatMeta(V4L2DeviceFormat *format);
@@ -290,6 +310,7 @@ private:
 
 	State state_;
 	std::optional<unsigned int> firstFrame_;
+	DequeueStats dequeueStats_;
 
 	Timer watchdog_;
 	utils::Duration watchdogDuration_;
@@ -195,6 +195,8 @@ public:
 			 std::is_same_v<uint16_t, T> ||
 			 std::is_same_v<int32_t, T> ||
 			 std::is_same_v<uint32_t, T> ||
+			 std::is_same_v<int64_t, T> ||
+			 std::is_same_v<uint64_t, T> ||
 			 std::is_same_v<std::string, T> ||
 			 std::is_same_v<Size, T>> * = nullptr>
 #else
@@ -8,6 +8,7 @@
 #include "camera_device.h"
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <set>
 #include <sys/mman.h>
@@ -437,6 +438,13 @@ void CameraDevice::stop()
 
 	camera_->stop();
 
+	/*
+	 * Wait for post-processing to complete before destroying the
+	 * descriptors and streams it operates on.
+	 */
+	if (postProcessorPool_)
+		postProcessorPool_->stop();
+
 	{
 		MutexLocker descriptorsLock(descriptorsMutex_);
 		descriptors_ = {};
@@ -444,6 +452,20 @@ void CameraDevice::stop()
 
 	streams_.clear();
 
+	{
+		MutexLocker resultMetadataLock(resultMetadataMutex_);
+		ResultMetadataStats &stats = resultMetadataStats_;
+
+		if (stats.frames)
+			LOG(HAL, Info)
+				<< "Built result metadata for " << stats.frames
+				<< " requests in " << stats.buildTime.count() / stats.frames
+				<< "us on average, with " << stats.allocations
+				<< " allocations";
+
+		stats = {};
+	}
+
 	state_ = State::Stopped;
 }
 
@@ -555,6 +577,9 @@ int CameraDevice::configureStreams(camera3_stream_configuration_t *stream_list)
 	streams_.clear();
 	streams_.reserve(stream_list->num_streams);
 
+	if (!postProcessorPool_)
+		postProcessorPool_ = std::make_unique<PostProcessorPool>();
+
 	std::vector<Camera3StreamConfig> streamConfigs;
 	streamConfigs.reserve(stream_list->num_streams);
 
@@ -1332,6 +1357,8 @@ void CameraDevice::sendCaptureResults()
 			captureResult.partial_result = 1;
 
 		callbacks_->process_capture_result(callbacks_, &captureResult);
+
+		releaseResultMetadata(std::move(descriptor->resultMetadata_));
 	}
 }
 
@@ -1418,36 +1445,19 @@ void CameraDevice::notifyError(uint32_t frameNumber, camera3_stream_t *stream,
 }
 
 /*
- * Produce a set of fixed result metadata.
+ * Produce the result metadata entries that don't depend on the request. They
+ * are copied into the result metadata of every request by getResultMetadata().
  */
-std::unique_ptr<CameraMetadata>
-CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) const
+std::unique_ptr<CameraMetadata> CameraDevice::createResultMetadataTemplate() const
 {
-	const ControlList &metadata = descriptor.request_->metadata();
-	const CameraMetadata &settings = descriptor.settings_;
-	camera_metadata_ro_entry_t entry;
-	bool found;
-
 	/*
 	 * \todo Keep this in sync with the actual number of entries.
-	 * Currently: 40 entries, 156 bytes
-	 *
-	 * Reserve more space for the JPEG metadata set by the post-processor.
-	 * Currently:
-	 * ANDROID_JPEG_GPS_COORDINATES (double x 3) = 24 bytes
-	 * ANDROID_JPEG_GPS_PROCESSING_METHOD (byte x 32) = 32 bytes
-	 * ANDROID_JPEG_GPS_TIMESTAMP (int64) = 8 bytes
-	 * ANDROID_JPEG_SIZE (int32_t) = 4 bytes
-	 * ANDROID_JPEG_QUALITY (byte) = 1 byte
-	 * ANDROID_JPEG_ORIENTATION (int32_t) = 4 bytes
-	 * ANDROID_JPEG_THUMBNAIL_QUALITY (byte) = 1 byte
-	 * ANDROID_JPEG_THUMBNAIL_SIZE (int32 x 2) = 8 bytes
-	 * Total bytes for JPEG metadata: 82
+	 * Currently: 28 entries, 8 bytes
 	 */
 	std::unique_ptr<CameraMetadata> resultMetadata =
-		std::make_unique<CameraMetadata>(88, 166);
+		std::make_unique<CameraMetadata>(28, 8);
 	if (!resultMetadata->isValid()) {
-		LOG(HAL, Error) << "Failed to allocate result metadata";
+		LOG(HAL, Error) << "Failed to allocate result metadata template";
 		return nullptr;
 	}
 
@@ -1474,20 +1484,6 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 	value = ANDROID_CONTROL_AE_MODE_ON;
 	resultMetadata->addEntry(ANDROID_CONTROL_AE_MODE, value);
 
-	if (settings.getEntry(ANDROID_CONTROL_AE_TARGET_FPS_RANGE, &entry))
-		/*
-		 * \todo Retrieve the AE FPS range from the libcamera metadata.
-		 * As libcamera does not support that control, as a temporary
-		 * workaround return what the framework asked.
-		 */
-		resultMetadata->addEntry(ANDROID_CONTROL_AE_TARGET_FPS_RANGE,
-					 entry.data.i32, 2);
-
-	found = settings.getEntry(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &entry);
-	value = found ? *entry.data.u8 :
-			(uint8_t)ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
-	resultMetadata->addEntry(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, value);
-
 	value = ANDROID_CONTROL_AE_STATE_CONVERGED;
 	resultMetadata->addEntry(ANDROID_CONTROL_AE_STATE, value);
 
@@ -1530,9 +1526,6 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 	value = ANDROID_FLASH_STATE_UNAVAILABLE;
 	resultMetadata->addEntry(ANDROID_FLASH_STATE, value);
 
-	if (settings.getEntry(ANDROID_LENS_APERTURE, &entry))
-		resultMetadata->addEntry(ANDROID_LENS_APERTURE, entry.data.f, 1);
-
 	float focal_length = 1.0;
 	resultMetadata->addEntry(ANDROID_LENS_FOCAL_LENGTH, focal_length);
 
@@ -1546,10 +1539,6 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 	value32 = ANDROID_SENSOR_TEST_PATTERN_MODE_OFF;
 	resultMetadata->addEntry(ANDROID_SENSOR_TEST_PATTERN_MODE, value32);
 
-	if (settings.getEntry(ANDROID_STATISTICS_FACE_DETECT_MODE, &entry))
-		resultMetadata->addEntry(ANDROID_STATISTICS_FACE_DETECT_MODE,
-					 entry.data.u8, 1);
-
 	value = ANDROID_STATISTICS_LENS_SHADING_MAP_MODE_OFF;
 	resultMetadata->addEntry(ANDROID_STATISTICS_LENS_SHADING_MAP_MODE,
 				 value);
@@ -1568,6 +1557,118 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 	resultMetadata->addEntry(ANDROID_SENSOR_ROLLING_SHUTTER_SKEW,
 				 rolling_shutter_skew);
 
+	if (!resultMetadata->isValid()) {
+		LOG(HAL, Error) << "Failed to construct result metadata template";
+		return nullptr;
+	}
+
+	return resultMetadata;
+}
+
+/*
+ * Get a result metadata buffer, reusing a buffer released by a previous request
+ * when available, initialized with the result metadata template.
+ */
+std::unique_ptr<CameraMetadata> CameraDevice::acquireResultMetadata()
+{
+	MutexLocker locker(resultMetadataMutex_);
+
+	if (!resultMetadataTemplate_) {
+		resultMetadataTemplate_ = createResultMetadataTemplate();
+		if (!resultMetadataTemplate_)
+			return nullptr;
+	}
+
+	std::unique_ptr<CameraMetadata> resultMetadata;
+
+	if (!resultMetadataPool_.empty()) {
+		resultMetadata = std::move(resultMetadataPool_.back());
+		resultMetadataPool_.pop_back();
+	} else {
+		/*
+		 * \todo Keep this in sync with the actual number of entries.
+		 * Currently: 40 entries, 156 bytes
+		 *
+		 * Reserve more space for the JPEG metadata set by the
+		 * post-processor. Currently:
+		 * ANDROID_JPEG_GPS_COORDINATES (double x 3) = 24 bytes
+		 * ANDROID_JPEG_GPS_PROCESSING_METHOD (byte x 32) = 32 bytes
+		 * ANDROID_JPEG_GPS_TIMESTAMP (int64) = 8 bytes
+		 * ANDROID_JPEG_SIZE (int32_t) = 4 bytes
+		 * ANDROID_JPEG_QUALITY (byte) = 1 byte
+		 * ANDROID_JPEG_ORIENTATION (int32_t) = 4 bytes
+		 * ANDROID_JPEG_THUMBNAIL_QUALITY (byte) = 1 byte
+		 * ANDROID_JPEG_THUMBNAIL_SIZE (int32 x 2) = 8 bytes
+		 * Total bytes for JPEG metadata: 82
+		 */
+		resultMetadata = std::make_unique<CameraMetadata>(88, 166);
+		resultMetadataStats_.allocations++;
+	}
+
+	if (!resultMetadata->assign(*resultMetadataTemplate_)) {
+		LOG(HAL, Error) << "Failed to allocate result metadata";
+		return nullptr;
+	}
+
+	return resultMetadata;
+}
+
+/*
+ * Return a result metadata buffer to the pool once the capture result has been
+ * sent to the framework, which copies the metadata.
+ */
+void CameraDevice::releaseResultMetadata(std::unique_ptr<CameraMetadata> resultMetadata)
+{
+	if (!resultMetadata)
+		return;
+
+	MutexLocker locker(resultMetadataMutex_);
+
+	if (resultMetadata->resized())
+		resultMetadataStats_.allocations++;
+
+	resultMetadataPool_.push_back(std::move(resultMetadata));
+}
+
+/*
+ * Produce the result metadata for a request from the result metadata template
+ * and the entries that change with each request.
+ */
+std::unique_ptr<CameraMetadata>
+CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor)
+{
+	const ControlList &metadata = descriptor.request_->metadata();
+	const CameraMetadata &settings = descriptor.settings_;
+	camera_metadata_ro_entry_t entry;
+	bool found;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::unique_ptr<CameraMetadata> resultMetadata = acquireResultMetadata();
+	if (!resultMetadata)
+		return nullptr;
+
+	if (settings.getEntry(ANDROID_CONTROL_AE_TARGET_FPS_RANGE, &entry))
+		/*
+		 * \todo Retrieve the AE FPS range from the libcamera metadata.
+		 * As libcamera does not support that control, as a temporary
+		 * workaround return what the framework asked.
+		 */
+		resultMetadata->addEntry(ANDROID_CONTROL_AE_TARGET_FPS_RANGE,
+					 entry.data.i32, 2);
+
+	found = settings.getEntry(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &entry);
+	uint8_t value = found ? *entry.data.u8 :
+				(uint8_t)ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
+	resultMetadata->addEntry(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, value);
+
+	if (settings.getEntry(ANDROID_LENS_APERTURE, &entry))
+		resultMetadata->addEntry(ANDROID_LENS_APERTURE, entry.data.f, 1);
+
+	if (settings.getEntry(ANDROID_STATISTICS_FACE_DETECT_MODE, &entry))
+		resultMetadata->addEntry(ANDROID_STATISTICS_FACE_DETECT_MODE,
+					 entry.data.u8, 1);
+
 	/* Add metadata tags reported by libcamera. */
 	const int64_t timestamp = metadata.get(controls::SensorTimestamp).value_or(0);
 	resultMetadata->addEntry(ANDROID_SENSOR_TIMESTAMP, timestamp);
@@ -1654,8 +1755,8 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 
 	const auto &testPatternMode = metadata.get(controls::draft::TestPatternMode);
 	if (testPatternMode)
-		resultMetadata->addEntry(ANDROID_SENSOR_TEST_PATTERN_MODE,
-					 *testPatternMode);
+		resultMetadata->updateEntry(ANDROID_SENSOR_TEST_PATTERN_MODE,
+					    *testPatternMode);
 
 	/*
 	 * Return the result metadata pack even is not valid: get() will return
@@ -1672,5 +1773,13 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 			<< " entries and " << dataCount << " bytes used";
 	}
 
+	std::chrono::microseconds duration =
+		std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start);
+
+	MutexLocker locker(resultMetadataMutex_);
+	resultMetadataStats_.frames++;
+	resultMetadataStats_.buildTime += duration;
+
 	return resultMetadata;
 }
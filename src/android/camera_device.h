@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <map>
 #include <memory>
 #include <queue>
@@ -31,6 +32,7 @@
 #include "camera_stream.h"
 #include "hal_framebuffer.h"
 #include "jpeg/encoder.h"
+#include "post_processor_pool.h"
 
 class Camera3RequestDescriptor;
 struct CameraConfigData;
@@ -58,6 +60,7 @@ public:
 	int facing() const { return facing_; }
 	int orientation() const { return orientation_; }
 	unsigned int maxJpegBufferSize() const;
+	PostProcessorPool *postProcessorPool() const { return postProcessorPool_.get(); }
 
 	void setCallbacks(const camera3_callback_ops_t *callbacks);
 	const camera_metadata_t *getStaticMetadata();
@@ -99,8 +102,14 @@ private:
 	void sendCaptureResults() LIBCAMERA_TSA_REQUIRES(descriptorsMutex_);
 	void setBufferStatus(Camera3RequestDescriptor::StreamBuffer &buffer,
 			     Camera3RequestDescriptor::Status status);
+	std::unique_ptr<CameraMetadata> createResultMetadataTemplate() const;
+	std::unique_ptr<CameraMetadata> acquireResultMetadata()
+		LIBCAMERA_TSA_EXCLUDES(resultMetadataMutex_);
+	void releaseResultMetadata(std::unique_ptr<CameraMetadata> resultMetadata)
+		LIBCAMERA_TSA_EXCLUDES(resultMetadataMutex_);
 	std::unique_ptr<CameraMetadata> getResultMetadata(
-		const Camera3RequestDescriptor &descriptor) const;
+		const Camera3RequestDescriptor &descriptor)
+		LIBCAMERA_TSA_EXCLUDES(resultMetadataMutex_);
 
 	unsigned int id_;
 	camera3_device_t camera3Device_;
@@ -116,11 +125,27 @@ private:
 	const camera3_callback_ops_t *callbacks_;
 
 	std::vector<CameraStream> streams_;
+	/* Declared after streams_ to be destroyed first. */
+	std::unique_ptr<PostProcessorPool> postProcessorPool_;
 
 	libcamera::Mutex descriptorsMutex_ LIBCAMERA_TSA_ACQUIRED_AFTER(stateMutex_);
 	std::queue<std::unique_ptr<Camera3RequestDescriptor>> descriptors_
 		LIBCAMERA_TSA_GUARDED_BY(descriptorsMutex_);
 
+	struct ResultMetadataStats {
+		unsigned int frames = 0;
+		unsigned int allocations = 0;
+		std::chrono::microseconds buildTime{ 0 };
+	};
+
+	libcamera::Mutex resultMetadataMutex_;
+	std::unique_ptr<CameraMetadata> resultMetadataTemplate_
+		LIBCAMERA_TSA_GUARDED_BY(resultMetadataMutex_);
+	std::vector<std::unique_ptr<CameraMetadata>> resultMetadataPool_
+		LIBCAMERA_TSA_GUARDED_BY(resultMetadataMutex_);
+	ResultMetadataStats resultMetadataStats_
+		LIBCAMERA_TSA_GUARDED_BY(resultMetadataMutex_);
+
 	std::string maker_;
 	std::string model_;
 
@@ -7,6 +7,8 @@
 
 #include "camera_metadata.h"
 
+#include <algorithm>
+
 #include <libcamera/base/log.h>
 
 using namespace libcamera;
@@ -57,6 +59,57 @@ CameraMetadata &CameraMetadata::operator=(const CameraMetadata &other)
 	return *this;
 }
 
+/*
+ * \brief Replace the entries of the container with the entries of \a other
+ * \param[in] other The metadata to copy
+ *
+ * Unlike the copy assignment operator, the existing buffer is reused when its
+ * capacity is large enough to store the entries of \a other, avoiding a memory
+ * allocation. The resized() flag is reset.
+ *
+ * \return True on success, false otherwise
+ */
+bool CameraMetadata::assign(const CameraMetadata &other)
+{
+	const camera_metadata_t *src = other.getMetadata();
+	if (!src || src == metadata_)
+		return src != nullptr;
+
+	size_t entryCapacity = 0;
+	size_t dataCapacity = 0;
+	if (metadata_) {
+		entryCapacity = get_camera_metadata_entry_capacity(metadata_);
+		dataCapacity = get_camera_metadata_data_capacity(metadata_);
+	}
+
+	if (entryCapacity >= get_camera_metadata_entry_count(src) &&
+	    dataCapacity >= get_camera_metadata_data_count(src)) {
+		place_camera_metadata(metadata_, get_camera_metadata_size(metadata_),
+				      entryCapacity, dataCapacity);
+	} else {
+		entryCapacity = std::max(entryCapacity,
+					 get_camera_metadata_entry_capacity(src));
+		dataCapacity = std::max(dataCapacity,
+					get_camera_metadata_data_capacity(src));
+
+		camera_metadata_t *metadata =
+			allocate_camera_metadata(entryCapacity, dataCapacity);
+		if (!metadata) {
+			valid_ = false;
+			return false;
+		}
+
+		if (metadata_)
+			free_camera_metadata(metadata_);
+		metadata_ = metadata;
+	}
+
+	valid_ = !append_camera_metadata(metadata_, src);
+	resized_ = false;
+
+	return valid_;
+}
+
 std::tuple<size_t, size_t> CameraMetadata::usage() const
 {
 	size_t currentEntryCount = get_camera_metadata_entry_count(metadata_);
@@ -22,6 +22,7 @@ public:
 	~CameraMetadata();
 
 	CameraMetadata &operator=(const CameraMetadata &other);
+	bool assign(const CameraMetadata &other);
 
 	std::tuple<size_t, size_t> usage() const;
 	bool resized() const { return resized_; }
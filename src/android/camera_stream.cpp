@@ -24,6 +24,7 @@
 #include "camera_metadata.h"
 #include "frame_buffer_allocator.h"
 #include "post_processor.h"
+#include "post_processor_pool.h"
 
 using namespace libcamera;
 
@@ -70,6 +71,22 @@ CameraStream::~CameraStream()
 	 */
 	allocatedBuffers_.clear();
 	allocator_.reset();
+
+	if (!mutex_)
+		return;
+
+	MutexLocker locker(*mutex_);
+
+	if (!stats_.count)
+		return;
+
+	LOG(HAL, Info)
+		<< "Post-processed " << stats_.count << " frames of stream "
+		<< index_ << " with " << postProcessors_.size()
+		<< " post-processors: queue wait "
+		<< stats_.queueWait.count() / stats_.count << "us (max "
+		<< stats_.maxQueueWait.count() << "us), processing "
+		<< stats_.processing.count() / stats_.count << "us";
 }
 
 const StreamConfiguration &CameraStream::configuration() const
@@ -84,56 +101,56 @@ Stream *CameraStream::stream() const
 
 int CameraStream::configure()
 {
+	mutex_ = std::make_unique<Mutex>();
+
 	if (type_ == Type::Internal || type_ == Type::Mapped) {
-		const PixelFormat outFormat =
+		outputConfig_ = configuration();
+		outputConfig_.pixelFormat =
 			cameraDevice_->capabilities()->toPixelFormat(camera3Stream_->format);
-		StreamConfiguration output = configuration();
-		output.pixelFormat = outFormat;
-		output.size.width = camera3Stream_->width;
-		output.size.height = camera3Stream_->height;
-
-		switch (outFormat) {
-		case formats::NV12:
-			postProcessor_ = std::make_unique<PostProcessorYuv>();
-			break;
-
-		case formats::MJPEG:
-			postProcessor_ = std::make_unique<PostProcessorJpeg>(cameraDevice_);
-			break;
-
-		default:
-			LOG(HAL, Error) << "Unsupported format: " << outFormat;
+		outputConfig_.size.width = camera3Stream_->width;
+		outputConfig_.size.height = camera3Stream_->height;
+
+		std::unique_ptr<PostProcessor> postProcessor = createPostProcessor();
+		if (!postProcessor)
 			return -EINVAL;
-		}
 
-		int ret = postProcessor_->configure(configuration(), output);
-		if (ret)
-			return ret;
+		MutexLocker locker(*mutex_);
+		idlePostProcessors_.push_back(postProcessor.get());
+		postProcessors_.push_back(std::move(postProcessor));
+	}
+
+	allocator_ = std::make_unique<PlatformFrameBufferAllocator>(cameraDevice_);
+
+	camera3Stream_->max_buffers = configuration().bufferCount;
 
-		worker_ = std::make_unique<PostProcessorWorker>(postProcessor_.get());
-		postProcessor_->processComplete.connect(
-			this, [&](Camera3RequestDescriptor::StreamBuffer *streamBuffer,
-				  PostProcessor::Status status) {
-				Camera3RequestDescriptor::Status bufferStatus;
+	return 0;
+}
+
+std::unique_ptr<PostProcessor> CameraStream::createPostProcessor()
+{
+	std::unique_ptr<PostProcessor> postProcessor;
 
-				if (status == PostProcessor::Status::Success)
-					bufferStatus = Camera3RequestDescriptor::Status::Success;
-				else
-					bufferStatus = Camera3RequestDescriptor::Status::Error;
+	switch (outputConfig_.pixelFormat) {
+	case formats::NV12:
+		postProcessor = std::make_unique<PostProcessorYuv>();
+		break;
 
-				cameraDevice_->streamProcessingComplete(streamBuffer,
-									bufferStatus);
-			});
+	case formats::MJPEG:
+		postProcessor = std::make_unique<PostProcessorJpeg>(cameraDevice_);
+		break;
 
-		worker_->start();
+	default:
+		LOG(HAL, Error) << "Unsupported format: " << outputConfig_.pixelFormat;
+		return nullptr;
 	}
 
-	allocator_ = std::make_unique<PlatformFrameBufferAllocator>(cameraDevice_);
-	mutex_ = std::make_unique<Mutex>();
+	int ret = postProcessor->configure(configuration(), outputConfig_);
+	if (ret)
+		return nullptr;
 
-	camera3Stream_->max_buffers = configuration().bufferCount;
+	postProcessor->processComplete.connect(this, &CameraStream::postProcessingComplete);
 
-	return 0;
+	return postProcessor;
 }
 
 int CameraStream::waitFence(int fence)
@@ -191,17 +208,17 @@ int CameraStream::process(Camera3RequestDescriptor::StreamBuffer *streamBuffer)
 		return -EINVAL;
 	}
 
-	worker_->queueRequest(streamBuffer);
+	cameraDevice_->postProcessorPool()->queue(this, streamBuffer);
 
 	return 0;
 }
 
 void CameraStream::flush()
 {
-	if (!postProcessor_)
+	if (type_ == Type::Direct || !mutex_)
 		return;
 
-	worker_->flush();
+	cameraDevice_->postProcessorPool()->cancel(this);
 }
 
 FrameBuffer *CameraStream::getBuffer()
@@ -244,98 +261,70 @@ void CameraStream::putBuffer(FrameBuffer *buffer)
 	buffers_.push_back(buffer);
 }
 
-/**
- * \class CameraStream::PostProcessorWorker
- * \brief Post-process a CameraStream in an internal thread
- *
- * If the association between CameraStream and camera3_stream_t dictated by
- * CameraStream::Type is internal or mapped, the stream is generated by post
- * processing of a libcamera stream. Such a request is queued to a
- * PostProcessorWorker in CameraStream::process(). A queue of post-processing
- * requests is maintained by the PostProcessorWorker and it will run the
- * post-processing on an internal thread as soon as any request is available on
- * its queue.
+/*
+ * Run post-processing for a request on a thread of the PostProcessorPool. An
+ * idle post-processor is used if available, or a new one is created otherwise.
  */
-CameraStream::PostProcessorWorker::PostProcessorWorker(PostProcessor *postProcessor)
-	: postProcessor_(postProcessor)
-{
-}
-
-CameraStream::PostProcessorWorker::~PostProcessorWorker()
-{
-	{
-		MutexLocker lock(mutex_);
-		state_ = State::Stopped;
-	}
-
-	cv_.notify_one();
-	wait();
-}
-
-void CameraStream::PostProcessorWorker::start()
+void CameraStream::postProcess(Camera3RequestDescriptor::StreamBuffer *streamBuffer,
+			       std::chrono::steady_clock::time_point queued)
 {
-	{
-		MutexLocker lock(mutex_);
-		ASSERT(state_ != State::Running);
-		state_ = State::Running;
-	}
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	using std::chrono::steady_clock;
 
-	Thread::start();
-}
+	steady_clock::time_point start = steady_clock::now();
+	PostProcessor *postProcessor = nullptr;
 
-void CameraStream::PostProcessorWorker::queueRequest(Camera3RequestDescriptor::StreamBuffer *dest)
-{
 	{
-		MutexLocker lock(mutex_);
-		ASSERT(state_ == State::Running);
-		requests_.push(dest);
+		MutexLocker locker(*mutex_);
+		if (!idlePostProcessors_.empty()) {
+			postProcessor = idlePostProcessors_.back();
+			idlePostProcessors_.pop_back();
+		}
 	}
 
-	cv_.notify_one();
-}
-
-void CameraStream::PostProcessorWorker::run()
-{
-	MutexLocker locker(mutex_);
-
-	while (1) {
-		cv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
-			return state_ != State::Running || !requests_.empty();
-		});
+	if (!postProcessor) {
+		std::unique_ptr<PostProcessor> instance = createPostProcessor();
+		if (!instance) {
+			postProcessingComplete(streamBuffer, PostProcessor::Status::Error);
+			return;
+		}
 
-		if (state_ != State::Running)
-			break;
+		postProcessor = instance.get();
 
-		Camera3RequestDescriptor::StreamBuffer *streamBuffer = requests_.front();
-		requests_.pop();
-		locker.unlock();
+		MutexLocker locker(*mutex_);
+		postProcessors_.push_back(std::move(instance));
+	}
 
-		postProcessor_->process(streamBuffer);
+	/* The streamBuffer may be freed once processing completes. */
+	postProcessor->process(streamBuffer);
 
-		locker.lock();
-	}
+	steady_clock::time_point end = steady_clock::now();
+	microseconds queueWait = duration_cast<microseconds>(start - queued);
 
-	if (state_ == State::Flushing) {
-		std::queue<Camera3RequestDescriptor::StreamBuffer *> requests =
-			std::move(requests_);
-		locker.unlock();
+	MutexLocker locker(*mutex_);
+	idlePostProcessors_.push_back(postProcessor);
 
-		while (!requests.empty()) {
-			postProcessor_->processComplete.emit(
-				requests.front(), PostProcessor::Status::Error);
-			requests.pop();
-		}
+	stats_.count++;
+	stats_.queueWait += queueWait;
+	stats_.maxQueueWait = std::max(stats_.maxQueueWait, queueWait);
+	stats_.processing += duration_cast<microseconds>(end - start);
+}
 
-		locker.lock();
-		state_ = State::Stopped;
-	}
+void CameraStream::cancelPostProcessing(Camera3RequestDescriptor::StreamBuffer *streamBuffer)
+{
+	postProcessingComplete(streamBuffer, PostProcessor::Status::Error);
 }
 
-void CameraStream::PostProcessorWorker::flush()
+void CameraStream::postProcessingComplete(Camera3RequestDescriptor::StreamBuffer *streamBuffer,
+					  PostProcessor::Status status)
 {
-	MutexLocker lock(mutex_);
-	state_ = State::Flushing;
-	lock.unlock();
+	Camera3RequestDescriptor::Status bufferStatus;
+
+	if (status == PostProcessor::Status::Success)
+		bufferStatus = Camera3RequestDescriptor::Status::Success;
+	else
+		bufferStatus = Camera3RequestDescriptor::Status::Error;
 
-	cv_.notify_one();
+	cameraDevice_->streamProcessingComplete(streamBuffer, bufferStatus);
 }
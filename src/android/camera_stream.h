@@ -7,14 +7,13 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
-#include <queue>
 #include <vector>
 
 #include <hardware/camera3.h>
 
 #include <libcamera/base/mutex.h>
-#include <libcamera/base/thread.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/framebuffer.h>
@@ -133,37 +132,22 @@ public:
 	void flush();
 
 private:
-	class PostProcessorWorker : public libcamera::Thread
-	{
-	public:
-		enum class State {
-			Stopped,
-			Running,
-			Flushing,
-		};
+	friend class PostProcessorPool;
 
-		PostProcessorWorker(PostProcessor *postProcessor);
-		~PostProcessorWorker();
-
-		void start();
-		void queueRequest(Camera3RequestDescriptor::StreamBuffer *request);
-		void flush();
-
-	protected:
-		void run() override;
-
-	private:
-		PostProcessor *postProcessor_;
-
-		libcamera::Mutex mutex_;
-		libcamera::ConditionVariable cv_;
-
-		std::queue<Camera3RequestDescriptor::StreamBuffer *> requests_
-			LIBCAMERA_TSA_GUARDED_BY(mutex_);
-
-		State state_ LIBCAMERA_TSA_GUARDED_BY(mutex_) = State::Stopped;
+	struct ProcessingStats {
+		unsigned int count = 0;
+		std::chrono::microseconds queueWait{ 0 };
+		std::chrono::microseconds maxQueueWait{ 0 };
+		std::chrono::microseconds processing{ 0 };
 	};
 
+	std::unique_ptr<PostProcessor> createPostProcessor();
+	void postProcess(Camera3RequestDescriptor::StreamBuffer *streamBuffer,
+			 std::chrono::steady_clock::time_point queued);
+	void cancelPostProcessing(Camera3RequestDescriptor::StreamBuffer *streamBuffer);
+	void postProcessingComplete(Camera3RequestDescriptor::StreamBuffer *streamBuffer,
+				    PostProcessor::Status status);
+
 	int waitFence(int fence);
 
 	CameraDevice *const cameraDevice_;
@@ -181,7 +165,15 @@ private:
 	 * an std::vector in CameraDevice.
 	 */
 	std::unique_ptr<libcamera::Mutex> mutex_;
-	std::unique_ptr<PostProcessor> postProcessor_;
 
-	std::unique_ptr<PostProcessorWorker> worker_;
+	/*
+	 * Post-processors are not reentrant, one instance is created for each
+	 * request processed concurrently, up to the size of the thread pool.
+	 */
+	libcamera::StreamConfiguration outputConfig_;
+	std::vector<std::unique_ptr<PostProcessor>> postProcessors_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::vector<PostProcessor *> idlePostProcessors_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	ProcessingStats stats_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
 };
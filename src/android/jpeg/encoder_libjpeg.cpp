@@ -7,15 +7,19 @@
 
 #include "encoder_libjpeg.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdlib.h>
 #include <string.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/formats.h>
@@ -68,19 +72,68 @@ const struct JPEGPixelFormatInfo &findPixelInfo(const PixelFormat &format)
 	return iter->second;
 }
 
+/*
+ * Locate the entropy-coded data in a JPEG stream produced by libjpeg, right
+ * after the start of scan header, and optionally the start of frame marker.
+ * Return 0 if the stream can't be parsed.
+ */
+size_t scanDataOffset(Span<const uint8_t> jpeg, size_t *sofOffset = nullptr)
+{
+	/* Skip the SOI marker. */
+	size_t offset = 2;
+
+	while (offset + 4 <= jpeg.size()) {
+		if (jpeg[offset] != 0xff)
+			return 0;
+
+		uint8_t marker = jpeg[offset + 1];
+		size_t length = (jpeg[offset + 2] << 8) | jpeg[offset + 3];
+
+		if (marker >= 0xc0 && marker <= 0xc2 && sofOffset)
+			*sofOffset = offset;
+
+		offset += 2 + length;
+
+		if (marker == 0xda)
+			return offset <= jpeg.size() ? offset : 0;
+	}
+
+	return 0;
+}
+
 } /* namespace */
 
-EncoderLibJpeg::EncoderLibJpeg()
+EncoderLibJpeg::Band::Band()
+	: firstRow(0), output(nullptr), outputSize(0)
 {
 	/* \todo Expand error handling coverage with a custom handler. */
-	compress_.err = jpeg_std_error(&jerr_);
+	compress.err = jpeg_std_error(&jerr);
+
+	jpeg_create_compress(&compress);
+}
+
+EncoderLibJpeg::Band::~Band()
+{
+	jpeg_destroy_compress(&compress);
+}
 
-	jpeg_create_compress(&compress_);
+EncoderLibJpeg::EncoderLibJpeg()
+	: source_(nullptr), nextBand_(0), pendingBands_(0), exiting_(false)
+{
+	bands_.push_back(std::make_unique<Band>());
 }
 
 EncoderLibJpeg::~EncoderLibJpeg()
 {
-	jpeg_destroy_compress(&compress_);
+	{
+		MutexLocker locker(mutex_);
+		exiting_ = true;
+	}
+
+	workCv_.notify_all();
+
+	for (std::unique_ptr<Worker> &worker : workers_)
+		worker->wait();
 }
 
 int EncoderLibJpeg::configure(const StreamConfiguration &cfg)
@@ -89,94 +142,207 @@ int EncoderLibJpeg::configure(const StreamConfiguration &cfg)
 	if (info.colorSpace == JCS_UNKNOWN)
 		return -ENOTSUP;
 
-	compress_.image_width = cfg.size.width;
-	compress_.image_height = cfg.size.height;
-	compress_.in_color_space = info.colorSpace;
-
-	compress_.input_components = info.colorSpace == JCS_GRAYSCALE ? 1 : 3;
-
-	jpeg_set_defaults(&compress_);
+	size_ = cfg.size;
+	colorSpace_ = info.colorSpace;
 
 	pixelFormatInfo_ = &info.pixelFormatInfo;
 
 	nv_ = pixelFormatInfo_->numPlanes() == 2;
 	nvSwap_ = info.nvSwap;
 
+	if (nv_) {
+		unsigned int c_stride = pixelFormatInfo_->stride(size_.width, 1);
+
+		horzSubSample_ = 2 * size_.width / c_stride;
+		vertSubSample_ = pixelFormatInfo_->planes[1].verticalSubSampling;
+	}
+
+	/*
+	 * Split large NV images in horizontal bands of whole MCU rows,
+	 * compressed in parallel and stitched together with restart markers.
+	 * The restart interval is stored on 16 bits, use a single band if the
+	 * bands would be too large.
+	 */
+	unsigned int numBands = 1;
+	unsigned int bandHeight = size_.height;
+	unsigned int restartInterval = 0;
+
+	if (nv_ && size_.width * size_.height >= kMinBandedPixels) {
+		unsigned int mcuWidth = horzSubSample_ * DCTSIZE;
+		unsigned int mcuHeight = vertSubSample_ * DCTSIZE;
+		unsigned int mcusPerRow = (size_.width + mcuWidth - 1) / mcuWidth;
+		unsigned int mcuRows = (size_.height + mcuHeight - 1) / mcuHeight;
+
+		unsigned int threads = std::clamp(std::thread::hardware_concurrency(),
+						  1U, kMaxBands);
+		unsigned int bandMcuRows = (mcuRows + threads - 1) / threads;
+
+		if (bandMcuRows * mcusPerRow <= 0xffff) {
+			bandHeight = bandMcuRows * mcuHeight;
+			numBands = (size_.height + bandHeight - 1) / bandHeight;
+			restartInterval = bandMcuRows * mcusPerRow;
+		}
+	}
+
+	if (numBands == 1) {
+		bandHeight = size_.height;
+		restartInterval = 0;
+	}
+
+	while (bands_.size() < numBands)
+		bands_.push_back(std::make_unique<Band>());
+	bands_.resize(numBands);
+
+	/*
+	 * The first band is compressed by the calling thread. Keep the worker
+	 * threads for the other bands running across encodes, as the encoder
+	 * may be reconfigured with fewer bands and back.
+	 */
+	while (workers_.size() + 1 < numBands) {
+		workers_.push_back(std::make_unique<Worker>(this));
+		workers_.back()->start();
+	}
+
+	for (unsigned int i = 0; i < numBands; i++) {
+		unsigned int firstRow = i * bandHeight;
+
+		configureBand(bands_[i].get(), firstRow,
+			      std::min(bandHeight, size_.height - firstRow),
+			      restartInterval);
+	}
+
 	return 0;
 }
 
-void EncoderLibJpeg::compressRGB(const std::vector<Span<uint8_t>> &planes)
+void EncoderLibJpeg::configureBand(Band *band, unsigned int firstRow,
+				   unsigned int height, unsigned int restartInterval)
+{
+	struct jpeg_compress_struct *compress = &band->compress;
+
+	compress->image_width = size_.width;
+	compress->image_height = height;
+	compress->in_color_space = colorSpace_;
+
+	compress->input_components = colorSpace_ == JCS_GRAYSCALE ? 1 : 3;
+
+	jpeg_set_defaults(compress);
+
+	/*
+	 * Feed NV formats as raw planar data to skip the colour conversion and
+	 * downsampling stages. The subsampling factors of the luma component
+	 * match the chroma subsampling of the format.
+	 */
+	if (nv_) {
+		compress->raw_data_in = TRUE;
+
+		compress->comp_info[0].h_samp_factor = horzSubSample_;
+		compress->comp_info[0].v_samp_factor = vertSubSample_;
+		for (unsigned int i = 1; i < 3; i++) {
+			compress->comp_info[i].h_samp_factor = 1;
+			compress->comp_info[i].v_samp_factor = 1;
+		}
+	}
+
+	compress->restart_interval = restartInterval;
+
+	band->firstRow = firstRow;
+}
+
+void EncoderLibJpeg::compressRGB(Band *band, const std::vector<Span<uint8_t>> &planes)
 {
+	struct jpeg_compress_struct *compress = &band->compress;
 	unsigned char *src = const_cast<unsigned char *>(planes[0].data());
 	/* \todo Stride information should come from buffer configuration. */
-	unsigned int stride = pixelFormatInfo_->stride(compress_.image_width, 0);
+	unsigned int stride = pixelFormatInfo_->stride(compress->image_width, 0);
 
 	JSAMPROW row_pointer[1];
 
-	while (compress_.next_scanline < compress_.image_height) {
-		row_pointer[0] = &src[compress_.next_scanline * stride];
-		jpeg_write_scanlines(&compress_, row_pointer, 1);
+	while (compress->next_scanline < compress->image_height) {
+		row_pointer[0] = &src[compress->next_scanline * stride];
+		jpeg_write_scanlines(compress, row_pointer, 1);
 	}
 }
 
 /*
- * Compress the incoming buffer from a supported NV format.
- * This naively unpacks the semi-planar NV12 to a YUV888 format for libjpeg.
+ * Compress the rows of a band from a supported NV format, using the libjpeg
+ * raw data API. Luma rows are passed to libjpeg in place, and only the chroma
+ * samples are deinterleaved to line buffers.
  */
-void EncoderLibJpeg::compressNV(const std::vector<Span<uint8_t>> &planes)
+void EncoderLibJpeg::compressNV(Band *band, const std::vector<Span<uint8_t>> &planes)
 {
-	std::vector<uint8_t> tmprowbuf(compress_.image_width * 3);
+	struct jpeg_compress_struct *compress = &band->compress;
+
+	/* \todo Stride information should come from buffer configuration. */
+	unsigned int y_stride = pixelFormatInfo_->stride(size_.width, 0);
+	unsigned int c_stride = pixelFormatInfo_->stride(size_.width, 1);
+
+	unsigned int cb_pos = nvSwap_ ? 1 : 0;
+	unsigned int cr_pos = nvSwap_ ? 0 : 1;
+
+	unsigned int chromaWidth = (size_.width + horzSubSample_ - 1) / horzSubSample_;
+	unsigned int chromaHeight = (size_.height + vertSubSample_ - 1) / vertSubSample_;
 
 	/*
-	 * \todo Use the raw api, and only unpack the cb/cr samples to new line
-	 * buffers. If possible, see if we can set appropriate pixel strides
-	 * too to save even that copy.
-	 *
-	 * Possible hints at:
-	 * https://sourceforge.net/p/libjpeg/mailman/message/30815123/
+	 * libjpeg reads complete DCT blocks, past the end of the image lines.
+	 * Copy the luma lines to padded line buffers when the stride doesn't
+	 * cover the padding.
 	 */
-	unsigned int y_stride = pixelFormatInfo_->stride(compress_.image_width, 0);
-	unsigned int c_stride = pixelFormatInfo_->stride(compress_.image_width, 1);
+	unsigned int y_width = compress->comp_info[0].width_in_blocks * DCTSIZE;
+	unsigned int c_width = compress->comp_info[1].width_in_blocks * DCTSIZE;
+	unsigned int y_rows = vertSubSample_ * DCTSIZE;
+	bool copyLuma = y_stride < y_width;
 
-	unsigned int horzSubSample = 2 * compress_.image_width / c_stride;
-	unsigned int vertSubSample = pixelFormatInfo_->planes[1].verticalSubSampling;
+	band->lines.resize(2 * DCTSIZE * c_width + (copyLuma ? y_rows * y_width : 0));
+	uint8_t *cb_lines = band->lines.data();
+	uint8_t *cr_lines = cb_lines + DCTSIZE * c_width;
+	uint8_t *y_lines = cr_lines + DCTSIZE * c_width;
 
-	unsigned int c_inc = horzSubSample == 1 ? 2 : 0;
-	unsigned int cb_pos = nvSwap_ ? 1 : 0;
-	unsigned int cr_pos = nvSwap_ ? 0 : 1;
+	JSAMPROW y_pointers[2 * DCTSIZE];
+	JSAMPROW cb_pointers[DCTSIZE];
+	JSAMPROW cr_pointers[DCTSIZE];
+	JSAMPARRAY data[3] = { y_pointers, cb_pointers, cr_pointers };
 
 	const unsigned char *src = planes[0].data();
 	const unsigned char *src_c = planes[1].data();
 
-	JSAMPROW row_pointer[1];
-	row_pointer[0] = tmprowbuf.data();
-
-	for (unsigned int y = 0; y < compress_.image_height; y++) {
-		unsigned char *dst = tmprowbuf.data();
-
-		const unsigned char *src_y = src + y * y_stride;
-		const unsigned char *src_cb = src_c + (y / vertSubSample) * c_stride + cb_pos;
-		const unsigned char *src_cr = src_c + (y / vertSubSample) * c_stride + cr_pos;
-
-		for (unsigned int x = 0; x < compress_.image_width; x += 2) {
-			dst[0] = *src_y;
-			dst[1] = *src_cb;
-			dst[2] = *src_cr;
-			src_y++;
-			src_cb += c_inc;
-			src_cr += c_inc;
-			dst += 3;
-
-			dst[0] = *src_y;
-			dst[1] = *src_cb;
-			dst[2] = *src_cr;
-			src_y++;
-			src_cb += 2;
-			src_cr += 2;
-			dst += 3;
+	while (compress->next_scanline < compress->image_height) {
+		unsigned int row = band->firstRow + compress->next_scanline;
+
+		/* Replicate the last line to fill the last MCU row. */
+		for (unsigned int i = 0; i < y_rows; i++) {
+			unsigned int y = std::min(row + i, size_.height - 1);
+			unsigned char *line = const_cast<unsigned char *>(src + y * y_stride);
+
+			if (copyLuma) {
+				unsigned char *dst = y_lines + i * y_width;
+				memcpy(dst, line, size_.width);
+				memset(dst + size_.width, line[size_.width - 1],
+				       y_width - size_.width);
+				line = dst;
+			}
+
+			y_pointers[i] = line;
 		}
 
-		jpeg_write_scanlines(&compress_, row_pointer, 1);
+		for (unsigned int i = 0; i < DCTSIZE; i++) {
+			unsigned int y = std::min(row / vertSubSample_ + i, chromaHeight - 1);
+			const unsigned char *src_cbcr = src_c + y * c_stride;
+			unsigned char *cb = cb_lines + i * c_width;
+			unsigned char *cr = cr_lines + i * c_width;
+
+			for (unsigned int x = 0; x < chromaWidth; x++) {
+				cb[x] = src_cbcr[2 * x + cb_pos];
+				cr[x] = src_cbcr[2 * x + cr_pos];
+			}
+
+			memset(cb + chromaWidth, cb[chromaWidth - 1], c_width - chromaWidth);
+			memset(cr + chromaWidth, cr[chromaWidth - 1], c_width - chromaWidth);
+
+			cb_pointers[i] = cb;
+			cr_pointers[i] = cr;
+		}
+
+		jpeg_write_raw_data(compress, data, y_rows);
 	}
 }
 
@@ -200,10 +366,38 @@ int EncoderLibJpeg::encode(const std::vector<Span<uint8_t>> &src,
 			   Span<uint8_t> dest, Span<const uint8_t> exifData,
 			   unsigned int quality)
 {
+	LOG(JPEG, Debug) << "JPEG Encode Starting:" << size_;
+
+	ASSERT(src.size() == pixelFormatInfo_->numPlanes());
+
+	utils::time_point start = utils::clock::now();
+
+	int ret;
+	if (bands_.size() > 1)
+		ret = encodeBands(src, dest, exifData, quality);
+	else
+		ret = encodeSingle(src, dest, exifData, quality);
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+		utils::clock::now() - start).count();
+	LOG(JPEG, Debug)
+		<< "JPEG Encode Finished: " << elapsed << "us, "
+		<< elapsed * 1000000 / size_.width / size_.height
+		<< "us/MP with " << bands_.size() << " band(s)";
+
+	return ret;
+}
+
+int EncoderLibJpeg::encodeSingle(const std::vector<Span<uint8_t>> &src,
+				 Span<uint8_t> dest, Span<const uint8_t> exifData,
+				 unsigned int quality)
+{
+	Band *band = bands_[0].get();
+	struct jpeg_compress_struct *compress = &band->compress;
 	unsigned char *destination = dest.data();
 	unsigned long size = dest.size();
 
-	jpeg_set_quality(&compress_, quality, TRUE);
+	jpeg_set_quality(compress, quality, TRUE);
 
 	/*
 	 * The jpeg_mem_dest will reallocate if the required size is not
@@ -213,27 +407,156 @@ int EncoderLibJpeg::encode(const std::vector<Span<uint8_t>> &src,
 	 * \todo Implement our own custom memory destination to prevent
 	 * reallocation and prefer failure with correct reporting.
 	 */
-	jpeg_mem_dest(&compress_, &destination, &size);
+	jpeg_mem_dest(compress, &destination, &size);
 
-	jpeg_start_compress(&compress_, TRUE);
+	jpeg_start_compress(compress, TRUE);
 
 	if (exifData.size())
 		/* Store Exif data in the JPEG_APP1 data block. */
-		jpeg_write_marker(&compress_, JPEG_APP0 + 1,
+		jpeg_write_marker(compress, JPEG_APP0 + 1,
 				  static_cast<const JOCTET *>(exifData.data()),
 				  exifData.size());
 
-	LOG(JPEG, Debug) << "JPEG Encode Starting:" << compress_.image_width
-			 << "x" << compress_.image_height;
-
-	ASSERT(src.size() == pixelFormatInfo_->numPlanes());
-
 	if (nv_)
-		compressNV(src);
+		compressNV(band, src);
 	else
-		compressRGB(src);
+		compressRGB(band, src);
 
-	jpeg_finish_compress(&compress_);
+	jpeg_finish_compress(compress);
 
 	return size;
 }
+
+/*
+ * Compress the bands in parallel, each as a separate JPEG image using the same
+ * tables and a restart interval that covers a whole band. The entropy-coded
+ * segments of the bands are then concatenated, separated by restart markers,
+ * behind the headers of the first band with the image height patched.
+ */
+int EncoderLibJpeg::encodeBands(const std::vector<Span<uint8_t>> &src,
+				Span<uint8_t> dest, Span<const uint8_t> exifData,
+				unsigned int quality)
+{
+	for (std::unique_ptr<Band> &band : bands_) {
+		jpeg_set_quality(&band->compress, quality, TRUE);
+
+		/* Start from the uncompressed band size, libjpeg grows it if needed. */
+		band->buffer.resize(size_.width * band->compress.image_height);
+		band->output = band->buffer.data();
+		band->outputSize = band->buffer.size();
+		jpeg_mem_dest(&band->compress, &band->output, &band->outputSize);
+	}
+
+	for (unsigned int i = 1; i < bands_.size(); i++)
+		jpeg_start_compress(&bands_[i]->compress, TRUE);
+
+	{
+		MutexLocker locker(mutex_);
+		source_ = &src;
+		nextBand_ = 1;
+		pendingBands_ = bands_.size() - 1;
+	}
+
+	workCv_.notify_all();
+
+	jpeg_start_compress(&bands_[0]->compress, TRUE);
+
+	if (exifData.size())
+		/* Store Exif data in the JPEG_APP1 data block. */
+		jpeg_write_marker(&bands_[0]->compress, JPEG_APP0 + 1,
+				  static_cast<const JOCTET *>(exifData.data()),
+				  exifData.size());
+
+	compressBand(bands_[0].get(), src);
+
+	{
+		MutexLocker locker(mutex_);
+		doneCv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return pendingBands_ == 0;
+		});
+		source_ = nullptr;
+	}
+
+	/* Stitch the bands, dropping the EOI marker at the end of each band. */
+	int ret = 0;
+	size_t size = 0;
+
+	for (unsigned int i = 0; i < bands_.size(); i++) {
+		Span<const uint8_t> jpeg(bands_[i]->output, bands_[i]->outputSize);
+		size_t sofOffset = 0;
+		size_t offset = scanDataOffset(jpeg, &sofOffset);
+
+		if (!offset || !sofOffset || jpeg.size() < offset + 2) {
+			LOG(JPEG, Error) << "Failed to parse JPEG band " << i;
+			ret = -EINVAL;
+			break;
+		}
+
+		if (i == 0)
+			offset = 0;
+
+		size_t length = jpeg.size() - 2 - offset;
+		if (size + length + 2 > dest.size()) {
+			LOG(JPEG, Error) << "Destination buffer too small";
+			ret = -ENOSPC;
+			break;
+		}
+
+		if (i == 0) {
+			memcpy(dest.data(), jpeg.data(), length);
+
+			/* Patch the image height in the start of frame header. */
+			dest[sofOffset + 5] = size_.height >> 8;
+			dest[sofOffset + 6] = size_.height & 0xff;
+		} else {
+			dest[size - 2] = 0xff;
+			dest[size - 1] = JPEG_RST0 + (i - 1) % 8;
+			memcpy(dest.data() + size, jpeg.data() + offset, length);
+		}
+
+		size += length + 2;
+	}
+
+	if (!ret) {
+		dest[size - 2] = 0xff;
+		dest[size - 1] = JPEG_EOI;
+		ret = size;
+	}
+
+	for (std::unique_ptr<Band> &band : bands_) {
+		if (band->output != band->buffer.data())
+			free(band->output);
+	}
+
+	return ret;
+}
+
+void EncoderLibJpeg::compressBand(Band *band, const std::vector<Span<uint8_t>> &planes)
+{
+	compressNV(band, planes);
+	jpeg_finish_compress(&band->compress);
+}
+
+void EncoderLibJpeg::runWorker()
+{
+	MutexLocker locker(mutex_);
+
+	while (1) {
+		workCv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return exiting_ || (source_ && nextBand_ < bands_.size());
+		});
+
+		if (exiting_)
+			break;
+
+		Band *band = bands_[nextBand_++].get();
+		const std::vector<Span<uint8_t>> *source = source_;
+		locker.unlock();
+
+		compressBand(band, *source);
+
+		locker.lock();
+		if (--pendingBands_ == 0)
+			doneCv_.notify_one();
+	}
+}
@@ -9,8 +9,12 @@
 
 #include "encoder.h"
 
+#include <memory>
 #include <vector>
 
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread.h>
+
 #include "libcamera/internal/formats.h"
 
 #include <jpeglib.h>
@@ -31,14 +35,80 @@ public:
 		   unsigned int quality);
 
 private:
-	void compressRGB(const std::vector<libcamera::Span<uint8_t>> &planes);
-	void compressNV(const std::vector<libcamera::Span<uint8_t>> &planes);
+	/* A horizontal band of the image, compressed independently */
+	struct Band {
+		Band();
+		~Band();
+
+		struct jpeg_compress_struct compress;
+		struct jpeg_error_mgr jerr;
+
+		unsigned int firstRow;
+		std::vector<uint8_t> lines;
+
+		std::vector<uint8_t> buffer;
+		unsigned char *output;
+		unsigned long outputSize;
+	};
+
+	/* A thread compressing bands other than the first one */
+	class Worker : public libcamera::Thread
+	{
+	public:
+		Worker(EncoderLibJpeg *encoder)
+			: encoder_(encoder)
+		{
+		}
+
+	protected:
+		void run() override { encoder_->runWorker(); }
+
+	private:
+		EncoderLibJpeg *encoder_;
+	};
+
+	static constexpr unsigned int kMaxBands = 4;
+	static constexpr unsigned int kMinBandedPixels = 2000000;
+
+	void configureBand(Band *band, unsigned int firstRow,
+			   unsigned int height, unsigned int restartInterval);
+
+	int encodeSingle(const std::vector<libcamera::Span<uint8_t>> &planes,
+			 libcamera::Span<uint8_t> destination,
+			 libcamera::Span<const uint8_t> exifData,
+			 unsigned int quality);
+	int encodeBands(const std::vector<libcamera::Span<uint8_t>> &planes,
+			libcamera::Span<uint8_t> destination,
+			libcamera::Span<const uint8_t> exifData,
+			unsigned int quality);
+
+	void compressRGB(Band *band,
+			 const std::vector<libcamera::Span<uint8_t>> &planes);
+	void compressNV(Band *band,
+			const std::vector<libcamera::Span<uint8_t>> &planes);
+	void compressBand(Band *band,
+			  const std::vector<libcamera::Span<uint8_t>> &planes);
+
+	void runWorker();
+
+	std::vector<std::unique_ptr<Band>> bands_;
+	std::vector<std::unique_ptr<Worker>> workers_;
+
+	libcamera::Mutex mutex_;
+	libcamera::ConditionVariable workCv_;
+	libcamera::ConditionVariable doneCv_;
 
-	struct jpeg_compress_struct compress_;
-	struct jpeg_error_mgr jerr_;
+	const std::vector<libcamera::Span<uint8_t>> *source_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int nextBand_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int pendingBands_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	bool exiting_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
 
+	libcamera::Size size_;
+	J_COLOR_SPACE colorSpace_;
 	const libcamera::PixelFormatInfo *pixelFormatInfo_;
 
 	bool nv_;
 	bool nvSwap_;
+	unsigned int horzSubSample_;
+	unsigned int vertSubSample_;
 };
@@ -7,16 +7,38 @@
 
 #include "thumbnailer.h"
 
+#include <map>
+
 #include <libcamera/base/log.h>
 
 #include <libcamera/formats.h>
 
 #include "libcamera/internal/mapped_framebuffer.h"
 
+#include <libyuv/scale.h>
+#include <libyuv/scale_uv.h>
+
 using namespace libcamera;
 
 LOG_DEFINE_CATEGORY(Thumbnailer)
 
+namespace {
+
+/*
+ * Thumbnails are generated in a 4:2:0 semi-planar format, preserving the
+ * chroma order of the source format.
+ */
+const std::map<PixelFormat, PixelFormat> thumbnailFormats{
+	{ formats::NV12, formats::NV12 },
+	{ formats::NV21, formats::NV21 },
+	{ formats::NV16, formats::NV12 },
+	{ formats::NV61, formats::NV21 },
+	{ formats::NV24, formats::NV12 },
+	{ formats::NV42, formats::NV21 },
+};
+
+} /* namespace */
+
 Thumbnailer::Thumbnailer()
 	: valid_(false)
 {
@@ -27,13 +49,16 @@ void Thumbnailer::configure(const Size &sourceSize, PixelFormat pixelFormat)
 	sourceSize_ = sourceSize;
 	pixelFormat_ = pixelFormat;
 
-	if (pixelFormat_ != formats::NV12) {
+	const auto it = thumbnailFormats.find(pixelFormat_);
+	if (it == thumbnailFormats.end()) {
 		LOG(Thumbnailer, Error)
 			<< "Failed to configure: Pixel Format "
 			<< pixelFormat_ << " unsupported.";
+		valid_ = false;
 		return;
 	}
 
+	outputFormat_ = it->second;
 	valid_ = true;
 }
 
@@ -62,35 +87,28 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 	ASSERT(frame.planes().size() == 2);
 	ASSERT(tw % 2 == 0 && th % 2 == 0);
 
-	/* Image scaling block implementing nearest-neighbour algorithm. */
-	unsigned char *src = frame.planes()[0].data();
-	unsigned char *srcC = frame.planes()[1].data();
-	unsigned char *srcCb, *srcCr;
-	unsigned char *dstY, *srcY;
+	const PixelFormatInfo &info = PixelFormatInfo::info(pixelFormat_);
+	const unsigned int strideY = info.stride(sw, 0);
+	const unsigned int strideC = info.stride(sw, 1);
+	const unsigned int cw = strideC / 2;
+	const unsigned int ch = sh / info.planes[1].verticalSubSampling;
 
 	size_t dstSize = (th * tw) + ((th / 2) * tw);
 	destination->resize(dstSize);
 	unsigned char *dst = destination->data();
 	unsigned char *dstC = dst + th * tw;
 
-	for (unsigned int y = 0; y < th; y += 2) {
-		unsigned int sourceY = (sh * y + th / 2) / th;
-
-		dstY = dst + y * tw;
-		srcY = src + sw * sourceY;
-		srcCb = srcC + (sourceY / 2) * sw + 0;
-		srcCr = srcC + (sourceY / 2) * sw + 1;
-
-		for (unsigned int x = 0; x < tw; x += 2) {
-			unsigned int sourceX = (sw * x + tw / 2) / tw;
-
-			dstY[x] = srcY[sourceX];
-			dstY[tw + x] = srcY[sw + sourceX];
-			dstY[x + 1] = srcY[sourceX + 1];
-			dstY[tw + x + 1] = srcY[sw + sourceX + 1];
-
-			dstC[(y / 2) * tw + x + 0] = srcCb[(sourceX / 2) * 2];
-			dstC[(y / 2) * tw + x + 1] = srcCr[(sourceX / 2) * 2];
-		}
+	/*
+	 * Scale the luma and the interleaved chroma planes separately with a
+	 * box filter, which averages all source pixels covered by each
+	 * thumbnail pixel to avoid aliasing.
+	 */
+	libyuv::ScalePlane(frame.planes()[0].data(), strideY, sw, sh,
+			   dst, tw, tw, th, libyuv::kFilterBox);
+	int ret = libyuv::UVScale(frame.planes()[1].data(), strideC, cw, ch,
+				  dstC, tw, tw / 2, th / 2, libyuv::kFilterBox);
+	if (ret) {
+		LOG(Thumbnailer, Error) << "Failed to scale thumbnail: " << ret;
+		destination->clear();
 	}
 }
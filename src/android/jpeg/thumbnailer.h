@@ -22,10 +22,11 @@ public:
 	void createThumbnail(const libcamera::FrameBuffer &source,
 			     const libcamera::Size &targetSize,
 			     std::vector<unsigned char> *dest);
-	const libcamera::PixelFormat &pixelFormat() const { return pixelFormat_; }
+	const libcamera::PixelFormat &pixelFormat() const { return outputFormat_; }
 
 private:
 	libcamera::PixelFormat pixelFormat_;
+	libcamera::PixelFormat outputFormat_;
 	libcamera::Size sourceSize_;
 
 	bool valid_;
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Thread pool shared by the post-processors of a camera device
+ */
+
+#include "post_processor_pool.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <thread>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include "camera_stream.h"
+
+using namespace libcamera;
+
+LOG_DECLARE_CATEGORY(HAL)
+
+/**
+ * \class PostProcessorPool
+ * \brief Run post-processing of all streams of a camera device on a thread pool
+ *
+ * Post-processing requests queued by CameraStream::process() are dispatched to
+ * the first available thread of the pool, regardless of the stream they belong
+ * to. Requests for the same stream may thus be processed concurrently, using
+ * one PostProcessor instance per thread, and complete out of order. Capture
+ * results are still delivered to the framework in order, as
+ * CameraDevice::sendCaptureResults() only sends completed descriptors from the
+ * head of its queue.
+ *
+ * The number of threads defaults to the number of CPUs, and can be overridden
+ * with the LIBCAMERA_HAL_POST_PROCESSING_THREADS environment variable. It is
+ * capped to kMaxThreads in both cases.
+ */
+
+PostProcessorPool::PostProcessorPool()
+	: running_(0), exiting_(false)
+{
+	unsigned int count = std::clamp(std::thread::hardware_concurrency(),
+					1U, kMaxThreads);
+
+	const char *env = utils::secure_getenv("LIBCAMERA_HAL_POST_PROCESSING_THREADS");
+	if (env) {
+		char *end;
+		unsigned long value = strtoul(env, &end, 10);
+		if (*end == '\0' && value > 0)
+			count = std::min<unsigned long>(value, kMaxThreads);
+		else
+			LOG(HAL, Warning)
+				<< "Invalid post-processing thread count '"
+				<< env << "'";
+	}
+
+	LOG(HAL, Debug) << "Using " << count << " post-processing threads";
+
+	for (unsigned int i = 0; i < count; ++i) {
+		workers_.push_back(std::make_unique<Worker>(this));
+		workers_.back()->start();
+	}
+}
+
+PostProcessorPool::~PostProcessorPool()
+{
+	stop();
+
+	{
+		MutexLocker locker(mutex_);
+		exiting_ = true;
+	}
+
+	cv_.notify_all();
+
+	for (std::unique_ptr<Worker> &worker : workers_)
+		worker->wait();
+}
+
+/**
+ * \brief Queue a post-processing request
+ * \param[in] stream The stream to post-process
+ * \param[in] streamBuffer The destination buffer
+ */
+void PostProcessorPool::queue(CameraStream *stream,
+			      Camera3RequestDescriptor::StreamBuffer *streamBuffer)
+{
+	{
+		MutexLocker locker(mutex_);
+		jobs_.push_back({ stream, streamBuffer,
+				  std::chrono::steady_clock::now() });
+	}
+
+	cv_.notify_one();
+}
+
+/**
+ * \brief Cancel all queued requests for a stream
+ * \param[in] stream The stream
+ *
+ * Requests that have not started processing yet are completed with an error
+ * status. Requests being processed are not affected.
+ */
+void PostProcessorPool::cancel(CameraStream *stream)
+{
+	std::deque<Job> cancelled;
+
+	{
+		MutexLocker locker(mutex_);
+
+		auto it = std::stable_partition(jobs_.begin(), jobs_.end(),
+						[&](const Job &job) {
+							return job.stream != stream;
+						});
+		std::move(it, jobs_.end(), std::back_inserter(cancelled));
+		jobs_.erase(it, jobs_.end());
+	}
+
+	for (const Job &job : cancelled)
+		job.stream->cancelPostProcessing(job.streamBuffer);
+}
+
+/**
+ * \brief Cancel all queued requests and wait for running ones to complete
+ *
+ * Requests that have not started processing yet are completed with an error
+ * status, as for cancel().
+ */
+void PostProcessorPool::stop()
+{
+	std::deque<Job> cancelled;
+
+	{
+		MutexLocker locker(mutex_);
+		cancelled.swap(jobs_);
+	}
+
+	for (const Job &job : cancelled)
+		job.stream->cancelPostProcessing(job.streamBuffer);
+
+	MutexLocker locker(mutex_);
+
+	idle_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+		return running_ == 0;
+	});
+}
+
+void PostProcessorPool::run()
+{
+	MutexLocker locker(mutex_);
+
+	while (1) {
+		cv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return exiting_ || !jobs_.empty();
+		});
+
+		if (exiting_)
+			break;
+
+		Job job = jobs_.front();
+		jobs_.pop_front();
+		running_++;
+		locker.unlock();
+
+		job.stream->postProcess(job.streamBuffer, job.queued);
+
+		locker.lock();
+		if (--running_ == 0)
+			idle_.notify_all();
+	}
+}
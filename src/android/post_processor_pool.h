@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Thread pool shared by the post-processors of a camera device
+ */
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread.h>
+
+#include "camera_request.h"
+
+class CameraStream;
+
+class PostProcessorPool
+{
+public:
+	PostProcessorPool();
+	~PostProcessorPool();
+
+	unsigned int size() const { return workers_.size(); }
+
+	void queue(CameraStream *stream,
+		   Camera3RequestDescriptor::StreamBuffer *streamBuffer);
+	void cancel(CameraStream *stream);
+	void stop();
+
+private:
+	class Worker : public libcamera::Thread
+	{
+	public:
+		Worker(PostProcessorPool *pool)
+			: pool_(pool)
+		{
+		}
+
+	protected:
+		void run() override { pool_->run(); }
+
+	private:
+		PostProcessorPool *pool_;
+	};
+
+	struct Job {
+		CameraStream *stream;
+		Camera3RequestDescriptor::StreamBuffer *streamBuffer;
+		std::chrono::steady_clock::time_point queued;
+	};
+
+	static constexpr unsigned int kMaxThreads = 4;
+
+	void run();
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+
+	libcamera::Mutex mutex_;
+	libcamera::ConditionVariable cv_;
+	libcamera::ConditionVariable idle_;
+
+	std::deque<Job> jobs_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int running_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	bool exiting_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
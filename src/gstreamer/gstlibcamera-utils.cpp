@@ -333,6 +333,75 @@ bare_structure_from_format(const PixelFormat &format)
 	}
 }
 
+#if GST_CHECK_VERSION(1, 24, 0)
+static GstStructure *
+dma_drm_structure_from_format(const PixelFormat &format)
+{
+	GstVideoFormat gst_format = pixel_format_to_gst_format(format);
+
+	/* Only raw video formats have a DRM fourcc. */
+	if (gst_format == GST_VIDEO_FORMAT_UNKNOWN ||
+	    gst_format == GST_VIDEO_FORMAT_ENCODED)
+		return nullptr;
+
+	g_autofree gchar *drm_format =
+		gst_video_dma_drm_fourcc_to_string(format.fourcc(), format.modifier());
+	if (!drm_format)
+		return nullptr;
+
+	return gst_structure_new("video/x-raw",
+				 "format", G_TYPE_STRING, "DMA_DRM",
+				 "drm-format", G_TYPE_STRING, drm_format,
+				 nullptr);
+}
+#endif
+
+static GstCapsFeatures *
+caps_features_copy(const GstCapsFeatures *features)
+{
+	return features ? gst_caps_features_copy(features) : nullptr;
+}
+
+static GstCaps *
+append_stream_formats(GstCaps *caps, const StreamFormats &formats,
+		      const PixelFormat &pixelformat, const GstStructure *bare_s,
+		      const GstCapsFeatures *features)
+{
+	for (const Size &size : formats.sizes(pixelformat)) {
+		GstStructure *s = gst_structure_copy(bare_s);
+		gst_structure_set(s,
+				  "width", G_TYPE_INT, size.width,
+				  "height", G_TYPE_INT, size.height,
+				  nullptr);
+		gst_caps_append_structure_full(caps, s, caps_features_copy(features));
+	}
+
+	const SizeRange &range = formats.range(pixelformat);
+	if (range.hStep && range.vStep) {
+		GstStructure *s = gst_structure_copy(bare_s);
+		GValue val = G_VALUE_INIT;
+
+		g_value_init(&val, GST_TYPE_INT_RANGE);
+		if (range.min.width == range.max.width) {
+			gst_structure_set(s, "width", G_TYPE_INT, range.min.width, nullptr);
+		} else {
+			gst_value_set_int_range_step(&val, range.min.width, range.max.width, range.hStep);
+			gst_structure_set_value(s, "width", &val);
+		}
+		if (range.min.height == range.max.height) {
+			gst_structure_set(s, "height", G_TYPE_INT, range.min.height, nullptr);
+		} else {
+			gst_value_set_int_range_step(&val, range.min.height, range.max.height, range.vStep);
+			gst_structure_set_value(s, "height", &val);
+		}
+		g_value_unset(&val);
+
+		caps = gst_caps_merge_structure_full(caps, s, caps_features_copy(features));
+	}
+
+	return caps;
+}
+
 GstCaps *
 gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 {
@@ -347,37 +416,22 @@ gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 			continue;
 		}
 
-		for (const Size &size : formats.sizes(pixelformat)) {
-			GstStructure *s = gst_structure_copy(bare_s);
-			gst_structure_set(s,
-					  "width", G_TYPE_INT, size.width,
-					  "height", G_TYPE_INT, size.height,
-					  nullptr);
-			gst_caps_append_structure(caps, s);
+#if GST_CHECK_VERSION(1, 24, 0)
+		/*
+		 * Offer DMABuf caps first, to allow downstream elements to
+		 * import the camera buffers without copying them.
+		 */
+		g_autoptr(GstStructure) dma_s = dma_drm_structure_from_format(pixelformat);
+		if (dma_s) {
+			g_autoptr(GstCapsFeatures) features =
+				gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_DMABUF, nullptr);
+			caps = append_stream_formats(caps, formats, pixelformat,
+						     dma_s, features);
 		}
+#endif
 
-		const SizeRange &range = formats.range(pixelformat);
-		if (range.hStep && range.vStep) {
-			GstStructure *s = gst_structure_copy(bare_s);
-			GValue val = G_VALUE_INIT;
-
-			g_value_init(&val, GST_TYPE_INT_RANGE);
-			if (range.min.width == range.max.width) {
-				gst_structure_set(s, "width", G_TYPE_INT, range.min.width, nullptr);
-			} else {
-				gst_value_set_int_range_step(&val, range.min.width, range.max.width, range.hStep);
-				gst_structure_set_value(s, "width", &val);
-			}
-			if (range.min.height == range.max.height) {
-				gst_structure_set(s, "height", G_TYPE_INT, range.min.height, nullptr);
-			} else {
-				gst_value_set_int_range_step(&val, range.min.height, range.max.height, range.vStep);
-				gst_structure_set_value(s, "height", &val);
-			}
-			g_value_unset(&val);
-
-			caps = gst_caps_merge_structure(caps, s);
-		}
+		caps = append_stream_formats(caps, formats, pixelformat, bare_s,
+					     nullptr);
 	}
 
 	return caps;
@@ -385,10 +439,22 @@ gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 
 GstCaps *
 gst_libcamera_stream_configuration_to_caps(const StreamConfiguration &stream_cfg,
-					   GstVideoTransferFunction transfer)
+					   GstVideoTransferFunction transfer,
+					   [[maybe_unused]] bool dma_drm)
 {
 	GstCaps *caps = gst_caps_new_empty();
-	GstStructure *s = bare_structure_from_format(stream_cfg.pixelFormat);
+	GstCapsFeatures *features = nullptr;
+	GstStructure *s;
+
+#if GST_CHECK_VERSION(1, 24, 0)
+	if (dma_drm) {
+		s = dma_drm_structure_from_format(stream_cfg.pixelFormat);
+		features = gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_DMABUF, nullptr);
+	} else
+#endif
+	{
+		s = bare_structure_from_format(stream_cfg.pixelFormat);
+	}
 
 	gst_structure_set(s,
 			  "width", G_TYPE_INT, stream_cfg.size.width,
@@ -406,13 +472,14 @@ gst_libcamera_stream_configuration_to_caps(const StreamConfiguration &stream_cfg
 				ColorSpace::toString(stream_cfg.colorSpace).c_str());
 	}
 
-	gst_caps_append_structure(caps, s);
+	gst_caps_append_structure_full(caps, s, features);
 
 	return caps;
 }
 
 void gst_libcamera_configure_stream_from_caps(StreamConfiguration &stream_cfg,
-					      GstCaps *caps, GstVideoTransferFunction *transfer)
+					      GstCaps *caps, GstVideoTransferFunction *transfer,
+					      bool *dma_drm)
 {
 	GstVideoFormat gst_format = pixel_format_to_gst_format(stream_cfg.pixelFormat);
 	guint i;
@@ -462,18 +529,58 @@ void gst_libcamera_configure_stream_from_caps(StreamConfiguration &stream_cfg,
 	}
 
 	/* Prefer reliable fixed value over ranges */
-	if (best_fixed >= 0)
-		s = gst_caps_get_structure(caps, best_fixed);
-	else
-		s = gst_caps_get_structure(caps, best_in_range);
+	gint best = best_fixed >= 0 ? best_fixed : best_in_range;
+	s = gst_caps_get_structure(caps, best);
+
+	bool is_dma_drm = false;
+	PixelFormat dma_drm_format;
+#if GST_CHECK_VERSION(1, 24, 0)
+	GstCapsFeatures *features = gst_caps_get_features(caps, best);
+	if (features &&
+	    gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_DMABUF) &&
+	    gst_structure_has_name(s, "video/x-raw")) {
+		g_autofree gchar *drm_format =
+			gst_video_dma_drm_fourcc_to_string(stream_cfg.pixelFormat.fourcc(),
+							   stream_cfg.pixelFormat.modifier());
+		if (drm_format)
+			gst_structure_fixate_field_string(s, "drm-format", drm_format);
 
-	if (gst_structure_has_name(s, "video/x-raw")) {
+		/*
+		 * Downstream caps may omit the drm-format field, or carry one
+		 * that can't be parsed. Fall back to system memory caps in that
+		 * case, and let downstream decide if they are acceptable.
+		 */
+		const gchar *drm_format_str = gst_structure_get_string(s, "drm-format");
+		guint64 modifier = 0;
+		guint32 fourcc = 0;
+		if (drm_format_str)
+			fourcc = gst_video_dma_drm_fourcc_from_string(drm_format_str,
+								      &modifier);
+
+		if (fourcc) {
+			dma_drm_format = PixelFormat(fourcc, modifier);
+			is_dma_drm = true;
+		} else {
+			GST_WARNING("Invalid drm-format in DMABuf caps, using system memory");
+			gst_caps_set_features(caps, best, nullptr);
+			gst_structure_set(s, "format", G_TYPE_STRING,
+					  gst_video_format_to_string(gst_format), nullptr);
+		}
+	}
+#endif
+
+	if (dma_drm)
+		*dma_drm = is_dma_drm;
+
+	if (gst_structure_has_name(s, "video/x-raw") && !is_dma_drm) {
 		const gchar *format = gst_video_format_to_string(gst_format);
 		gst_structure_fixate_field_string(s, "format", format);
 	}
 
 	/* Then configure the stream with the result. */
-	if (gst_structure_has_name(s, "video/x-raw")) {
+	if (is_dma_drm) {
+		stream_cfg.pixelFormat = dma_drm_format;
+	} else if (gst_structure_has_name(s, "video/x-raw")) {
 		const gchar *format = gst_structure_get_string(s, "format");
 		gst_format = gst_video_format_from_string(format);
 		stream_cfg.pixelFormat = gst_format_to_pixel_format(gst_format);
@@ -507,6 +614,46 @@ void gst_libcamera_configure_stream_from_caps(StreamConfiguration &stream_cfg,
 	}
 }
 
+/*
+ * Fill a GstVideoInfo from caps, supporting DMA_DRM caps with a linear layout
+ * in addition to system memory caps.
+ */
+bool gst_libcamera_video_info_from_caps(GstVideoInfo *info, GstCaps *caps)
+{
+#if GST_CHECK_VERSION(1, 24, 0)
+	if (gst_video_is_dma_drm_caps(caps)) {
+		GstVideoInfoDmaDrm drm_info;
+
+		if (!gst_video_info_dma_drm_from_caps(&drm_info, caps))
+			return false;
+
+		return gst_video_info_dma_drm_to_video_info(&drm_info, info);
+	}
+#endif
+
+	return gst_video_info_from_caps(info, caps);
+}
+
+/*
+ * Compute the stride GStreamer uses by default for the format and size of a
+ * stream, or 0 if the stream doesn't use a raw video format.
+ */
+guint gst_libcamera_stream_default_stride(const StreamConfiguration &stream_cfg)
+{
+	GstVideoFormat gst_format = pixel_format_to_gst_format(stream_cfg.pixelFormat);
+	GstVideoInfo info;
+
+	if (gst_format == GST_VIDEO_FORMAT_UNKNOWN ||
+	    gst_format == GST_VIDEO_FORMAT_ENCODED)
+		return 0;
+
+	if (!gst_video_info_set_format(&info, gst_format, stream_cfg.size.width,
+				       stream_cfg.size.height))
+		return 0;
+
+	return GST_VIDEO_INFO_PLANE_STRIDE(&info, 0);
+}
+
 void gst_libcamera_get_framerate_from_caps(GstCaps *caps,
 					   GstStructure *element_caps)
 {
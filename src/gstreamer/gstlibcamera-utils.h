@@ -13,13 +13,18 @@
 #include <libcamera/stream.h>
 
 #include <gst/gst.h>
+#include <gst/allocators/allocators.h>
 #include <gst/video/video.h>
 
 GstCaps *gst_libcamera_stream_formats_to_caps(const libcamera::StreamFormats &formats);
 GstCaps *gst_libcamera_stream_configuration_to_caps(const libcamera::StreamConfiguration &stream_cfg,
-						    GstVideoTransferFunction transfer);
+						    GstVideoTransferFunction transfer,
+						    bool dma_drm = false);
 void gst_libcamera_configure_stream_from_caps(libcamera::StreamConfiguration &stream_cfg,
-					      GstCaps *caps, GstVideoTransferFunction *transfer);
+					      GstCaps *caps, GstVideoTransferFunction *transfer,
+					      bool *dma_drm = nullptr);
+bool gst_libcamera_video_info_from_caps(GstVideoInfo *info, GstCaps *caps);
+guint gst_libcamera_stream_default_stride(const libcamera::StreamConfiguration &stream_cfg);
 void gst_libcamera_get_framerate_from_caps(GstCaps *caps, GstStructure *element_caps);
 void gst_libcamera_clamp_and_set_frameduration(libcamera::ControlList &controls,
 					       const libcamera::ControlInfoMap &camera_controls,
@@ -8,8 +8,13 @@
 
 #include "gstlibcameraallocator.h"
 
+#include <errno.h>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
 #include <utility>
 
+#include <libcamera/base/shared_fd.h>
+
 #include <libcamera/camera.h>
 #include <libcamera/framebuffer_allocator.h>
 #include <libcamera/stream.h>
@@ -107,6 +112,9 @@ struct _GstLibcameraAllocator {
 	 * alive until all the memory has been released.
 	 */
 	std::shared_ptr<CameraManager> *cm_ptr;
+	/* The GstFdAllocator map functions, wrapped to sync CPU access. */
+	GstMemoryMapFunction fd_mem_map;
+	GstMemoryUnmapFunction fd_mem_unmap;
 };
 
 G_DEFINE_TYPE(GstLibcameraAllocator, gst_libcamera_allocator,
@@ -152,12 +160,71 @@ gst_libcamera_allocator_free_pool(gpointer data)
 	g_queue_free(queue);
 }
 
+/*
+ * Synchronize CPU access to a dmabuf memory with the device, in the same way as
+ * libcamera's DmaSyncer.
+ */
+static void
+gst_libcamera_memory_sync(GstMemory *mem, GstMapFlags flags, guint64 step)
+{
+	struct dma_buf_sync sync = {
+		.flags = step
+	};
+
+	if (flags & GST_MAP_READ)
+		sync.flags |= DMA_BUF_SYNC_READ;
+	if (flags & GST_MAP_WRITE)
+		sync.flags |= DMA_BUF_SYNC_WRITE;
+
+	int fd = gst_fd_memory_get_fd(mem);
+	int ret;
+	do {
+		ret = ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret && (errno == EINTR || errno == EAGAIN));
+
+	if (ret)
+		GST_WARNING_OBJECT(mem->allocator, "Unable to sync dma fd %d: %s",
+				   fd, g_strerror(errno));
+}
+
+static gpointer
+gst_libcamera_allocator_mem_map_full(GstMemory *mem, GstMapInfo *info,
+				     gsize maxsize)
+{
+	GstLibcameraAllocator *self = GST_LIBCAMERA_ALLOCATOR(mem->allocator);
+
+	gst_libcamera_memory_sync(mem, info->flags, DMA_BUF_SYNC_START);
+
+	gpointer data = self->fd_mem_map(mem, maxsize, info->flags);
+	if (!data)
+		gst_libcamera_memory_sync(mem, info->flags, DMA_BUF_SYNC_END);
+
+	return data;
+}
+
+static void
+gst_libcamera_allocator_mem_unmap_full(GstMemory *mem, GstMapInfo *info)
+{
+	GstLibcameraAllocator *self = GST_LIBCAMERA_ALLOCATOR(mem->allocator);
+
+	self->fd_mem_unmap(mem);
+
+	gst_libcamera_memory_sync(mem, info->flags, DMA_BUF_SYNC_END);
+}
+
 static void
 gst_libcamera_allocator_init(GstLibcameraAllocator *self)
 {
+	GstAllocator *allocator = GST_ALLOCATOR(self);
+
 	self->pools = g_hash_table_new_full(nullptr, nullptr, nullptr,
 					    gst_libcamera_allocator_free_pool);
 	GST_OBJECT_FLAG_SET(self, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+
+	self->fd_mem_map = allocator->mem_map;
+	self->fd_mem_unmap = allocator->mem_unmap;
+	allocator->mem_map_full = gst_libcamera_allocator_mem_map_full;
+	allocator->mem_unmap_full = gst_libcamera_allocator_mem_unmap_full;
 }
 
 static void
@@ -265,10 +332,97 @@ gst_libcamera_allocator_get_pool_size(GstLibcameraAllocator *self,
 	return pool->length;
 }
 
+static GQuark
+gst_libcamera_import_quark()
+{
+	static gsize import_quark = 0;
+
+	if (g_once_init_enter(&import_quark)) {
+		GQuark quark = g_quark_from_string("GstLibcameraImportedFrameBuffer");
+		g_once_init_leave(&import_quark, quark);
+	}
+
+	return import_quark;
+}
+
 FrameBuffer *
 gst_libcamera_memory_get_frame_buffer(GstMemory *mem)
 {
 	auto *frame = reinterpret_cast<FrameWrap *>(gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(mem),
 									      FrameWrap::getQuark()));
-	return frame->buffer_;
+	if (frame)
+		return frame->buffer_;
+
+	return reinterpret_cast<FrameBuffer *>(gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(mem),
+									 gst_libcamera_import_quark()));
+}
+
+/**
+ * \brief Import a downstream dmabuf GstBuffer as a libcamera FrameBuffer
+ * \param[in] buffer The buffer to import
+ * \param[in] info The video info of the stream
+ * \param[in] stride The stride of the stream
+ *
+ * The plane layout is taken from the GstVideoMeta of the buffer if present, or
+ * from \a info otherwise, and must match the stride of the stream. The
+ * FrameBuffer is cached on the first memory of the buffer, and destroyed with
+ * it, so that buffers reused by the downstream pool are imported only once.
+ *
+ * \return The FrameBuffer, or nullptr if the buffer can't be imported
+ */
+FrameBuffer *
+gst_libcamera_buffer_import(GstBuffer *buffer, const GstVideoInfo *info,
+			    guint stride)
+{
+	GstMemory *first = gst_buffer_peek_memory(buffer, 0);
+	if (!first || !gst_is_dmabuf_memory(first))
+		return nullptr;
+
+	auto *fb = reinterpret_cast<FrameBuffer *>(gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(first),
+									     gst_libcamera_import_quark()));
+	if (fb)
+		return fb;
+
+	GstVideoMeta *meta = gst_buffer_get_video_meta(buffer);
+	std::vector<FrameBuffer::Plane> planes;
+
+	for (guint i = 0; i < GST_VIDEO_INFO_N_PLANES(info); i++) {
+		gsize offset = meta ? meta->offset[i] : info->offset[i];
+		gint plane_stride = meta ? meta->stride[i] : info->stride[i];
+
+		if (i == 0 && static_cast<guint>(plane_stride) != stride)
+			return nullptr;
+
+		gint height = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(info->finfo, i,
+								 GST_VIDEO_INFO_HEIGHT(info));
+		gsize length = plane_stride * height;
+
+		guint idx, n_mem;
+		gsize skip;
+		if (!gst_buffer_find_memory(buffer, offset, length, &idx, &n_mem, &skip) ||
+		    n_mem != 1)
+			return nullptr;
+
+		GstMemory *mem = gst_buffer_peek_memory(buffer, idx);
+		if (!gst_is_dmabuf_memory(mem))
+			return nullptr;
+
+		/* Duplicate the fd, it is owned by the downstream allocator. */
+		const int fd = gst_dmabuf_memory_get_fd(mem);
+
+		FrameBuffer::Plane plane;
+		plane.fd = SharedFD(fd);
+		plane.offset = mem->offset + skip;
+		plane.length = length;
+		planes.push_back(std::move(plane));
+	}
+
+	fb = new FrameBuffer(planes);
+	gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(first),
+				  gst_libcamera_import_quark(), fb,
+				  [](gpointer data) {
+					  delete reinterpret_cast<FrameBuffer *>(data);
+				  });
+
+	return fb;
 }
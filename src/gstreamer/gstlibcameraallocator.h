@@ -10,6 +10,7 @@
 
 #include <gst/gst.h>
 #include <gst/allocators/allocators.h>
+#include <gst/video/video.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/stream.h>
@@ -29,3 +30,7 @@ gsize gst_libcamera_allocator_get_pool_size(GstLibcameraAllocator *allocator,
 					    libcamera::Stream *stream);
 
 libcamera::FrameBuffer *gst_libcamera_memory_get_frame_buffer(GstMemory *mem);
+
+libcamera::FrameBuffer *gst_libcamera_buffer_import(GstBuffer *buffer,
+						    const GstVideoInfo *info,
+						    guint stride);
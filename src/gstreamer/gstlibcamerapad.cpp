@@ -19,6 +19,7 @@ struct _GstLibcameraPad {
 	StreamRole role;
 	GstLibcameraPool *pool;
 	GstBufferPool *video_pool;
+	GstBufferPool *import_pool;
 	GstVideoInfo info;
 	GstClockTime latency;
 };
@@ -176,6 +177,24 @@ void gst_libcamera_pad_set_video_pool(GstPad *pad, GstBufferPool *video_pool)
 	self->video_pool = video_pool;
 }
 
+GstBufferPool *
+gst_libcamera_pad_get_import_pool(GstPad *pad)
+{
+	auto *self = GST_LIBCAMERA_PAD(pad);
+	return self->import_pool;
+}
+
+void gst_libcamera_pad_set_import_pool(GstPad *pad, GstBufferPool *import_pool)
+{
+	auto *self = GST_LIBCAMERA_PAD(pad);
+
+	if (self->import_pool) {
+		gst_buffer_pool_set_active(self->import_pool, false);
+		g_object_unref(self->import_pool);
+	}
+	self->import_pool = import_pool;
+}
+
 GstVideoInfo gst_libcamera_pad_get_video_info(GstPad *pad)
 {
 	auto *self = GST_LIBCAMERA_PAD(pad);
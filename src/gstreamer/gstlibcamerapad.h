@@ -27,6 +27,10 @@ GstBufferPool *gst_libcamera_pad_get_video_pool(GstPad *pad);
 
 void gst_libcamera_pad_set_video_pool(GstPad *pad, GstBufferPool *video_pool);
 
+GstBufferPool *gst_libcamera_pad_get_import_pool(GstPad *pad);
+
+void gst_libcamera_pad_set_import_pool(GstPad *pad, GstBufferPool *import_pool);
+
 GstVideoInfo gst_libcamera_pad_get_video_info(GstPad *pad);
 
 void gst_libcamera_pad_set_video_info(GstPad *pad, const GstVideoInfo *info);
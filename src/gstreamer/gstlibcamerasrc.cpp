@@ -15,7 +15,6 @@
  *    + Evaluate if a single streaming thread is fine
  *  - Add application driven request (snapshot)
  *  - Add framerate control
- *  - Add buffer importation support
  *
  *  Requires new libcamera API:
  *  - Add framerate negotiation support
@@ -60,12 +59,12 @@ struct RequestWrap {
 	std::unique_ptr<Request> request_;
 	std::map<Stream *, GstBuffer *> buffers_;
 
-	GstClockTime latency_;
+	GstClockTime timestamp_;
 	GstClockTime pts_;
 };
 
 RequestWrap::RequestWrap(std::unique_ptr<Request> request)
-	: request_(std::move(request)), latency_(0), pts_(GST_CLOCK_TIME_NONE)
+	: request_(std::move(request)), timestamp_(0), pts_(GST_CLOCK_TIME_NONE)
 {
 }
 
@@ -133,6 +132,7 @@ struct GstLibcameraSrcState {
 	guint group_id_;
 	GstCameraControls controls_;
 
+	GstBuffer *importBuffer(GstPad *srcpad, Stream *stream);
 	int queueRequest();
 	void requestCompleted(Request *request);
 	int processRequest();
@@ -148,6 +148,9 @@ struct _GstLibcameraSrc {
 	gchar *camera_name;
 
 	std::atomic<GstEvent *> pending_eos;
+	std::atomic<guint64> copied_frames;
+	std::atomic<guint> queue_depth;
+	std::atomic<bool> low_latency;
 
 	GstLibcameraSrcState *state;
 	GstLibcameraAllocator *allocator;
@@ -157,6 +160,9 @@ struct _GstLibcameraSrc {
 enum {
 	PROP_0,
 	PROP_CAMERA_NAME,
+	PROP_COPIED_FRAMES,
+	PROP_QUEUE_DEPTH,
+	PROP_LOW_LATENCY,
 	PROP_LAST
 };
 
@@ -169,7 +175,12 @@ G_DEFINE_TYPE_WITH_CODE(GstLibcameraSrc, gst_libcamera_src, GST_TYPE_ELEMENT,
 			GST_DEBUG_CATEGORY_INIT(source_debug, "libcamerasrc", 0,
 						"libcamera Source"))
 
+#if GST_CHECK_VERSION(1, 24, 0)
+#define TEMPLATE_CAPS GST_STATIC_CAPS("video/x-raw(memory:DMABuf), format=(string)DMA_DRM; " \
+				      "video/x-raw; image/jpeg; video/x-bayer")
+#else
 #define TEMPLATE_CAPS GST_STATIC_CAPS("video/x-raw; image/jpeg; video/x-bayer")
+#endif
 
 /* For the simple case, we have a src pad that is always present. */
 GstStaticPadTemplate src_template = {
@@ -181,9 +192,59 @@ GstStaticPadTemplate request_src_template = {
 	"src_%u", GST_PAD_SRC, GST_PAD_REQUEST, TEMPLATE_CAPS
 };
 
+/*
+ * Acquire a buffer from the downstream pool of the pad, if any, and import it.
+ * The downstream pool is not waited for, the caller falls back to the
+ * libcamera buffers when it is empty. This also guarantees the task will be
+ * resumed by the libcamera pool buffer-notify signal when buffers are returned.
+ *
+ * Must be called with stream_lock held.
+ */
+GstBuffer *GstLibcameraSrcState::importBuffer(GstPad *srcpad, Stream *stream)
+{
+	GstBufferPool *import_pool = gst_libcamera_pad_get_import_pool(srcpad);
+	if (!import_pool)
+		return nullptr;
+
+	GstBufferPoolAcquireParams params = {};
+	params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+	GstBuffer *buffer;
+	if (gst_buffer_pool_acquire_buffer(import_pool, &buffer, &params) != GST_FLOW_OK)
+		return nullptr;
+
+	const GstVideoInfo info = gst_libcamera_pad_get_video_info(srcpad);
+	if (!gst_libcamera_buffer_import(buffer, &info, stream->configuration().stride)) {
+		GST_WARNING_OBJECT(srcpad, "Can't import downstream buffers, using own buffers");
+		gst_buffer_unref(buffer);
+		gst_libcamera_pad_set_import_pool(srcpad, nullptr);
+		return nullptr;
+	}
+
+	return buffer;
+}
+
+/*
+ * In low-latency mode, keep one request being captured and a single one queued
+ * ahead of it.
+ */
+static constexpr guint kLowLatencyQueueDepth = 2;
+
 /* Must be called with stream_lock held. */
 int GstLibcameraSrcState::queueRequest()
 {
+	guint queue_depth = src_->low_latency ? kLowLatencyQueueDepth
+					      : src_->queue_depth.load();
+	if (queue_depth) {
+		/*
+		 * The task is resumed by requestCompleted() when the number of
+		 * requests in flight decreases.
+		 */
+		GLibLocker locker(&lock_);
+		if (queuedRequests_.size() >= queue_depth)
+			return -EBUSY;
+	}
+
 	std::unique_ptr<Request> request = cam_->createRequest();
 	if (!request)
 		return -ENOMEM;
@@ -197,17 +258,20 @@ int GstLibcameraSrcState::queueRequest()
 	for (GstPad *srcpad : srcpads_) {
 		Stream *stream = gst_libcamera_pad_get_stream(srcpad);
 		GstLibcameraPool *pool = gst_libcamera_pad_get_pool(srcpad);
-		GstBuffer *buffer;
+		GstBuffer *buffer = importBuffer(srcpad, stream);
 		GstFlowReturn ret;
 
-		ret = gst_buffer_pool_acquire_buffer(GST_BUFFER_POOL(pool),
-						     &buffer, nullptr);
-		if (ret != GST_FLOW_OK) {
-			/*
-			 * RequestWrap has ownership of the request, and we
-			 * won't be queueing this one due to lack of buffers.
-			 */
-			return -ENOBUFS;
+		if (!buffer) {
+			ret = gst_buffer_pool_acquire_buffer(GST_BUFFER_POOL(pool),
+							     &buffer, nullptr);
+			if (ret != GST_FLOW_OK) {
+				/*
+				 * RequestWrap has ownership of the request, and
+				 * we won't be queueing this one due to lack of
+				 * buffers.
+				 */
+				return -ENOBUFS;
+			}
 		}
 
 		wrap->attachBuffer(stream, buffer);
@@ -259,7 +323,7 @@ GstLibcameraSrcState::requestCompleted(Request *request)
 		/* Deduced from: sys_now - sys_base_time == gst_now - gst_base_time */
 		GstClockTime sys_base_time = sys_now - (gst_now - gst_base_time);
 		wrap->pts_ = timestamp - sys_base_time;
-		wrap->latency_ = sys_now - timestamp;
+		wrap->timestamp_ = timestamp;
 	}
 
 	{
@@ -336,12 +400,25 @@ gst_libcamera_video_frame_copy(GstBuffer *src, GstBuffer *dest,
 /* Must be called with stream_lock held. */
 int GstLibcameraSrcState::processRequest()
 {
+	std::vector<std::unique_ptr<RequestWrap>> staleRequests;
 	std::unique_ptr<RequestWrap> wrap;
 	int err = 0;
 
 	{
 		GLibLocker locker(&lock_);
 
+		/*
+		 * In low-latency mode, only the most recent frame is pushed.
+		 * The buffers of the stale ones are returned to their pool
+		 * when the requests are destroyed, outside of the lock.
+		 */
+		if (src_->low_latency) {
+			while (completedRequests_.size() > 1) {
+				staleRequests.push_back(std::move(completedRequests_.front()));
+				completedRequests_.pop();
+			}
+		}
+
 		if (!completedRequests_.empty()) {
 			wrap = std::move(completedRequests_.front());
 			completedRequests_.pop();
@@ -351,6 +428,9 @@ int GstLibcameraSrcState::processRequest()
 			err = -ENOBUFS;
 	}
 
+	if (!staleRequests.empty())
+		GST_DEBUG_OBJECT(src_, "Dropping %zu stale frames", staleRequests.size());
+
 	if (!wrap)
 		return -ENOBUFS;
 
@@ -390,12 +470,21 @@ int GstLibcameraSrcState::processRequest()
 				return -EPIPE;
 			}
 
+			src_->copied_frames++;
 			buffer = copy;
 		}
 
 		if (GST_CLOCK_TIME_IS_VALID(wrap->pts_)) {
+			/*
+			 * Report the latency measured from the sensor
+			 * timestamp to the buffer being pushed, including
+			 * the time spent in the queue of completed requests
+			 * and in copies.
+			 */
+			GstClockTime sys_now = g_get_monotonic_time() * 1000;
+
 			GST_BUFFER_PTS(buffer) = wrap->pts_;
-			gst_libcamera_pad_set_latency(srcpad, wrap->latency_);
+			gst_libcamera_pad_set_latency(srcpad, sys_now - wrap->timestamp_);
 		} else {
 			GST_BUFFER_PTS(buffer) = 0;
 		}
@@ -590,6 +679,56 @@ gst_libcamera_create_video_pool(GstLibcameraSrc *self, GstPad *srcpad,
 	return { std::exchange(pool, nullptr), 0 };
 }
 
+/**
+ * \brief Create a pool of downstream buffers to import for a pad
+ * \param[in] self The libcamerasrc instance
+ * \param[in] srcpad The pad
+ * \param[in] caps The pad caps
+ * \param[in] info The video info for the pad
+ *
+ * When DMABuf caps have been negotiated, downstream elements may provide a
+ * buffer pool in the allocation query, typically to have frames captured
+ * directly in memory they have allocated. Configure and activate that pool to
+ * import its buffers. Buffers that can't be imported, for instance because
+ * their stride doesn't match the camera stride, disable importation.
+ *
+ * \return The activated downstream pool, or nullptr if no pool is available
+ */
+static GstBufferPool *
+gst_libcamera_create_import_pool(GstLibcameraSrc *self, GstPad *srcpad,
+				 GstCaps *caps, const GstVideoInfo *info)
+{
+	g_autoptr(GstQuery) query = gst_query_new_allocation(caps, true);
+	g_autoptr(GstBufferPool) pool = nullptr;
+	guint size, min_buffers, max_buffers;
+
+	if (!gst_pad_peer_query(srcpad, query) ||
+	    !gst_query_get_n_allocation_pools(query))
+		return nullptr;
+
+	gst_query_parse_nth_allocation_pool(query, 0, &pool, &size,
+					    &min_buffers, &max_buffers);
+	if (!pool)
+		return nullptr;
+
+	GstStructure *config = gst_buffer_pool_get_config(pool);
+	gst_buffer_pool_config_set_params(config, caps, MAX(size, info->size),
+					  min_buffers, max_buffers);
+	gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+	if (!gst_buffer_pool_set_config(pool, config) ||
+	    !gst_buffer_pool_set_active(pool, true)) {
+		GST_DEBUG_OBJECT(self, "Failed to configure downstream pool %" GST_PTR_FORMAT,
+				 pool);
+		return nullptr;
+	}
+
+	GST_DEBUG_OBJECT(self, "Importing buffers from downstream pool %" GST_PTR_FORMAT,
+			 pool);
+
+	return std::exchange(pool, nullptr);
+}
+
 /* Must be called with stream_lock held. */
 static bool
 gst_libcamera_src_negotiate(GstLibcameraSrc *self)
@@ -597,6 +736,7 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 	GstLibcameraSrcState *state = self->state;
 	std::vector<GstVideoTransferFunction> transfer(state->srcpads_.size(),
 						       GST_VIDEO_TRANSFER_UNKNOWN);
+	std::vector<bool> dma_drm(state->srcpads_.size(), false);
 
 	g_autoptr(GstStructure) element_caps = gst_structure_new_empty("caps");
 
@@ -611,9 +751,22 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 			return false;
 
 		/* Fixate caps and configure the stream. */
+		bool is_dma_drm;
 		caps = gst_caps_make_writable(caps);
-		gst_libcamera_configure_stream_from_caps(stream_cfg, caps, &transfer[i]);
+		gst_libcamera_configure_stream_from_caps(stream_cfg, caps, &transfer[i],
+							 &is_dma_drm);
 		gst_libcamera_get_framerate_from_caps(caps, element_caps);
+		dma_drm[i] = is_dma_drm;
+
+		/*
+		 * Request the stride GStreamer uses by default, so that frames
+		 * don't need to be copied if downstream doesn't support video
+		 * meta. Pipeline handlers adjust the stride during validation
+		 * if they can't produce it, in which case copying remains the
+		 * last resort.
+		 */
+		if (!is_dma_drm)
+			stream_cfg.stride = gst_libcamera_stream_default_stride(stream_cfg);
 	}
 
 	/* Validate the configuration. */
@@ -640,7 +793,8 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 		GstPad *srcpad = state->srcpads_[i];
 		const StreamConfiguration &stream_cfg = state->config_->at(i);
 
-		g_autoptr(GstCaps) caps = gst_libcamera_stream_configuration_to_caps(stream_cfg, transfer[i]);
+		g_autoptr(GstCaps) caps = gst_libcamera_stream_configuration_to_caps(stream_cfg, transfer[i],
+										     dma_drm[i]);
 		gst_libcamera_framerate_to_caps(caps, element_caps);
 
 		if (!gst_pad_push_event(srcpad, gst_event_new_caps(caps)))
@@ -662,16 +816,32 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 		GstPad *srcpad = state->srcpads_[i];
 		const StreamConfiguration &stream_cfg = state->config_->at(i);
 		GstBufferPool *video_pool = nullptr;
+		GstBufferPool *import_pool = nullptr;
 		GstVideoInfo info;
 
-		g_autoptr(GstCaps) caps = gst_libcamera_stream_configuration_to_caps(stream_cfg, transfer[i]);
+		g_autoptr(GstCaps) caps = gst_libcamera_stream_configuration_to_caps(stream_cfg, transfer[i],
+										     dma_drm[i]);
 
-		gst_video_info_from_caps(&info, caps);
+		if (!gst_libcamera_video_info_from_caps(&info, caps))
+			return false;
 		gst_libcamera_pad_set_video_info(srcpad, &info);
 
-		/* Stride mismatch between camera stride and that calculated by video-info. */
-		if (static_cast<unsigned int>(info.stride[0]) != stream_cfg.stride &&
-		    GST_VIDEO_INFO_FORMAT(&info) != GST_VIDEO_FORMAT_ENCODED) {
+		if (dma_drm[i]) {
+			/*
+			 * Downstream supports DMABuf, which implies support
+			 * for video meta. Never copy frames, and import the
+			 * downstream buffers if a pool is provided.
+			 */
+			if (static_cast<unsigned int>(info.stride[0]) != stream_cfg.stride)
+				gst_libcamera_extrapolate_info(&info, stream_cfg.stride);
+
+			import_pool = gst_libcamera_create_import_pool(self, srcpad,
+								       caps, &info);
+		} else if (static_cast<unsigned int>(info.stride[0]) != stream_cfg.stride &&
+			   GST_VIDEO_INFO_FORMAT(&info) != GST_VIDEO_FORMAT_ENCODED) {
+			/* Stride mismatch between camera stride and that calculated by video-info. */
+			GST_INFO_OBJECT(self, "Camera stride %u differs from default stride %d",
+					stream_cfg.stride, info.stride[0]);
 			gst_libcamera_extrapolate_info(&info, stream_cfg.stride);
 
 			std::tie(video_pool, ret) =
@@ -688,6 +858,7 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 
 		gst_libcamera_pad_set_pool(srcpad, pool);
 		gst_libcamera_pad_set_video_pool(srcpad, video_pool);
+		gst_libcamera_pad_set_import_pool(srcpad, import_pool);
 
 		/* Clear all reconfigure flags. */
 		gst_pad_check_reconfigure(srcpad);
@@ -773,6 +944,10 @@ gst_libcamera_src_task_run(gpointer user_data)
 		gst_task_stop(self->task);
 		return;
 
+	case -EBUSY:
+		GST_TRACE_OBJECT(self, "Request queue depth reached");
+		break;
+
 	case -ENOBUFS:
 	default:
 		break;
@@ -884,6 +1059,7 @@ gst_libcamera_src_task_leave([[maybe_unused]] GstTask *task,
 		for (GstPad *srcpad : state->srcpads_) {
 			gst_libcamera_pad_set_latency(srcpad, GST_CLOCK_TIME_NONE);
 			gst_libcamera_pad_set_pool(srcpad, nullptr);
+			gst_libcamera_pad_set_import_pool(srcpad, nullptr);
 		}
 	}
 
@@ -926,6 +1102,12 @@ gst_libcamera_src_set_property(GObject *object, guint prop_id,
 		g_free(self->camera_name);
 		self->camera_name = g_value_dup_string(value);
 		break;
+	case PROP_QUEUE_DEPTH:
+		self->queue_depth = g_value_get_uint(value);
+		break;
+	case PROP_LOW_LATENCY:
+		self->low_latency = g_value_get_boolean(value);
+		break;
 	default:
 		if (!state->controls_.setProperty(prop_id - PROP_LAST, value, pspec))
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -945,6 +1127,15 @@ gst_libcamera_src_get_property(GObject *object, guint prop_id, GValue *value,
 	case PROP_CAMERA_NAME:
 		g_value_set_string(value, self->camera_name);
 		break;
+	case PROP_COPIED_FRAMES:
+		g_value_set_uint64(value, self->copied_frames);
+		break;
+	case PROP_QUEUE_DEPTH:
+		g_value_set_uint(value, self->queue_depth);
+		break;
+	case PROP_LOW_LATENCY:
+		g_value_set_boolean(value, self->low_latency);
+		break;
 	default:
 		if (!state->controls_.getProperty(prop_id - PROP_LAST, value, pspec))
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -971,6 +1162,7 @@ gst_libcamera_src_change_state(GstElement *element, GstStateChange transition)
 	case GST_STATE_CHANGE_READY_TO_PAUSED:
 		/* This needs to be called after pads activation.*/
 		self->state->group_id_ = gst_util_group_id_next();
+		self->copied_frames = 0;
 		if (!gst_task_pause(self->task))
 			return GST_STATE_CHANGE_FAILURE;
 		ret = GST_STATE_CHANGE_NO_PREROLL;
@@ -1112,6 +1304,8 @@ gst_libcamera_src_release_pad(GstElement *element, GstPad *pad)
 			gst_object_unref(video_pool);
 		}
 
+		gst_libcamera_pad_set_import_pool(pad, nullptr);
+
 		if (pad_iterator != end_iterator) {
 			g_object_unref(*pad_iterator);
 			pads.erase(pad_iterator);
@@ -1154,6 +1348,32 @@ gst_libcamera_src_class_init(GstLibcameraSrcClass *klass)
 							     | G_PARAM_STATIC_STRINGS));
 	g_object_class_install_property(object_class, PROP_CAMERA_NAME, spec);
 
+	spec = g_param_spec_uint64("copied-frames", "Copied Frames",
+				   "Number of frames copied due to a stride mismatch "
+				   "with a downstream element lacking video meta support, "
+				   "since the element last went from READY to PAUSED.",
+				   0, G_MAXUINT64, 0,
+				   (GParamFlags)(G_PARAM_READABLE
+						 | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_COPIED_FRAMES, spec);
+
+	spec = g_param_spec_uint("queue-depth", "Queue Depth",
+				 "Maximum number of requests queued to the camera, "
+				 "0 to queue as many as buffers allow.",
+				 0, G_MAXUINT, 0,
+				 (GParamFlags)(G_PARAM_READWRITE
+					       | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_QUEUE_DEPTH, spec);
+
+	spec = g_param_spec_boolean("low-latency", "Low Latency",
+				    "Keep a single request queued ahead and drop "
+				    "stale frames instead of pushing them, "
+				    "overriding queue-depth.",
+				    FALSE,
+				    (GParamFlags)(G_PARAM_READWRITE
+						  | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_LOW_LATENCY, spec);
+
 	GstCameraControls::installProperties(object_class, PROP_LAST);
 }
 
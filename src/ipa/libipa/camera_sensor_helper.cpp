@@ -745,6 +745,18 @@ public:
 };
 REGISTER_CAMERA_SENSOR_HELPER("ov13858", CameraSensorHelperOv13858)
 
+class CameraSensorHelperVirtual : public CameraSensorHelper
+{
+public:
+	CameraSensorHelperVirtual()
+	{
+		/* Raw Bayer sensor emulated by the virtual pipeline handler. */
+		blackLevel_ = 4096;
+		gain_ = AnalogueGainLinear{ 1, 0, 0, 256 };
+	}
+};
+REGISTER_CAMERA_SENSOR_HELPER("virtual", CameraSensorHelperVirtual)
+
 #endif /* __DOXYGEN__ */
 
 } /* namespace ipa */
@@ -253,6 +253,32 @@ bool SensorConfiguration::isValid() const
 	return false;
 }
 
+/**
+ * \struct BufferPoolUsage
+ * \brief Memory usage of a pool of buffers allocated internally by a camera
+ *
+ * Pipeline handlers allocate internal buffers, such as ISP parameters and
+ * statistics buffers or intermediate image buffers, in addition to the buffers
+ * allocated by applications. The BufferPoolUsage describes the memory held by
+ * one such pool, to help applications budget memory on constrained systems.
+ *
+ * \var BufferPoolUsage::name
+ * \brief The name of the pool, describing the purpose of its buffers
+ *
+ * \var BufferPoolUsage::allocator
+ * \brief The device node the buffers are allocated from
+ *
+ * This is the path to the dma-buf heap, the udmabuf device or the V4L2 video
+ * device that allocated the buffers, as buffers allocated by a video device
+ * are exported from its own memory allocator.
+ *
+ * \var BufferPoolUsage::count
+ * \brief The number of buffers in the pool
+ *
+ * \var BufferPoolUsage::size
+ * \brief The total size of the buffers in the pool, in bytes
+ */
+
 /**
  * \class CameraConfiguration
  * \brief Hold configuration for streams of the camera
@@ -589,7 +615,7 @@ CameraConfiguration::Status CameraConfiguration::validateColorSpaces(ColorSpaceF
  */
 Camera::Private::Private(PipelineHandler *pipe)
 	: controlInfo_({}, controls::controls), properties_(properties::properties),
-	  requestSequence_(0), pipe_(pipe->shared_from_this()),
+	  requestSequence_(0), bufferUsage_({}), pipe_(pipe->shared_from_this()),
 	  disconnected_(false), state_(CameraAvailable)
 {
 }
@@ -660,6 +686,33 @@ Camera::Private::~Private()
  * over a single capture session.
  */
 
+/**
+ * \struct Camera::Private::BufferUsage
+ * \brief Buffer usage measured during a capture session
+ *
+ * \var Camera::Private::BufferUsage::maxQueuedRequests
+ * \brief The largest number of requests queued to the device at once
+ *
+ * \var Camera::Private::BufferUsage::maxLatency
+ * \brief The longest pipeline latency, in nanoseconds
+ *
+ * \var Camera::Private::BufferUsage::frameInterval
+ * \brief The moving average of the interval between sensor timestamps, in
+ * nanoseconds
+ *
+ * \var Camera::Private::BufferUsage::lastTimestamp
+ * \brief The sensor timestamp of the last completed request, in nanoseconds
+ */
+
+/**
+ * \var Camera::Private::bufferUsage_
+ * \brief The buffer usage of the current capture session
+ *
+ * The buffer usage is updated by the PipelineHandler base class as requests
+ * are queued and completed, to compute the controls::RecommendedBufferCount
+ * metadata. It is reset when the camera is stopped.
+ */
+
 static const char *const camera_state_names[] = {
 	"Available",
 	"Acquired",
@@ -1456,6 +1509,35 @@ int Camera::stop()
 	return 0;
 }
 
+/**
+ * \brief Retrieve the memory usage of the camera internal buffers
+ *
+ * Internal buffers are allocated when the camera is started. Pipeline handlers
+ * may keep them allocated when the camera is stopped, to speed up restarting
+ * the camera with the same configuration, and release them when the camera is
+ * reconfigured or released.
+ *
+ * \context This function is \threadsafe. It may only be called when the
+ * camera is in the Acquired, Configured or Running state as defined in \ref
+ * camera_operation.
+ *
+ * \return The list of internal buffer pools currently allocated by the camera,
+ * or an empty list if the camera has no internal buffer allocated or is not
+ * acquired
+ */
+std::vector<BufferPoolUsage> Camera::internalBufferUsage()
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraAcquired,
+				     Private::CameraRunning);
+	if (ret < 0)
+		return {};
+
+	return d->pipe_->invokeMethod(&PipelineHandler::internalBufferUsage,
+				      ConnectionTypeBlocking, this);
+}
+
 /**
  * \brief Handle request completion and notify application
  * \param[in] request The request that has completed
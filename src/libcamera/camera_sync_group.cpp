@@ -0,0 +1,489 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Synchronized capture across multiple cameras
+ */
+
+#include <libcamera/camera_sync_group.h>
+
+#include <algorithm>
+#include <deque>
+#include <errno.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
+
+#include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/request.h>
+
+#include "libcamera/internal/clock_recovery.h"
+
+/**
+ * \file camera_sync_group.h
+ * \brief Synchronized capture across multiple cameras
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(CameraSync)
+
+namespace {
+
+/* Tolerance used when the frame duration of the cameras is unknown. */
+constexpr std::chrono::nanoseconds kDefaultTolerance = std::chrono::milliseconds(10);
+
+/*
+ * Maximum number of completed requests held per camera while waiting for the
+ * other cameras. It must be lower than the number of requests queued to each
+ * camera, otherwise a stalled camera would starve the other ones.
+ */
+constexpr unsigned int kMaxPending = 3;
+
+} /* namespace */
+
+class CameraSyncGroup::Private : public Extensible::Private
+{
+	LIBCAMERA_DECLARE_PUBLIC(CameraSyncGroup)
+
+public:
+	Private(const std::vector<std::shared_ptr<Camera>> &cameras);
+
+	void requestCompleted(unsigned int index, Request *request);
+	void flush(std::vector<Frame> *frames);
+
+	std::vector<std::shared_ptr<Camera>> cameras_;
+
+	Mutex mutex_;
+	std::chrono::nanoseconds tolerance_;
+	bool autoTolerance_;
+	std::chrono::nanoseconds frameDuration_;
+	bool running_;
+
+	struct PendingRequest {
+		Request *request;
+		/* Smoothed timestamp, used to pair requests */
+		int64_t timestamp;
+		/* Sensor timestamp, used to report the skew */
+		int64_t sensorTimestamp;
+	};
+
+	struct CameraState {
+		std::deque<PendingRequest> pending;
+		ClockRecovery clock;
+	};
+
+	std::vector<CameraState> states_;
+
+private:
+	int64_t alignTimestamp(CameraState &state, const Request *request,
+			       int64_t timestamp);
+	void match(std::vector<Frame> *frames);
+	Frame unpaired(unsigned int index, Request *request) const;
+};
+
+CameraSyncGroup::Private::Private(const std::vector<std::shared_ptr<Camera>> &cameras)
+	: cameras_(cameras), tolerance_(kDefaultTolerance), autoTolerance_(true),
+	  frameDuration_(0), running_(false), states_(cameras.size())
+{
+}
+
+void CameraSyncGroup::Private::requestCompleted(unsigned int index, Request *request)
+{
+	std::vector<Frame> frames;
+
+	{
+		MutexLocker locker(mutex_);
+
+		const auto timestamp = request->metadata().get(controls::SensorTimestamp);
+
+		/*
+		 * Cancelled requests, requests completed while stopping and
+		 * requests without a timestamp can't be paired.
+		 */
+		if (!running_ || request->status() != Request::RequestComplete ||
+		    !timestamp) {
+			frames.push_back(unpaired(index, request));
+		} else {
+			CameraState &state = states_[index];
+			int64_t aligned = alignTimestamp(state, request, *timestamp);
+
+			state.pending.push_back({ request, aligned, *timestamp });
+			match(&frames);
+		}
+	}
+
+	for (const Frame &frame : frames)
+		_o<CameraSyncGroup>()->frameCompleted.emit(frame);
+}
+
+void CameraSyncGroup::Private::flush(std::vector<Frame> *frames)
+{
+	for (unsigned int i = 0; i < states_.size(); ++i) {
+		for (const PendingRequest &pending : states_[i].pending)
+			frames->push_back(unpaired(i, pending.request));
+
+		states_[i].pending.clear();
+	}
+}
+
+/*
+ * Smooth the jitter of the sensor timestamps by modelling them as a linear
+ * function of the frame sequence number, as the cameras run at a fixed frame
+ * duration. ClockRecovery operates in microseconds.
+ */
+int64_t CameraSyncGroup::Private::alignTimestamp(CameraState &state,
+						 const Request *request,
+						 int64_t timestamp)
+{
+	if (!frameDuration_.count() || request->buffers().empty())
+		return timestamp;
+
+	const FrameBuffer *buffer = request->buffers().begin()->second;
+	uint64_t input = static_cast<uint64_t>(buffer->metadata().sequence) *
+			 (frameDuration_.count() / 1000);
+	uint64_t output = timestamp / 1000;
+
+	state.clock.addSample(input, output);
+
+	return static_cast<int64_t>(state.clock.getOutput(input)) * 1000;
+}
+
+void CameraSyncGroup::Private::match(std::vector<Frame> *frames)
+{
+	while (true) {
+		bool ready = std::all_of(states_.begin(), states_.end(),
+					 [](const CameraState &state) {
+						 return !state.pending.empty();
+					 });
+		if (!ready) {
+			/* Don't hold requests forever when a camera stalls. */
+			for (unsigned int i = 0; i < states_.size(); ++i) {
+				std::deque<PendingRequest> &pending = states_[i].pending;
+
+				while (pending.size() > kMaxPending) {
+					frames->push_back(unpaired(i, pending.front().request));
+					pending.pop_front();
+				}
+			}
+
+			return;
+		}
+
+		unsigned int earliest = 0;
+		int64_t minTimestamp = states_[0].pending.front().timestamp;
+		int64_t maxTimestamp = minTimestamp;
+
+		for (unsigned int i = 1; i < states_.size(); ++i) {
+			int64_t timestamp = states_[i].pending.front().timestamp;
+
+			if (timestamp < minTimestamp) {
+				minTimestamp = timestamp;
+				earliest = i;
+			}
+
+			maxTimestamp = std::max(maxTimestamp, timestamp);
+		}
+
+		if (maxTimestamp - minTimestamp <= tolerance_.count()) {
+			/*
+			 * Report the skew between the sensor timestamps, not
+			 * the smoothed timestamps, to reflect the actual
+			 * capture time difference.
+			 */
+			int64_t minSensorTimestamp = states_[0].pending.front().sensorTimestamp;
+			int64_t maxSensorTimestamp = minSensorTimestamp;
+			Frame frame;
+
+			for (CameraState &state : states_) {
+				const PendingRequest &pending = state.pending.front();
+
+				minSensorTimestamp = std::min(minSensorTimestamp,
+							      pending.sensorTimestamp);
+				maxSensorTimestamp = std::max(maxSensorTimestamp,
+							      pending.sensorTimestamp);
+
+				frame.requests.push_back(pending.request);
+				state.pending.pop_front();
+			}
+
+			frame.skew = maxSensorTimestamp - minSensorTimestamp;
+			frames->push_back(std::move(frame));
+			continue;
+		}
+
+		/*
+		 * The earliest frame is too far from the oldest frames of all
+		 * other cameras to be paired, and later frames will be further
+		 * away. Complete it on its own.
+		 */
+		LOG(CameraSync, Debug)
+			<< "Dropping synchronization of "
+			<< cameras_[earliest]->id() << " frame, skew "
+			<< maxTimestamp - minTimestamp << "ns";
+
+		frames->push_back(unpaired(earliest, states_[earliest].pending.front().request));
+		states_[earliest].pending.pop_front();
+	}
+}
+
+CameraSyncGroup::Frame CameraSyncGroup::Private::unpaired(unsigned int index,
+							  Request *request) const
+{
+	Frame frame;
+	frame.requests.resize(cameras_.size(), nullptr);
+	frame.requests[index] = request;
+	frame.skew = 0;
+
+	return frame;
+}
+
+/**
+ * \class CameraSyncGroup
+ * \brief Synchronize the capture of frames across multiple cameras
+ *
+ * Applications that capture from multiple cameras at the same time, such as
+ * stereo or multi-view rigs, need to process the frames captured at the same
+ * instant together. The CameraSyncGroup groups the cameras, starts them with a
+ * common frame duration, and pairs the requests they complete by their sensor
+ * timestamps.
+ *
+ * The cameras shall be acquired and configured by the application before
+ * starting the group with start(), and the application keeps creating and
+ * queuing requests to each camera. Completed requests are reported through the
+ * frameCompleted signal, grouped in frames that contain one request per camera.
+ * The Camera::requestCompleted signal is still emitted for every request, but
+ * the request may then be held by the group to be paired with requests of the
+ * other cameras. Applications shall thus process and requeue requests from the
+ * frameCompleted signal only. Requests that can't be paired with requests from
+ * all other cameras, because a camera dropped a frame, or because the request
+ * has been cancelled, are reported in a frame of their own.
+ *
+ * Frames are paired in software by comparing their SensorTimestamp, which all
+ * cameras express in the CLOCK_MONOTONIC clock. The jitter of the timestamps is
+ * reduced by a per-camera ClockRecovery model that relates the timestamps to
+ * the frame sequence numbers, for pairing purpose only. This doesn't control
+ * the exposure start time of the camera sensors. The difference between the
+ * sensor timestamps of the requests of a frame is reported as the frame skew.
+ * Pipeline handlers that support hardware or IPA synchronization can be used
+ * alongside the group to reduce the skew.
+ */
+
+/**
+ * \struct CameraSyncGroup::Frame
+ * \brief A set of requests captured at the same time by cameras of the group
+ *
+ * \var CameraSyncGroup::Frame::requests
+ * \brief The requests of the frame, in the order of CameraSyncGroup::cameras()
+ *
+ * Entries for cameras that have no request in the frame are set to nullptr.
+ *
+ * \var CameraSyncGroup::Frame::skew
+ * \brief The difference in nanoseconds between the latest and the earliest
+ * SensorTimestamp of the requests in the frame
+ *
+ * The skew is computed from the sensor timestamps reported in the request
+ * metadata, and may thus exceed the tolerance when the timestamps jitter.
+ */
+
+/**
+ * \brief Create a synchronization group for \a cameras
+ * \param[in] cameras The cameras to synchronize
+ */
+CameraSyncGroup::CameraSyncGroup(const std::vector<std::shared_ptr<Camera>> &cameras)
+	: Extensible(std::make_unique<Private>(cameras))
+{
+	Private *const d = _d();
+
+	for (unsigned int i = 0; i < cameras.size(); ++i) {
+		cameras[i]->requestCompleted.connect(d, [d, i](Request *request) {
+			d->requestCompleted(i, request);
+		});
+	}
+}
+
+CameraSyncGroup::~CameraSyncGroup()
+{
+	Private *const d = _d();
+
+	for (const std::shared_ptr<Camera> &camera : d->cameras_)
+		camera->requestCompleted.disconnect(d);
+}
+
+/**
+ * \brief Retrieve the cameras of the group
+ * \return The cameras of the group
+ */
+const std::vector<std::shared_ptr<Camera>> &CameraSyncGroup::cameras() const
+{
+	return _d()->cameras_;
+}
+
+/**
+ * \brief Set the maximum timestamp difference between requests of a frame
+ * \param[in] tolerance The maximum timestamp difference
+ *
+ * By default, the tolerance is set to half the frame duration when the group
+ * is started, or to 10ms if the frame duration is unknown.
+ */
+void CameraSyncGroup::setTolerance(std::chrono::nanoseconds tolerance)
+{
+	Private *const d = _d();
+
+	MutexLocker locker(d->mutex_);
+	d->tolerance_ = tolerance;
+	d->autoTolerance_ = false;
+}
+
+/**
+ * \brief Retrieve the maximum timestamp difference between requests of a frame
+ * \return The tolerance
+ */
+std::chrono::nanoseconds CameraSyncGroup::tolerance() const
+{
+	Private *const d = const_cast<Private *>(_d());
+
+	MutexLocker locker(d->mutex_);
+	return d->tolerance_;
+}
+
+/**
+ * \brief Retrieve the common frame duration of the cameras
+ * \return The frame duration, or 0 if the cameras run at their own rate
+ */
+std::chrono::nanoseconds CameraSyncGroup::frameDuration() const
+{
+	Private *const d = const_cast<Private *>(_d());
+
+	MutexLocker locker(d->mutex_);
+	return d->frameDuration_;
+}
+
+/**
+ * \brief Start capture on all cameras of the group
+ * \param[in] controls Controls to be applied before starting the cameras
+ *
+ * The cameras are started one after the other with the same \a controls. If
+ * \a controls doesn't contain the FrameDurationLimits control, the cameras that
+ * support it are set to the longest of their minimum frame durations, to run
+ * all cameras at the same rate.
+ *
+ * \return 0 on success or a negative error code otherwise, as returned by
+ * Camera::start()
+ */
+int CameraSyncGroup::start(const ControlList *controls)
+{
+	Private *const d = _d();
+
+	ControlList startControls = controls ? *controls : ControlList(controls::controls);
+
+	int64_t frameDuration = 0;
+	const auto limits = startControls.get(controls::FrameDurationLimits);
+	if (limits) {
+		if ((*limits)[0] == (*limits)[1])
+			frameDuration = (*limits)[0];
+	} else {
+		for (const std::shared_ptr<Camera> &camera : d->cameras_) {
+			const auto info = camera->controls().find(&controls::FrameDurationLimits);
+			if (info == camera->controls().end())
+				continue;
+
+			frameDuration = std::max(frameDuration,
+						 info->second.min().get<int64_t>());
+		}
+	}
+
+	{
+		MutexLocker locker(d->mutex_);
+
+		/* FrameDurationLimits is expressed in microseconds. */
+		d->frameDuration_ = std::chrono::microseconds(frameDuration);
+		if (d->autoTolerance_ && frameDuration)
+			d->tolerance_ = d->frameDuration_ / 2;
+
+		for (Private::CameraState &state : d->states_) {
+			state.pending.clear();
+			state.clock.reset();
+		}
+
+		d->running_ = true;
+	}
+
+	LOG(CameraSync, Debug)
+		<< "Starting " << d->cameras_.size() << " cameras with frame duration "
+		<< frameDuration << "us";
+
+	for (unsigned int i = 0; i < d->cameras_.size(); ++i) {
+		Camera *camera = d->cameras_[i].get();
+
+		ControlList cameraControls = startControls;
+		if (!limits && frameDuration &&
+		    camera->controls().count(controls::FrameDurationLimits.id()))
+			cameraControls.set(controls::FrameDurationLimits,
+					   { frameDuration, frameDuration });
+
+		int ret = camera->start(&cameraControls);
+		if (ret) {
+			LOG(CameraSync, Error)
+				<< "Failed to start camera " << camera->id();
+
+			{
+				MutexLocker locker(d->mutex_);
+				d->running_ = false;
+			}
+
+			while (i--)
+				d->cameras_[i]->stop();
+
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Stop capture on all cameras of the group
+ *
+ * Requests waiting to be paired are completed in frames of their own, and the
+ * cameras are then stopped, completing all their pending requests.
+ *
+ * \return 0 on success or a negative error code otherwise, as returned by
+ * Camera::stop()
+ */
+int CameraSyncGroup::stop()
+{
+	Private *const d = _d();
+	std::vector<Frame> frames;
+
+	{
+		MutexLocker locker(d->mutex_);
+		d->running_ = false;
+		d->flush(&frames);
+	}
+
+	for (const Frame &frame : frames)
+		frameCompleted.emit(frame);
+
+	int ret = 0;
+	for (const std::shared_ptr<Camera> &camera : d->cameras_) {
+		int err = camera->stop();
+		if (err && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+/**
+ * \var CameraSyncGroup::frameCompleted
+ * \brief Signal emitted when a frame has completed
+ *
+ * The signal is emitted from the libcamera internal thread, in the same
+ * conditions as the Camera::requestCompleted signal.
+ */
+
+} /* namespace libcamera */
@@ -11,6 +11,7 @@
 
 #include <libcamera/controls.h>
 
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/v4l2_device.h"
 
 /**
@@ -228,15 +229,23 @@ ControlList DelayedControls::get(uint32_t sequence)
  * number. Any user of these helpers is responsible to inform the helper about
  * the start of any frame. This can be connected with ease to the start of a
  * exposure (SOE) V4L2 event.
+ *
+ * All controls due for a frame are written with at most one VIDIOC_S_EXT_CTRLS
+ * call for the controls flagged with ControlParams::priorityWrite, followed by
+ * one call for the remaining controls.
  */
 void DelayedControls::applyControls(uint32_t sequence)
 {
 	LOG(DelayedControls, Debug) << "frame " << sequence << " started";
 
+	LIBCAMERA_TRACEPOINT(delayed_controls_apply_begin,
+			     device_->deviceNode().c_str(), sequence);
+
 	/*
 	 * Create control list peeking ahead in the value queue to ensure
 	 * values are set in time to satisfy the sensor delay.
 	 */
+	ControlList priority(device_->controls());
 	ControlList out(device_->controls());
 	for (auto &ctrl : values_) {
 		const ControlId *id = ctrl.first;
@@ -247,12 +256,10 @@ void DelayedControls::applyControls(uint32_t sequence)
 		if (info.updated) {
 			if (controlParams_[id].priorityWrite) {
 				/*
-				 * This control must be written now, it could
-				 * affect validity of the other controls.
+				 * These controls must be written first, they
+				 * could affect validity of the other controls.
 				 */
-				ControlList priority(device_->controls());
 				priority.set(id->id(), info);
-				device_->setControls(&priority);
 			} else {
 				/*
 				 * Batch up the list of controls and write them
@@ -279,7 +286,15 @@ void DelayedControls::applyControls(uint32_t sequence)
 		push({});
 	}
 
+	unsigned int count = priority.size() + out.size();
+	unsigned int writes = !priority.empty() + !out.empty();
+
+	device_->setControls(&priority);
 	device_->setControls(&out);
+
+	LIBCAMERA_TRACEPOINT(delayed_controls_apply_end,
+			     device_->deviceNode().c_str(), sequence, count,
+			     writes);
 }
 
 } /* namespace libcamera */
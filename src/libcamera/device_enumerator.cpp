@@ -7,9 +7,14 @@
 
 #include "libcamera/internal/device_enumerator.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <string.h>
+#include <thread>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/thread.h>
 
 #include "libcamera/internal/device_enumerator_sysfs.h"
 #include "libcamera/internal/device_enumerator_udev.h"
@@ -40,6 +45,28 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(DeviceEnumerator)
 
+namespace {
+
+class DevicePopulateThread : public Thread
+{
+public:
+	DevicePopulateThread(std::function<void()> work)
+		: work_(std::move(work))
+	{
+	}
+
+protected:
+	void run() override
+	{
+		work_();
+	}
+
+private:
+	std::function<void()> work_;
+};
+
+} /* namespace */
+
 /**
  * \class DeviceMatch
  * \brief Description of a media device search pattern
@@ -234,6 +261,54 @@ std::unique_ptr<MediaDevice> DeviceEnumerator::createDevice(const std::string &d
 	return media;
 }
 
+/**
+ * \brief Create multiple media device instances concurrently
+ * \param[in] deviceNodes paths to the media devices to create
+ *
+ * Create a media device for each entry in \a deviceNodes as done by
+ * createDevice(). Populating a media device graph is self-contained and mostly
+ * spends time waiting for the kernel, so media devices are populated in
+ * parallel by a pool of worker threads, bounded by the number of CPUs, to
+ * reduce the enumeration time on systems with multiple media devices.
+ *
+ * \return A vector of created media device instances, in the same order as
+ * \a deviceNodes, with a nullptr entry for each media device that failed to be
+ * created
+ */
+std::vector<std::unique_ptr<MediaDevice>>
+DeviceEnumerator::createDevices(const std::vector<std::string> &deviceNodes)
+{
+	std::vector<std::unique_ptr<MediaDevice>> devices(deviceNodes.size());
+
+	std::atomic<unsigned int> next = 0;
+
+	auto work = [this, &devices, &deviceNodes, &next]() {
+		for (unsigned int i = next++; i < deviceNodes.size(); i = next++)
+			devices[i] = createDevice(deviceNodes[i]);
+	};
+
+	unsigned int numThreads =
+		std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1U),
+				      deviceNodes.size());
+	if (numThreads <= 1) {
+		work();
+		return devices;
+	}
+
+	/* Create all workers before starting any of them. */
+	std::vector<std::unique_ptr<DevicePopulateThread>> threads;
+	for (unsigned int i = 0; i < numThreads; i++)
+		threads.push_back(std::make_unique<DevicePopulateThread>(work));
+
+	for (auto &thread : threads)
+		thread->start();
+
+	for (auto &thread : threads)
+		thread->wait();
+
+	return devices;
+}
+
 /**
 * \var DeviceEnumerator::devicesAdded
 * \brief Notify of new media devices being found
@@ -16,6 +16,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/log.h>
 
@@ -32,6 +33,7 @@ int DeviceEnumeratorSysfs::init()
 
 int DeviceEnumeratorSysfs::enumerate()
 {
+	std::vector<std::string> devnodes;
 	struct dirent *ent;
 	DIR *dir = nullptr;
 
@@ -73,7 +75,12 @@ int DeviceEnumeratorSysfs::enumerate()
 			continue;
 		}
 
-		std::unique_ptr<MediaDevice> media = createDevice(devnode);
+		devnodes.push_back(std::move(devnode));
+	}
+
+	closedir(dir);
+
+	for (std::unique_ptr<MediaDevice> &media : createDevices(devnodes)) {
 		if (!media)
 			continue;
 
@@ -88,8 +95,6 @@ int DeviceEnumeratorSysfs::enumerate()
 		addDevice(std::move(media));
 	}
 
-	closedir(dir);
-
 	return 0;
 }
 
@@ -17,6 +17,7 @@
 #include <sys/ioctl.h>
 #include <sys/sysmacros.h>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/event_notifier.h>
 #include <libcamera/base/log.h>
@@ -82,32 +83,7 @@ int DeviceEnumeratorUdev::addUdevDevice(struct udev_device *dev)
 		if (!media)
 			return -ENODEV;
 
-		DependencyMap deps;
-		int ret = populateMediaDevice(media.get(), &deps);
-		if (ret < 0) {
-			LOG(DeviceEnumerator, Warning)
-				<< "Failed to populate media device "
-				<< media->deviceNode()
-				<< " (" << media->driver() << "), skipping";
-			return ret;
-		}
-
-		if (!deps.empty()) {
-			LOG(DeviceEnumerator, Debug)
-				<< "Defer media device " << media->deviceNode()
-				<< " due to " << deps.size()
-				<< " missing dependencies";
-
-			pending_.emplace_back(std::move(media), std::move(deps));
-			MediaDeviceDeps *mediaDeps = &pending_.back();
-			for (const auto &dep : mediaDeps->deps_)
-				devMap_[dep.first] = mediaDeps;
-
-			return 0;
-		}
-
-		addDevice(std::move(media));
-		return 0;
+		return addMediaDevice(std::move(media));
 	}
 
 	if (!strcmp(subsystem, "video4linux")) {
@@ -118,10 +94,44 @@ int DeviceEnumeratorUdev::addUdevDevice(struct udev_device *dev)
 	return -ENODEV;
 }
 
+int DeviceEnumeratorUdev::addMediaDevice(std::unique_ptr<MediaDevice> media)
+{
+	DependencyMap deps;
+	int ret = populateMediaDevice(media.get(), &deps);
+	if (ret < 0) {
+		LOG(DeviceEnumerator, Warning)
+			<< "Failed to populate media device "
+			<< media->deviceNode()
+			<< " (" << media->driver() << "), skipping";
+		return ret;
+	}
+
+	if (!deps.empty()) {
+		LOG(DeviceEnumerator, Debug)
+			<< "Defer media device " << media->deviceNode()
+			<< " due to " << deps.size()
+			<< " missing dependencies";
+
+		pending_.emplace_back(std::move(media), std::move(deps));
+		MediaDeviceDeps *mediaDeps = &pending_.back();
+		for (const auto &dep : mediaDeps->deps_)
+			devMap_[dep.first] = mediaDeps;
+
+		return 0;
+	}
+
+	addDevice(std::move(media));
+	return 0;
+}
+
 int DeviceEnumeratorUdev::enumerate()
 {
 	struct udev_enumerate *udev_enum = nullptr;
 	struct udev_list_entry *ents, *ent;
+	std::vector<struct udev_device *> devices;
+	std::vector<std::string> mediaNodes;
+	std::vector<std::unique_ptr<MediaDevice>> medias;
+	std::vector<std::unique_ptr<MediaDevice>>::iterator media;
 	int ret;
 
 	udev_enum = udev_enumerate_new(udev_);
@@ -170,10 +180,35 @@ int DeviceEnumeratorUdev::enumerate()
 			continue;
 		}
 
-		if (addUdevDevice(dev) < 0)
+		devices.push_back(dev);
+
+		const char *subsystem = udev_device_get_subsystem(dev);
+		if (subsystem && !strcmp(subsystem, "media"))
+			mediaNodes.push_back(devnode);
+	}
+
+	/*
+	 * Populate the graph of all media devices concurrently, and then add
+	 * all devices in enumeration order.
+	 */
+	medias = createDevices(mediaNodes);
+	media = medias.begin();
+
+	for (struct udev_device *dev : devices) {
+		const char *subsystem = udev_device_get_subsystem(dev);
+		const char *syspath = udev_device_get_syspath(dev);
+
+		if (subsystem && !strcmp(subsystem, "media")) {
+			std::unique_ptr<MediaDevice> device = std::move(*media++);
+			if (!device || addMediaDevice(std::move(device)) < 0)
+				LOG(DeviceEnumerator, Warning)
+					<< "Failed to add device for '"
+					<< syspath << "', skipping";
+		} else if (addUdevDevice(dev) < 0) {
 			LOG(DeviceEnumerator, Warning)
 				<< "Failed to add device for '"
 				<< syspath << "', skipping";
+		}
 
 		udev_device_unref(dev);
 	}
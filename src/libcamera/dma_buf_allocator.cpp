@@ -112,6 +112,7 @@ DmaBufAllocator::DmaBufAllocator(DmaBufAllocatorFlags type)
 		LOG(DmaBufAllocator, Debug) << "Using " << info.deviceNodeName;
 		providerHandle_ = UniqueFD(ret);
 		type_ = info.type;
+		deviceNode_ = info.deviceNodeName;
 		break;
 	}
 
@@ -129,6 +130,13 @@ DmaBufAllocator::~DmaBufAllocator() = default;
  * \brief Check if the DmaBufAllocator instance is valid
  * \return True if the DmaBufAllocator is valid, false otherwise
  */
+
+/**
+ * \fn DmaBufAllocator::deviceNode()
+ * \brief Retrieve the device node of the dma-buf provider
+ * \return The path to the device node of the dma-buf provider, or nullptr if
+ * the DmaBufAllocator is not valid
+ */
 UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
 {
 	/* Size must be a multiple of the page size. Round it up. */
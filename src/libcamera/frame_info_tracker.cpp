@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Tracker of per-frame information for pipeline handlers
+ */
+
+#include "libcamera/internal/frame_info_tracker.h"
+
+/**
+ * \file frame_info_tracker.h
+ * \brief Tracking of per-frame information in pipeline handlers
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(FrameInfoTracker)
+
+/**
+ * \struct FrameInfo
+ * \brief Base structure for per-frame information tracked by FrameInfoTracker
+ *
+ * Pipeline handlers derive their per-frame information structure from
+ * FrameInfo, and add the buffers and state they need to track the processing
+ * of a frame. The FrameInfo members are set by FrameInfoTracker::create() and
+ * shall not be modified by pipeline handlers.
+ *
+ * \var FrameInfo::frame
+ * \brief The frame number
+ *
+ * \var FrameInfo::request
+ * \brief The request associated with the frame
+ */
+
+/**
+ * \class FrameInfoTracker
+ * \brief Fixed-capacity tracker of per-frame information in pipeline handlers
+ * \tparam Info The pipeline handler-specific FrameInfo derived structure type
+ *
+ * Pipeline handlers associate information with each request they process, such
+ * as internal buffers or completion state, and need to retrieve it when a
+ * buffer completes, or when the IPA module returns results for a frame. The
+ * FrameInfoTracker stores that information and retrieves it by frame number,
+ * by request or by buffer in constant time.
+ *
+ * Entries are stored in a circular buffer indexed by frame number, and
+ * referenced from a second circular buffer indexed by request sequence number.
+ * Frame numbers and request sequence numbers are expected to increase
+ * monotonically. They may differ, for instance when the frame number follows
+ * the sequence number of the frames produced by the camera sensor. Buffers are
+ * looked up through the request they are associated with. Internal buffers of
+ * the pipeline handler must thus be associated with the request of the frame
+ * they belong to with FrameBuffer::Private::setRequest().
+ *
+ * The storage is allocated when constructing or resetting the tracker, and no
+ * memory is allocated when creating or destroying entries. If an entry is
+ * created while its storage slot is still in use, because more frames are in
+ * flight than the capacity allows or frame numbers have skipped, the capacity
+ * is doubled until all entries fit. Entries are not moved in memory when the
+ * capacity grows, pointers to entries thus stay valid until the entries are
+ * destroyed. Pipeline handlers should size the tracker for the depth of their
+ * request queue to avoid growing it while streaming.
+ *
+ * The tracker checks the consistency of the frames it tracks. Frames are
+ * expected to complete, and be destroyed, in the order they have been created.
+ * A warning is logged when a frame is destroyed while older frames are still
+ * tracked, and when a lookup finds the storage slot of the frame or request
+ * used by another entry, as this indicates that an older frame has never been
+ * destroyed or that the looked up frame has completed already. Frame numbers
+ * are compared modulo 2^32.
+ *
+ * Entries are created, looked up and destroyed in the pipeline handler thread
+ * only, the tracker doesn't use any lock.
+ */
+
+/**
+ * \fn FrameInfoTracker::FrameInfoTracker(unsigned int capacity)
+ * \brief Construct a frame information tracker
+ * \param[in] capacity The number of frames that can be tracked concurrently
+ */
+
+/**
+ * \fn FrameInfoTracker::reset()
+ * \brief Destroy the information for all frames and change the capacity
+ * \param[in] capacity The number of frames that can be tracked concurrently
+ *
+ * This function is meant to be called when the pipeline handler starts the
+ * camera and knows how many frames it can have in flight, for instance based on
+ * the number of internal buffers it has allocated.
+ */
+
+/**
+ * \fn FrameInfoTracker::create()
+ * \brief Create the information for a frame
+ * \param[in] frame The frame number
+ * \param[in] request The request associated with the frame
+ *
+ * Create a new entry for \a frame and \a request, value-initialized except for
+ * the FrameInfo members. Creating an entry may increase the capacity of the
+ * tracker, pointers to the other entries stay valid.
+ *
+ * A warning is logged if \a frame is not larger than the frame number of the
+ * last created entry.
+ *
+ * \return A pointer to the frame information, or nullptr if \a frame or
+ * \a request is already tracked
+ */
+
+/**
+ * \fn FrameInfoTracker::destroy()
+ * \brief Destroy the information for a frame
+ * \param[in] info The frame information
+ *
+ * The frame information must have been returned by create() and not destroyed
+ * yet, otherwise an error is logged and the tracker is left unchanged. A
+ * warning is logged if older frames are still tracked.
+ */
+
+/**
+ * \fn FrameInfoTracker::clear()
+ * \brief Destroy the information for all frames
+ */
+
+/**
+ * \fn FrameInfoTracker::find(uint32_t frame)
+ * \brief Find the information for a frame from its frame number
+ * \param[in] frame The frame number
+ *
+ * A warning is logged if \a frame isn't tracked and its storage slot is used
+ * by another frame.
+ *
+ * \return A pointer to the frame information, or nullptr if not found
+ */
+
+/**
+ * \fn FrameInfoTracker::find(const Request *request)
+ * \brief Find the information for a frame from its request
+ * \param[in] request The request
+ *
+ * A warning is logged if \a request isn't tracked and its storage slot is used
+ * by another request.
+ *
+ * \return A pointer to the frame information, or nullptr if not found
+ */
+
+/**
+ * \fn FrameInfoTracker::find(const FrameBuffer *buffer)
+ * \brief Find the information for a frame from one of its buffers
+ * \param[in] buffer The buffer
+ *
+ * The information is looked up from the request \a buffer is associated with.
+ *
+ * \return A pointer to the frame information, or nullptr if not found
+ */
+
+/**
+ * \fn FrameInfoTracker::forEach()
+ * \brief Call a function for the information of all tracked frames
+ * \param[in] func The function, taking an Info reference as argument
+ */
+
+/**
+ * \fn FrameInfoTracker::empty()
+ * \brief Check if no frame is being tracked
+ * \return True if no frame is being tracked, false otherwise
+ */
+
+/**
+ * \fn FrameInfoTracker::size()
+ * \brief Retrieve the number of frames being tracked
+ * \return The number of frames being tracked
+ */
+
+/**
+ * \fn FrameInfoTracker::capacity()
+ * \brief Retrieve the number of frames that can be tracked without growing
+ * \return The capacity of the tracker
+ */
+
+} /* namespace libcamera */
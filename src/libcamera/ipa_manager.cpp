@@ -236,16 +236,16 @@ unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
 }
 
 /**
- * \brief Retrieve an IPA module that matches a given pipeline handler
- * \param[in] pipe The pipeline handler
+ * \brief Retrieve an IPA module that matches a given pipeline handler name
+ * \param[in] pipelineName The pipeline handler name
  * \param[in] minVersion Minimum acceptable version of IPA module
  * \param[in] maxVersion Maximum acceptable version of IPA module
  */
-IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
+IPAModule *IPAManager::module(const char *pipelineName, uint32_t minVersion,
 			      uint32_t maxVersion)
 {
 	for (const auto &module : modules_) {
-		if (module->match(pipe, minVersion, maxVersion))
+		if (module->match(pipelineName, minVersion, maxVersion))
 			return module.get();
 	}
 
@@ -253,7 +253,8 @@ IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
 }
 
 /**
- * \fn IPAManager::createIPA()
+ * \fn IPAManager::createIPA(PipelineHandler *pipe, uint32_t minVersion,
+ * uint32_t maxVersion)
  * \brief Create an IPA proxy that matches a given pipeline handler
  * \param[in] pipe The pipeline handler that wants a matching IPA proxy
  * \param[in] minVersion Minimum acceptable version of IPA module
@@ -263,6 +264,24 @@ IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
  * found or if the IPA proxy fails to initialize
  */
 
+/**
+ * \fn IPAManager::createIPA(PipelineHandler *pipe, const char *pipelineName,
+ * uint32_t minVersion, uint32_t maxVersion)
+ * \brief Create an IPA proxy that matches a given pipeline handler name
+ * \param[in] pipe The pipeline handler that wants a matching IPA proxy
+ * \param[in] pipelineName The name of the pipeline handler the IPA module is
+ * designed for
+ * \param[in] minVersion Minimum acceptable version of IPA module
+ * \param[in] maxVersion Maximum acceptable version of IPA module
+ *
+ * This function allows a pipeline handler to use an IPA module designed for a
+ * different pipeline handler, for instance to use the IPA module of a shared
+ * ISP implementation.
+ *
+ * \return A newly created IPA proxy, or nullptr if no matching IPA module is
+ * found or if the IPA proxy fails to initialize
+ */
+
 #if HAVE_IPA_PUBKEY
 /**
  * \fn IPAManager::pubKey()
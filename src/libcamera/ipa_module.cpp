@@ -474,10 +474,28 @@ IPAInterface *IPAModule::createInterface()
  */
 bool IPAModule::match(PipelineHandler *pipe,
 		      uint32_t minVersion, uint32_t maxVersion) const
+{
+	return match(pipe->name(), minVersion, maxVersion);
+}
+
+/**
+ * \brief Verify if the IPA module matches a given pipeline handler name
+ * \param[in] pipelineName Name of the pipeline handler to match with
+ * \param[in] minVersion Minimum acceptable version of IPA module
+ * \param[in] maxVersion Maximum acceptable version of IPA module
+ *
+ * This function checks if this IPA module matches the \a pipelineName pipeline
+ * handler name, and the input version range.
+ *
+ * \return True if the pipeline handler name matches the IPA module, or false
+ * otherwise
+ */
+bool IPAModule::match(const char *pipelineName,
+		      uint32_t minVersion, uint32_t maxVersion) const
 {
 	return info_.pipelineVersion >= minVersion &&
 	       info_.pipelineVersion <= maxVersion &&
-	       !strcmp(info_.pipelineName, pipe->name());
+	       !strcmp(info_.pipelineName, pipelineName);
 }
 
 std::string IPAModule::logPrefix() const
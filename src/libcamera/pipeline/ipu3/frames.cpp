@@ -19,10 +19,6 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPU3)
 
-IPU3Frames::IPU3Frames()
-{
-}
-
 void IPU3Frames::init(const std::vector<std::unique_ptr<FrameBuffer>> &paramBuffers,
 		      const std::vector<std::unique_ptr<FrameBuffer>> &statBuffers)
 {
@@ -32,7 +28,8 @@ void IPU3Frames::init(const std::vector<std::unique_ptr<FrameBuffer>> &paramBuff
 	for (const std::unique_ptr<FrameBuffer> &buffer : statBuffers)
 		availableStatBuffers_.push(buffer.get());
 
-	frameInfo_.clear();
+	/* The number of frames in flight is bounded by the parameter buffers. */
+	frameInfo_.reset(paramBuffers.size());
 }
 
 void IPU3Frames::clear()
@@ -55,6 +52,10 @@ IPU3Frames::Info *IPU3Frames::create(Request *request)
 		return nullptr;
 	}
 
+	Info *info = frameInfo_.create(id, request);
+	if (!info)
+		return nullptr;
+
 	FrameBuffer *paramBuffer = availableParamBuffers_.front();
 	FrameBuffer *statBuffer = availableStatBuffers_.front();
 
@@ -64,20 +65,13 @@ IPU3Frames::Info *IPU3Frames::create(Request *request)
 	availableParamBuffers_.pop();
 	availableStatBuffers_.pop();
 
-	/* \todo Remove the dynamic allocation of Info */
-	std::unique_ptr<Info> info = std::make_unique<Info>();
-
-	info->id = id;
-	info->request = request;
 	info->rawBuffer = nullptr;
 	info->paramBuffer = paramBuffer;
 	info->statBuffer = statBuffer;
 	info->paramDequeued = false;
 	info->metadataProcessed = false;
 
-	frameInfo_[id] = std::move(info);
-
-	return frameInfo_[id].get();
+	return info;
 }
 
 void IPU3Frames::remove(IPU3Frames::Info *info)
@@ -87,7 +81,7 @@ void IPU3Frames::remove(IPU3Frames::Info *info)
 	availableStatBuffers_.push(info->statBuffer);
 
 	/* Delete the extended frame information. */
-	frameInfo_.erase(info->id);
+	frameInfo_.destroy(info);
 }
 
 bool IPU3Frames::tryComplete(IPU3Frames::Info *info)
@@ -112,33 +106,20 @@ bool IPU3Frames::tryComplete(IPU3Frames::Info *info)
 
 IPU3Frames::Info *IPU3Frames::find(unsigned int id)
 {
-	const auto &itInfo = frameInfo_.find(id);
+	Info *info = frameInfo_.find(id);
+	if (!info)
+		LOG(IPU3, Fatal) << "Can't find tracking information for frame " << id;
 
-	if (itInfo != frameInfo_.end())
-		return itInfo->second.get();
-
-	LOG(IPU3, Fatal) << "Can't find tracking information for frame " << id;
-
-	return nullptr;
+	return info;
 }
 
 IPU3Frames::Info *IPU3Frames::find(FrameBuffer *buffer)
 {
-	for (auto const &itInfo : frameInfo_) {
-		Info *info = itInfo.second.get();
-
-		for (auto const itBuffers : info->request->buffers())
-			if (itBuffers.second == buffer)
-				return info;
-
-		if (info->rawBuffer == buffer || info->paramBuffer == buffer ||
-		    info->statBuffer == buffer)
-			return info;
-	}
-
-	LOG(IPU3, Fatal) << "Can't find tracking information from buffer";
+	Info *info = frameInfo_.find(buffer);
+	if (!info)
+		LOG(IPU3, Fatal) << "Can't find tracking information from buffer";
 
-	return nullptr;
+	return info;
 }
 
 } /* namespace libcamera */
@@ -7,7 +7,6 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
 #include <queue>
 #include <vector>
@@ -16,6 +15,8 @@
 
 #include <libcamera/controls.h>
 
+#include "libcamera/internal/frame_info_tracker.h"
+
 namespace libcamera {
 
 class FrameBuffer;
@@ -28,10 +29,7 @@ struct IPABuffer;
 class IPU3Frames
 {
 public:
-	struct Info {
-		unsigned int id;
-		Request *request;
-
+	struct Info : public FrameInfo {
 		FrameBuffer *rawBuffer;
 		FrameBuffer *paramBuffer;
 		FrameBuffer *statBuffer;
@@ -42,8 +40,6 @@ public:
 		bool metadataProcessed;
 	};
 
-	IPU3Frames();
-
 	void init(const std::vector<std::unique_ptr<FrameBuffer>> &paramBuffers,
 		  const std::vector<std::unique_ptr<FrameBuffer>> &statBuffers);
 	void clear();
@@ -61,7 +57,7 @@ private:
 	std::queue<FrameBuffer *> availableParamBuffers_;
 	std::queue<FrameBuffer *> availableStatBuffers_;
 
-	std::map<unsigned int, std::unique_ptr<Info>> frameInfo_;
+	FrameInfoTracker<Info> frameInfo_;
 };
 
 } /* namespace libcamera */
@@ -826,7 +826,7 @@ void IPU3CameraData::queuePendingRequests()
 
 		info->rawBuffer = rawBuffer;
 
-		ipa_->queueRequest(info->id, request->controls());
+		ipa_->queueRequest(info->frame, request->controls());
 
 		pendingRequests_.pop();
 		processingRequests_.push(request);
@@ -1325,7 +1325,7 @@ void IPU3CameraData::cio2BufferReady(FrameBuffer *buffer)
 	if (request->findBuffer(&rawStream_))
 		pipe()->completeBuffer(request, buffer);
 
-	ipa_->computeParams(info->id, info->paramBuffer->cookie());
+	ipa_->computeParams(info->frame, info->paramBuffer->cookie());
 }
 
 void IPU3CameraData::paramBufferReady(FrameBuffer *buffer)
@@ -1369,7 +1369,7 @@ void IPU3CameraData::statBufferReady(FrameBuffer *buffer)
 		return;
 	}
 
-	ipa_->processStats(info->id, request->metadata().get(controls::SensorTimestamp).value_or(0),
+	ipa_->processStats(info->frame, request->metadata().get(controls::SensorTimestamp).value_or(0),
 			   info->statBuffer->cookie(), info->effectiveSensorControls);
 }
 
@@ -34,6 +34,7 @@
 #include "libcamera/internal/camera_sensor_properties.h"
 #include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/frame_info_tracker.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
@@ -79,9 +80,7 @@ constexpr Size kMaliC55MinSize = { 128, 128 };
 constexpr Size kMaliC55MaxSize = { 8192, 8192 };
 constexpr unsigned int kMaliC55ISPInternalFormat = MEDIA_BUS_FMT_RGB121212_1X36;
 
-struct MaliC55FrameInfo {
-	Request *request;
-
+struct MaliC55FrameInfo : public FrameInfo {
 	FrameBuffer *paramBuffer;
 	FrameBuffer *statBuffer;
 
@@ -693,7 +692,7 @@ private:
 	std::vector<std::unique_ptr<FrameBuffer>> paramsBuffers_;
 	std::queue<FrameBuffer *> availableParamsBuffers_;
 
-	std::map<unsigned int, MaliC55FrameInfo> frameInfoMap_;
+	FrameInfoTracker<MaliC55FrameInfo> frameInfo_;
 
 	std::array<MaliC55Pipe, MaliC55NumPipes> pipes_;
 
@@ -1160,6 +1159,13 @@ int PipelineHandlerMaliC55::allocateBuffers(Camera *camera)
 		data->ipa_->mapBuffers(data->ipaParamBuffers_, false);
 	}
 
+	/*
+	 * The number of frames in flight is bounded by the parameter buffers
+	 * when the IPA is used, and by the request queue depth otherwise.
+	 */
+	frameInfo_.reset(data->ipa_ ? paramsBuffers_.size()
+				    : maxQueuedRequestsDevice());
+
 	return 0;
 }
 
@@ -1266,6 +1272,8 @@ void PipelineHandlerMaliC55::stopDevice(Camera *camera)
 	if (data->ipa_)
 		data->ipa_->stop();
 	freeBuffers(camera);
+
+	frameInfo_.clear();
 }
 
 void PipelineHandlerMaliC55::applyScalerCrop(Camera *camera,
@@ -1370,14 +1378,15 @@ int PipelineHandlerMaliC55::queueRequestDevice(Camera *camera, Request *request)
 
 	/* Do not run the IPA if the TPG is in use. */
 	if (!data->ipa_) {
-		MaliC55FrameInfo frameInfo;
-		frameInfo.request = request;
-		frameInfo.statBuffer = nullptr;
-		frameInfo.paramBuffer = nullptr;
-		frameInfo.paramsDone = true;
-		frameInfo.statsDone = true;
+		MaliC55FrameInfo *frameInfo = frameInfo_.create(request->sequence(),
+								request);
+		if (!frameInfo)
+			return -EINVAL;
 
-		frameInfoMap_[request->sequence()] = frameInfo;
+		frameInfo->statBuffer = nullptr;
+		frameInfo->paramBuffer = nullptr;
+		frameInfo->paramsDone = true;
+		frameInfo->statsDone = true;
 
 		for (auto &[stream, buffer] : request->buffers()) {
 			MaliC55Pipe *pipe = pipeFromStream(data, stream);
@@ -1398,45 +1407,38 @@ int PipelineHandlerMaliC55::queueRequestDevice(Camera *camera, Request *request)
 		return -ENOENT;
 	}
 
-	MaliC55FrameInfo frameInfo;
-	frameInfo.request = request;
+	MaliC55FrameInfo *frameInfo = frameInfo_.create(request->sequence(),
+							request);
+	if (!frameInfo)
+		return -EINVAL;
 
-	frameInfo.statBuffer = availableStatsBuffers_.front();
+	frameInfo->statBuffer = availableStatsBuffers_.front();
 	availableStatsBuffers_.pop();
-	frameInfo.paramBuffer = availableParamsBuffers_.front();
+	frameInfo->paramBuffer = availableParamsBuffers_.front();
 	availableParamsBuffers_.pop();
 
-	frameInfo.paramsDone = false;
-	frameInfo.statsDone = false;
+	/* Associate the internal buffers with the request to look them up. */
+	frameInfo->statBuffer->_d()->setRequest(request);
+	frameInfo->paramBuffer->_d()->setRequest(request);
 
-	frameInfoMap_[request->sequence()] = frameInfo;
+	frameInfo->paramsDone = false;
+	frameInfo->statsDone = false;
 
 	data->ipa_->queueRequest(request->sequence(), request->controls());
 	data->ipa_->fillParams(request->sequence(),
-			       frameInfo.paramBuffer->cookie());
+			       frameInfo->paramBuffer->cookie());
 
 	return 0;
 }
 
 MaliC55FrameInfo *PipelineHandlerMaliC55::findFrameInfo(Request *request)
 {
-	for (auto &[sequence, info] : frameInfoMap_) {
-		if (info.request == request)
-			return &info;
-	}
-
-	return nullptr;
+	return frameInfo_.find(request);
 }
 
 MaliC55FrameInfo *PipelineHandlerMaliC55::findFrameInfo(FrameBuffer *buffer)
 {
-	for (auto &[sequence, info] : frameInfoMap_) {
-		if (info.paramBuffer == buffer ||
-		    info.statBuffer == buffer)
-			return &info;
-	}
-
-	return nullptr;
+	return frameInfo_.find(buffer);
 }
 
 void PipelineHandlerMaliC55::tryComplete(MaliC55FrameInfo *info)
@@ -1455,7 +1457,7 @@ void PipelineHandlerMaliC55::tryComplete(MaliC55FrameInfo *info)
 	if (info->paramBuffer)
 		availableParamsBuffers_.push(info->paramBuffer);
 
-	frameInfoMap_.erase(request->sequence());
+	frameInfo_.destroy(info);
 
 	completeRequest(request);
 }
@@ -1496,8 +1498,10 @@ void PipelineHandlerMaliC55::statsBufferReady(FrameBuffer *buffer)
 
 void PipelineHandlerMaliC55::paramsComputed(unsigned int requestId)
 {
-	MaliC55FrameInfo &frameInfo = frameInfoMap_[requestId];
-	Request *request = frameInfo.request;
+	MaliC55FrameInfo *frameInfo = frameInfo_.find(requestId);
+	ASSERT(frameInfo);
+
+	Request *request = frameInfo->request;
 	MaliC55CameraData *data = cameraData(request->_d()->camera());
 
 	/*
@@ -1505,10 +1509,10 @@ void PipelineHandlerMaliC55::paramsComputed(unsigned int requestId)
 	 * video devices.
 	 */
 
-	frameInfo.paramBuffer->_d()->metadata().planes()[0].bytesused =
+	frameInfo->paramBuffer->_d()->metadata().planes()[0].bytesused =
 		sizeof(struct mali_c55_params_buffer);
-	params_->queueBuffer(frameInfo.paramBuffer);
-	stats_->queueBuffer(frameInfo.statBuffer);
+	params_->queueBuffer(frameInfo->paramBuffer);
+	stats_->queueBuffer(frameInfo->statBuffer);
 
 	for (auto &[stream, buffer] : request->buffers()) {
 		MaliC55Pipe *pipe = pipeFromStream(data, stream);
@@ -1520,12 +1524,13 @@ void PipelineHandlerMaliC55::paramsComputed(unsigned int requestId)
 void PipelineHandlerMaliC55::statsProcessed(unsigned int requestId,
 					    const ControlList &metadata)
 {
-	MaliC55FrameInfo &frameInfo = frameInfoMap_[requestId];
+	MaliC55FrameInfo *frameInfo = frameInfo_.find(requestId);
+	ASSERT(frameInfo);
 
-	frameInfo.statsDone = true;
-	frameInfo.request->metadata().merge(metadata);
+	frameInfo->statsDone = true;
+	frameInfo->request->metadata().merge(metadata);
 
-	tryComplete(&frameInfo);
+	tryComplete(frameInfo);
 }
 
 bool PipelineHandlerMaliC55::registerMaliCamera(std::unique_ptr<MaliC55CameraData> data,
@@ -39,11 +39,13 @@
 #include "libcamera/internal/converter/converter_v4l2_m2m.h"
 #include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/frame_info_tracker.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/media_pipeline.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/v4l2_subdevice.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
@@ -53,13 +55,18 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(RkISP1)
 
+/*
+ * Maximum number of requests queued to the device. Parameters are computed by
+ * the IPA when a request is queued, this bounds how many frames ahead of the
+ * capture they are prepared, and keeps the number of frames in flight well
+ * within the IPA frame context queue.
+ */
+static constexpr unsigned int kRkISP1MaxQueuedRequests = 4;
+
 class PipelineHandlerRkISP1;
 class RkISP1CameraData;
 
-struct RkISP1FrameInfo {
-	unsigned int frame;
-	Request *request;
-
+struct RkISP1FrameInfo : public FrameInfo {
 	FrameBuffer *paramBuffer;
 	FrameBuffer *statBuffer;
 	FrameBuffer *mainPathBuffer;
@@ -67,6 +74,10 @@ struct RkISP1FrameInfo {
 
 	bool paramDequeued;
 	bool metadataProcessed;
+
+	/* Dewarping stage, when the dewarper is in use */
+	bool dewarpQueued;
+	utils::time_point dewarpQueueTime;
 };
 
 class RkISP1Frames
@@ -76,7 +87,7 @@ public:
 
 	RkISP1FrameInfo *create(const RkISP1CameraData *data, Request *request,
 				bool isRaw);
-	int destroy(unsigned int frame);
+	void destroy(RkISP1FrameInfo *info);
 	void clear();
 
 	RkISP1FrameInfo *find(unsigned int frame);
@@ -84,8 +95,10 @@ public:
 	RkISP1FrameInfo *find(Request *request);
 
 private:
+	void releaseBuffers(RkISP1FrameInfo *info);
+
 	PipelineHandlerRkISP1 *pipe_;
-	std::map<unsigned int, RkISP1FrameInfo *> frameInfo_;
+	FrameInfoTracker<RkISP1FrameInfo> frameInfo_;
 };
 
 class RkISP1CameraData : public Camera::Private
@@ -94,6 +107,7 @@ public:
 	RkISP1CameraData(PipelineHandler *pipe, RkISP1MainPath *mainPath,
 			 RkISP1SelfPath *selfPath)
 		: Camera::Private(pipe), frame_(0), frameInfo_(pipe),
+		  preparedFrames_(0), lateFrames_(0), minLead_(0),
 		  mainPath_(mainPath), selfPath_(selfPath)
 	{
 	}
@@ -110,6 +124,12 @@ public:
 	std::vector<IPABuffer> ipaBuffers_;
 	RkISP1Frames frameInfo_;
 
+	/* Lead of the parameters computation over the frame capture */
+	std::optional<uint32_t> lastFrameStart_;
+	unsigned int preparedFrames_;
+	unsigned int lateFrames_;
+	int minLead_;
+
 	RkISP1MainPath *mainPath_;
 	RkISP1SelfPath *selfPath_;
 
@@ -172,11 +192,15 @@ public:
 
 	int queueRequestDevice(Camera *camera, Request *request) override;
 
+	std::vector<BufferPoolUsage> internalBufferUsage(Camera *camera) override;
+
 	bool match(DeviceEnumerator *enumerator) override;
 
 private:
 	static constexpr Size kRkISP1PreviewSize = { 1920, 1080 };
 
+	void releaseDevice(Camera *camera) override;
+
 	RkISP1CameraData *cameraData(Camera *camera)
 	{
 		return static_cast<RkISP1CameraData *>(camera->_d());
@@ -192,9 +216,11 @@ private:
 	void imageBufferReady(FrameBuffer *buffer);
 	void paramBufferReady(FrameBuffer *buffer);
 	void statBufferReady(FrameBuffer *buffer);
+	void dewarpInputReady(FrameBuffer *buffer);
 	void dewarpBufferReady(FrameBuffer *buffer);
 	void frameStart(uint32_t sequence);
 
+	unsigned int dewarpBufferCount(unsigned int count) const;
 	int allocateBuffers(Camera *camera);
 	int freeBuffers(Camera *camera);
 
@@ -226,11 +252,21 @@ private:
 	std::queue<FrameBuffer *> availableParamBuffers_;
 	std::queue<FrameBuffer *> availableStatBuffers_;
 
+	/*
+	 * Internal buffers are kept allocated when the camera stops, to be
+	 * reused when it restarts with the same configuration. The stream
+	 * configurations applied by the last call to configure() are recorded
+	 * to detect configuration changes.
+	 */
+	Camera *buffersCamera_;
+	std::vector<StreamConfiguration> buffersConfig_;
+
 	Camera *activeCamera_;
 };
 
 RkISP1Frames::RkISP1Frames(PipelineHandler *pipe)
-	: pipe_(static_cast<PipelineHandlerRkISP1 *>(pipe))
+	: pipe_(static_cast<PipelineHandlerRkISP1 *>(pipe)),
+	  frameInfo_(pipe->maxQueuedRequestsDevice())
 {
 }
 
@@ -262,104 +298,111 @@ RkISP1FrameInfo *RkISP1Frames::create(const RkISP1CameraData *data, Request *req
 		pipe_->availableStatBuffers_.pop();
 
 		if (pipe_->useDewarper_) {
+			if (pipe_->availableMainPathBuffers_.empty()) {
+				LOG(RkISP1, Error) << "Dewarper input buffer underrun";
+				pipe_->availableParamBuffers_.push(paramBuffer);
+				pipe_->availableStatBuffers_.push(statBuffer);
+				return nullptr;
+			}
+
 			mainPathBuffer = pipe_->availableMainPathBuffers_.front();
 			pipe_->availableMainPathBuffers_.pop();
 		}
 	}
 
-	if (!mainPathBuffer)
+	RkISP1FrameInfo *info = frameInfo_.create(frame, request);
+	if (!info) {
+		if (paramBuffer)
+			pipe_->availableParamBuffers_.push(paramBuffer);
+		if (statBuffer)
+			pipe_->availableStatBuffers_.push(statBuffer);
+		if (mainPathBuffer)
+			pipe_->availableMainPathBuffers_.push(mainPathBuffer);
+		return nullptr;
+	}
+
+	/*
+	 * Associate the internal buffers with the request, to look up the
+	 * frame information when they complete.
+	 */
+	if (paramBuffer) {
+		paramBuffer->_d()->setRequest(request);
+		statBuffer->_d()->setRequest(request);
+	}
+
+	if (mainPathBuffer)
+		mainPathBuffer->_d()->setRequest(request);
+	else
 		mainPathBuffer = request->findBuffer(&data->mainPathStream_);
 	selfPathBuffer = request->findBuffer(&data->selfPathStream_);
 
-	RkISP1FrameInfo *info = new RkISP1FrameInfo;
-
-	info->frame = frame;
-	info->request = request;
 	info->paramBuffer = paramBuffer;
 	info->mainPathBuffer = mainPathBuffer;
 	info->selfPathBuffer = selfPathBuffer;
 	info->statBuffer = statBuffer;
 	info->paramDequeued = false;
 	info->metadataProcessed = false;
-
-	frameInfo_[frame] = info;
+	info->dewarpQueued = false;
 
 	return info;
 }
 
-int RkISP1Frames::destroy(unsigned int frame)
+void RkISP1Frames::releaseBuffers(RkISP1FrameInfo *info)
 {
-	RkISP1FrameInfo *info = find(frame);
-	if (!info)
-		return -ENOENT;
-
-	pipe_->availableParamBuffers_.push(info->paramBuffer);
-	pipe_->availableStatBuffers_.push(info->statBuffer);
-	pipe_->availableMainPathBuffers_.push(info->mainPathBuffer);
-
-	frameInfo_.erase(info->frame);
+	if (info->paramBuffer)
+		pipe_->availableParamBuffers_.push(info->paramBuffer);
+	if (info->statBuffer)
+		pipe_->availableStatBuffers_.push(info->statBuffer);
 
-	delete info;
+	/*
+	 * Internal main path buffers queued to the dewarper are returned to
+	 * the pool as soon as the dewarper has consumed them, see
+	 * PipelineHandlerRkISP1::dewarpInputReady().
+	 */
+	if (pipe_->useDewarper_ && info->mainPathBuffer && !info->dewarpQueued)
+		pipe_->availableMainPathBuffers_.push(info->mainPathBuffer);
+}
 
-	return 0;
+void RkISP1Frames::destroy(RkISP1FrameInfo *info)
+{
+	releaseBuffers(info);
+	frameInfo_.destroy(info);
 }
 
 void RkISP1Frames::clear()
 {
-	for (const auto &entry : frameInfo_) {
-		RkISP1FrameInfo *info = entry.second;
-
-		pipe_->availableParamBuffers_.push(info->paramBuffer);
-		pipe_->availableStatBuffers_.push(info->statBuffer);
-		pipe_->availableMainPathBuffers_.push(info->mainPathBuffer);
-
-		delete info;
-	}
+	frameInfo_.forEach([this](RkISP1FrameInfo &info) {
+		releaseBuffers(&info);
+	});
 
 	frameInfo_.clear();
 }
 
 RkISP1FrameInfo *RkISP1Frames::find(unsigned int frame)
 {
-	auto itInfo = frameInfo_.find(frame);
-
-	if (itInfo != frameInfo_.end())
-		return itInfo->second;
-
-	LOG(RkISP1, Fatal) << "Can't locate info from frame";
+	RkISP1FrameInfo *info = frameInfo_.find(frame);
+	if (!info)
+		LOG(RkISP1, Fatal) << "Can't locate info from frame";
 
-	return nullptr;
+	return info;
 }
 
 RkISP1FrameInfo *RkISP1Frames::find(FrameBuffer *buffer)
 {
-	for (auto &itInfo : frameInfo_) {
-		RkISP1FrameInfo *info = itInfo.second;
-
-		if (info->paramBuffer == buffer ||
-		    info->statBuffer == buffer ||
-		    info->mainPathBuffer == buffer ||
-		    info->selfPathBuffer == buffer)
-			return info;
-	}
-
-	LOG(RkISP1, Fatal) << "Can't locate info from buffer";
+	RkISP1FrameInfo *info = frameInfo_.find(buffer);
+	if (!info)
+		LOG(RkISP1, Fatal) << "Can't locate info from buffer";
 
-	return nullptr;
+	return info;
 }
 
 RkISP1FrameInfo *RkISP1Frames::find(Request *request)
 {
-	for (auto &itInfo : frameInfo_) {
-		RkISP1FrameInfo *info = itInfo.second;
-
-		if (info->request == request)
-			return info;
-	}
-
-	LOG(RkISP1, Fatal) << "Can't locate info from request";
+	RkISP1FrameInfo *info = frameInfo_.find(request);
+	if (!info)
+		LOG(RkISP1, Fatal) << "Can't locate info from request";
 
-	return nullptr;
+	return info;
 }
 
 PipelineHandlerRkISP1 *RkISP1CameraData::pipe()
@@ -406,10 +449,30 @@ int RkISP1CameraData::loadIPA(unsigned int hwRevision)
 void RkISP1CameraData::paramsComputed(unsigned int frame, unsigned int bytesused)
 {
 	PipelineHandlerRkISP1 *pipe = RkISP1CameraData::pipe();
+	LIBCAMERA_TRACEPOINT_IPA_FRAME_END(rkisp1, computeParams, frame);
+
 	RkISP1FrameInfo *info = frameInfo_.find(frame);
 	if (!info)
 		return;
 
+	/*
+	 * Track how many frames ahead of their capture the parameters are
+	 * ready. Parameters completed after the frame has started are late and
+	 * will be applied to a later frame.
+	 */
+	int lead = lastFrameStart_ ? static_cast<int>(frame - *lastFrameStart_)
+				   : static_cast<int>(frame) + 1;
+	if (!preparedFrames_ || lead < minLead_)
+		minLead_ = lead;
+	preparedFrames_++;
+
+	if (lead <= 0) {
+		lateFrames_++;
+		LOG(RkISP1, Debug)
+			<< "Parameters for frame " << frame << " ready "
+			<< 1 - lead << " frame(s) late";
+	}
+
 	info->paramBuffer->_d()->metadata().planes()[0].bytesused = bytesused;
 	pipe->param_->queueBuffer(info->paramBuffer);
 	pipe->stat_->queueBuffer(info->statBuffer);
@@ -429,6 +492,8 @@ void RkISP1CameraData::setSensorControls([[maybe_unused]] unsigned int frame,
 
 void RkISP1CameraData::metadataReady(unsigned int frame, const ControlList &metadata)
 {
+	LIBCAMERA_TRACEPOINT_IPA_FRAME_END(rkisp1, processStats, frame);
+
 	RkISP1FrameInfo *info = frameInfo_.find(frame);
 	if (!info)
 		return;
@@ -684,7 +749,8 @@ CameraConfiguration::Status RkISP1CameraConfiguration::validate()
  */
 
 PipelineHandlerRkISP1::PipelineHandlerRkISP1(CameraManager *manager)
-	: PipelineHandler(manager), hasSelfPath_(true), useDewarper_(false)
+	: PipelineHandler(manager, kRkISP1MaxQueuedRequests), hasSelfPath_(true),
+	  useDewarper_(false), buffersCamera_(nullptr)
 {
 }
 
@@ -800,6 +866,24 @@ int PipelineHandlerRkISP1::configure(Camera *camera, CameraConfiguration *c)
 	CameraSensor *sensor = data->sensor_.get();
 	int ret;
 
+	/*
+	 * Internal buffers depend on the configuration, release them unless
+	 * the camera is reconfigured identically.
+	 */
+	bool keepBuffers = buffersCamera_ == camera &&
+		std::equal(config->begin(), config->end(),
+			   buffersConfig_.begin(), buffersConfig_.end(),
+			   [](const StreamConfiguration &a, const StreamConfiguration &b) {
+				   return a.stream() == b.stream() &&
+					  a.pixelFormat == b.pixelFormat &&
+					  a.size == b.size &&
+					  a.bufferCount == b.bufferCount;
+			   });
+	if (buffersCamera_ && !keepBuffers)
+		freeBuffers(buffersCamera_);
+
+	buffersConfig_.assign(config->begin(), config->end());
+
 	ret = initLinks(camera, *config);
 	if (ret)
 		return ret;
@@ -928,17 +1012,28 @@ int PipelineHandlerRkISP1::configure(Camera *camera, CameraConfiguration *c)
 			return ret;
 	}
 
+	/*
+	 * The parameters and statistics formats don't depend on the
+	 * configuration, and can't be set while buffers are allocated. Keep
+	 * the current formats when reusing the internal buffers.
+	 */
 	V4L2DeviceFormat paramFormat;
-	paramFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_EXT_PARAMS);
-	ret = param_->setFormat(&paramFormat);
+	if (keepBuffers) {
+		ret = param_->getFormat(&paramFormat);
+	} else {
+		paramFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_EXT_PARAMS);
+		ret = param_->setFormat(&paramFormat);
+	}
 	if (ret)
 		return ret;
 
-	V4L2DeviceFormat statFormat;
-	statFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_STAT_3A);
-	ret = stat_->setFormat(&statFormat);
-	if (ret)
-		return ret;
+	if (!keepBuffers) {
+		V4L2DeviceFormat statFormat;
+		statFormat.fourcc = V4L2PixelFormat(V4L2_META_FMT_RK_ISP1_STAT_3A);
+		ret = stat_->setFormat(&statFormat);
+		if (ret)
+			return ret;
+	}
 
 	/* Inform IPA of stream configuration and sensor controls. */
 	ipa::rkisp1::IPAConfigInfo ipaConfig{ sensorInfo,
@@ -977,15 +1072,67 @@ int PipelineHandlerRkISP1::exportFrameBuffers([[maybe_unused]] Camera *camera, S
 	return -EINVAL;
 }
 
+/*
+ * Compute the number of internal buffers between the ISP main path and the
+ * dewarper. The ISP and the dewarper process consecutive frames concurrently,
+ * and each internal buffer is returned to the pool as soon as the dewarper has
+ * consumed it. The default of one buffer per request can be overridden with the
+ * LIBCAMERA_RKISP1_DEWARP_BUFFERS environment variable, to trade memory for
+ * queue depth. At least two buffers are needed to overlap the two stages.
+ */
+unsigned int PipelineHandlerRkISP1::dewarpBufferCount(unsigned int count) const
+{
+	const char *env = utils::secure_getenv("LIBCAMERA_RKISP1_DEWARP_BUFFERS");
+	if (!env || *env == '\0')
+		return count;
+
+	char *end;
+	unsigned long value = strtoul(env, &end, 10);
+	if (*end != '\0' || value < 2 || value > VIDEO_MAX_FRAME) {
+		LOG(RkISP1, Warning)
+			<< "Invalid dewarper buffer count '" << env
+			<< "', using " << count;
+		return count;
+	}
+
+	return value;
+}
+
 int PipelineHandlerRkISP1::allocateBuffers(Camera *camera)
 {
 	RkISP1CameraData *data = cameraData(camera);
 	unsigned int ipaBufferId = 1;
 	int ret;
 
+	if (buffersCamera_ == camera) {
+		LOG(RkISP1, Debug) << "Reusing internal buffers";
+
+		/*
+		 * All internal buffers have been returned when the camera
+		 * stopped, repopulate the queues of available buffers to
+		 * restore their original order.
+		 */
+		availableParamBuffers_ = {};
+		availableStatBuffers_ = {};
+		availableMainPathBuffers_ = {};
+
+		for (std::unique_ptr<FrameBuffer> &buffer : paramBuffers_)
+			availableParamBuffers_.push(buffer.get());
+		for (std::unique_ptr<FrameBuffer> &buffer : statBuffers_)
+			availableStatBuffers_.push(buffer.get());
+		for (std::unique_ptr<FrameBuffer> &buffer : mainPathBuffers_)
+			availableMainPathBuffers_.push(buffer.get());
+
+		return 0;
+	}
+
+	if (buffersCamera_)
+		freeBuffers(buffersCamera_);
+
 	unsigned int maxCount = std::max({
 		data->mainPathStream_.configuration().bufferCount,
 		data->selfPathStream_.configuration().bufferCount,
+		kRkISP1MaxQueuedRequests,
 	});
 
 	if (!isRaw_) {
@@ -1000,7 +1147,12 @@ int PipelineHandlerRkISP1::allocateBuffers(Camera *camera)
 
 	/* If the dewarper is being used, allocate internal buffers for ISP. */
 	if (useDewarper_) {
-		ret = mainPath_.exportBuffers(maxCount, &mainPathBuffers_);
+		unsigned int count = dewarpBufferCount(maxCount);
+
+		LOG(RkISP1, Debug)
+			<< "Using " << count << " internal buffers for the dewarper";
+
+		ret = mainPath_.exportBuffers(count, &mainPathBuffers_);
 		if (ret < 0)
 			goto error;
 
@@ -1024,6 +1176,8 @@ int PipelineHandlerRkISP1::allocateBuffers(Camera *camera)
 
 	data->ipa_->mapBuffers(data->ipaBuffers_);
 
+	buffersCamera_ = camera;
+
 	return 0;
 
 error:
@@ -1064,6 +1218,8 @@ int PipelineHandlerRkISP1::freeBuffers(Camera *camera)
 	if (stat_->releaseBuffers())
 		LOG(RkISP1, Error) << "Failed to release stat buffers";
 
+	buffersCamera_ = nullptr;
+
 	return 0;
 }
 
@@ -1088,6 +1244,9 @@ int PipelineHandlerRkISP1::start(Camera *camera, [[maybe_unused]] const ControlL
 	actions += [&]() { data->ipa_->stop(); };
 
 	data->frame_ = 0;
+	data->lastFrameStart_.reset();
+	data->preparedFrames_ = 0;
+	data->lateFrames_ = 0;
 
 	if (!isRaw_) {
 		ret = param_->streamOn();
@@ -1168,7 +1327,11 @@ void PipelineHandlerRkISP1::stopDevice(Camera *camera)
 	ASSERT(data->queuedRequests_.empty());
 	data->frameInfo_.clear();
 
-	freeBuffers(camera);
+	if (data->lateFrames_)
+		LOG(RkISP1, Warning)
+			<< "Parameters ready late for " << data->lateFrames_
+			<< " of " << data->preparedFrames_
+			<< " frames, minimum lead " << data->minLead_ << " frame(s)";
 
 	activeCamera_ = nullptr;
 }
@@ -1189,6 +1352,8 @@ int PipelineHandlerRkISP1::queueRequestDevice(Camera *camera, Request *request)
 		if (data->selfPath_ && info->selfPathBuffer)
 			data->selfPath_->queueBuffer(info->selfPathBuffer);
 	} else {
+		LIBCAMERA_TRACEPOINT_IPA_FRAME_BEGIN(rkisp1, computeParams,
+						     data->frame_);
 		data->ipa_->computeParams(data->frame_,
 					  info->paramBuffer->cookie());
 	}
@@ -1198,6 +1363,42 @@ int PipelineHandlerRkISP1::queueRequestDevice(Camera *camera, Request *request)
 	return 0;
 }
 
+std::vector<BufferPoolUsage>
+PipelineHandlerRkISP1::internalBufferUsage(Camera *camera)
+{
+	std::vector<BufferPoolUsage> pools;
+
+	if (buffersCamera_ != camera)
+		return pools;
+
+	auto addPool = [&](const char *name, const std::string &allocator,
+			   const std::vector<std::unique_ptr<FrameBuffer>> &buffers) {
+		if (buffers.empty())
+			return;
+
+		size_t size = 0;
+		for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+			for (const FrameBuffer::Plane &plane : buffer->planes())
+				size += plane.length;
+		}
+
+		pools.push_back({ name, allocator, static_cast<unsigned int>(buffers.size()),
+				  size });
+	};
+
+	addPool("parameters", param_->deviceNode(), paramBuffers_);
+	addPool("statistics", stat_->deviceNode(), statBuffers_);
+	addPool("dewarper input", mainPath_.deviceNode(), mainPathBuffers_);
+
+	return pools;
+}
+
+void PipelineHandlerRkISP1::releaseDevice(Camera *camera)
+{
+	if (buffersCamera_ == camera)
+		freeBuffers(camera);
+}
+
 /* -----------------------------------------------------------------------------
  * Match and Setup
  */
@@ -1393,6 +1594,7 @@ bool PipelineHandlerRkISP1::match(DeviceEnumerator *enumerator)
 		selfPath_.bufferReady().connect(this, &PipelineHandlerRkISP1::imageBufferReady);
 	stat_->bufferReady.connect(this, &PipelineHandlerRkISP1::statBufferReady);
 	param_->bufferReady.connect(this, &PipelineHandlerRkISP1::paramBufferReady);
+	isp_->frameStart.connect(this, &PipelineHandlerRkISP1::frameStart);
 
 	/* If dewarper is present, create its instance. */
 	DeviceMatch dwp("dw100");
@@ -1403,6 +1605,8 @@ bool PipelineHandlerRkISP1::match(DeviceEnumerator *enumerator)
 	if (dwpMediaDevice) {
 		dewarper_ = std::make_unique<V4L2M2MConverter>(dwpMediaDevice.get());
 		if (dewarper_->isValid()) {
+			dewarper_->inputBufferReady.connect(
+				this, &PipelineHandlerRkISP1::dewarpInputReady);
 			dewarper_->outputBufferReady.connect(
 				this, &PipelineHandlerRkISP1::dewarpBufferReady);
 
@@ -1450,7 +1654,7 @@ void PipelineHandlerRkISP1::tryCompleteRequest(RkISP1FrameInfo *info)
 	if (!isRaw_ && !info->paramDequeued)
 		return;
 
-	data->frameInfo_.destroy(info->frame);
+	data->frameInfo_.destroy(info);
 
 	completeRequest(request);
 }
@@ -1480,6 +1684,8 @@ void PipelineHandlerRkISP1::imageBufferReady(FrameBuffer *buffer)
 		if (isRaw_) {
 			const ControlList &ctrls =
 				data->delayedCtrls_->get(metadata.sequence);
+			LIBCAMERA_TRACEPOINT_IPA_FRAME_BEGIN(rkisp1, processStats,
+							     info->frame);
 			data->ipa_->processStats(info->frame, 0, ctrls);
 		}
 	} else {
@@ -1553,14 +1759,28 @@ void PipelineHandlerRkISP1::imageBufferReady(FrameBuffer *buffer)
 	 * buffers for the dewarper are the buffers of the request, supplied
 	 * by the application.
 	 */
+	info->dewarpQueueTime = utils::clock::now();
+
 	int ret = dewarper_->queueBuffers(buffer, request->buffers());
 	if (ret < 0)
 		LOG(RkISP1, Error) << "Cannot queue buffers to dewarper: "
 				   << strerror(-ret);
+	else
+		info->dewarpQueued = true;
 
 	request->metadata().set(controls::ScalerCrop, activeCrop_.value());
 }
 
+void PipelineHandlerRkISP1::dewarpInputReady(FrameBuffer *buffer)
+{
+	/*
+	 * Return the internal buffer to the pool without waiting for the
+	 * request to complete, to let the ISP capture the next frame while the
+	 * dewarper processes the current one.
+	 */
+	availableMainPathBuffers_.push(buffer);
+}
+
 void PipelineHandlerRkISP1::dewarpBufferReady(FrameBuffer *buffer)
 {
 	ASSERT(activeCamera_);
@@ -1571,6 +1791,14 @@ void PipelineHandlerRkISP1::dewarpBufferReady(FrameBuffer *buffer)
 	if (!info)
 		return;
 
+	if (buffer->metadata().status != FrameMetadata::FrameCancelled) {
+		utils::Duration elapsed = utils::clock::now() - info->dewarpQueueTime;
+
+		LOG(RkISP1, Debug)
+			<< "Frame " << info->frame << " dewarped in "
+			<< elapsed.get<std::micro>() << "us";
+	}
+
 	completeBuffer(request, buffer);
 	tryCompleteRequest(info);
 }
@@ -1606,10 +1834,19 @@ void PipelineHandlerRkISP1::statBufferReady(FrameBuffer *buffer)
 	if (data->frame_ <= buffer->metadata().sequence)
 		data->frame_ = buffer->metadata().sequence + 1;
 
+	LIBCAMERA_TRACEPOINT_IPA_FRAME_BEGIN(rkisp1, processStats, info->frame);
 	data->ipa_->processStats(info->frame, info->statBuffer->cookie(),
 				 data->delayedCtrls_->get(buffer->metadata().sequence));
 }
 
+void PipelineHandlerRkISP1::frameStart(uint32_t sequence)
+{
+	if (!activeCamera_)
+		return;
+
+	cameraData(activeCamera_)->lastFrameStart_ = sequence;
+}
+
 REGISTER_PIPELINE_HANDLER(PipelineHandlerRkISP1, "rkisp1")
 
 } /* namespace libcamera */
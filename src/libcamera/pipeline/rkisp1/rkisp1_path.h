@@ -52,6 +52,8 @@ public:
 	int configure(const StreamConfiguration &config,
 		      const V4L2SubdeviceFormat &inputFormat);
 
+	const std::string &deviceNode() const { return video_->deviceNode(); }
+
 	int exportBuffers(unsigned int bufferCount,
 			  std::vector<std::unique_ptr<FrameBuffer>> *buffers)
 	{
@@ -35,6 +35,7 @@
 #include "libcamera/internal/converter.h"
 #include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/frame_info_tracker.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/software_isp/software_isp.h"
@@ -181,14 +182,7 @@ LOG_DEFINE_CATEGORY(SimplePipeline)
 
 class SimplePipelineHandler;
 
-struct SimpleFrameInfo {
-	SimpleFrameInfo(uint32_t f, Request *r, bool m)
-		: frame(f), request(r), metadataRequired(m), metadataProcessed(false)
-	{
-	}
-
-	uint32_t frame;
-	Request *request;
+struct SimpleFrameInfo : public FrameInfo {
 	bool metadataRequired;
 	bool metadataProcessed;
 };
@@ -196,26 +190,35 @@ struct SimpleFrameInfo {
 class SimpleFrames
 {
 public:
+	SimpleFrames(unsigned int capacity);
+
 	void create(Request *request, bool metadataRequested);
-	void destroy(uint32_t frame);
+	void destroy(SimpleFrameInfo *info);
 	void clear();
 
 	SimpleFrameInfo *find(uint32_t frame);
 
 private:
-	std::map<uint32_t, SimpleFrameInfo> frameInfo_;
+	FrameInfoTracker<SimpleFrameInfo> frameInfo_;
 };
 
+SimpleFrames::SimpleFrames(unsigned int capacity)
+	: frameInfo_(capacity)
+{
+}
+
 void SimpleFrames::create(Request *request, bool metadataRequired)
 {
-	const uint32_t frame = request->sequence();
-	auto [it, inserted] = frameInfo_.try_emplace(frame, frame, request, metadataRequired);
-	ASSERT(inserted);
+	SimpleFrameInfo *info = frameInfo_.create(request->sequence(), request);
+	ASSERT(info);
+
+	info->metadataRequired = metadataRequired;
+	info->metadataProcessed = false;
 }
 
-void SimpleFrames::destroy(uint32_t frame)
+void SimpleFrames::destroy(SimpleFrameInfo *info)
 {
-	frameInfo_.erase(frame);
+	frameInfo_.destroy(info);
 }
 
 void SimpleFrames::clear()
@@ -225,10 +228,7 @@ void SimpleFrames::clear()
 
 SimpleFrameInfo *SimpleFrames::find(uint32_t frame)
 {
-	auto info = frameInfo_.find(frame);
-	if (info == frameInfo_.end())
-		return nullptr;
-	return &info->second;
+	return frameInfo_.find(frame);
 }
 
 struct SimplePipelineInfo {
@@ -446,7 +446,8 @@ private:
 SimpleCameraData::SimpleCameraData(SimplePipelineHandler *pipe,
 				   unsigned int numStreams,
 				   MediaEntity *sensor)
-	: Camera::Private(pipe), streams_(numStreams)
+	: Camera::Private(pipe), streams_(numStreams),
+	  frameInfo_(pipe->maxQueuedRequestsDevice())
 {
 	/*
 	 * Find the shortest path from the camera sensor to a video capture
@@ -965,7 +966,7 @@ void SimpleCameraData::tryCompleteRequest(Request *request)
 	if (info->metadataRequired && !info->metadataProcessed)
 		return;
 
-	frameInfo_.destroy(info->frame);
+	frameInfo_.destroy(info);
 	pipe()->completeRequest(request);
 }
 
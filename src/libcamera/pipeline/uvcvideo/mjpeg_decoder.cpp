@@ -0,0 +1,466 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Multi-threaded software MJPEG decoder for the uvcvideo pipeline handler
+ */
+
+#include "mjpeg_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <errno.h>
+#include <thread>
+
+#if HAVE_LIBJPEG
+#include <setjmp.h>
+#include <stdio.h>
+
+#include <jpeglib.h>
+#endif
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(UVC)
+
+namespace {
+
+constexpr std::array<PixelFormat, 2> kDecodedFormats = {
+	formats::NV12,
+	formats::YUYV,
+};
+
+#if HAVE_LIBJPEG
+struct JpegErrorManager : public jpeg_error_mgr {
+	JpegErrorManager()
+	{
+		jpeg_std_error(this);
+		error_exit = errorExit;
+		output_message = outputMessage;
+	}
+
+	static void errorExit(j_common_ptr cinfo)
+	{
+		JpegErrorManager *self =
+			static_cast<JpegErrorManager *>(cinfo->err);
+		longjmp(self->escape_, 1);
+	}
+
+	static void outputMessage(j_common_ptr cinfo)
+	{
+		char buffer[JMSG_LENGTH_MAX];
+		(*cinfo->err->format_message)(cinfo, buffer);
+		LOG(UVC, Debug) << "JPEG decoder: " << buffer;
+	}
+
+	jmp_buf escape_;
+};
+#endif /* HAVE_LIBJPEG */
+
+} /* namespace */
+
+/*
+ * Decoding is performed one frame per worker, with the workers running in
+ * separate threads. JPEG frames can't be split in independently decodable
+ * slices without restart markers, which UVC cameras don't guarantee, so
+ * parallelism comes from decoding consecutive frames concurrently.
+ */
+class MjpegDecoder::Worker : public Object
+{
+public:
+	Worker(const std::atomic<bool> &stopping)
+		: stopping_(stopping)
+	{
+	}
+
+	void configure(const PixelFormat &format, const Size &size);
+	void decode(FrameBuffer *input, FrameBuffer *output);
+	void flush() {}
+
+	Signal<FrameBuffer *, FrameBuffer *> done;
+
+private:
+	int decompress(Span<const uint8_t> jpeg, std::array<uint8_t *, 2> planes);
+	void writeLine(unsigned int y, const uint8_t *src,
+		       std::array<uint8_t *, 2> planes) const;
+
+	const std::atomic<bool> &stopping_;
+
+	PixelFormat format_;
+	Size size_;
+	unsigned int stride_;
+
+	std::vector<uint8_t> line_;
+};
+
+void MjpegDecoder::Worker::configure(const PixelFormat &format, const Size &size)
+{
+	format_ = format;
+	size_ = size;
+	stride_ = MjpegDecoder::stride(format, size);
+	line_.resize(size.width * 3);
+}
+
+void MjpegDecoder::Worker::decode(FrameBuffer *input, FrameBuffer *output)
+{
+	FrameMetadata &metadata = output->_d()->metadata();
+	metadata.status = input->metadata().status;
+	metadata.sequence = input->metadata().sequence;
+	metadata.timestamp = input->metadata().timestamp;
+
+	if (stopping_.load(std::memory_order_relaxed)) {
+		metadata.status = FrameMetadata::FrameCancelled;
+		done.emit(input, output);
+		return;
+	}
+
+	std::vector<DmaSyncer> dmaSyncers;
+	for (const FrameBuffer::Plane &plane : input->planes())
+		dmaSyncers.emplace_back(plane.fd, DmaSyncer::SyncType::Read);
+
+	for (const FrameBuffer::Plane &plane : output->planes())
+		dmaSyncers.emplace_back(plane.fd, DmaSyncer::SyncType::Write);
+
+	MappedFrameBuffer in(input, MappedFrameBuffer::MapFlag::Read);
+	MappedFrameBuffer out(output, MappedFrameBuffer::MapFlag::Write);
+	if (!in.isValid() || !out.isValid()) {
+		LOG(UVC, Error) << "Failed to map buffers for decoding";
+		metadata.status = FrameMetadata::FrameError;
+		done.emit(input, output);
+		return;
+	}
+
+	/* Single-plane NV12 buffers store the chroma plane after the luma. */
+	std::array<uint8_t *, 2> planes = { out.planes()[0].data(), nullptr };
+	if (format_ == formats::NV12)
+		planes[1] = out.planes().size() > 1
+			  ? out.planes()[1].data()
+			  : planes[0] + stride_ * size_.height;
+
+	Span<const uint8_t> jpeg = in.planes()[0].subspan(0, input->metadata().planes()[0].bytesused);
+
+	int ret = decompress(jpeg, planes);
+	if (ret < 0) {
+		LOG(UVC, Warning)
+			<< "Failed to decode frame " << input->metadata().sequence;
+		metadata.status = FrameMetadata::FrameError;
+	} else {
+		for (unsigned int i = 0; i < output->planes().size(); ++i)
+			metadata.planes()[i].bytesused = output->planes()[i].length;
+	}
+
+	dmaSyncers.clear();
+
+	done.emit(input, output);
+}
+
+#if HAVE_LIBJPEG
+int MjpegDecoder::Worker::decompress(Span<const uint8_t> jpeg,
+				     std::array<uint8_t *, 2> planes)
+{
+	struct jpeg_decompress_struct cinfo;
+
+	JpegErrorManager errorManager;
+	if (setjmp(errorManager.escape_)) {
+		/* libjpeg found an error */
+		jpeg_destroy_decompress(&cinfo);
+		return -EINVAL;
+	}
+
+	cinfo.err = &errorManager;
+	jpeg_create_decompress(&cinfo);
+
+	jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+
+	jpeg_read_header(&cinfo, TRUE);
+
+	if (cinfo.image_width != size_.width ||
+	    cinfo.image_height != size_.height) {
+		LOG(UVC, Debug)
+			<< "Unexpected JPEG size " << cinfo.image_width << "x"
+			<< cinfo.image_height;
+		jpeg_destroy_decompress(&cinfo);
+		return -EINVAL;
+	}
+
+	/*
+	 * Decode to YCbCr and skip the upsampling filter, the chroma is
+	 * subsampled again when writing the output. Keep the accurate integer
+	 * DCT, the fast one trades image quality for a small speedup only.
+	 */
+	cinfo.out_color_space = JCS_YCbCr;
+	cinfo.dct_method = JDCT_ISLOW;
+	cinfo.do_fancy_upsampling = FALSE;
+
+	jpeg_start_decompress(&cinfo);
+
+	JSAMPROW row = line_.data();
+	while (cinfo.output_scanline < cinfo.output_height) {
+		unsigned int y = cinfo.output_scanline;
+		if (jpeg_read_scanlines(&cinfo, &row, 1) != 1)
+			break;
+
+		writeLine(y, row, planes);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	return 0;
+}
+#else
+int MjpegDecoder::Worker::decompress([[maybe_unused]] Span<const uint8_t> jpeg,
+				     [[maybe_unused]] std::array<uint8_t *, 2> planes)
+{
+	return -ENOTSUP;
+}
+#endif /* HAVE_LIBJPEG */
+
+void MjpegDecoder::Worker::writeLine(unsigned int y, const uint8_t *src,
+				     std::array<uint8_t *, 2> planes) const
+{
+	const unsigned int width = size_.width;
+
+	if (format_ == formats::YUYV) {
+		uint8_t *dst = planes[0] + y * stride_;
+
+		for (unsigned int x = 0; x < width; x += 2) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[3];
+			dst[3] = src[2];
+			src += 6;
+			dst += 4;
+		}
+
+		return;
+	}
+
+	uint8_t *luma = planes[0] + y * stride_;
+	for (unsigned int x = 0; x < width; ++x)
+		luma[x] = src[x * 3];
+
+	if (y % 2)
+		return;
+
+	uint8_t *chroma = planes[1] + y / 2 * stride_;
+	for (unsigned int x = 0; x < width; x += 2) {
+		chroma[0] = src[1];
+		chroma[1] = src[2];
+		src += 6;
+		chroma += 2;
+	}
+}
+
+/**
+ * \class MjpegDecoder
+ * \brief Decode MJPEG frames to YUV in worker threads
+ *
+ * The decoder allocates the output buffers, and decodes the input buffers
+ * queued with queueBuffers() in a pool of worker threads. Completion is
+ * signalled in the thread the decoder is bound to, in the order in which
+ * decoding completes.
+ */
+
+MjpegDecoder::MjpegDecoder()
+	: dmaHeap_(DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
+		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf),
+	  nextWorker_(0), stopping_(false)
+{
+	unsigned int numThreads =
+		std::clamp(std::thread::hardware_concurrency(), 1U, kMaxThreads);
+
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		threads_.push_back(std::make_unique<Thread>());
+		workers_.push_back(std::make_unique<Worker>(stopping_));
+
+		workers_.back()->moveToThread(threads_.back().get());
+		workers_.back()->done.connect(this, &MjpegDecoder::decodeDone);
+	}
+}
+
+MjpegDecoder::~MjpegDecoder()
+{
+	stop();
+
+	/* Destroy the workers before the threads they are bound to. */
+	workers_.clear();
+}
+
+/**
+ * \brief Check if MJPEG decoding is supported
+ * \return True if libcamera has been compiled with libjpeg, false otherwise
+ */
+bool MjpegDecoder::isAvailable()
+{
+#if HAVE_LIBJPEG
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * \brief Retrieve the output pixel formats supported by the decoder
+ * \return The supported output pixel formats
+ */
+Span<const PixelFormat> MjpegDecoder::formats()
+{
+	return kDecodedFormats;
+}
+
+/**
+ * \brief Compute the line stride of decoded frames
+ * \param[in] format The output pixel format
+ * \param[in] size The frame size
+ * \return The line stride in bytes
+ */
+unsigned int MjpegDecoder::stride(const PixelFormat &format, const Size &size)
+{
+	return PixelFormatInfo::info(format).stride(size.width, 0, 1);
+}
+
+/**
+ * \brief Compute the size of decoded frames
+ * \param[in] format The output pixel format
+ * \param[in] size The frame size
+ * \return The frame size in bytes
+ */
+unsigned int MjpegDecoder::frameSize(const PixelFormat &format, const Size &size)
+{
+	return PixelFormatInfo::info(format).frameSize(size, 1);
+}
+
+/**
+ * \brief Configure the decoder output
+ * \param[in] format The output pixel format
+ * \param[in] size The frame size
+ * \return 0 on success, a negative error code otherwise
+ */
+int MjpegDecoder::configure(const PixelFormat &format, const Size &size)
+{
+	if (std::find(kDecodedFormats.begin(), kDecodedFormats.end(), format) ==
+	    kDecodedFormats.end())
+		return -EINVAL;
+
+	if (size.width % 2) {
+		LOG(UVC, Error) << "Can't decode frames with odd width " << size;
+		return -EINVAL;
+	}
+
+	format_ = format;
+	size_ = size;
+
+	for (std::unique_ptr<Worker> &worker : workers_)
+		worker->configure(format, size);
+
+	LOG(UVC, Debug)
+		<< "Decoding MJPEG to " << format << " " << size << " with "
+		<< workers_.size() << " threads";
+
+	return 0;
+}
+
+/**
+ * \brief Allocate output buffers for the decoder
+ * \param[in] count The number of buffers to allocate
+ * \param[out] buffers The allocated buffers
+ * \return The number of allocated buffers on success or a negative error code
+ * otherwise
+ */
+int MjpegDecoder::exportBuffers(unsigned int count,
+				std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	const PixelFormatInfo &info = PixelFormatInfo::info(format_);
+
+	std::vector<unsigned int> planeSizes;
+	for (unsigned int i = 0; i < info.numPlanes(); ++i)
+		planeSizes.push_back(info.planeSize(size_, i, 1));
+
+	return dmaHeap_.exportBuffers(count, planeSizes, buffers);
+}
+
+/**
+ * \brief Start the worker threads
+ */
+void MjpegDecoder::start()
+{
+	stopping_.store(false, std::memory_order_relaxed);
+
+	for (std::unique_ptr<Thread> &thread : threads_)
+		thread->start();
+}
+
+/**
+ * \brief Stop the worker threads
+ *
+ * Frames queued for decoding and not decoded yet are completed with the
+ * FrameCancelled status before this function returns.
+ */
+void MjpegDecoder::stop()
+{
+	stopping_.store(true, std::memory_order_relaxed);
+
+	for (unsigned int i = 0; i < threads_.size(); ++i) {
+		if (!threads_[i]->isRunning())
+			continue;
+
+		/* Wait for the queued frames to be processed. */
+		workers_[i]->invokeMethod(&Worker::flush, ConnectionTypeBlocking);
+
+		threads_[i]->exit();
+		threads_[i]->wait();
+	}
+
+	Thread::current()->dispatchMessages(Message::Type::InvokeMessage, this);
+
+	ASSERT(queuedBuffers_.empty());
+}
+
+/**
+ * \brief Queue an MJPEG frame for decoding
+ * \param[in] input The buffer containing the MJPEG frame
+ * \param[in] output The buffer to store the decoded frame
+ * \return 0 on success, a negative error code otherwise
+ */
+int MjpegDecoder::queueBuffers(FrameBuffer *input, FrameBuffer *output)
+{
+	auto [it, inserted] = queuedBuffers_.try_emplace(output, input);
+	if (!inserted)
+		return -EBUSY;
+
+	Worker *worker = workers_[nextWorker_].get();
+	nextWorker_ = (nextWorker_ + 1) % workers_.size();
+
+	worker->invokeMethod(&Worker::decode, ConnectionTypeQueued, input, output);
+
+	return 0;
+}
+
+void MjpegDecoder::decodeDone(FrameBuffer *input, FrameBuffer *output)
+{
+	queuedBuffers_.erase(output);
+
+	inputBufferReady.emit(input);
+	outputBufferReady.emit(output);
+}
+
+/**
+ * \var MjpegDecoder::inputBufferReady
+ * \brief A signal emitted when an input buffer isn't used by the decoder
+ * anymore
+ *
+ * \var MjpegDecoder::outputBufferReady
+ * \brief A signal emitted when an output buffer contains a decoded frame
+ */
+
+} /* namespace libcamera */
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Multi-threaded software MJPEG decoder for the uvcvideo pipeline handler
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/object.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
+#include <libcamera/base/thread.h>
+
+#include <libcamera/geometry.h>
+#include <libcamera/pixel_format.h>
+
+#include "libcamera/internal/dma_buf_allocator.h"
+
+namespace libcamera {
+
+class FrameBuffer;
+
+class MjpegDecoder : public Object
+{
+public:
+	MjpegDecoder();
+	~MjpegDecoder();
+
+	static bool isAvailable();
+	static Span<const PixelFormat> formats();
+
+	bool isValid() const { return dmaHeap_.isValid(); }
+
+	static unsigned int stride(const PixelFormat &format, const Size &size);
+	static unsigned int frameSize(const PixelFormat &format, const Size &size);
+
+	int configure(const PixelFormat &format, const Size &size);
+	int exportBuffers(unsigned int count,
+			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
+
+	void start();
+	void stop();
+
+	int queueBuffers(FrameBuffer *input, FrameBuffer *output);
+
+	Signal<FrameBuffer *> inputBufferReady;
+	Signal<FrameBuffer *> outputBufferReady;
+
+private:
+	class Worker;
+
+	static constexpr unsigned int kMaxThreads = 4;
+
+	void decodeDone(FrameBuffer *input, FrameBuffer *output);
+
+	DmaBufAllocator dmaHeap_;
+
+	std::vector<std::unique_ptr<Thread>> threads_;
+	std::vector<std::unique_ptr<Worker>> workers_;
+	unsigned int nextWorker_;
+	std::atomic<bool> stopping_;
+
+	PixelFormat format_;
+	Size size_;
+
+	/* Input buffers being decoded, indexed by output buffer */
+	std::map<FrameBuffer *, FrameBuffer *> queuedBuffers_;
+};
+
+} /* namespace libcamera */
@@ -12,6 +12,7 @@
 #include <map>
 #include <memory>
 #include <optional>
+#include <queue>
 #include <set>
 #include <string>
 #include <vector>
@@ -23,17 +24,21 @@
 #include <libcamera/camera.h>
 #include <libcamera/control_ids.h>
 #include <libcamera/controls.h>
+#include <libcamera/formats.h>
 #include <libcamera/property_ids.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/sysfs.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
+#include "mjpeg_decoder.h"
+
 namespace libcamera {
 
 LOG_DEFINE_CATEGORY(UVC)
@@ -42,7 +47,7 @@ class UVCCameraData : public Camera::Private
 {
 public:
 	UVCCameraData(PipelineHandler *pipe)
-		: Camera::Private(pipe)
+		: Camera::Private(pipe), decoding_(false)
 	{
 	}
 
@@ -51,6 +56,10 @@ public:
 			ControlInfoMap::Map *ctrls);
 	void imageBufferReady(FrameBuffer *buffer);
 
+	bool needsDecoding(const PixelFormat &pixelFormat, const Size &size) const;
+	void queuePendingRequests();
+	void cancelRequest(Request *request);
+
 	const std::string &id() const { return id_; }
 
 	Mutex openLock_;
@@ -58,11 +67,28 @@ public:
 	Stream stream_;
 	std::map<PixelFormat, std::vector<SizeRange>> formats_;
 
+	/*
+	 * Formats produced by decoding MJPEG frames in software, for the sizes
+	 * the camera doesn't produce natively.
+	 */
+	std::unique_ptr<MjpegDecoder> decoder_;
+	std::map<PixelFormat, std::vector<SizeRange>> decodedFormats_;
+	bool decoding_;
+
+	std::vector<std::unique_ptr<FrameBuffer>> mjpegBuffers_;
+	std::queue<FrameBuffer *> availableMjpegBuffers_;
+	std::queue<Request *> pendingRequests_;
+
 	std::optional<v4l2_exposure_auto_type> autoExposureMode_;
 	std::optional<v4l2_exposure_auto_type> manualExposureMode_;
 
 private:
 	bool generateId();
+	void initDecoder();
+
+	void mjpegBufferReady(FrameBuffer *buffer);
+	void decodeInputDone(FrameBuffer *buffer);
+	void decodeOutputDone(FrameBuffer *buffer);
 
 	std::string id_;
 };
@@ -186,8 +212,15 @@ CameraConfiguration::Status UVCCameraConfiguration::validate()
 
 	cfg.bufferCount = 4;
 
+	/*
+	 * Formats not produced natively by the camera are decoded from MJPEG
+	 * frames of the same size.
+	 */
+	const bool decode = data_->needsDecoding(cfg.pixelFormat, cfg.size);
+
 	V4L2DeviceFormat format;
-	format.fourcc = data_->video_->toV4L2PixelFormat(cfg.pixelFormat);
+	format.fourcc = data_->video_->toV4L2PixelFormat(decode ? formats::MJPEG
+								: cfg.pixelFormat);
 	format.size = cfg.size;
 
 	/*
@@ -214,8 +247,13 @@ CameraConfiguration::Status UVCCameraConfiguration::validate()
 			return Invalid;
 	}
 
-	cfg.stride = format.planes[0].bpl;
-	cfg.frameSize = format.planes[0].size;
+	if (decode) {
+		cfg.stride = MjpegDecoder::stride(cfg.pixelFormat, cfg.size);
+		cfg.frameSize = MjpegDecoder::frameSize(cfg.pixelFormat, cfg.size);
+	} else {
+		cfg.stride = format.planes[0].bpl;
+		cfg.frameSize = format.planes[0].size;
+	}
 
 	if (cfg.colorSpace != format.colorSpace) {
 		cfg.colorSpace = format.colorSpace;
@@ -241,10 +279,17 @@ PipelineHandlerUVC::generateConfiguration(Camera *camera,
 	if (roles.empty())
 		return config;
 
-	StreamFormats formats(data->formats_);
+	std::map<PixelFormat, std::vector<SizeRange>> streamFormats = data->formats_;
+	for (const auto &[pixelFormat, sizes] : data->decodedFormats_) {
+		std::vector<SizeRange> &ranges = streamFormats[pixelFormat];
+		ranges.insert(ranges.end(), sizes.begin(), sizes.end());
+	}
+
+	StreamFormats formats(streamFormats);
 	StreamConfiguration cfg(formats);
 
-	cfg.pixelFormat = formats.pixelformats().front();
+	/* Default to a format produced natively by the camera. */
+	cfg.pixelFormat = data->formats_.begin()->first;
 	cfg.size = formats.sizes(cfg.pixelFormat).back();
 	cfg.bufferCount = 4;
 
@@ -261,18 +306,30 @@ int PipelineHandlerUVC::configure(Camera *camera, CameraConfiguration *config)
 	StreamConfiguration &cfg = config->at(0);
 	int ret;
 
+	const bool decode = data->needsDecoding(cfg.pixelFormat, cfg.size);
+	const V4L2PixelFormat fourcc =
+		data->video_->toV4L2PixelFormat(decode ? formats::MJPEG
+						       : cfg.pixelFormat);
+
 	V4L2DeviceFormat format;
-	format.fourcc = data->video_->toV4L2PixelFormat(cfg.pixelFormat);
+	format.fourcc = fourcc;
 	format.size = cfg.size;
 
 	ret = data->video_->setFormat(&format);
 	if (ret)
 		return ret;
 
-	if (format.size != cfg.size ||
-	    format.fourcc != data->video_->toV4L2PixelFormat(cfg.pixelFormat))
+	if (format.size != cfg.size || format.fourcc != fourcc)
 		return -EINVAL;
 
+	if (decode) {
+		ret = data->decoder_->configure(cfg.pixelFormat, cfg.size);
+		if (ret)
+			return ret;
+	}
+
+	data->decoding_ = decode;
+
 	cfg.setStream(&data->stream_);
 
 	return 0;
@@ -284,6 +341,9 @@ int PipelineHandlerUVC::exportFrameBuffers(Camera *camera, Stream *stream,
 	UVCCameraData *data = cameraData(camera);
 	unsigned int count = stream->configuration().bufferCount;
 
+	if (data->decoding_)
+		return data->decoder_->exportBuffers(count, buffers);
+
 	return data->video_->exportBuffers(count, buffers);
 }
 
@@ -291,10 +351,20 @@ int PipelineHandlerUVC::start(Camera *camera, const ControlList *controls)
 {
 	UVCCameraData *data = cameraData(camera);
 	unsigned int count = data->stream_.configuration().bufferCount;
+	int ret;
 
-	int ret = data->video_->importBuffers(count);
-	if (ret < 0)
-		return ret;
+	if (data->decoding_) {
+		ret = data->video_->allocateBuffers(count, &data->mjpegBuffers_);
+		if (ret < 0)
+			return ret;
+
+		for (std::unique_ptr<FrameBuffer> &buffer : data->mjpegBuffers_)
+			data->availableMjpegBuffers_.push(buffer.get());
+	} else {
+		ret = data->video_->importBuffers(count);
+		if (ret < 0)
+			return ret;
+	}
 
 	if (controls) {
 		ret = processControls(data, *controls);
@@ -306,10 +376,15 @@ int PipelineHandlerUVC::start(Camera *camera, const ControlList *controls)
 	if (ret < 0)
 		goto err_release_buffers;
 
+	if (data->decoding_)
+		data->decoder_->start();
+
 	return 0;
 
 err_release_buffers:
 	data->video_->releaseBuffers();
+	data->availableMjpegBuffers_ = {};
+	data->mjpegBuffers_.clear();
 
 	return ret;
 }
@@ -317,8 +392,21 @@ err_release_buffers:
 void PipelineHandlerUVC::stopDevice(Camera *camera)
 {
 	UVCCameraData *data = cameraData(camera);
+
+	/* Cancel the requests waiting for an MJPEG buffer first. */
+	while (!data->pendingRequests_.empty()) {
+		data->cancelRequest(data->pendingRequests_.front());
+		data->pendingRequests_.pop();
+	}
+
 	data->video_->streamOff();
+
+	if (data->decoding_)
+		data->decoder_->stop();
+
 	data->video_->releaseBuffers();
+	data->availableMjpegBuffers_ = {};
+	data->mjpegBuffers_.clear();
 }
 
 int PipelineHandlerUVC::processControl(const UVCCameraData *data, ControlList *controls,
@@ -457,6 +545,12 @@ int PipelineHandlerUVC::queueRequestDevice(Camera *camera, Request *request)
 	if (ret < 0)
 		return ret;
 
+	if (data->decoding_) {
+		data->pendingRequests_.push(request);
+		data->queuePendingRequests();
+		return 0;
+	}
+
 	ret = data->video_->queueBuffer(buffer);
 	if (ret < 0)
 		return ret;
@@ -594,6 +688,8 @@ int UVCCameraData::init(MediaDevice *media)
 
 	properties_.set(properties::Location, location);
 
+	initDecoder();
+
 	properties_.set(properties::PixelArraySize, resolution);
 	properties_.set(properties::PixelArrayActiveAreas, { Rectangle(resolution) });
 
@@ -623,6 +719,55 @@ int UVCCameraData::init(MediaDevice *media)
 	return 0;
 }
 
+void UVCCameraData::initDecoder()
+{
+	const auto mjpeg = formats_.find(formats::MJPEG);
+	if (mjpeg == formats_.end() || !MjpegDecoder::isAvailable())
+		return;
+
+	std::unique_ptr<MjpegDecoder> decoder = std::make_unique<MjpegDecoder>();
+	if (!decoder->isValid()) {
+		LOG(UVC, Debug)
+			<< "No dma-buf allocator available, not decoding MJPEG";
+		return;
+	}
+
+	for (const PixelFormat &pixelFormat : MjpegDecoder::formats()) {
+		const auto native = formats_.find(pixelFormat);
+
+		for (const SizeRange &range : mjpeg->second) {
+			if (native != formats_.end() &&
+			    std::any_of(native->second.begin(), native->second.end(),
+					[&](const SizeRange &r) { return r.contains(range.max); }))
+				continue;
+
+			decodedFormats_[pixelFormat].push_back(range);
+		}
+	}
+
+	if (decodedFormats_.empty())
+		return;
+
+	decoder_ = std::move(decoder);
+	decoder_->inputBufferReady.connect(this, &UVCCameraData::decodeInputDone);
+	decoder_->outputBufferReady.connect(this, &UVCCameraData::decodeOutputDone);
+}
+
+bool UVCCameraData::needsDecoding(const PixelFormat &pixelFormat,
+				  const Size &size) const
+{
+	const auto contains = [&](const std::map<PixelFormat, std::vector<SizeRange>> &formats) {
+		const auto it = formats.find(pixelFormat);
+		if (it == formats.end())
+			return false;
+
+		return std::any_of(it->second.begin(), it->second.end(),
+				   [&](const SizeRange &range) { return range.contains(size); });
+	};
+
+	return !contains(formats_) && contains(decodedFormats_);
+}
+
 bool UVCCameraData::generateId()
 {
 	const std::string path = video_->devicePath();
@@ -889,6 +1034,11 @@ void UVCCameraData::addControl(uint32_t cid, const ControlInfo &v4l2Info,
 
 void UVCCameraData::imageBufferReady(FrameBuffer *buffer)
 {
+	if (decoding_) {
+		mjpegBufferReady(buffer);
+		return;
+	}
+
 	Request *request = buffer->request();
 
 	/* \todo Use the UVC metadata to calculate a more precise timestamp */
@@ -899,6 +1049,79 @@ void UVCCameraData::imageBufferReady(FrameBuffer *buffer)
 	pipe()->completeRequest(request);
 }
 
+void UVCCameraData::queuePendingRequests()
+{
+	while (!pendingRequests_.empty() && !availableMjpegBuffers_.empty()) {
+		Request *request = pendingRequests_.front();
+		pendingRequests_.pop();
+
+		/* Associate the internal buffer with the request to decode it. */
+		FrameBuffer *buffer = availableMjpegBuffers_.front();
+		buffer->_d()->setRequest(request);
+
+		int ret = video_->queueBuffer(buffer);
+		if (ret < 0) {
+			LOG(UVC, Error) << "Failed to queue MJPEG buffer: " << ret;
+			cancelRequest(request);
+			continue;
+		}
+
+		availableMjpegBuffers_.pop();
+	}
+}
+
+void UVCCameraData::cancelRequest(Request *request)
+{
+	FrameBuffer *buffer = request->findBuffer(&stream_);
+
+	buffer->_d()->cancel();
+	pipe()->completeBuffer(request, buffer);
+	pipe()->completeRequest(request);
+}
+
+void UVCCameraData::mjpegBufferReady(FrameBuffer *buffer)
+{
+	Request *request = buffer->request();
+	FrameBuffer *output = request->findBuffer(&stream_);
+	const FrameMetadata &metadata = buffer->metadata();
+
+	request->metadata().set(controls::SensorTimestamp, metadata.timestamp);
+
+	if (metadata.status == FrameMetadata::FrameSuccess) {
+		int ret = decoder_->queueBuffers(buffer, output);
+		if (!ret)
+			return;
+
+		LOG(UVC, Error) << "Failed to queue MJPEG buffer for decoding";
+	}
+
+	availableMjpegBuffers_.push(buffer);
+
+	output->_d()->metadata().status = metadata.status == FrameMetadata::FrameSuccess
+					? FrameMetadata::FrameError
+					: metadata.status;
+	pipe()->completeBuffer(request, output);
+	pipe()->completeRequest(request);
+
+	/* Don't queue buffers when the device is being stopped. */
+	if (metadata.status != FrameMetadata::FrameCancelled)
+		queuePendingRequests();
+}
+
+void UVCCameraData::decodeInputDone(FrameBuffer *buffer)
+{
+	availableMjpegBuffers_.push(buffer);
+	queuePendingRequests();
+}
+
+void UVCCameraData::decodeOutputDone(FrameBuffer *buffer)
+{
+	Request *request = buffer->request();
+
+	pipe()->completeBuffer(request, buffer);
+	pipe()->completeRequest(request);
+}
+
 REGISTER_PIPELINE_HANDLER(PipelineHandlerUVC, "uvcvideo")
 
 } /* namespace libcamera */
@@ -7,14 +7,19 @@
 
 #include "config_parser.h"
 
+#include <filesystem>
+#include <memory>
+#include <optional>
 #include <string.h>
 #include <utility>
 
 #include <libcamera/base/log.h>
 
 #include <libcamera/control_ids.h>
+#include <libcamera/pixel_format.h>
 #include <libcamera/property_ids.h>
 
+#include "libcamera/internal/bayer_format.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/yaml_parser.h"
 
@@ -156,6 +161,19 @@ int ConfigParser::parseFrameGenerator(const YamlObject &cameraConfigData, Virtua
 {
 	const std::string testPatternKey = "test_pattern";
 	const std::string framesKey = "frames";
+	const std::string rawKey = "raw";
+	if (cameraConfigData.contains(rawKey)) {
+		if (cameraConfigData.contains(testPatternKey) ||
+		    cameraConfigData.contains(framesKey)) {
+			LOG(Virtual, Error) << "A camera using " << rawKey
+					    << " can't use " << testPatternKey
+					    << " or " << framesKey;
+			return -EINVAL;
+		}
+
+		return parseRawFrames(cameraConfigData[rawKey], data);
+	}
+
 	if (cameraConfigData.contains(testPatternKey)) {
 		if (cameraConfigData.contains(framesKey)) {
 			LOG(Virtual, Error) << "A camera should use either "
@@ -231,6 +249,135 @@ int ConfigParser::parseFrameGenerator(const YamlObject &cameraConfigData, Virtua
 	return 0;
 }
 
+int ConfigParser::parseRawFrames(const YamlObject &rawConfigData, VirtualCameraData *data)
+{
+	if (!rawConfigData.isDictionary()) {
+		LOG(Virtual, Error) << "'raw' is not a dictionary.";
+		return -EINVAL;
+	}
+
+	std::string format = rawConfigData["format"].get<std::string>("SRGGB10_CSI2P");
+	PixelFormat pixelFormat = PixelFormat::fromString(format);
+	BayerFormat bayerFormat = BayerFormat::fromPixelFormat(pixelFormat);
+
+	if (!bayerFormat.isValid() || bayerFormat.order == BayerFormat::MONO ||
+	    (bayerFormat.bitDepth != 8 && bayerFormat.bitDepth != 10 &&
+	     bayerFormat.bitDepth != 12) ||
+	    (bayerFormat.packing != BayerFormat::Packing::None &&
+	     (bayerFormat.packing != BayerFormat::Packing::CSI2 ||
+	      bayerFormat.bitDepth == 8))) {
+		LOG(Virtual, Error) << "Raw format: " << format << " is not supported";
+		return -EINVAL;
+	}
+
+	/* Keep whole packing groups and Bayer patterns on each line. */
+	for (const auto &resolution : data->config_.resolutions) {
+		if (resolution.size.width % 4 || resolution.size.height % 2) {
+			LOG(Virtual, Error)
+				<< "Invalid resolution " << resolution.size
+				<< ": raw frames require a width multiple of 4"
+				<< " and an even height";
+			return -EINVAL;
+		}
+	}
+
+	RawFrames rawFrames{ pixelFormat, std::nullopt, {}, RawFrames::Replay::RealTime };
+
+	if (auto path = rawConfigData["path"].get<std::string>()) {
+		if (std::filesystem::symlink_status(*path).type() !=
+		    std::filesystem::file_type::regular) {
+			LOG(Virtual, Error) << "Raw file: " << *path << " is not supported";
+			return -EINVAL;
+		}
+
+		/* A recorded file contains frames of a single size. */
+		if (data->config_.resolutions.size() != 1) {
+			LOG(Virtual, Error)
+				<< "Raw files require a single supported format";
+			return -EINVAL;
+		}
+
+		rawFrames.path = std::move(path);
+	}
+
+	if (auto metadata = rawConfigData["metadata"].get<std::string>()) {
+		if (!rawFrames.path) {
+			LOG(Virtual, Error) << "Raw metadata requires a raw file";
+			return -EINVAL;
+		}
+
+		int ret = parseRawMetadata(*metadata, &rawFrames);
+		if (ret)
+			return ret;
+	}
+
+	std::string replay = rawConfigData["replay"].get<std::string>("realtime");
+	if (replay == "fast") {
+		if (!rawFrames.path) {
+			LOG(Virtual, Error) << "Fast replay requires a raw file";
+			return -EINVAL;
+		}
+
+		rawFrames.replay = RawFrames::Replay::Fast;
+	} else if (replay != "realtime") {
+		LOG(Virtual, Error) << "Replay mode: " << replay << " is not supported";
+		return -EINVAL;
+	}
+
+	data->config_.frame = std::move(rawFrames);
+
+	return 0;
+}
+
+int ConfigParser::parseRawMetadata(const std::string &path, RawFrames *rawFrames)
+{
+	File file(path);
+	if (!file.open(File::OpenModeFlag::ReadOnly)) {
+		LOG(Virtual, Error)
+			<< "Failed to open raw metadata file `" << path << "`";
+		return -EINVAL;
+	}
+
+	std::unique_ptr<YamlObject> root = YamlParser::parse(file);
+	if (!root) {
+		LOG(Virtual, Error) << "Failed to parse raw metadata file `" << path << "`";
+		return -EINVAL;
+	}
+
+	const YamlObject &frames = (*root)["frames"];
+	if (!frames.isList() || !frames.size()) {
+		LOG(Virtual, Error) << "Raw metadata: 'frames' is not a non-empty list";
+		return -EINVAL;
+	}
+
+	rawFrames->metadata.reserve(frames.size());
+
+	for (const YamlObject &frame : frames.asList()) {
+		auto timestamp = frame["timestamp"].get<int64_t>();
+		auto exposure = frame["exposure"].get<int32_t>();
+		auto gain = frame["gain"].get<int32_t>();
+
+		if (!timestamp || !exposure || !gain) {
+			LOG(Virtual, Error)
+				<< "Raw metadata: frame " << rawFrames->metadata.size()
+				<< " requires a timestamp, exposure and gain";
+			return -EINVAL;
+		}
+
+		if (!rawFrames->metadata.empty() &&
+		    *timestamp <= rawFrames->metadata.back().timestamp) {
+			LOG(Virtual, Error)
+				<< "Raw metadata: timestamps are not increasing at frame "
+				<< rawFrames->metadata.size();
+			return -EINVAL;
+		}
+
+		rawFrames->metadata.push_back({ *timestamp, *exposure, *gain });
+	}
+
+	return 0;
+}
+
 int ConfigParser::parseLocation(const YamlObject &cameraConfigData, VirtualCameraData *data)
 {
 	/* Default value is properties::CameraLocationFront */
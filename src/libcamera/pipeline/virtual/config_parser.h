@@ -8,6 +8,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <libcamera/base/file.h>
@@ -32,6 +33,8 @@ private:
 	int parseSupportedFormats(const YamlObject &cameraConfigData,
 				  std::vector<VirtualCameraData::Resolution> *resolutions);
 	int parseFrameGenerator(const YamlObject &cameraConfigData, VirtualCameraData *data);
+	int parseRawFrames(const YamlObject &rawConfigData, VirtualCameraData *data);
+	int parseRawMetadata(const std::string &path, RawFrames *rawFrames);
 	int parseLocation(const YamlObject &cameraConfigData, VirtualCameraData *data);
 	int parseModel(const YamlObject &cameraConfigData, VirtualCameraData *data);
 };
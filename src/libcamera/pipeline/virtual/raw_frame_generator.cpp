@@ -0,0 +1,375 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Derived class of FrameGenerator for generating raw Bayer frames
+ */
+
+#include "raw_frame_generator.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include <linux/v4l2-controls.h>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(Virtual)
+
+namespace {
+
+/*
+ * Controls of the emulated sensor. The analogue gain code is linear with 256
+ * representing a gain of 1.0, as described by the "virtual" sensor helper in
+ * libipa.
+ */
+const ControlId exposureControl(V4L2_CID_EXPOSURE, "Exposure", "v4l2",
+				ControlTypeInteger32,
+				ControlId::Direction::In | ControlId::Direction::Out);
+const ControlId gainControl(V4L2_CID_ANALOGUE_GAIN, "Analogue Gain", "v4l2",
+			    ControlTypeInteger32,
+			    ControlId::Direction::In | ControlId::Direction::Out);
+
+const ControlIdMap sensorControlIds = {
+	{ V4L2_CID_EXPOSURE, &exposureControl },
+	{ V4L2_CID_ANALOGUE_GAIN, &gainControl },
+};
+
+constexpr int32_t kGainUnity = 256;
+constexpr int32_t kGainMax = 16 * kGainUnity;
+
+/* 16-bit black level, scaled to the bit depth of the format */
+constexpr unsigned int kBlackLevel = 4096;
+
+/*
+ * Scene illuminance, expressed as the fraction of the maximum exposure time
+ * that saturates a white patch at unity gain.
+ */
+constexpr unsigned int kSaturationExposureDivider = 4;
+
+} /* namespace */
+
+RawFrameGenerator::RawFrameGenerator(const RawFrames &rawFrames, const Size &maxSize)
+	: rawFrames_(rawFrames), lutValid_(false), shift_(0), frameIndex_(0),
+	  frameCount_(0), frameSize_(0)
+{
+	bayerFormat_ = BayerFormat::fromPixelFormat(rawFrames.format);
+
+	/* The frame length is the height of the largest resolution. */
+	maxExposure_ = maxSize.height;
+	exposure_ = maxExposure_ / 2;
+	gain_ = kGainUnity;
+
+	ControlInfoMap::Map ctrls;
+	ctrls.emplace(&exposureControl,
+		      ControlInfo(int32_t(1), static_cast<int32_t>(maxExposure_),
+				  exposure_));
+	ctrls.emplace(&gainControl,
+		      ControlInfo(kGainUnity, kGainMax, kGainUnity));
+	controlInfo_ = ControlInfoMap(std::move(ctrls), sensorControlIds);
+}
+
+/*
+ * Factory function to create a RawFrameGenerator object. The frames are
+ * synthesized from a test scene, or read from a file containing frames of the
+ * configured format stored back to back without padding. Recorded frames may
+ * come with per-frame sensor metadata, used to pace the replay and reported to
+ * the IPA.
+ */
+std::unique_ptr<RawFrameGenerator>
+RawFrameGenerator::create(const RawFrames &rawFrames, const Size &maxSize)
+{
+	std::unique_ptr<RawFrameGenerator> generator(
+		new RawFrameGenerator(rawFrames, maxSize));
+
+	if (rawFrames.path && generator->loadFile() < 0)
+		return nullptr;
+
+	return generator;
+}
+
+int RawFrameGenerator::loadFile()
+{
+	file_.setFileName(*rawFrames_.path);
+	if (!file_.open(File::OpenModeFlag::ReadOnly)) {
+		LOG(Virtual, Error) << "Failed to open raw file " << file_.fileName()
+				    << ": " << strerror(-file_.error());
+		return file_.error();
+	}
+
+	data_ = file_.map();
+	if (data_.empty()) {
+		LOG(Virtual, Error) << "Failed to map raw file " << file_.fileName()
+				    << ": " << strerror(-file_.error());
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+void RawFrameGenerator::configure(const Size &size)
+{
+	const PixelFormatInfo &info = PixelFormatInfo::info(rawFrames_.format);
+
+	frameSize_ = info.frameSize(size);
+	frameIndex_ = 0;
+	shift_ = 0;
+	lutValid_ = false;
+
+	if (!data_.empty()) {
+		frameCount_ = data_.size() / frameSize_;
+		if (!frameCount_) {
+			LOG(Virtual, Error)
+				<< "Raw file " << file_.fileName()
+				<< " is too small for a " << size << " frame";
+			return;
+		}
+
+		const std::vector<RecordedFrame> &metadata = rawFrames_.metadata;
+		if (!metadata.empty() && metadata.size() != frameCount_) {
+			LOG(Virtual, Warning)
+				<< "Raw file " << file_.fileName() << " contains "
+				<< frameCount_ << " frame(s) but metadata for "
+				<< metadata.size() << ", replaying "
+				<< std::min<size_t>(frameCount_, metadata.size());
+			frameCount_ = std::min<size_t>(frameCount_, metadata.size());
+		}
+
+		return;
+	}
+
+	generateTemplate(size);
+}
+
+/*
+ * Render the test scene as per-pixel reflectance values sampled through the
+ * colour filter array of the sensor. As for test patterns, the scene is stored
+ * twice side by side to make scrolling a plain offset.
+ */
+void RawFrameGenerator::generateTemplate(const Size &size)
+{
+	/* 75% colour bars */
+	constexpr uint8_t kColorBar[8][3] = {
+		/*  R,    G,    B */
+		{ 0xbf, 0xbf, 0xbf }, /* White */
+		{ 0xbf, 0xbf, 0x00 }, /* Yellow */
+		{ 0x00, 0xbf, 0xbf }, /* Cyan */
+		{ 0x00, 0xbf, 0x00 }, /* Green */
+		{ 0xbf, 0x00, 0xbf }, /* Magenta */
+		{ 0xbf, 0x00, 0x00 }, /* Red */
+		{ 0x00, 0x00, 0xbf }, /* Blue */
+		{ 0x10, 0x10, 0x10 }, /* Black */
+	};
+
+	/* Colour component index of the top-left 2x2 pixels of each order. */
+	constexpr unsigned int kCfa[4][4] = {
+		{ 2, 1, 1, 0 }, /* BGGR */
+		{ 1, 2, 0, 1 }, /* GBRG */
+		{ 1, 0, 2, 1 }, /* GRBG */
+		{ 0, 1, 1, 2 }, /* RGGB */
+	};
+
+	const unsigned int width = size.width * 2;
+	const unsigned int barWidth = std::max(size.width / 8, 1U);
+	const unsigned int *cfa = kCfa[bayerFormat_.order];
+
+	template_.resize(width * size.height);
+
+	uint8_t *buf = template_.data();
+	for (unsigned int y = 0; y < size.height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			unsigned int bar = ((x % size.width) / barWidth) % 8;
+			unsigned int component = cfa[(y & 1) * 2 + (x & 1)];
+
+			*buf++ = kColorBar[bar][component];
+		}
+	}
+}
+
+/*
+ * Compute the pixel values for all reflectance values, given the current
+ * exposure time and gain.
+ */
+void RawFrameGenerator::updateLut()
+{
+	const unsigned int maxValue = (1 << bayerFormat_.bitDepth) - 1;
+	const unsigned int black = kBlackLevel >> (16 - bayerFormat_.bitDepth);
+	const double scale = static_cast<double>(exposure_) * gain_ *
+			     kSaturationExposureDivider /
+			     (maxExposure_ * kGainUnity * 255.0);
+
+	for (unsigned int i = 0; i < lut_.size(); i++) {
+		double value = black + i * scale * (maxValue - black);
+		lut_[i] = std::min<double>(value, maxValue);
+	}
+
+	lutValid_ = true;
+}
+
+void RawFrameGenerator::writeLine(const uint8_t *src, unsigned int width,
+				  uint8_t *dst) const
+{
+	if (bayerFormat_.packing == BayerFormat::Packing::CSI2) {
+		if (bayerFormat_.bitDepth == 10) {
+			for (unsigned int x = 0; x < width; x += 4) {
+				uint16_t p[4] = { lut_[src[x]], lut_[src[x + 1]],
+						  lut_[src[x + 2]], lut_[src[x + 3]] };
+
+				*dst++ = p[0] >> 2;
+				*dst++ = p[1] >> 2;
+				*dst++ = p[2] >> 2;
+				*dst++ = p[3] >> 2;
+				*dst++ = (p[0] & 3) | (p[1] & 3) << 2 |
+					 (p[2] & 3) << 4 | (p[3] & 3) << 6;
+			}
+		} else {
+			for (unsigned int x = 0; x < width; x += 2) {
+				uint16_t p[2] = { lut_[src[x]], lut_[src[x + 1]] };
+
+				*dst++ = p[0] >> 4;
+				*dst++ = p[1] >> 4;
+				*dst++ = (p[0] & 0xf) | (p[1] & 0xf) << 4;
+			}
+		}
+
+		return;
+	}
+
+	if (bayerFormat_.bitDepth == 8) {
+		for (unsigned int x = 0; x < width; x++)
+			dst[x] = lut_[src[x]];
+		return;
+	}
+
+	for (unsigned int x = 0; x < width; x++) {
+		uint16_t p = lut_[src[x]];
+
+		*dst++ = p & 0xff;
+		*dst++ = p >> 8;
+	}
+}
+
+int RawFrameGenerator::generateFrame(const Size &size, const FrameBuffer *buffer)
+{
+	MappedFrameBuffer mappedFrameBuffer(buffer,
+					    MappedFrameBuffer::MapFlag::Write);
+
+	Span<uint8_t> plane = mappedFrameBuffer.planes()[0];
+	if (plane.size() < frameSize_)
+		return -EINVAL;
+
+	/* Replay recorded frames in a loop. */
+	if (!data_.empty()) {
+		if (!frameCount_)
+			return -EINVAL;
+
+		memcpy(plane.data(), data_.data() + frameIndex_ * frameSize_,
+		       frameSize_);
+		applyRecordedControls();
+		frameIndex_ = (frameIndex_ + 1) % frameCount_;
+		return 0;
+	}
+
+	if (!lutValid_)
+		updateLut();
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(rawFrames_.format);
+	const unsigned int stride = info.stride(size.width, 0);
+	const unsigned int width = size.width * 2;
+
+	/* Scroll the scene left by one CFA pattern per frame. */
+	shift_ = (shift_ + 2) % size.width;
+
+	for (unsigned int y = 0; y < size.height; y++)
+		writeLine(template_.data() + y * width + shift_, size.width,
+			  plane.data() + y * stride);
+
+	return 0;
+}
+
+/*
+ * Skip the next recorded frame, for frames dropped by the emulated sensor, to
+ * keep the replay in sync with the recorded timestamps.
+ */
+void RawFrameGenerator::skipFrame()
+{
+	if (frameCount_)
+		frameIndex_ = (frameIndex_ + 1) % frameCount_;
+}
+
+/*
+ * Compute the time between the last generated or skipped recorded frame and
+ * the next one from the recorded timestamps. The first interval is used when
+ * looping back to the beginning of the file.
+ */
+std::optional<std::chrono::nanoseconds> RawFrameGenerator::frameInterval() const
+{
+	const std::vector<RecordedFrame> &metadata = rawFrames_.metadata;
+
+	if (metadata.empty() || frameCount_ < 2)
+		return std::nullopt;
+
+	unsigned int next = frameIndex_ ? frameIndex_ : 1;
+
+	return std::chrono::nanoseconds(metadata[next].timestamp -
+					metadata[next - 1].timestamp);
+}
+
+/*
+ * Report the exposure and gain the frame being replayed was recorded with,
+ * instead of the values requested by the IPA.
+ */
+void RawFrameGenerator::applyRecordedControls()
+{
+	if (rawFrames_.metadata.empty())
+		return;
+
+	const RecordedFrame &frame = rawFrames_.metadata[frameIndex_];
+	exposure_ = frame.exposure;
+	gain_ = frame.gain;
+}
+
+ControlList RawFrameGenerator::sensorControls() const
+{
+	ControlList ctrls(controlInfo_);
+
+	ctrls.set(V4L2_CID_EXPOSURE, exposure_);
+	ctrls.set(V4L2_CID_ANALOGUE_GAIN, gain_);
+
+	return ctrls;
+}
+
+/*
+ * Apply new exposure and gain values. They take effect from the next generated
+ * frame.
+ */
+void RawFrameGenerator::setSensorControls(const ControlList &controls)
+{
+	/* Recorded frames are replayed with their recorded controls. */
+	if (!rawFrames_.metadata.empty())
+		return;
+
+	const ControlInfo &exposureInfo = controlInfo_.at(V4L2_CID_EXPOSURE);
+	const ControlInfo &gainInfo = controlInfo_.at(V4L2_CID_ANALOGUE_GAIN);
+
+	if (controls.contains(V4L2_CID_EXPOSURE))
+		exposure_ = std::clamp(controls.get(V4L2_CID_EXPOSURE).get<int32_t>(),
+				       exposureInfo.min().get<int32_t>(),
+				       exposureInfo.max().get<int32_t>());
+
+	if (controls.contains(V4L2_CID_ANALOGUE_GAIN))
+		gain_ = std::clamp(controls.get(V4L2_CID_ANALOGUE_GAIN).get<int32_t>(),
+				   gainInfo.min().get<int32_t>(),
+				   gainInfo.max().get<int32_t>());
+
+	lutValid_ = false;
+}
+
+} /* namespace libcamera */
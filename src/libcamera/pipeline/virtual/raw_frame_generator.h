@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Derived class of FrameGenerator for generating raw Bayer frames
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/file.h>
+
+#include <libcamera/controls.h>
+#include <libcamera/geometry.h>
+#include <libcamera/pixel_format.h>
+
+#include "libcamera/internal/bayer_format.h"
+
+#include "frame_generator.h"
+
+namespace libcamera {
+
+/* Sensor metadata recorded along with a raw frame */
+struct RecordedFrame {
+	int64_t timestamp;
+	int32_t exposure;
+	int32_t gain;
+};
+
+/* Raw sensor configuration provided by the config file */
+struct RawFrames {
+	enum class Replay {
+		RealTime,
+		Fast,
+	};
+
+	PixelFormat format;
+	std::optional<std::string> path;
+	std::vector<RecordedFrame> metadata;
+	Replay replay;
+};
+
+class RawFrameGenerator : public FrameGenerator
+{
+public:
+	/* The model name of the emulated sensor, matching its IPA helper */
+	static constexpr const char *kSensorModel = "virtual";
+
+	static std::unique_ptr<RawFrameGenerator>
+	create(const RawFrames &rawFrames, const Size &maxSize);
+
+	void configure(const Size &size) override;
+	int generateFrame(const Size &size, const FrameBuffer *buffer) override;
+	void skipFrame();
+
+	std::optional<std::chrono::nanoseconds> frameInterval() const;
+	bool fastReplay() const { return rawFrames_.replay == RawFrames::Replay::Fast; }
+
+	const BayerFormat &bayerFormat() const { return bayerFormat_; }
+	const PixelFormat &pixelFormat() const { return rawFrames_.format; }
+
+	const ControlInfoMap &controls() const { return controlInfo_; }
+	ControlList sensorControls() const;
+	void setSensorControls(const ControlList &controls);
+
+private:
+	RawFrameGenerator(const RawFrames &rawFrames, const Size &maxSize);
+
+	int loadFile();
+	void applyRecordedControls();
+	void generateTemplate(const Size &size);
+	void updateLut();
+
+	void writeLine(const uint8_t *src, unsigned int width, uint8_t *dst) const;
+
+	RawFrames rawFrames_;
+	BayerFormat bayerFormat_;
+
+	ControlInfoMap controlInfo_;
+	int32_t exposure_;
+	int32_t gain_;
+	unsigned int maxExposure_;
+
+	/* Synthetic scene */
+	std::vector<uint8_t> template_;
+	std::array<uint16_t, 256> lut_;
+	bool lutValid_;
+	unsigned int shift_;
+
+	/* Recorded frames */
+	File file_;
+	Span<uint8_t> data_;
+	unsigned int frameIndex_;
+	unsigned int frameCount_;
+	size_t frameSize_;
+};
+
+} /* namespace libcamera */
@@ -7,6 +7,7 @@
 
 #include "test_pattern_generator.h"
 
+#include <memory>
 #include <string.h>
 
 #include <libcamera/base/log.h>
@@ -14,32 +15,45 @@
 #include "libcamera/internal/mapped_framebuffer.h"
 
 #include <libyuv/convert_from_argb.h>
+#include <libyuv/planar_functions.h>
 
-namespace {
+namespace libcamera {
 
-template<size_t SampleSize>
-void rotateLeft1Column(const libcamera::Size &size, uint8_t *image)
-{
-	if (size.width < 2)
-		return;
+LOG_DECLARE_CATEGORY(Virtual)
 
-	const size_t stride = size.width * SampleSize;
-	uint8_t first[SampleSize];
+static const unsigned int kARGBSize = 4;
 
-	for (size_t i = 0; i < size.height; i++, image += stride) {
-		memcpy(first, &image[0], SampleSize);
-		memmove(&image[0], &image[SampleSize], stride - SampleSize);
-		memcpy(&image[stride - SampleSize], first, SampleSize);
+void TestPatternGenerator::configure(const Size &size)
+{
+	const unsigned int width = size.width * 2;
+	const unsigned int stride = size.width * kARGBSize;
+
+	/*
+	 * Render the pattern once and store it twice side by side, so that
+	 * every horizontally rotated frame is a window in the pre-rendered
+	 * frame and can be produced with a plain copy.
+	 */
+	auto argb = std::make_unique<uint8_t[]>(width * size.height * kARGBSize);
+	generateTemplate(size, argb.get());
+
+	for (unsigned int y = size.height; y-- > 0;) {
+		uint8_t *src = argb.get() + y * stride;
+		uint8_t *dst = argb.get() + y * stride * 2;
+
+		memmove(dst, src, stride);
+		memcpy(dst + stride, dst, stride);
 	}
-}
-
-} /* namespace */
-
-namespace libcamera {
 
-LOG_DECLARE_CATEGORY(Virtual)
+	frame_.resize(width * size.height + width * ((size.height + 1) / 2));
+	shift_ = 0;
 
-static const unsigned int kARGBSize = 4;
+	int ret = libyuv::ARGBToNV12(argb.get(), width * kARGBSize,
+				     frame_.data(), width,
+				     frame_.data() + width * size.height, width,
+				     width, size.height);
+	if (ret != 0)
+		LOG(Virtual, Error) << "ARGBToNV12() failed with " << ret;
+}
 
 int TestPatternGenerator::generateFrame(const Size &size,
 					const FrameBuffer *buffer)
@@ -48,21 +62,23 @@ int TestPatternGenerator::generateFrame(const Size &size,
 					    MappedFrameBuffer::MapFlag::Write);
 
 	const auto &planes = mappedFrameBuffer.planes();
+	const unsigned int width = size.width * 2;
 
-	rotateLeft1Column<kARGBSize>(size, template_.get());
+	/* Scroll the pattern left by one column per frame. */
+	shift_ = (shift_ + 1) % size.width;
 
-	/* Convert the template_ to the frame buffer */
-	int ret = libyuv::ARGBToNV12(template_.get(), size.width * kARGBSize,
-				     planes[0].begin(), size.width,
-				     planes[1].begin(), size.width,
-				     size.width, size.height);
-	if (ret != 0)
-		LOG(Virtual, Error) << "ARGBToNV12() failed with " << ret;
+	/* The chroma plane is subsampled, move it by whole pixel pairs. */
+	libyuv::CopyPlane(frame_.data() + shift_, width,
+			  planes[0].begin(), size.width,
+			  size.width, size.height);
+	libyuv::CopyPlane(frame_.data() + width * size.height + (shift_ & ~1), width,
+			  planes[1].begin(), size.width,
+			  size.width, (size.height + 1) / 2);
 
-	return ret;
+	return 0;
 }
 
-void ColorBarsGenerator::configure(const Size &size)
+void ColorBarsGenerator::generateTemplate(const Size &size, uint8_t *buffer)
 {
 	constexpr uint8_t kColorBar[8][3] = {
 		/*  R,    G,    B */
@@ -76,12 +92,9 @@ void ColorBarsGenerator::configure(const Size &size)
 		{ 0x00, 0x00, 0x00 }, /* Black */
 	};
 
-	template_ = std::make_unique<uint8_t[]>(
-		size.width * size.height * kARGBSize);
-
 	unsigned int colorBarWidth = size.width / std::size(kColorBar);
 
-	uint8_t *buf = template_.get();
+	uint8_t *buf = buffer;
 	for (size_t h = 0; h < size.height; h++) {
 		for (size_t w = 0; w < size.width; w++) {
 			/* Repeat when the width is exceed */
@@ -95,7 +108,7 @@ void ColorBarsGenerator::configure(const Size &size)
 	}
 }
 
-void DiagonalLinesGenerator::configure(const Size &size)
+void DiagonalLinesGenerator::generateTemplate(const Size &size, uint8_t *buffer)
 {
 	constexpr uint8_t kColorBar[2][3] = {
 		/*  R,    G,    B */
@@ -103,12 +116,9 @@ void DiagonalLinesGenerator::configure(const Size &size)
 		{ 0x00, 0x00, 0x00 }, /* Black */
 	};
 
-	template_ = std::make_unique<uint8_t[]>(
-		size.width * size.height * kARGBSize);
-
 	unsigned int lineWidth = size.width / 10;
 
-	uint8_t *buf = template_.get();
+	uint8_t *buf = buffer;
 	for (size_t h = 0; h < size.height; h++) {
 		for (size_t w = 0; w < size.width; w++) {
 			/* Repeat when the width is exceed */
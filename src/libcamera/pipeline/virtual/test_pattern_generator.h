@@ -7,7 +7,8 @@
 
 #pragma once
 
-#include <memory>
+#include <stdint.h>
+#include <vector>
 
 #include <libcamera/framebuffer.h>
 #include <libcamera/geometry.h>
@@ -24,25 +25,34 @@ enum class TestPattern : char {
 class TestPatternGenerator : public FrameGenerator
 {
 public:
+	void configure(const Size &size) override;
 	int generateFrame(const Size &size, const FrameBuffer *buffer) override;
 
 protected:
-	/* Buffer of test pattern template */
-	std::unique_ptr<uint8_t[]> template_;
+	/* Fill an ARGB buffer of the given size with the test pattern */
+	virtual void generateTemplate(const Size &size, uint8_t *buffer) = 0;
+
+private:
+	/*
+	 * Pre-rendered NV12 frame of twice the configured width, containing
+	 * the test pattern repeated horizontally
+	 */
+	std::vector<uint8_t> frame_;
+	unsigned int shift_ = 0;
 };
 
 class ColorBarsGenerator : public TestPatternGenerator
 {
-public:
+protected:
 	/* Generate a template buffer of the color bar test pattern. */
-	void configure(const Size &size) override;
+	void generateTemplate(const Size &size, uint8_t *buffer) override;
 };
 
 class DiagonalLinesGenerator : public TestPatternGenerator
 {
-public:
+protected:
 	/* Generate a template buffer of the diagonal lines test pattern. */
-	void configure(const Size &size) override;
+	void generateTemplate(const Size &size, uint8_t *buffer) override;
 };
 
 } /* namespace libcamera */
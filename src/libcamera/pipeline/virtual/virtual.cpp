@@ -13,16 +13,20 @@
 #include <errno.h>
 #include <map>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <stdint.h>
 #include <string>
 #include <time.h>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include <libcamera/base/flags.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/message.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/control_ids.h>
 #include <libcamera/controls.h>
@@ -31,17 +35,24 @@
 #include <libcamera/property_ids.h>
 #include <libcamera/request.h>
 
+#include <libcamera/ipa/core_ipa_interface.h>
+#include <libcamera/ipa/soft_ipa_interface.h>
+
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/dma_buf_allocator.h"
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/request.h"
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/yaml_parser.h"
 
 #include "pipeline/virtual/config_parser.h"
 
 namespace libcamera {
 
+using namespace std::chrono_literals;
+
 LOG_DEFINE_CATEGORY(Virtual)
 
 namespace {
@@ -74,6 +85,8 @@ public:
 	Status validate() override;
 
 private:
+	Status validateRaw();
+
 	const VirtualCameraData *data_;
 };
 
@@ -95,9 +108,13 @@ public:
 
 	int queueRequestDevice(Camera *camera, Request *request) override;
 
+	std::vector<BufferPoolUsage> internalBufferUsage(Camera *camera) override;
+
 	bool match(DeviceEnumerator *enumerator) override;
 
 private:
+	void releaseDevice(Camera *camera) override;
+
 	static bool created_;
 
 	VirtualCameraData *cameraData(Camera *camera)
@@ -107,6 +124,10 @@ private:
 
 	bool initFrameGenerator(Camera *camera);
 
+	void frameDone(Request *request);
+	void rawFrameDone(Request *request, FrameBuffer *rawBuffer,
+			  const ControlList &sensorControls);
+
 	DmaBufAllocator dmaBufAllocator_;
 
 	bool resetCreated_ = false;
@@ -114,7 +135,7 @@ private:
 
 VirtualCameraData::VirtualCameraData(PipelineHandler *pipe,
 				     const std::vector<Resolution> &supportedResolutions)
-	: Camera::Private(pipe)
+	: Camera::Private(pipe), worker_(this)
 {
 	config_.resolutions = supportedResolutions;
 	for (const auto &resolution : config_.resolutions) {
@@ -129,6 +150,506 @@ VirtualCameraData::VirtualCameraData(PipelineHandler *pipe,
 
 	/* \todo Support multiple streams and pass multi_stream_test */
 	streamConfigs_.resize(kMaxStream);
+
+	worker_.moveToThread(&thread_);
+}
+
+std::optional<std::chrono::nanoseconds>
+VirtualCameraData::frameDuration(const ControlList &controls) const
+{
+	const auto limits = controls.get(controls::FrameDurationLimits);
+	if (!limits)
+		return std::nullopt;
+
+	/*
+	 * Run at the shortest requested frame duration, clamped to the range
+	 * supported by the camera.
+	 */
+	const ControlInfo &info = controlInfo_.at(&controls::FrameDurationLimits);
+	int64_t duration = std::clamp((*limits)[0], info.min().get<int64_t>(),
+				      info.max().get<int64_t>());
+
+	return std::chrono::microseconds(duration);
+}
+
+int VirtualCameraData::initRaw(const RawFrames &rawFrames)
+{
+	/* Colour filter arrangements indexed by BayerFormat::Order. */
+	static constexpr int32_t kCfaPatterns[] = {
+		properties::draft::BGGR,
+		properties::draft::GBRG,
+		properties::draft::GRBG,
+		properties::draft::RGGB,
+	};
+
+	rawGenerator_ = RawFrameGenerator::create(rawFrames, config_.maxResolutionSize);
+	if (!rawGenerator_)
+		return -EINVAL;
+
+	/*
+	 * Emulate a sensor without blanking whose frame length is the height of
+	 * the largest resolution, running at the highest frame rate.
+	 */
+	int64_t minFrameRate = config_.resolutions[0].frameRates[0];
+	int64_t maxFrameRate = config_.resolutions[0].frameRates[1];
+	for (const Resolution &resolution : config_.resolutions) {
+		minFrameRate = std::min(minFrameRate, resolution.frameRates[0]);
+		maxFrameRate = std::max(maxFrameRate, resolution.frameRates[1]);
+	}
+
+	const Size &size = config_.maxResolutionSize;
+	const BayerFormat &bayerFormat = rawGenerator_->bayerFormat();
+
+	IPACameraSensorInfo sensorInfo{};
+	sensorInfo.model = RawFrameGenerator::kSensorModel;
+	sensorInfo.bitsPerPixel = bayerFormat.bitDepth;
+	sensorInfo.cfaPattern = kCfaPatterns[bayerFormat.order];
+	sensorInfo.activeAreaSize = size;
+	sensorInfo.analogCrop = Rectangle(size);
+	sensorInfo.outputSize = size;
+	sensorInfo.pixelRate = static_cast<uint64_t>(size.width) * size.height *
+			       maxFrameRate;
+	sensorInfo.minLineLength = size.width;
+	sensorInfo.maxLineLength = size.width;
+	sensorInfo.minFrameLength = size.height;
+	sensorInfo.maxFrameLength = size.height * maxFrameRate / minFrameRate;
+
+	ControlInfoMap ipaControls;
+	swIsp_ = std::make_unique<SoftwareIsp>(pipe(), RawFrameGenerator::kSensorModel,
+					       sensorInfo, rawGenerator_->controls(),
+					       &ipaControls);
+	if (!swIsp_->isValid()) {
+		LOG(Virtual, Error) << "Failed to create software ISP";
+		swIsp_.reset();
+		return -EINVAL;
+	}
+
+	if (swIsp_->formats(rawGenerator_->pixelFormat()).empty()) {
+		LOG(Virtual, Error)
+			<< "Raw format " << rawGenerator_->pixelFormat()
+			<< " not supported by the software ISP";
+		swIsp_.reset();
+		return -EINVAL;
+	}
+
+	swIsp_->inputBufferReady.connect(this, &VirtualCameraData::rawInputDone);
+	swIsp_->outputBufferReady.connect(this, &VirtualCameraData::rawOutputDone);
+	swIsp_->ispStatsReady.connect(this, &VirtualCameraData::ispStatsReady);
+	swIsp_->metadataReady.connect(this, &VirtualCameraData::ispMetadataReady);
+	swIsp_->setSensorControls.connect(this, &VirtualCameraData::setSensorControls);
+
+	/* Expose the controls handled by the IPA along with the camera controls. */
+	ControlInfoMap::Map ctrls(controlInfo_.begin(), controlInfo_.end());
+	ctrls.insert(ipaControls.begin(), ipaControls.end());
+	controlInfo_ = ControlInfoMap(std::move(ctrls), controls::controls);
+
+	return 0;
+}
+
+/*
+ * Find the smallest sensor resolution from which the software ISP can produce
+ * an output of the given size.
+ */
+std::optional<Size> VirtualCameraData::rawSensorSize(const Size &outputSize) const
+{
+	std::optional<Size> sensorSize;
+
+	for (const Resolution &resolution : config_.resolutions) {
+		SizeRange sizes = swIsp_->sizes(rawGenerator_->pixelFormat(),
+						resolution.size);
+		if (!sizes.contains(outputSize))
+			continue;
+
+		if (!sensorSize || resolution.size < *sensorSize)
+			sensorSize = resolution.size;
+	}
+
+	return sensorSize;
+}
+
+void VirtualCameraData::queueRawRequest(Request *request)
+{
+	rawFrameInfo_.try_emplace(request->sequence(),
+				  RawFrameInfo{ request, ControlList(), false, {} });
+
+	swIsp_->queueRequest(request->sequence(), request->controls());
+
+	/*
+	 * Wait for a raw buffer to be released by the software ISP if none is
+	 * available.
+	 */
+	if (availableRawBuffers_.empty()) {
+		pendingRawRequests_.push(request);
+		return;
+	}
+
+	FrameBuffer *rawBuffer = availableRawBuffers_.front();
+	availableRawBuffers_.pop();
+
+	worker_.invokeMethod(&VirtualFrameWorker::queueRequest,
+			     ConnectionTypeQueued, request, rawBuffer);
+}
+
+void VirtualCameraData::rawFrameReady(Request *request, FrameBuffer *rawBuffer,
+				      const ControlList &sensorControls)
+{
+	auto it = rawFrameInfo_.find(request->sequence());
+	ASSERT(it != rawFrameInfo_.end());
+
+	it->second.sensorControls = sensorControls;
+	it->second.queueTime = utils::clock::now();
+
+	int ret = swIsp_->queueBuffers(request->sequence(), rawBuffer,
+				       request->buffers());
+	if (ret < 0) {
+		LOG(Virtual, Error) << "Failed to queue buffers to the software ISP";
+		availableRawBuffers_.push(rawBuffer);
+		it->second.metadataProcessed = true;
+
+		for (auto const &[stream, buffer] : request->buffers()) {
+			buffer->_d()->cancel();
+			pipe()->completeBuffer(request, buffer);
+		}
+
+		tryCompleteRawRequest(request);
+	}
+}
+
+/*
+ * Cancel the requests waiting for a raw buffer, and complete all requests
+ * whose metadata will never be produced. This must be called once the worker
+ * and the software ISP have been stopped.
+ */
+void VirtualCameraData::cancelRawRequests()
+{
+	while (!pendingRawRequests_.empty()) {
+		Request *request = pendingRawRequests_.front();
+		pendingRawRequests_.pop();
+
+		for (auto const &[stream, buffer] : request->buffers()) {
+			buffer->_d()->cancel();
+			pipe()->completeBuffer(request, buffer);
+		}
+	}
+
+	for (auto it = rawFrameInfo_.begin(); it != rawFrameInfo_.end();) {
+		Request *request = it->second.request;
+		ASSERT(!request->hasPendingBuffers());
+
+		it = rawFrameInfo_.erase(it);
+		pipe()->completeRequest(request);
+	}
+}
+
+void VirtualCameraData::tryCompleteRawRequest(Request *request)
+{
+	if (request->hasPendingBuffers())
+		return;
+
+	auto it = rawFrameInfo_.find(request->sequence());
+	if (it == rawFrameInfo_.end() || !it->second.metadataProcessed)
+		return;
+
+	/*
+	 * Account for the time spent by the software ISP and IPA to process
+	 * the frame, from the raw buffer being queued to request completion.
+	 */
+	if (it->second.queueTime != utils::time_point{}) {
+		utils::Duration elapsed = utils::clock::now() - it->second.queueTime;
+
+		LOG(Virtual, Debug)
+			<< "Frame " << request->sequence() << " processed in "
+			<< elapsed.get<std::micro>() << "us";
+
+		ProcessingTime &stats = processingTime_;
+		if (!stats.frames || elapsed < stats.min)
+			stats.min = elapsed;
+		if (elapsed > stats.max)
+			stats.max = elapsed;
+		stats.total += elapsed;
+		stats.frames++;
+	}
+
+	rawFrameInfo_.erase(it);
+	pipe()->completeRequest(request);
+}
+
+void VirtualCameraData::logProcessingTime() const
+{
+	const ProcessingTime &stats = processingTime_;
+	if (!stats.frames)
+		return;
+
+	LOG(Virtual, Info)
+		<< "Camera " << config_.id << " processed " << stats.frames
+		<< " raw frame(s) in " << stats.min.get<std::micro>() << "us min, "
+		<< utils::Duration(stats.total / stats.frames).get<std::micro>()
+		<< "us avg, "
+		<< stats.max.get<std::micro>() << "us max";
+}
+
+void VirtualCameraData::rawInputDone(FrameBuffer *buffer)
+{
+	/* Hand the raw buffer to the next request waiting for one. */
+	if (!pendingRawRequests_.empty() && thread_.isRunning()) {
+		Request *request = pendingRawRequests_.front();
+		pendingRawRequests_.pop();
+
+		worker_.invokeMethod(&VirtualFrameWorker::queueRequest,
+				     ConnectionTypeQueued, request, buffer);
+		return;
+	}
+
+	availableRawBuffers_.push(buffer);
+}
+
+void VirtualCameraData::rawOutputDone(FrameBuffer *buffer)
+{
+	Request *request = buffer->request();
+
+	/* Metadata will not be produced for cancelled frames. */
+	if (buffer->metadata().status == FrameMetadata::FrameCancelled) {
+		auto it = rawFrameInfo_.find(request->sequence());
+		if (it != rawFrameInfo_.end())
+			it->second.metadataProcessed = true;
+	}
+
+	if (pipe()->completeBuffer(request, buffer))
+		tryCompleteRawRequest(request);
+}
+
+void VirtualCameraData::ispStatsReady(uint32_t frame, uint32_t bufferId)
+{
+	auto it = rawFrameInfo_.find(frame);
+	if (it == rawFrameInfo_.end())
+		return;
+
+	LIBCAMERA_TRACEPOINT_IPA_FRAME_BEGIN(virtual, processStats, frame);
+	swIsp_->processStats(frame, bufferId, it->second.sensorControls);
+}
+
+void VirtualCameraData::ispMetadataReady(uint32_t frame, const ControlList &metadata)
+{
+	LIBCAMERA_TRACEPOINT_IPA_FRAME_END(virtual, processStats, frame);
+
+	auto it = rawFrameInfo_.find(frame);
+	if (it == rawFrameInfo_.end())
+		return;
+
+	Request *request = it->second.request;
+	request->metadata().merge(metadata);
+	it->second.metadataProcessed = true;
+
+	tryCompleteRawRequest(request);
+}
+
+void VirtualCameraData::setSensorControls(const ControlList &sensorControls)
+{
+	if (!thread_.isRunning())
+		return;
+
+	worker_.invokeMethod(&VirtualFrameWorker::setSensorControls,
+			     ConnectionTypeQueued, sensorControls);
+}
+
+VirtualFrameWorker::VirtualFrameWorker(VirtualCameraData *data)
+	: data_(data), fastReplay_(false), sequence_(0), droppedFrames_(0)
+{
+}
+
+void VirtualFrameWorker::start(std::chrono::nanoseconds frameDuration)
+{
+	frameDuration_ = frameDuration;
+	sequence_ = 0;
+	droppedFrames_ = 0;
+
+	/*
+	 * Recorded frames replayed as fast as possible are produced as soon as
+	 * a request is queued, without pacing.
+	 */
+	fastReplay_ = data_->rawGenerator_ && data_->rawGenerator_->fastReplay();
+	if (fastReplay_)
+		return;
+
+	/*
+	 * The timer is created here to bind it to the worker thread, it can
+	 * then only be started and stopped from that thread.
+	 */
+	timer_ = std::make_unique<Timer>();
+	timer_->timeout.connect(this, &VirtualFrameWorker::frameTick);
+
+	deadline_ = utils::clock::now() + frameDuration_;
+	timer_->start(deadline_);
+}
+
+void VirtualFrameWorker::stop()
+{
+	timer_.reset();
+	fastReplay_ = false;
+}
+
+void VirtualFrameWorker::queueRequest(Request *request, FrameBuffer *rawBuffer)
+{
+	if (fastReplay_) {
+		processRequest(request, rawBuffer, currentTimestamp());
+		sequence_++;
+		return;
+	}
+
+	requests_.emplace(request, rawBuffer);
+}
+
+std::queue<std::pair<Request *, FrameBuffer *>> VirtualFrameWorker::takeRequests()
+{
+	return std::exchange(requests_, {});
+}
+
+void VirtualFrameWorker::setSensorControls(const ControlList &controls)
+{
+	data_->rawGenerator_->setSensorControls(controls);
+}
+
+void VirtualFrameWorker::frameTick()
+{
+	const uint64_t timestamp = currentTimestamp();
+
+	/*
+	 * Like a sensor, the virtual camera produces frames at a fixed rate
+	 * regardless of the application. If no request is queued when a frame
+	 * is produced the frame is dropped.
+	 */
+	if (requests_.empty()) {
+		LOG(Virtual, Debug)
+			<< "No request queued for frame " << sequence_
+			<< ", dropping";
+		droppedFrames_++;
+		skipFrame();
+	} else {
+		auto [request, rawBuffer] = requests_.front();
+		requests_.pop();
+
+		std::optional<std::chrono::nanoseconds> duration =
+			data_->frameDuration(request->controls());
+		if (duration)
+			frameDuration_ = *duration;
+
+		processRequest(request, rawBuffer, timestamp);
+	}
+
+	sequence_++;
+
+	/* Recorded frames are paced by their original timestamps. */
+	if (data_->rawGenerator_) {
+		std::optional<std::chrono::nanoseconds> interval =
+			data_->rawGenerator_->frameInterval();
+		if (interval)
+			frameDuration_ = *interval;
+	}
+
+	/*
+	 * Schedule the next frame. If frame generation took longer than the
+	 * frame duration, account for the frames that have been missed to keep
+	 * the sequence numbers consistent with the frame rate.
+	 */
+	deadline_ += frameDuration_;
+
+	const auto now = utils::clock::now();
+	if (deadline_ <= now) {
+		unsigned int missed = 0;
+
+		while (deadline_ <= now) {
+			skipFrame();
+			deadline_ += frameDuration_;
+			missed++;
+		}
+
+		LOG(Virtual, Debug)
+			<< "Frame generation too slow, " << missed
+			<< " frame(s) missed";
+
+		sequence_ += missed;
+		droppedFrames_ += missed;
+	}
+
+	timer_->start(deadline_);
+}
+
+/*
+ * Skip a frame that is not delivered to the application. Recorded frames are
+ * skipped as well to keep the replay in sync with the recorded timestamps, and
+ * the frame duration follows the recorded frame intervals.
+ */
+void VirtualFrameWorker::skipFrame()
+{
+	if (!data_->rawGenerator_)
+		return;
+
+	data_->rawGenerator_->skipFrame();
+
+	std::optional<std::chrono::nanoseconds> interval =
+		data_->rawGenerator_->frameInterval();
+	if (interval)
+		frameDuration_ = *interval;
+}
+
+void VirtualFrameWorker::processRequest(Request *request, FrameBuffer *rawBuffer,
+					uint64_t timestamp)
+{
+	request->metadata().set(controls::SensorTimestamp, timestamp);
+	request->metadata().set(controls::FrameDuration,
+				std::chrono::duration_cast<std::chrono::microseconds>(frameDuration_).count());
+
+	/*
+	 * Raw frames are captured to an internal buffer, and processed by the
+	 * software ISP to fill the request buffers.
+	 */
+	if (rawBuffer) {
+		FrameMetadata &fmd = rawBuffer->_d()->metadata();
+
+		fmd.status = FrameMetadata::Status::FrameSuccess;
+		fmd.sequence = sequence_;
+		fmd.timestamp = timestamp;
+		fmd.planes()[0].bytesused = rawBuffer->planes()[0].length;
+
+		if (data_->rawGenerator_->generateFrame(data_->rawSensorSize_, rawBuffer))
+			fmd.status = FrameMetadata::Status::FrameError;
+
+		/*
+		 * Record the sensor controls the frame has been captured with,
+		 * which are the recorded controls when replaying a capture.
+		 */
+		ControlList sensorControls = data_->rawGenerator_->sensorControls();
+
+		rawFrameDone.emit(request, rawBuffer, sensorControls);
+		return;
+	}
+
+	for (auto const &[stream, buffer] : request->buffers()) {
+		bool found = false;
+		/* map buffer and fill test patterns */
+		for (auto &streamConfig : data_->streamConfigs_) {
+			if (stream == &streamConfig.stream) {
+				FrameMetadata &fmd = buffer->_d()->metadata();
+
+				fmd.status = FrameMetadata::Status::FrameSuccess;
+				fmd.sequence = sequence_;
+				fmd.timestamp = timestamp;
+
+				for (const auto [i, p] : utils::enumerate(buffer->planes()))
+					fmd.planes()[i].bytesused = p.length;
+
+				found = true;
+
+				if (streamConfig.frameGenerator->generateFrame(
+					    stream->configuration().size, buffer))
+					fmd.status = FrameMetadata::Status::FrameError;
+				break;
+			}
+		}
+		ASSERT(found);
+	}
+
+	frameDone.emit(request);
 }
 
 VirtualCameraConfiguration::VirtualCameraConfiguration(VirtualCameraData *data)
@@ -145,6 +666,9 @@ CameraConfiguration::Status VirtualCameraConfiguration::validate()
 		return Invalid;
 	}
 
+	if (data_->isRaw())
+		return validateRaw();
+
 	/* Only one stream is supported */
 	if (config_.size() > VirtualCameraData::kMaxStream) {
 		config_.resize(VirtualCameraData::kMaxStream);
@@ -194,6 +718,46 @@ CameraConfiguration::Status VirtualCameraConfiguration::validate()
 	return status;
 }
 
+CameraConfiguration::Status VirtualCameraConfiguration::validateRaw()
+{
+	Status status = Valid;
+
+	/* The software ISP supports a single output stream. */
+	if (config_.size() > 1) {
+		config_.resize(1);
+		status = Adjusted;
+	}
+
+	StreamConfiguration &cfg = config_[0];
+	const PixelFormat rawFormat = data_->rawGenerator_->pixelFormat();
+
+	std::vector<PixelFormat> outputFormats = data_->swIsp_->formats(rawFormat);
+	if (std::find(outputFormats.begin(), outputFormats.end(), cfg.pixelFormat) ==
+	    outputFormats.end()) {
+		cfg.pixelFormat = outputFormats[0];
+		status = Adjusted;
+	}
+
+	if (!data_->rawSensorSize(cfg.size)) {
+		cfg.size = data_->swIsp_->sizes(rawFormat,
+						data_->config_.maxResolutionSize).max;
+		status = Adjusted;
+	}
+
+	if (status == Adjusted)
+		LOG(Virtual, Info)
+			<< "Stream configuration adjusted to " << cfg.toString();
+
+	std::tie(cfg.stride, cfg.frameSize) =
+		data_->swIsp_->strideAndFrameSize(cfg.pixelFormat, cfg.size);
+	if (cfg.frameSize == 0)
+		return Invalid;
+
+	cfg.bufferCount = VirtualCameraConfiguration::kBufferCount;
+
+	return status;
+}
+
 /* static */
 bool PipelineHandlerVirtual::created_ = false;
 
@@ -237,12 +801,29 @@ PipelineHandlerVirtual::generateConfiguration(Camera *camera,
 
 		std::map<PixelFormat, std::vector<SizeRange>> streamFormats;
 		PixelFormat pixelFormat = formats::NV12;
-		streamFormats[pixelFormat] = { { data->config_.minResolutionSize,
-						 data->config_.maxResolutionSize } };
+		Size size = data->config_.maxResolutionSize;
+
+		if (data->isRaw()) {
+			const PixelFormat rawFormat = data->rawGenerator_->pixelFormat();
+
+			for (const PixelFormat &format : data->swIsp_->formats(rawFormat)) {
+				for (const auto &resolution : data->config_.resolutions)
+					streamFormats[format].push_back(
+						data->swIsp_->sizes(rawFormat, resolution.size));
+			}
+
+			if (!streamFormats.count(pixelFormat))
+				pixelFormat = streamFormats.begin()->first;
+			size = data->swIsp_->sizes(rawFormat, size).max;
+		} else {
+			streamFormats[pixelFormat] = { { data->config_.minResolutionSize,
+							 data->config_.maxResolutionSize } };
+		}
+
 		StreamFormats formats(streamFormats);
 		StreamConfiguration cfg(formats);
 		cfg.pixelFormat = pixelFormat;
-		cfg.size = data->config_.maxResolutionSize;
+		cfg.size = size;
 		cfg.bufferCount = VirtualCameraConfiguration::kBufferCount;
 
 		config->addConfiguration(cfg);
@@ -257,6 +838,36 @@ int PipelineHandlerVirtual::configure(Camera *camera,
 				      CameraConfiguration *config)
 {
 	VirtualCameraData *data = cameraData(camera);
+
+	if (data->isRaw()) {
+		StreamConfiguration &cfg = config->at(0);
+
+		std::optional<Size> sensorSize = data->rawSensorSize(cfg.size);
+		if (!sensorSize)
+			return -EINVAL;
+
+		cfg.setStream(&data->streamConfigs_[0].stream);
+
+		/* Raw buffers can be reused if the sensor size is unchanged. */
+		if (*sensorSize != data->rawSensorSize_)
+			data->rawBuffers_.clear();
+
+		data->rawSensorSize_ = *sensorSize;
+		data->rawGenerator_->configure(*sensorSize);
+
+		StreamConfiguration inputCfg;
+		inputCfg.pixelFormat = data->rawGenerator_->pixelFormat();
+		inputCfg.size = *sensorSize;
+		inputCfg.stride = PixelFormatInfo::info(inputCfg.pixelFormat)
+					  .stride(sensorSize->width, 0);
+		inputCfg.bufferCount = VirtualCameraData::kRawBufferCount;
+
+		ipa::soft::IPAConfigInfo configInfo;
+		configInfo.sensorControls = data->rawGenerator_->controls();
+
+		return data->swIsp_->configure(inputCfg, { cfg }, configInfo);
+	}
+
 	for (auto [i, c] : utils::enumerate(*config)) {
 		c.setStream(&data->streamConfigs_[i].stream);
 		/* Start reading the images/generating test patterns */
@@ -266,14 +877,18 @@ int PipelineHandlerVirtual::configure(Camera *camera,
 	return 0;
 }
 
-int PipelineHandlerVirtual::exportFrameBuffers([[maybe_unused]] Camera *camera,
-					       Stream *stream,
+int PipelineHandlerVirtual::exportFrameBuffers(Camera *camera, Stream *stream,
 					       std::vector<std::unique_ptr<FrameBuffer>> *buffers)
 {
+	VirtualCameraData *data = cameraData(camera);
+	const StreamConfiguration &config = stream->configuration();
+
+	if (data->isRaw())
+		return data->swIsp_->exportBuffers(stream, config.bufferCount, buffers);
+
 	if (!dmaBufAllocator_.isValid())
 		return -ENOBUFS;
 
-	const StreamConfiguration &config = stream->configuration();
 	const PixelFormatInfo &info = PixelFormatInfo::info(config.pixelFormat);
 
 	std::vector<unsigned int> planeSizes;
@@ -283,58 +898,155 @@ int PipelineHandlerVirtual::exportFrameBuffers([[maybe_unused]] Camera *camera,
 	return dmaBufAllocator_.exportBuffers(config.bufferCount, planeSizes, buffers);
 }
 
-int PipelineHandlerVirtual::start([[maybe_unused]] Camera *camera,
-				  [[maybe_unused]] const ControlList *controls)
+int PipelineHandlerVirtual::start(Camera *camera, const ControlList *controls)
 {
 	VirtualCameraData *data = cameraData(camera);
 
-	for (auto &s : data->streamConfigs_)
-		s.seq = 0;
+	/*
+	 * Default to the highest frame rate supported by the camera, unless
+	 * the application specifies frame duration limits.
+	 */
+	std::chrono::nanoseconds frameDuration = std::chrono::microseconds(
+		data->controlInfo_.at(&controls::FrameDurationLimits).min().get<int64_t>());
+	if (controls) {
+		std::optional<std::chrono::nanoseconds> duration =
+			data->frameDuration(*controls);
+		if (duration)
+			frameDuration = *duration;
+	}
+
+	if (data->isRaw()) {
+		if (!dmaBufAllocator_.isValid())
+			return -ENOBUFS;
+
+		if (data->rawBuffers_.empty()) {
+			const PixelFormatInfo &info =
+				PixelFormatInfo::info(data->rawGenerator_->pixelFormat());
+			int ret = dmaBufAllocator_.exportBuffers(VirtualCameraData::kRawBufferCount,
+								 { info.frameSize(data->rawSensorSize_) },
+								 &data->rawBuffers_);
+			if (ret < 0)
+				return ret;
+		} else {
+			LOG(Virtual, Debug) << "Reusing raw buffers";
+		}
+
+		for (std::unique_ptr<FrameBuffer> &buffer : data->rawBuffers_)
+			data->availableRawBuffers_.push(buffer.get());
+
+		data->processingTime_ = {};
+
+		int ret = data->swIsp_->start();
+		if (ret) {
+			data->availableRawBuffers_ = {};
+			return ret;
+		}
+	}
+
+	data->thread_.start();
+	data->worker_.invokeMethod(&VirtualFrameWorker::start,
+				   ConnectionTypeQueued, frameDuration);
 
 	return 0;
 }
 
-void PipelineHandlerVirtual::stopDevice([[maybe_unused]] Camera *camera)
+void PipelineHandlerVirtual::stopDevice(Camera *camera)
 {
+	VirtualCameraData *data = cameraData(camera);
+
+	data->worker_.invokeMethod(&VirtualFrameWorker::stop,
+				   ConnectionTypeBlocking);
+	data->thread_.exit();
+	data->thread_.wait();
+
+	/* Complete the requests for the frames produced before stopping. */
+	Thread::current()->dispatchMessages(Message::Type::InvokeMessage, this);
+
+	auto requests = data->worker_.takeRequests();
+	while (!requests.empty()) {
+		auto [request, rawBuffer] = requests.front();
+		requests.pop();
+
+		for (auto const &[stream, buffer] : request->buffers()) {
+			buffer->_d()->cancel();
+			completeBuffer(request, buffer);
+		}
+
+		/* Raw requests are completed by cancelRawRequests(). */
+		if (rawBuffer)
+			data->availableRawBuffers_.push(rawBuffer);
+		else
+			completeRequest(request);
+	}
+
+	if (data->isRaw()) {
+		data->swIsp_->stop();
+		data->cancelRawRequests();
+
+		data->availableRawBuffers_ = {};
+
+		data->logProcessingTime();
+	}
+
+	if (data->worker_.droppedFrames())
+		LOG(Virtual, Info)
+			<< "Camera " << data->config_.id << " dropped "
+			<< data->worker_.droppedFrames()
+			<< " frame(s) due to lack of queued requests";
 }
 
-int PipelineHandlerVirtual::queueRequestDevice([[maybe_unused]] Camera *camera,
-					       Request *request)
+int PipelineHandlerVirtual::queueRequestDevice(Camera *camera, Request *request)
 {
 	VirtualCameraData *data = cameraData(camera);
-	const auto timestamp = currentTimestamp();
 
-	for (auto const &[stream, buffer] : request->buffers()) {
-		bool found = false;
-		/* map buffer and fill test patterns */
-		for (auto &streamConfig : data->streamConfigs_) {
-			if (stream == &streamConfig.stream) {
-				FrameMetadata &fmd = buffer->_d()->metadata();
+	if (data->isRaw()) {
+		data->queueRawRequest(request);
+		return 0;
+	}
 
-				fmd.status = FrameMetadata::Status::FrameSuccess;
-				fmd.sequence = streamConfig.seq++;
-				fmd.timestamp = timestamp;
+	data->worker_.invokeMethod(&VirtualFrameWorker::queueRequest,
+				   ConnectionTypeQueued, request, nullptr);
 
-				for (const auto [i, p] : utils::enumerate(buffer->planes()))
-					fmd.planes()[i].bytesused = p.length;
+	return 0;
+}
 
-				found = true;
+void PipelineHandlerVirtual::frameDone(Request *request)
+{
+	for (auto const &[stream, buffer] : request->buffers())
+		completeBuffer(request, buffer);
 
-				if (streamConfig.frameGenerator->generateFrame(
-					    stream->configuration().size, buffer))
-					fmd.status = FrameMetadata::Status::FrameError;
+	completeRequest(request);
+}
 
-				completeBuffer(request, buffer);
-				break;
-			}
-		}
-		ASSERT(found);
+void PipelineHandlerVirtual::rawFrameDone(Request *request, FrameBuffer *rawBuffer,
+					  const ControlList &sensorControls)
+{
+	VirtualCameraData *data = cameraData(request->_d()->camera());
+
+	data->rawFrameReady(request, rawBuffer, sensorControls);
+}
+
+std::vector<BufferPoolUsage>
+PipelineHandlerVirtual::internalBufferUsage(Camera *camera)
+{
+	VirtualCameraData *data = cameraData(camera);
+
+	if (data->rawBuffers_.empty())
+		return {};
+
+	size_t size = 0;
+	for (const std::unique_ptr<FrameBuffer> &buffer : data->rawBuffers_) {
+		for (const FrameBuffer::Plane &plane : buffer->planes())
+			size += plane.length;
 	}
 
-	request->metadata().set(controls::SensorTimestamp, timestamp);
-	completeRequest(request);
+	return { { "raw frames", dmaBufAllocator_.deviceNode(),
+		   static_cast<unsigned int>(data->rawBuffers_.size()), size } };
+}
 
-	return 0;
+void PipelineHandlerVirtual::releaseDevice(Camera *camera)
+{
+	cameraData(camera)->rawBuffers_.clear();
 }
 
 bool PipelineHandlerVirtual::match([[maybe_unused]] DeviceEnumerator *enumerator)
@@ -344,7 +1056,13 @@ bool PipelineHandlerVirtual::match([[maybe_unused]] DeviceEnumerator *enumerator
 
 	created_ = true;
 
-	std::string configFile = configurationFile("virtual", "virtual.yaml", true);
+	std::string configFile;
+	const char *configFromEnv = utils::secure_getenv("LIBCAMERA_VIRTUAL_CONFIG_FILE");
+	if (configFromEnv && *configFromEnv != '\0')
+		configFile = configFromEnv;
+	else
+		configFile = configurationFile("virtual", "virtual.yaml", true);
+
 	if (configFile.empty()) {
 		LOG(Virtual, Debug)
 			<< "Configuration file not found, skipping virtual cameras";
@@ -367,11 +1085,14 @@ bool PipelineHandlerVirtual::match([[maybe_unused]] DeviceEnumerator *enumerator
 	}
 
 	/* Configure and register cameras with configData */
+	bool registered = false;
 	for (auto &data : configData) {
 		std::set<Stream *> streams;
 		for (auto &streamConfig : data->streamConfigs_)
 			streams.insert(&streamConfig.stream);
 		std::string id = data->config_.id;
+		data->worker_.frameDone.connect(this, &PipelineHandlerVirtual::frameDone);
+		data->worker_.rawFrameDone.connect(this, &PipelineHandlerVirtual::rawFrameDone);
 		std::shared_ptr<Camera> camera = Camera::create(std::move(data), id, streams);
 
 		if (!initFrameGenerator(camera.get())) {
@@ -381,8 +1102,16 @@ bool PipelineHandlerVirtual::match([[maybe_unused]] DeviceEnumerator *enumerator
 		}
 
 		registerCamera(std::move(camera));
+		registered = true;
 	}
 
+	/*
+	 * Don't report a match without cameras, the pipeline handler would be
+	 * destroyed and created again endlessly.
+	 */
+	if (!registered)
+		return false;
+
 	resetCreated_ = true;
 
 	return true;
@@ -404,9 +1133,14 @@ bool PipelineHandlerVirtual::initFrameGenerator(Camera *camera)
 			   [&](ImageFrames &imageFrames) {
 				   for (auto &streamConfig : data->streamConfigs_)
 					   streamConfig.frameGenerator = ImageFrameGenerator::create(imageFrames);
-			   } },
+			   },
+			   [&](RawFrames &) {} },
 		   frame);
 
+	/* Raw frames are processed by the software ISP to produce the streams. */
+	if (auto *rawFrames = std::get_if<RawFrames>(&frame))
+		return data->initRaw(*rawFrames) == 0;
+
 	for (auto &streamConfig : data->streamConfigs_)
 		if (!streamConfig.frameGenerator)
 			return false;
@@ -7,28 +7,84 @@
 
 #pragma once
 
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <stdint.h>
 #include <string>
 #include <variant>
 #include <vector>
 
+#include <libcamera/base/object.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/controls.h>
 #include <libcamera/geometry.h>
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/software_isp/software_isp.h"
 
 #include "frame_generator.h"
 #include "image_frame_generator.h"
+#include "raw_frame_generator.h"
 #include "test_pattern_generator.h"
 
 namespace libcamera {
 
-using VirtualFrame = std::variant<TestPattern, ImageFrames>;
+using VirtualFrame = std::variant<TestPattern, ImageFrames, RawFrames>;
+
+class FrameBuffer;
+class Request;
+class VirtualCameraData;
+
+class VirtualFrameWorker : public Object
+{
+public:
+	VirtualFrameWorker(VirtualCameraData *data);
+
+	void start(std::chrono::nanoseconds frameDuration);
+	void stop();
+
+	void queueRequest(Request *request, FrameBuffer *rawBuffer);
+	std::queue<std::pair<Request *, FrameBuffer *>> takeRequests();
+
+	void setSensorControls(const ControlList &controls);
+
+	uint64_t droppedFrames() const { return droppedFrames_; }
+
+	Signal<Request *> frameDone;
+	Signal<Request *, FrameBuffer *, const ControlList &> rawFrameDone;
+
+private:
+	void frameTick();
+	void skipFrame();
+	void processRequest(Request *request, FrameBuffer *rawBuffer,
+			    uint64_t timestamp);
+
+	VirtualCameraData *data_;
+
+	std::unique_ptr<Timer> timer_;
+	std::chrono::steady_clock::time_point deadline_;
+	std::chrono::nanoseconds frameDuration_;
+	bool fastReplay_;
+
+	std::queue<std::pair<Request *, FrameBuffer *>> requests_;
+	uint32_t sequence_;
+	uint64_t droppedFrames_;
+};
 
 class VirtualCameraData : public Camera::Private
 {
 public:
 	const static unsigned int kMaxStream = 3;
+	static constexpr unsigned int kRawBufferCount = 4;
 
 	struct Resolution {
 		Size size;
@@ -37,7 +93,6 @@ public:
 	struct StreamConfig {
 		Stream stream;
 		std::unique_ptr<FrameGenerator> frameGenerator;
-		unsigned int seq = 0;
 	};
 	/* The config file is parsed to the Configuration struct */
 	struct Configuration {
@@ -54,9 +109,62 @@ public:
 
 	~VirtualCameraData() = default;
 
+	std::optional<std::chrono::nanoseconds> frameDuration(const ControlList &controls) const;
+
+	bool isRaw() const { return !!swIsp_; }
+	int initRaw(const RawFrames &rawFrames);
+	std::optional<Size> rawSensorSize(const Size &outputSize) const;
+
+	void queueRawRequest(Request *request);
+	void rawFrameReady(Request *request, FrameBuffer *rawBuffer,
+			   const ControlList &sensorControls);
+	void cancelRawRequests();
+	void logProcessingTime() const;
+
 	Configuration config_;
 
 	std::vector<StreamConfig> streamConfigs_;
+
+	Thread thread_;
+	VirtualFrameWorker worker_;
+
+	/* Raw Bayer sensor emulation, processed by the software ISP */
+	struct RawFrameInfo {
+		Request *request;
+		ControlList sensorControls;
+		bool metadataProcessed;
+		utils::time_point queueTime;
+	};
+
+	struct ProcessingTime {
+		unsigned int frames;
+		utils::Duration total;
+		utils::Duration min;
+		utils::Duration max;
+	};
+
+	std::unique_ptr<RawFrameGenerator> rawGenerator_;
+	std::unique_ptr<SoftwareIsp> swIsp_;
+	Size rawSensorSize_;
+
+	/*
+	 * Raw buffers are kept allocated when the camera stops, and freed when
+	 * the sensor size changes or the camera is released.
+	 */
+	std::vector<std::unique_ptr<FrameBuffer>> rawBuffers_;
+	std::queue<FrameBuffer *> availableRawBuffers_;
+	std::queue<Request *> pendingRawRequests_;
+	std::map<uint32_t, RawFrameInfo> rawFrameInfo_;
+	ProcessingTime processingTime_;
+
+private:
+	void tryCompleteRawRequest(Request *request);
+
+	void rawInputDone(FrameBuffer *buffer);
+	void rawOutputDone(FrameBuffer *buffer);
+	void ispStatsReady(uint32_t frame, uint32_t bufferId);
+	void ispMetadataReady(uint32_t frame, const ControlList &metadata);
+	void setSensorControls(const ControlList &sensorControls);
 };
 
 } /* namespace libcamera */
@@ -7,6 +7,7 @@
 
 #include "libcamera/internal/pipeline_handler.h"
 
+#include <algorithm>
 #include <chrono>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
@@ -16,6 +17,7 @@
 #include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
 #include <libcamera/framebuffer.h>
 #include <libcamera/property_ids.h>
 
@@ -62,13 +64,25 @@ LOG_DEFINE_CATEGORY(Pipeline)
 /**
  * \brief Construct a PipelineHandler instance
  * \param[in] manager The camera manager
+ * \param[in] maxQueuedRequestsDevice The maximum number of requests queued to
+ * the device
+ *
+ * The \a maxQueuedRequestsDevice parameter limits the number of requests that
+ * the pipeline handler processes at a time for a camera, and thus how many
+ * frames ahead of the capture it prepares. Pipeline handlers that bound the
+ * number of frames in flight, for instance by the number of internal buffers
+ * or by the depth of the IPA frame context queue, shall set it accordingly.
+ * Additional requests queued by the application are held until a request
+ * completes.
  *
  * In order to honour the std::enable_shared_from_this<> contract,
  * PipelineHandler instances shall never be constructed manually, but always
  * through the PipelineHandlerFactoryBase::create() function.
  */
-PipelineHandler::PipelineHandler(CameraManager *manager)
-	: manager_(manager), useCount_(0)
+PipelineHandler::PipelineHandler(CameraManager *manager,
+				 unsigned int maxQueuedRequestsDevice)
+	: manager_(manager), maxQueuedRequestsDevice_(maxQueuedRequestsDevice),
+	  useCount_(0)
 {
 }
 
@@ -360,13 +374,20 @@ void PipelineHandler::unlockMediaDevices()
  */
 void PipelineHandler::stop(Camera *camera)
 {
+	/*
+	 * Take the waiting requests out of the queue to prevent them from
+	 * being queued to the device when the queued requests complete.
+	 */
+	std::queue<Request *> waitingRequests;
+	waitingRequests.swap(waitingRequests_);
+
 	/* Stop the pipeline handler and let the queued requests complete. */
 	stopDevice(camera);
 
 	/* Cancel and signal as complete all waiting requests. */
-	while (!waitingRequests_.empty()) {
-		Request *request = waitingRequests_.front();
-		waitingRequests_.pop();
+	while (!waitingRequests.empty()) {
+		Request *request = waitingRequests.front();
+		waitingRequests.pop();
 		cancelRequest(request);
 	}
 
@@ -375,6 +396,13 @@ void PipelineHandler::stop(Camera *camera)
 	ASSERT(data->queuedRequests_.empty());
 
 	data->requestSequence_ = 0;
+
+	LOG(Pipeline, Debug)
+		<< camera->id() << ": peak of "
+		<< data->bufferUsage_.maxQueuedRequests
+		<< " requests queued to the device";
+
+	data->bufferUsage_ = {};
 }
 
 /**
@@ -400,6 +428,24 @@ bool PipelineHandler::hasPendingRequests(const Camera *camera) const
 	return !camera->_d()->queuedRequests_.empty();
 }
 
+/**
+ * \brief Retrieve the memory usage of the internal buffers of a camera
+ * \param[in] camera The camera to retrieve the internal buffers usage for
+ *
+ * Pipeline handlers that allocate internal buffers shall override this function
+ * to report them, grouped by pool. The default implementation reports no
+ * internal buffer.
+ *
+ * \context This function is called from the CameraManager thread.
+ *
+ * \return The list of internal buffer pools currently allocated for \a camera
+ */
+std::vector<BufferPoolUsage>
+PipelineHandler::internalBufferUsage([[maybe_unused]] Camera *camera)
+{
+	return {};
+}
+
 /**
  * \fn PipelineHandler::registerRequest()
  * \brief Register a request for use by the pipeline handler
@@ -429,7 +475,8 @@ void PipelineHandler::registerRequest(Request *request)
  *
  * The queue of waiting requests is iterated and all prepared requests are
  * passed to the pipeline handler in the same order they have been queued by
- * calling this function.
+ * calling this function, as long as the number of requests queued to the
+ * device stays below the limit set at construction time.
  *
  * If a Request fails during the preparation phase or if the pipeline handler
  * fails in queuing the request to the hardware the request is cancelled.
@@ -460,6 +507,10 @@ void PipelineHandler::doQueueRequest(Request *request)
 	Camera::Private *data = camera->_d();
 	data->queuedRequests_.push_back(request);
 
+	data->bufferUsage_.maxQueuedRequests =
+		std::max<unsigned int>(data->bufferUsage_.maxQueuedRequests,
+				       data->queuedRequests_.size());
+
 	request->_d()->sequence_ = data->requestSequence_++;
 
 	if (request->_d()->cancelled_) {
@@ -476,7 +527,7 @@ void PipelineHandler::doQueueRequest(Request *request)
  * \brief Queue prepared requests to the device
  *
  * Iterate the list of waiting requests and queue them to the device one
- * by one if they have been prepared.
+ * by one if they have been prepared and the device queue isn't full.
  */
 void PipelineHandler::doQueueRequests()
 {
@@ -485,8 +536,16 @@ void PipelineHandler::doQueueRequests()
 		if (!request->_d()->prepared_)
 			break;
 
-		doQueueRequest(request);
+		Camera::Private *data = request->_d()->camera()->_d();
+		if (data->queuedRequests_.size() >= maxQueuedRequestsDevice_)
+			break;
+
+		/*
+		 * Dequeue the request before queuing it to the device, as
+		 * completing it may recurse into this function.
+		 */
 		waitingRequests_.pop();
+		doQueueRequest(request);
 	}
 }
 
@@ -543,12 +602,28 @@ bool PipelineHandler::completeBuffer(Request *request, FrameBuffer *buffer)
  * submission order, the pipeline handler may call it on any complete request
  * without any ordering constraint.
  *
+ * If the request reports a controls::SensorTimestamp in its metadata, the
+ * controls::PipelineLatency metadata is also set to the time elapsed since
+ * that timestamp, and the controls::RecommendedBufferCount metadata is set
+ * based on the latency and frame interval measured since the camera started.
+ *
  * \context This function shall be called from the CameraManager thread.
  */
 void PipelineHandler::completeRequest(Request *request)
 {
 	Camera *camera = request->_d()->camera();
 
+	const auto timestamp = request->metadata().get(controls::SensorTimestamp);
+	if (timestamp && request->status() == Request::RequestPending) {
+		/* V4L2 buffer timestamps use the monotonic clock. */
+		int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			utils::clock::now().time_since_epoch()).count();
+		request->metadata().set(controls::PipelineLatency,
+					now - *timestamp);
+
+		updateBufferUsage(request, *timestamp, now - *timestamp);
+	}
+
 	request->_d()->complete();
 
 	Camera::Private *data = camera->_d();
@@ -562,6 +637,65 @@ void PipelineHandler::completeRequest(Request *request)
 		data->queuedRequests_.pop_front();
 		camera->requestComplete(req);
 	}
+
+	/* Queue the requests held back by the device queue limit. */
+	doQueueRequests();
+}
+
+/**
+ * \brief Update the buffer usage of a camera with a completed request
+ * \param[in] request The completed request
+ * \param[in] timestamp The sensor timestamp of the request
+ * \param[in] latency The pipeline latency of the request
+ *
+ * Each buffer stays in the pipeline from the time it is queued for the next
+ * frame until the request completes, for up to the longest latency measured
+ * from the start of the frame. The number of buffers needed to capture
+ * without drops is thus the number of frame intervals covered by that
+ * latency, plus the buffer queued for the next frame and one buffer held by
+ * the application.
+ *
+ * The frame interval is smoothed with an exponential moving average, so that
+ * a single early or late frame doesn't skew the recommendation for the rest
+ * of the capture session.
+ *
+ * Pipeline handlers that bound the number of requests queued to the device
+ * prepare that many frames ahead of the sensor, for instance to apply controls
+ * in time, and consume as many buffers at once. The recommendation is then
+ * never lower than the peak number of requests queued to the device, up to
+ * that bound. Other pipeline handlers queue all the requests of the
+ * application to the device, and the peak only reflects how many buffers the
+ * application has allocated, so it isn't taken into account.
+ */
+void PipelineHandler::updateBufferUsage(Request *request, int64_t timestamp,
+					int64_t latency)
+{
+	Camera::Private::BufferUsage &usage =
+		request->_d()->camera()->_d()->bufferUsage_;
+
+	if (usage.lastTimestamp && timestamp > usage.lastTimestamp) {
+		int64_t interval = timestamp - usage.lastTimestamp;
+		if (!usage.frameInterval)
+			usage.frameInterval = interval;
+		else
+			usage.frameInterval += (interval - usage.frameInterval) / 8;
+	}
+
+	usage.lastTimestamp = timestamp;
+	usage.maxLatency = std::max(usage.maxLatency, latency);
+
+	if (!usage.frameInterval)
+		return;
+
+	int64_t frames = (usage.maxLatency + usage.frameInterval - 1) /
+			 usage.frameInterval;
+	int64_t count = frames + 2;
+	if (maxQueuedRequestsDevice_ < kDefaultMaxQueuedRequestsDevice)
+		count = std::max<int64_t>(count, std::min(maxQueuedRequestsDevice_,
+							  usage.maxQueuedRequests));
+
+	request->metadata().set(controls::RecommendedBufferCount,
+				static_cast<int32_t>(count));
 }
 
 /**
@@ -776,6 +910,13 @@ void PipelineHandler::disconnect()
  * \return The CameraManager for this pipeline handler
  */
 
+/**
+ * \fn PipelineHandler::maxQueuedRequestsDevice()
+ * \brief Retrieve the maximum number of requests queued to the device
+ * \context This function is \threadsafe.
+ * \return The maximum number of requests queued to the device at a time
+ */
+
 /**
  * \class PipelineHandlerFactoryBase
  * \brief Base class for pipeline handler factories
@@ -78,6 +78,50 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor,
 	: dmaHeap_(DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap |
 		   DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
 		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf)
+{
+	IPACameraSensorInfo sensorInfo{};
+	int ret = sensor->sensorInfo(&sensorInfo);
+	if (ret) {
+		LOG(SoftwareIsp, Error) << "Camera sensor information not available";
+		return;
+	}
+
+	init(pipe, sensor->model(), sensorInfo, sensor->controls(), ipaControls);
+}
+
+/**
+ * \brief Constructs SoftwareIsp object for a sensor not backed by a
+ * CameraSensor
+ * \param[in] pipe The pipeline handler in use
+ * \param[in] sensorModel The model name of the sensor
+ * \param[in] sensorInfo The sensor information passed to the IPA
+ * \param[in] sensorControls The sensor controls passed to the IPA
+ * \param[out] ipaControls The IPA controls to update
+ *
+ * This constructor allows pipeline handlers that emulate a camera sensor, such
+ * as the virtual pipeline handler, to use the software ISP.
+ */
+SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const std::string &sensorModel,
+			 const IPACameraSensorInfo &sensorInfo,
+			 const ControlInfoMap &sensorControls,
+			 ControlInfoMap *ipaControls)
+	: dmaHeap_(DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap |
+		   DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
+		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf)
+{
+	init(pipe, sensorModel, sensorInfo, sensorControls, ipaControls);
+}
+
+SoftwareIsp::~SoftwareIsp()
+{
+	/* make sure to destroy the DebayerCpu before the ispWorkerThread_ is gone */
+	debayer_.reset();
+}
+
+void SoftwareIsp::init(PipelineHandler *pipe, const std::string &sensorModel,
+		       const IPACameraSensorInfo &sensorInfo,
+		       const ControlInfoMap &sensorControls,
+		       ControlInfoMap *ipaControls)
 {
 	/*
 	 * debayerParams_ must be initialized because the initial value is used for
@@ -118,7 +162,11 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor,
 	debayer_->inputBufferReady.connect(this, &SoftwareIsp::inputReady);
 	debayer_->outputBufferReady.connect(this, &SoftwareIsp::outputReady);
 
-	ipa_ = IPAManager::createIPA<ipa::soft::IPAProxySoft>(pipe, 0, 0);
+	/*
+	 * The software ISP IPA module is registered for the simple pipeline
+	 * handler, but serves all pipeline handlers using the software ISP.
+	 */
+	ipa_ = IPAManager::createIPA<ipa::soft::IPAProxySoft>(pipe, "simple", 0, 0);
 	if (!ipa_) {
 		LOG(SoftwareIsp, Error)
 			<< "Creating IPA for software ISP failed";
@@ -131,22 +179,15 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor,
 	 * isn't found, fall back to the 'uncalibrated' file.
 	 */
 	std::string ipaTuningFile =
-		ipa_->configurationFile(sensor->model() + ".yaml", "uncalibrated.yaml");
-
-	IPACameraSensorInfo sensorInfo{};
-	int ret = sensor->sensorInfo(&sensorInfo);
-	if (ret) {
-		LOG(SoftwareIsp, Error) << "Camera sensor information not available";
-		return;
-	}
-
-	ret = ipa_->init(IPASettings{ ipaTuningFile, sensor->model() },
-			 debayer_->getStatsFD(),
-			 sharedParams_.fd(),
-			 sensorInfo,
-			 sensor->controls(),
-			 ipaControls,
-			 &ccmEnabled_);
+		ipa_->configurationFile(sensorModel + ".yaml", "uncalibrated.yaml");
+
+	int ret = ipa_->init(IPASettings{ ipaTuningFile, sensorModel },
+			     debayer_->getStatsFD(),
+			     sharedParams_.fd(),
+			     sensorInfo,
+			     sensorControls,
+			     ipaControls,
+			     &ccmEnabled_);
 	if (ret) {
 		LOG(SoftwareIsp, Error) << "IPA init failed";
 		debayer_.reset();
@@ -163,12 +204,6 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor,
 	debayer_->moveToThread(&ispWorkerThread_);
 }
 
-SoftwareIsp::~SoftwareIsp()
-{
-	/* make sure to destroy the DebayerCpu before the ispWorkerThread_ is gone */
-	debayer_.reset();
-}
-
 /**
  * \fn int SoftwareIsp::loadConfiguration([[maybe_unused]] const std::string &filename)
  * \brief Load a configuration from a file
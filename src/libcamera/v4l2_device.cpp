@@ -25,6 +25,7 @@
 
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/sysfs.h"
+#include "libcamera/internal/tracepoints.h"
 
 /**
  * \file v4l2_device.h
@@ -278,6 +279,8 @@ ControlList V4L2Device::getControls(const std::vector<uint32_t> &ids)
  * stores the values actually applied to the device in the corresponding
  * \a ctrls entry.
  *
+ * All controls are written with a single VIDIOC_S_EXT_CTRLS call.
+ *
  * If any control in \a ctrls is not supported by the device, is disabled (i.e.
  * has the V4L2_CTRL_FLAG_DISABLED flag set), is read-only, if any other error
  * occurs during validation of the requested controls, no control is written and
@@ -848,6 +851,9 @@ void V4L2Device::eventAvailable()
 		return;
 	}
 
+	LIBCAMERA_TRACEPOINT(v4l2_frame_start, deviceNode_.c_str(),
+			     event.u.frame_sync.frame_sequence);
+
 	frameStart.emit(event.u.frame_sync.frame_sequence);
 }
 
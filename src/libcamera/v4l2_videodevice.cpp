@@ -30,6 +30,7 @@
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/media_object.h"
+#include "libcamera/internal/tracepoints.h"
 
 /**
  * \file v4l2_videodevice.h
@@ -161,6 +162,13 @@ LOG_DECLARE_CATEGORY(V4L2)
  * index associations to help selecting V4L2 buffers. It tracks, for every
  * entry, if the V4L2 buffer is in use, and offers lookup of the best free V4L2
  * buffer for a set of dmabufs.
+ *
+ * Lookups are performed in constant time. Entries are indexed by the file
+ * descriptor of the first dmabuf plane, and free entries are kept in a list
+ * sorted by last use to select the least recently used entry on cache misses.
+ * The number of cache hits and misses can be queried with hits() and misses(),
+ * and through V4L2VideoDevice::bufferCacheHits() and
+ * V4L2VideoDevice::bufferCacheMisses() for the cache of a video device.
  */
 
 /**
@@ -172,9 +180,12 @@ LOG_DECLARE_CATEGORY(V4L2)
  * buffer import, with buffers added to the cache as they are queued.
  */
 V4L2BufferCache::V4L2BufferCache(unsigned int numEntries)
-	: lastUsedCounter_(1), missCounter_(0)
+	: lastUsedCounter_(1), hitCounter_(0), missCounter_(0)
 {
 	cache_.resize(numEntries);
+
+	for (unsigned int index = 0; index < numEntries; index++)
+		cache_[index].lru_ = lru_.insert(lru_.end(), index);
 }
 
 /**
@@ -186,18 +197,25 @@ V4L2BufferCache::V4L2BufferCache(unsigned int numEntries)
  * allocated.
  */
 V4L2BufferCache::V4L2BufferCache(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
-	: lastUsedCounter_(1), missCounter_(0)
+	: lastUsedCounter_(1), hitCounter_(0), missCounter_(0)
 {
-	for (const std::unique_ptr<FrameBuffer> &buffer : buffers)
-		cache_.emplace_back(true,
-				    lastUsedCounter_++,
-				    *buffer.get());
+	for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+		unsigned int index = cache_.size();
+		Entry &entry = cache_.emplace_back(true,
+						   lastUsedCounter_++,
+						   *buffer.get());
+
+		entry.lru_ = lru_.insert(lru_.end(), index);
+		index_[entry.key()] = index;
+	}
 }
 
 V4L2BufferCache::~V4L2BufferCache()
 {
 	if (missCounter_ > cache_.size())
-		LOG(V4L2, Debug) << "Cache misses: " << missCounter_;
+		LOG(V4L2, Debug)
+			<< "Cache hits: " << hitCounter_
+			<< ", misses: " << missCounter_;
 }
 
 /**
@@ -205,12 +223,7 @@ V4L2BufferCache::~V4L2BufferCache()
  */
 bool V4L2BufferCache::isEmpty() const
 {
-	for (auto const &entry : cache_) {
-		if (!entry.free_)
-			return false;
-	}
-
-	return true;
+	return lru_.size() == cache_.size();
 }
 
 /**
@@ -220,46 +233,57 @@ bool V4L2BufferCache::isEmpty() const
  * Find the best V4L2 buffer index to be used for the FrameBuffer \a buffer
  * based on previous mappings of frame buffers to V4L2 buffers. If a free V4L2
  * buffer previously used with the same dmabufs as \a buffer is found in the
- * cache, return its index. Otherwise return the index of the first free V4L2
- * buffer and record its association with the dmabufs of \a buffer.
+ * cache, return its index. Otherwise return the index of the least recently
+ * used free V4L2 buffer and record its association with the dmabufs of
+ * \a buffer.
  *
  * \return The index of the best V4L2 buffer, or -ENOENT if no free V4L2 buffer
  * is available
  */
 int V4L2BufferCache::get(const FrameBuffer &buffer)
 {
+	const std::vector<FrameBuffer::Plane> &planes = buffer.planes();
+	int key = planes.empty() ? -1 : planes[0].fd.get();
 	bool hit = false;
-	int use = -1;
-	uint64_t oldest = UINT64_MAX;
+	unsigned int use;
 
-	for (unsigned int index = 0; index < cache_.size(); index++) {
-		const Entry &entry = cache_[index];
-
-		if (!entry.free_)
-			continue;
-
-		/* Try to find a cache hit by comparing the planes. */
-		if (entry == buffer) {
+	/* Try to find a cache hit by comparing the planes. */
+	auto it = index_.find(key);
+	if (it != index_.end()) {
+		const Entry &entry = cache_[it->second];
+		if (entry.free_ && entry == buffer) {
 			hit = true;
-			use = index;
-			break;
-		}
-
-		if (entry.lastUsed_ < oldest) {
-			use = index;
-			oldest = entry.lastUsed_;
+			use = it->second;
 		}
 	}
 
-	if (!hit)
+	if (hit) {
+		hitCounter_++;
+	} else {
 		missCounter_++;
 
-	if (use < 0)
-		return -ENOENT;
+		if (lru_.empty())
+			return -ENOENT;
+
+		use = lru_.front();
 
-	cache_[use] = Entry(false,
-			    lastUsedCounter_++,
-			    buffer);
+		/* Drop the index of the dmabufs previously held by the entry. */
+		auto old = index_.find(cache_[use].key());
+		if (old != index_.end() && old->second == use)
+			index_.erase(old);
+
+		auto node = cache_[use].lru_;
+		cache_[use] = Entry(true, 0, buffer);
+		cache_[use].lru_ = node;
+		index_[key] = use;
+	}
+
+	Entry &entry = cache_[use];
+	entry.free_ = false;
+	entry.lastUsed_ = lastUsedCounter_++;
+
+	/* Move the list node to avoid any memory allocation. */
+	used_.splice(used_.end(), lru_, entry.lru_);
 
 	return use;
 }
@@ -271,9 +295,43 @@ int V4L2BufferCache::get(const FrameBuffer &buffer)
 void V4L2BufferCache::put(unsigned int index)
 {
 	ASSERT(index < cache_.size());
-	cache_[index].free_ = true;
+
+	Entry &entry = cache_[index];
+	if (entry.free_)
+		return;
+
+	entry.free_ = true;
+
+	/*
+	 * Keep the free list sorted by last use. Buffers are usually released
+	 * in the order they have been queued, so the search stops immediately
+	 * in the common case.
+	 */
+	auto pos = lru_.end();
+	while (pos != lru_.begin()) {
+		auto prev = std::prev(pos);
+		if (cache_[*prev].lastUsed_ <= entry.lastUsed_)
+			break;
+		pos = prev;
+	}
+
+	lru_.splice(pos, used_, entry.lru_);
 }
 
+/**
+ * \fn V4L2BufferCache::hits()
+ * \brief Retrieve the number of cache hits
+ * \return The number of lookups that found a V4L2 buffer previously used with
+ * the same dmabufs
+ */
+
+/**
+ * \fn V4L2BufferCache::misses()
+ * \brief Retrieve the number of cache misses
+ * \return The number of lookups that required associating new dmabufs with a
+ * V4L2 buffer
+ */
+
 V4L2BufferCache::Entry::Entry()
 	: free_(true), lastUsed_(0)
 {
@@ -1625,6 +1683,42 @@ int V4L2VideoDevice::releaseBuffers()
 	return requestBuffers(0, memoryType_);
 }
 
+/**
+ * \brief Retrieve the number of V4L2 buffer cache hits
+ *
+ * Buffers queued with queueBuffer() are assigned a V4L2 buffer through a
+ * cache of previous associations between dmabufs and V4L2 buffers. A cache hit
+ * means that the buffer was queued to a V4L2 buffer previously used with the
+ * same dmabufs, avoiding a remapping in the kernel.
+ *
+ * The counter is reset when buffers are allocated or imported.
+ *
+ * \return The number of V4L2 buffer cache hits since buffers were last
+ * allocated or imported, or 0 if no buffers are allocated or imported
+ */
+uint64_t V4L2VideoDevice::bufferCacheHits() const
+{
+	return cache_ ? cache_->hits() : 0;
+}
+
+/**
+ * \brief Retrieve the number of V4L2 buffer cache misses
+ *
+ * A cache miss occurs when a buffer queued with queueBuffer() is assigned a
+ * V4L2 buffer that was last used with different dmabufs. Frequent misses with
+ * imported buffers indicate that more buffers are cycled through the device
+ * than it has V4L2 buffers.
+ *
+ * The counter is reset when buffers are allocated or imported.
+ *
+ * \return The number of V4L2 buffer cache misses since buffers were last
+ * allocated or imported, or 0 if no buffers are allocated or imported
+ */
+uint64_t V4L2VideoDevice::bufferCacheMisses() const
+{
+	return cache_ ? cache_->misses() : 0;
+}
+
 /**
  * \brief Queue a buffer to the video device if possible
  * \param[in] buffer The buffer to be queued
@@ -1677,20 +1771,45 @@ int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
 /**
  * \brief Slot to handle completed buffer events from the V4L2 video device
  *
- * When this slot is called, a Buffer has become available from the device, and
- * will be emitted through the bufferReady Signal.
+ * When this slot is called, one or more Buffers have become available from the
+ * device. All ready buffers are dequeued, until the device reports that no
+ * more buffer is available, and emitted in order through the bufferReady
+ * Signal. This avoids going through a full event loop cycle for every buffer
+ * when the event loop falls behind.
  *
  * For Capture video devices the FrameBuffer will contain valid data.
  * For Output video devices the FrameBuffer can be considered empty.
  */
 void V4L2VideoDevice::bufferAvailable()
 {
-	FrameBuffer *buffer = dequeueBuffer();
-	if (!buffer)
+	unsigned int count = 0;
+
+	/*
+	 * The bufferReady handlers may stop streaming, in which case all the
+	 * queued buffers get cancelled and the loop terminates.
+	 */
+	while (!queuedBuffers_.empty()) {
+		FrameBuffer *buffer = dequeueBuffer();
+		if (!buffer)
+			break;
+
+		count++;
+
+		LIBCAMERA_TRACEPOINT(v4l2_buffer_dequeue, deviceNode().c_str(),
+				     buffer);
+
+		/* Notify anyone listening to the device. */
+		bufferReady.emit(buffer);
+	}
+
+	if (!count)
 		return;
 
-	/* Notify anyone listening to the device. */
-	bufferReady.emit(buffer);
+	LIBCAMERA_TRACEPOINT(v4l2_buffers_dequeued, deviceNode().c_str(), count);
+
+	dequeueStats_.wakeups++;
+	dequeueStats_.buffers += count;
+	dequeueStats_.maxBuffers = std::max(dequeueStats_.maxBuffers, count);
 }
 
 /**
@@ -1698,6 +1817,8 @@ void V4L2VideoDevice::bufferAvailable()
  *
  * This function dequeues the next available buffer from the device. If no
  * buffer is available to be dequeued it will return nullptr immediately.
+ * As the device is opened in non-blocking mode, this is not considered as an
+ * error.
  *
  * Once a buffer is dequeued from the device, this function may also enqueue
  * a buffer that has been placed in the pending queue (due to reaching the V4L2
@@ -1723,6 +1844,9 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 	}
 
 	ret = ioctl(VIDIOC_DQBUF, &buf);
+	if (ret == -EAGAIN)
+		return nullptr;
+
 	if (ret < 0) {
 		LOG(V4L2, Error)
 			<< "Failed to dequeue buffer: " << strerror(-ret);
@@ -2027,6 +2151,9 @@ int V4L2VideoDevice::queueToDevice(FrameBuffer *buffer)
 
 	queuedBuffers_[buf.index] = buffer;
 
+	LIBCAMERA_TRACEPOINT(v4l2_buffer_queue, deviceNode().c_str(), buffer,
+			     buf.index);
+
 	return 0;
 }
 
@@ -2044,6 +2171,7 @@ int V4L2VideoDevice::streamOn()
 	int ret;
 
 	firstFrame_.reset();
+	dequeueStats_ = {};
 
 	ret = ioctl(VIDIOC_STREAMON, &bufferType_);
 	if (ret < 0) {
@@ -2107,6 +2235,12 @@ int V4L2VideoDevice::streamOff()
 	fdBufferNotifier_->setEnabled(false);
 	state_ = State::Stopped;
 
+	if (dequeueStats_.wakeups)
+		LOG(V4L2, Debug)
+			<< "Dequeued " << dequeueStats_.buffers << " buffers in "
+			<< dequeueStats_.wakeups << " wakeups, up to "
+			<< dequeueStats_.maxBuffers << " per wakeup";
+
 	return 0;
 }
 
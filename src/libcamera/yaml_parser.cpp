@@ -154,7 +154,9 @@ struct YamlObject::Getter<T, std::enable_if_t<
 	std::is_same_v<int16_t, T> ||
 	std::is_same_v<uint16_t, T> ||
 	std::is_same_v<int32_t, T> ||
-	std::is_same_v<uint32_t, T>>>
+	std::is_same_v<uint32_t, T> ||
+	std::is_same_v<int64_t, T> ||
+	std::is_same_v<uint64_t, T>>>
 {
 	std::optional<T> get(const YamlObject &obj) const
 	{
@@ -179,6 +181,8 @@ template struct YamlObject::Getter<int16_t>;
 template struct YamlObject::Getter<uint16_t>;
 template struct YamlObject::Getter<int32_t>;
 template struct YamlObject::Getter<uint32_t>;
+template struct YamlObject::Getter<int64_t>;
+template struct YamlObject::Getter<uint64_t>;
 
 template<>
 std::optional<float>
@@ -266,6 +270,8 @@ template<typename T,
 		 std::is_same_v<uint16_t, T> ||
 		 std::is_same_v<int32_t, T> ||
 		 std::is_same_v<uint32_t, T> ||
+		 std::is_same_v<int64_t, T> ||
+		 std::is_same_v<uint64_t, T> ||
 		 std::is_same_v<std::string, T> ||
 		 std::is_same_v<Size, T>> *>
 std::optional<std::vector<T>> YamlObject::getList() const
@@ -295,6 +301,8 @@ template std::optional<std::vector<int16_t>> YamlObject::getList<int16_t>() cons
 template std::optional<std::vector<uint16_t>> YamlObject::getList<uint16_t>() const;
 template std::optional<std::vector<int32_t>> YamlObject::getList<int32_t>() const;
 template std::optional<std::vector<uint32_t>> YamlObject::getList<uint32_t>() const;
+template std::optional<std::vector<int64_t>> YamlObject::getList<int64_t>() const;
+template std::optional<std::vector<uint64_t>> YamlObject::getList<uint64_t>() const;
 template std::optional<std::vector<std::string>> YamlObject::getList<std::string>() const;
 template std::optional<std::vector<Size>> YamlObject::getList<Size>() const;
 
@@ -8,64 +8,403 @@
 #include "v4l2_camera.h"
 
 #include <errno.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/control_ids.h>
 
+#include "libcamera/internal/formats.h"
+
 using namespace libcamera;
 
 LOG_DECLARE_CATEGORY(V4L2Compat)
 
-V4L2Camera::V4L2Camera(std::shared_ptr<Camera> camera)
-	: camera_(camera), controls_(controls::controls), isRunning_(false),
-	  bufferAllocator_(nullptr), efd_(-1), bufferAvailableCount_(0)
+namespace {
+
+/*
+ * Roles of the streams exposed through the video device nodes of a camera, in
+ * the order the nodes are opened.
+ */
+const std::vector<StreamRole> kStreamRoles = {
+	StreamRole::Viewfinder,
+	StreamRole::StillCapture,
+};
+
+bool sameFormat(const StreamConfiguration &a, const StreamConfiguration &b)
 {
-	camera_->requestCompleted.connect(this, &V4L2Camera::requestComplete);
+	return a.size == b.size && a.pixelFormat == b.pixelFormat &&
+	       a.stride == b.stride && a.frameSize == b.frameSize;
 }
 
-V4L2Camera::~V4L2Camera()
+} /* namespace */
+
+V4L2CameraSession::V4L2CameraSession(std::shared_ptr<Camera> camera)
+	: camera_(camera), openCount_(0), runningCount_(0)
 {
-	close();
+	/*
+	 * Expose as many streams as the camera can capture concurrently, up to
+	 * the number of supported roles. Pipeline handlers drop the streams
+	 * they can't support when validating the configuration.
+	 */
+	for (unsigned int count = kStreamRoles.size(); count > 0; count--) {
+		std::vector<StreamRole> roles(kStreamRoles.begin(),
+					      kStreamRoles.begin() + count);
+		std::unique_ptr<CameraConfiguration> config =
+			camera_->generateConfiguration(roles);
+		if (!config || config->validate() == CameraConfiguration::Invalid ||
+		    config->size() != count)
+			continue;
+
+		roles_ = std::move(roles);
+		break;
+	}
+
+	if (roles_.empty())
+		roles_.push_back(kStreamRoles[0]);
+
+	streams_.resize(roles_.size());
+
+	camera_->requestCompleted.connect(this, &V4L2CameraSession::requestComplete);
 }
 
-int V4L2Camera::open(StreamConfiguration *streamConfig)
+V4L2CameraSession::~V4L2CameraSession()
+{
+	camera_->requestCompleted.disconnect(this);
+}
+
+int V4L2CameraSession::open(V4L2Camera *vcam)
+{
+	MutexLocker locker(lock_);
+
+	if (streams_[vcam->index()])
+		return -EBUSY;
+
+	if (!openCount_) {
+		if (camera_->acquire() < 0) {
+			LOG(V4L2Compat, Error) << "Failed to acquire camera";
+			return -EINVAL;
+		}
+
+		bufferAllocator_ = std::make_unique<FrameBufferAllocator>(camera_);
+	}
+
+	std::unique_ptr<CameraConfiguration> config =
+		camera_->generateConfiguration({ roles_[vcam->index()] });
+	if (!config) {
+		if (!openCount_) {
+			bufferAllocator_.reset();
+			camera_->release();
+		}
+		return -EINVAL;
+	}
+
+	vcam->streamConfig_ = config->at(0);
+	vcam->stream_ = nullptr;
+	vcam->configUpdated_ = false;
+
+	streams_[vcam->index()] = vcam;
+	openCount_++;
+
+	return 0;
+}
+
+void V4L2CameraSession::close(V4L2Camera *vcam)
+{
+	MutexLocker locker(lock_);
+
+	if (streams_[vcam->index()] != vcam)
+		return;
+
+	streams_[vcam->index()] = nullptr;
+	busyStreams_.erase(vcam);
+
+	{
+		MutexLocker streamsLocker(streamsLock_);
+		if (vcam->stream_)
+			streamMap_.erase(vcam->stream_);
+	}
+
+	vcam->stream_ = nullptr;
+
+	if (--openCount_)
+		return;
+
+	bufferAllocator_.reset();
+	config_.reset();
+
+	camera_->release();
+}
+
+int V4L2CameraSession::configure(V4L2Camera *vcam, const Size &size,
+				 const PixelFormat &pixelformat,
+				 unsigned int bufferCount)
 {
-	if (camera_->acquire() < 0) {
-		LOG(V4L2Compat, Error) << "Failed to acquire camera";
+	MutexLocker locker(lock_);
+
+	/*
+	 * The camera can't be reconfigured while other streams hold buffers.
+	 * Accept the configuration only if it matches the one the stream has
+	 * been configured with.
+	 */
+	for (V4L2Camera *stream : busyStreams_) {
+		if (stream == vcam)
+			continue;
+
+		if (!vcam->stream_ || vcam->streamConfig_.size != size ||
+		    vcam->streamConfig_.pixelFormat != pixelformat) {
+			LOG(V4L2Compat, Error)
+				<< "Can't reconfigure camera while stream "
+				<< stream->index() << " holds buffers";
+			return -EBUSY;
+		}
+
+		return 0;
+	}
+
+	vcam->streamConfig_.size = size;
+	vcam->streamConfig_.pixelFormat = pixelformat;
+	vcam->streamConfig_.bufferCount = bufferCount;
+
+	/*
+	 * Configure the camera with all the open streams, using the last
+	 * configuration requested for each of them. The pipeline handler may
+	 * adjust the configuration of the other streams, which is then
+	 * reported to their proxies through configurationChanged().
+	 */
+	std::vector<V4L2Camera *> streams;
+	std::vector<StreamRole> roles;
+	for (V4L2Camera *stream : streams_) {
+		if (!stream)
+			continue;
+
+		streams.push_back(stream);
+		roles.push_back(roles_[stream->index()]);
+	}
+
+	std::unique_ptr<CameraConfiguration> config =
+		camera_->generateConfiguration(roles);
+	if (!config || config->size() != streams.size())
 		return -EINVAL;
+
+	for (auto [i, stream] : utils::enumerate(streams)) {
+		StreamConfiguration &streamConfig = config->at(i);
+		streamConfig.size = stream->streamConfig_.size;
+		streamConfig.pixelFormat = stream->streamConfig_.pixelFormat;
+		streamConfig.bufferCount = stream->streamConfig_.bufferCount;
 	}
+	/* \todo memoryType (interval vs external) */
 
-	config_ = camera_->generateConfiguration({ StreamRole::Viewfinder });
-	if (!config_) {
-		camera_->release();
+	CameraConfiguration::Status validation = config->validate();
+	if (validation == CameraConfiguration::Invalid ||
+	    config->size() != streams.size()) {
+		LOG(V4L2Compat, Debug) << "Configuration invalid";
 		return -EINVAL;
 	}
+	if (validation == CameraConfiguration::Adjusted)
+		LOG(V4L2Compat, Debug) << "Configuration adjusted";
+
+	for (const StreamConfiguration &streamConfig : *config)
+		LOG(V4L2Compat, Debug) << "Validated configuration is: "
+				      << streamConfig.toString();
+
+	int ret = camera_->configure(config.get());
+	if (ret < 0)
+		return ret;
+
+	config_ = std::move(config);
+
+	MutexLocker streamsLocker(streamsLock_);
+	streamMap_.clear();
+
+	for (auto [i, stream] : utils::enumerate(streams)) {
+		const StreamConfiguration &streamConfig = config_->at(i);
+
+		if (stream != vcam && !sameFormat(stream->streamConfig_, streamConfig))
+			stream->configUpdated_ = true;
+
+		stream->streamConfig_ = streamConfig;
+		stream->stream_ = streamConfig.stream();
+		streamMap_[stream->stream_] = stream;
+	}
+
+	return 0;
+}
+
+bool V4L2CameraSession::configurationChanged(V4L2Camera *vcam,
+					     StreamConfiguration *streamConfig)
+{
+	MutexLocker locker(lock_);
+
+	if (!vcam->configUpdated_)
+		return false;
+
+	*streamConfig = vcam->streamConfig_;
+	vcam->configUpdated_ = false;
+
+	return true;
+}
+
+int V4L2CameraSession::allocBuffers(V4L2Camera *vcam, bool import)
+{
+	MutexLocker locker(lock_);
+
+	if (!vcam->stream_)
+		return -EINVAL;
+
+	/* Imported buffers are provided by the application when queued. */
+	if (!import) {
+		int ret = bufferAllocator_->allocate(vcam->stream_);
+		if (ret < 0)
+			return ret;
+	}
+
+	busyStreams_.insert(vcam);
+
+	return 0;
+}
+
+void V4L2CameraSession::freeBuffers(V4L2Camera *vcam)
+{
+	MutexLocker locker(lock_);
+
+	busyStreams_.erase(vcam);
+
+	if (vcam->stream_)
+		bufferAllocator_->free(vcam->stream_);
+}
+
+FrameBuffer *V4L2CameraSession::buffer(V4L2Camera *vcam, unsigned int index)
+{
+	MutexLocker locker(lock_);
+
+	if (!vcam->stream_)
+		return nullptr;
+
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
+		bufferAllocator_->buffers(vcam->stream_);
+	if (buffers.size() <= index)
+		return nullptr;
+
+	return buffers[index].get();
+}
+
+int V4L2CameraSession::start(const ControlList *controls)
+{
+	MutexLocker locker(lock_);
+
+	/* The camera is started by the first stream and shared by the others. */
+	if (!runningCount_) {
+		int ret = camera_->start(controls);
+		if (ret < 0)
+			return ret;
+	}
+
+	runningCount_++;
+
+	return 0;
+}
+
+int V4L2CameraSession::stop()
+{
+	MutexLocker locker(lock_);
+
+	if (runningCount_ > 1) {
+		runningCount_--;
+		return 0;
+	}
+
+	int ret = camera_->stop();
+	if (ret < 0)
+		return ret;
+
+	runningCount_ = 0;
+
+	return 0;
+}
+
+void V4L2CameraSession::requestComplete(Request *request)
+{
+	/* Requests contain the buffer of a single stream. */
+	const Stream *stream = request->buffers().begin()->first;
+	V4L2Camera *vcam;
+
+	{
+		MutexLocker locker(streamsLock_);
+
+		auto iter = streamMap_.find(stream);
+		if (iter == streamMap_.end())
+			return;
+
+		vcam = iter->second;
+	}
+
+	vcam->requestComplete(request);
+}
+
+V4L2Camera::V4L2Camera(std::shared_ptr<V4L2CameraSession> session,
+		       unsigned int index)
+	: session_(session), index_(index), stream_(nullptr),
+	  configUpdated_(false), controls_(controls::controls), isRunning_(false), efd_(-1),
+	  bufferAvailableCount_(0), queuedCount_(0)
+{
+}
 
-	bufferAllocator_ = new FrameBufferAllocator(camera_);
+V4L2Camera::~V4L2Camera()
+{
+	close();
+}
+
+int V4L2Camera::open(StreamConfiguration *streamConfig)
+{
+	int ret = session_->open(this);
+	if (ret < 0)
+		return ret;
 
-	*streamConfig = config_->at(0);
+	*streamConfig = streamConfig_;
 	return 0;
 }
 
 void V4L2Camera::close()
 {
-	requestPool_.clear();
+	/* Wait for the requests of the stream to complete before freeing them. */
+	streamOff();
 
-	delete bufferAllocator_;
-	bufferAllocator_ = nullptr;
+	requestPool_.clear();
+	importedBuffers_.clear();
 
-	camera_->release();
+	session_->close(this);
 }
 
 void V4L2Camera::bind(int efd)
 {
+	MutexLocker locker(bufferMutex_);
+
 	efd_ = efd;
+
+	/* Make the new eventfd readable if buffers are already available. */
+	if (bufferAvailableCount_) {
+		uint64_t data = 1;
+		int ret = ::write(efd_, &data, sizeof(data));
+		if (ret != sizeof(data))
+			LOG(V4L2Compat, Error) << "Failed to signal eventfd POLLIN";
+	}
 }
 
 void V4L2Camera::unbind()
 {
+	MutexLocker locker(bufferMutex_);
+
+	/* Clear POLLIN on the old eventfd, the file may stay open. */
+	if (bufferAvailableCount_ && efd_ >= 0) {
+		uint64_t data;
+		int ret = ::read(efd_, &data, sizeof(data));
+		if (ret != sizeof(data))
+			LOG(V4L2Compat, Error) << "Failed to clear eventfd POLLIN";
+	}
+
 	efd_ = -1;
 }
 
@@ -73,77 +412,107 @@ std::vector<V4L2Camera::Buffer> V4L2Camera::completedBuffers()
 {
 	std::vector<Buffer> v;
 
-	MutexLocker lock(bufferLock_);
-	for (std::unique_ptr<Buffer> &metadata : completedBuffers_)
-		v.push_back(*metadata.get());
-	completedBuffers_.clear();
+	MutexLocker locker(bufferMutex_);
+	v.swap(completedBuffers_);
 
 	return v;
 }
 
 void V4L2Camera::requestComplete(Request *request)
 {
-	if (request->status() == Request::RequestCancelled)
+	if (request->status() == Request::RequestCancelled || !isRunning_) {
+		/*
+		 * Requests of a stream stopped while the camera keeps running
+		 * for other streams complete normally, and are dropped.
+		 */
+		if (request->status() != Request::RequestCancelled)
+			request->reuse();
+
+		{
+			MutexLocker locker(bufferMutex_);
+			queuedCount_--;
+		}
+		bufferCV_.notify_all();
 		return;
+	}
 
-	/* We only have one stream at the moment. */
-	bufferLock_.lock();
 	FrameBuffer *buffer = request->buffers().begin()->second;
-	std::unique_ptr<Buffer> metadata =
-		std::make_unique<Buffer>(request->cookie(), buffer->metadata());
-	completedBuffers_.push_back(std::move(metadata));
-	bufferLock_.unlock();
-
-	uint64_t data = 1;
-	int ret = ::write(efd_, &data, sizeof(data));
-	if (ret != sizeof(data))
-		LOG(V4L2Compat, Error) << "Failed to signal eventfd POLLIN";
+	Buffer completed(request->cookie(), buffer->metadata());
 
+	/* Reuse the request before the application can queue it again. */
 	request->reuse();
+
 	{
 		MutexLocker locker(bufferMutex_);
-		bufferAvailableCount_++;
+
+		completedBuffers_.push_back(std::move(completed));
+		queuedCount_--;
+
+		/*
+		 * Signal POLLIN only when the first buffer becomes available.
+		 * Applications blocked in DQBUF are woken up by the condition
+		 * variable and don't need the eventfd.
+		 */
+		if (!bufferAvailableCount_++ && efd_ >= 0) {
+			uint64_t data = 1;
+			int ret = ::write(efd_, &data, sizeof(data));
+			if (ret != sizeof(data))
+				LOG(V4L2Compat, Error) << "Failed to signal eventfd POLLIN";
+		}
 	}
 	bufferCV_.notify_all();
 }
 
-int V4L2Camera::configure(StreamConfiguration *streamConfigOut,
-			  const Size &size, const PixelFormat &pixelformat,
-			  unsigned int bufferCount)
+void V4L2Camera::consumeBuffer()
 {
-	StreamConfiguration &streamConfig = config_->at(0);
-	streamConfig.size.width = size.width;
-	streamConfig.size.height = size.height;
-	streamConfig.pixelFormat = pixelformat;
-	streamConfig.bufferCount = bufferCount;
-	/* \todo memoryType (interval vs external) */
+	/*
+	 * Clear POLLIN when the last available buffer is consumed. There is no
+	 * eventfd to clear when the stream is closed, as the file has been
+	 * unbound already.
+	 */
+	if (--bufferAvailableCount_ || efd_ < 0)
+		return;
 
-	CameraConfiguration::Status validation = config_->validate();
-	if (validation == CameraConfiguration::Invalid) {
-		LOG(V4L2Compat, Debug) << "Configuration invalid";
-		return -EINVAL;
-	}
-	if (validation == CameraConfiguration::Adjusted)
-		LOG(V4L2Compat, Debug) << "Configuration adjusted";
+	uint64_t data;
+	int ret = ::read(efd_, &data, sizeof(data));
+	if (ret != sizeof(data))
+		LOG(V4L2Compat, Error) << "Failed to clear eventfd POLLIN";
+}
+
+void V4L2Camera::clearBuffers()
+{
+	completedBuffers_.clear();
 
-	LOG(V4L2Compat, Debug) << "Validated configuration is: "
-			      << streamConfig.toString();
+	if (bufferAvailableCount_) {
+		bufferAvailableCount_ = 1;
+		consumeBuffer();
+	}
+}
 
-	int ret = camera_->configure(config_.get());
+int V4L2Camera::configure(StreamConfiguration *streamConfigOut,
+			  const Size &size, const PixelFormat &pixelformat,
+			  unsigned int bufferCount)
+{
+	int ret = session_->configure(this, size, pixelformat, bufferCount);
 	if (ret < 0)
 		return ret;
 
-	*streamConfigOut = config_->at(0);
+	*streamConfigOut = streamConfig_;
 
 	return 0;
 }
 
+bool V4L2Camera::configurationChanged(StreamConfiguration *streamConfig)
+{
+	return session_->configurationChanged(this, streamConfig);
+}
+
 int V4L2Camera::validateConfiguration(const PixelFormat &pixelFormat,
 				      const Size &size,
 				      StreamConfiguration *streamConfigOut)
 {
 	std::unique_ptr<CameraConfiguration> config =
-		camera_->generateConfiguration({ StreamRole::Viewfinder });
+		camera()->generateConfiguration({ session_->roles()[index_] });
 	StreamConfiguration &cfg = config->at(0);
 	cfg.size = size;
 	cfg.pixelFormat = pixelFormat;
@@ -158,16 +527,10 @@ int V4L2Camera::validateConfiguration(const PixelFormat &pixelFormat,
 	return 0;
 }
 
-int V4L2Camera::allocBuffers(unsigned int count)
+int V4L2Camera::createRequests(unsigned int count)
 {
-	Stream *stream = config_->at(0).stream();
-
-	int ret = bufferAllocator_->allocate(stream);
-	if (ret < 0)
-		return ret;
-
 	for (unsigned int i = 0; i < count; i++) {
-		std::unique_ptr<Request> request = camera_->createRequest(i);
+		std::unique_ptr<Request> request = camera()->createRequest(i);
 		if (!request) {
 			requestPool_.clear();
 			return -ENOMEM;
@@ -175,28 +538,149 @@ int V4L2Camera::allocBuffers(unsigned int count)
 		requestPool_.push_back(std::move(request));
 	}
 
-	return ret;
+	return 0;
+}
+
+int V4L2Camera::allocBuffers(unsigned int count)
+{
+	int ret = session_->allocBuffers(this, false);
+	if (ret < 0)
+		return ret;
+
+	ret = createRequests(count);
+	if (ret < 0) {
+		session_->freeBuffers(this);
+		return ret;
+	}
+
+	return 0;
+}
+
+int V4L2Camera::importBuffers(unsigned int count)
+{
+	int ret = session_->allocBuffers(this, true);
+	if (ret < 0)
+		return ret;
+
+	/* The buffers are created when queued, from the dmabuf fds. */
+	importedBuffers_.resize(count);
+
+	ret = createRequests(count);
+	if (ret < 0) {
+		importedBuffers_.clear();
+		session_->freeBuffers(this);
+		return ret;
+	}
+
+	return 0;
 }
 
 void V4L2Camera::freeBuffers()
 {
 	pendingRequests_.clear();
 	requestPool_.clear();
+	importedBuffers_.clear();
 
-	Stream *stream = config_->at(0).stream();
-	bufferAllocator_->free(stream);
+	session_->freeBuffers(this);
 }
 
 int V4L2Camera::getBufferFd(unsigned int index)
 {
-	Stream *stream = config_->at(0).stream();
-	const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
-		bufferAllocator_->buffers(stream);
-
-	if (buffers.size() <= index)
+	FrameBuffer *buffer = session_->buffer(this, index);
+	if (!buffer)
 		return -1;
 
-	return buffers[index]->planes()[0].fd.get();
+	return buffer->planes()[0].fd.get();
+}
+
+int V4L2Camera::importBuffer(unsigned int index, int fd)
+{
+	if (index >= importedBuffers_.size())
+		return -EINVAL;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		return -EINVAL;
+
+	/*
+	 * Applications usually queue the same dmabuf at the same index. Reuse
+	 * the FrameBuffer in that case to avoid importing the dmabuf in the
+	 * pipeline handler for every frame.
+	 */
+	std::unique_ptr<FrameBuffer> &buffer = importedBuffers_[index];
+	if (buffer) {
+		struct stat current;
+		if (fstat(buffer->planes()[0].fd.get(), &current) == 0 &&
+		    current.st_ino == st.st_ino)
+			return 0;
+	}
+
+	const StreamConfiguration &streamConfig = streamConfig_;
+	off_t size = lseek(fd, 0, SEEK_END);
+	if (size < 0 || static_cast<size_t>(size) < streamConfig.frameSize) {
+		LOG(V4L2Compat, Error)
+			<< "dmabuf too small for the frame size "
+			<< streamConfig.frameSize;
+		return -EINVAL;
+	}
+
+	SharedFD dmabuf(fd);
+	if (!dmabuf.isValid())
+		return -EINVAL;
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(streamConfig.pixelFormat);
+	std::vector<FrameBuffer::Plane> planes;
+
+	if (!info.isValid()) {
+		planes.resize(1);
+		planes[0].fd = dmabuf;
+		planes[0].offset = 0;
+		planes[0].length = streamConfig.frameSize;
+	} else {
+		planes.resize(info.numPlanes());
+
+		unsigned int offset = 0;
+		for (auto [i, plane] : utils::enumerate(planes)) {
+			/*
+			 * Compute the stride of the other planes from the
+			 * stride of the first plane, as in V4L2VideoDevice.
+			 */
+			unsigned int stride = streamConfig.stride
+					    * info.planes[i].bytesPerGroup
+					    / info.planes[0].bytesPerGroup;
+
+			plane.fd = dmabuf;
+			plane.offset = offset;
+			plane.length = info.planeSize(streamConfig.size.height,
+						      i, stride);
+			offset += plane.length;
+		}
+	}
+
+	buffer = std::make_unique<FrameBuffer>(planes);
+
+	return 0;
+}
+
+int V4L2Camera::queueRequest(Request *request)
+{
+	/*
+	 * Account for the request before queueing it, as it may complete
+	 * before queueRequest() returns.
+	 */
+	{
+		MutexLocker locker(bufferMutex_);
+		queuedCount_++;
+	}
+
+	int ret = camera()->queueRequest(request);
+	if (ret < 0) {
+		MutexLocker locker(bufferMutex_);
+		queuedCount_--;
+		return ret == -EACCES ? -EBUSY : ret;
+	}
+
+	return 0;
 }
 
 int V4L2Camera::streamOn()
@@ -204,7 +688,7 @@ int V4L2Camera::streamOn()
 	if (isRunning_)
 		return 0;
 
-	int ret = camera_->start(&controls_);
+	int ret = session_->start(&controls_);
 	if (ret < 0)
 		return ret == -EACCES ? -EBUSY : ret;
 
@@ -214,9 +698,9 @@ int V4L2Camera::streamOn()
 
 	for (Request *req : pendingRequests_) {
 		/* \todo What should we do if this returns -EINVAL? */
-		ret = camera_->queueRequest(req);
+		ret = queueRequest(req);
 		if (ret < 0)
-			return ret == -EACCES ? -EBUSY : ret;
+			return ret;
 	}
 
 	pendingRequests_.clear();
@@ -235,16 +719,32 @@ int V4L2Camera::streamOff()
 
 	pendingRequests_.clear();
 
-	int ret = camera_->stop();
-	if (ret < 0)
-		return ret == -EACCES ? -EBUSY : ret;
-
 	{
 		MutexLocker locker(bufferMutex_);
 		isRunning_ = false;
 	}
 	bufferCV_.notify_all();
 
+	int ret = session_->stop();
+	if (ret < 0) {
+		MutexLocker locker(bufferMutex_);
+		isRunning_ = true;
+		return ret == -EACCES ? -EBUSY : ret;
+	}
+
+	/*
+	 * If the camera is still running for other streams, the requests of
+	 * this stream haven't been cancelled. Wait for them to complete, so
+	 * that they can be reused or freed.
+	 */
+	MutexLocker locker(bufferMutex_);
+	bufferCV_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(bufferMutex_) {
+			       return queuedCount_ == 0;
+		       });
+
+	/* Drop the buffers that haven't been dequeued. */
+	clearBuffers();
+
 	return 0;
 }
 
@@ -256,9 +756,15 @@ int V4L2Camera::qbuf(unsigned int index)
 	}
 	Request *request = requestPool_[index].get();
 
-	Stream *stream = config_->at(0).stream();
-	FrameBuffer *buffer = bufferAllocator_->buffers(stream)[index].get();
-	int ret = request->addBuffer(stream, buffer);
+	FrameBuffer *buffer = importedBuffers_.empty()
+			    ? session_->buffer(this, index)
+			    : importedBuffers_[index].get();
+	if (!buffer) {
+		LOG(V4L2Compat, Error) << "No buffer imported at index " << index;
+		return -EINVAL;
+	}
+
+	int ret = request->addBuffer(stream_, buffer);
 	if (ret < 0) {
 		LOG(V4L2Compat, Error) << "Can't set buffer for request";
 		return -ENOMEM;
@@ -271,10 +777,10 @@ int V4L2Camera::qbuf(unsigned int index)
 
 	request->controls().merge(std::move(controls_));
 
-	ret = camera_->queueRequest(request);
+	ret = queueRequest(request);
 	if (ret < 0) {
 		LOG(V4L2Compat, Error) << "Can't queue request";
-		return ret == -EACCES ? -EBUSY : ret;
+		return ret;
 	}
 
 	return 0;
@@ -287,7 +793,7 @@ void V4L2Camera::waitForBufferAvailable()
 			       return bufferAvailableCount_ >= 1 || !isRunning_;
 		       });
 	if (isRunning_)
-		bufferAvailableCount_--;
+		consumeBuffer();
 }
 
 bool V4L2Camera::isBufferAvailable()
@@ -296,7 +802,7 @@ bool V4L2Camera::isBufferAvailable()
 	if (bufferAvailableCount_ < 1)
 		return false;
 
-	bufferAvailableCount_--;
+	consumeBuffer();
 	return true;
 }
 
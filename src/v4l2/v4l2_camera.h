@@ -8,40 +8,105 @@
 #pragma once
 
 #include <deque>
+#include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/semaphore.h>
 #include <libcamera/base/shared_fd.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/controls.h>
 #include <libcamera/framebuffer.h>
 #include <libcamera/framebuffer_allocator.h>
 
+class V4L2Camera;
+
+class V4L2CameraSession
+{
+public:
+	V4L2CameraSession(std::shared_ptr<libcamera::Camera> camera);
+	~V4L2CameraSession();
+
+	const std::shared_ptr<libcamera::Camera> &camera() const { return camera_; }
+	const std::vector<libcamera::StreamRole> &roles() const { return roles_; }
+
+	int open(V4L2Camera *vcam) LIBCAMERA_TSA_EXCLUDES(lock_, streamsLock_);
+	void close(V4L2Camera *vcam) LIBCAMERA_TSA_EXCLUDES(lock_, streamsLock_);
+
+	int configure(V4L2Camera *vcam, const libcamera::Size &size,
+		      const libcamera::PixelFormat &pixelformat,
+		      unsigned int bufferCount)
+		LIBCAMERA_TSA_EXCLUDES(lock_, streamsLock_);
+	bool configurationChanged(V4L2Camera *vcam,
+				  libcamera::StreamConfiguration *streamConfig)
+		LIBCAMERA_TSA_EXCLUDES(lock_);
+
+	int allocBuffers(V4L2Camera *vcam, bool import)
+		LIBCAMERA_TSA_EXCLUDES(lock_);
+	void freeBuffers(V4L2Camera *vcam) LIBCAMERA_TSA_EXCLUDES(lock_);
+	libcamera::FrameBuffer *buffer(V4L2Camera *vcam, unsigned int index)
+		LIBCAMERA_TSA_EXCLUDES(lock_);
+
+	int start(const libcamera::ControlList *controls)
+		LIBCAMERA_TSA_EXCLUDES(lock_);
+	int stop() LIBCAMERA_TSA_EXCLUDES(lock_);
+
+private:
+	void requestComplete(libcamera::Request *request)
+		LIBCAMERA_TSA_EXCLUDES(streamsLock_);
+
+	std::shared_ptr<libcamera::Camera> camera_;
+	std::vector<libcamera::StreamRole> roles_;
+
+	libcamera::Mutex lock_;
+	std::unique_ptr<libcamera::CameraConfiguration> config_
+		LIBCAMERA_TSA_GUARDED_BY(lock_);
+	std::unique_ptr<libcamera::FrameBufferAllocator> bufferAllocator_
+		LIBCAMERA_TSA_GUARDED_BY(lock_);
+	std::vector<V4L2Camera *> streams_ LIBCAMERA_TSA_GUARDED_BY(lock_);
+	std::set<V4L2Camera *> busyStreams_ LIBCAMERA_TSA_GUARDED_BY(lock_);
+	unsigned int openCount_ LIBCAMERA_TSA_GUARDED_BY(lock_);
+	unsigned int runningCount_ LIBCAMERA_TSA_GUARDED_BY(lock_);
+
+	/* Protects the stream lookup in the request completion handler. */
+	libcamera::Mutex streamsLock_;
+	std::map<const libcamera::Stream *, V4L2Camera *> streamMap_
+		LIBCAMERA_TSA_GUARDED_BY(streamsLock_);
+};
+
 class V4L2Camera
 {
 public:
 	struct Buffer {
 		Buffer(unsigned int index, const libcamera::FrameMetadata &data)
-			: index_(index), data_(data)
+			: index_(index), data_(data),
+			  completed_(libcamera::utils::clock::now())
 		{
 		}
 
 		unsigned int index_;
 		libcamera::FrameMetadata data_;
+		/* Time at which the request completed */
+		libcamera::utils::time_point completed_;
 	};
 
-	V4L2Camera(std::shared_ptr<libcamera::Camera> camera);
+	V4L2Camera(std::shared_ptr<V4L2CameraSession> session,
+		   unsigned int index);
 	~V4L2Camera();
 
+	const std::shared_ptr<libcamera::Camera> &camera() const { return session_->camera(); }
+	unsigned int index() const { return index_; }
+
 	int open(libcamera::StreamConfiguration *streamConfig);
 	void close();
-	void bind(int efd);
-	void unbind();
+	void bind(int efd) LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
+	void unbind() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
 
-	std::vector<Buffer> completedBuffers() LIBCAMERA_TSA_EXCLUDES(bufferLock_);
+	std::vector<Buffer> completedBuffers() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
 
 	int configure(libcamera::StreamConfiguration *streamConfigOut,
 		      const libcamera::Size &size,
@@ -50,18 +115,21 @@ public:
 	int validateConfiguration(const libcamera::PixelFormat &pixelformat,
 				  const libcamera::Size &size,
 				  libcamera::StreamConfiguration *streamConfigOut);
+	bool configurationChanged(libcamera::StreamConfiguration *streamConfig);
 
 	libcamera::ControlList &controls() { return controls_; }
-	const libcamera::ControlInfoMap &controlInfo() { return camera_->controls(); }
+	const libcamera::ControlInfoMap &controlInfo() { return camera()->controls(); }
 
 	int allocBuffers(unsigned int count);
+	int importBuffers(unsigned int count);
 	void freeBuffers();
 	int getBufferFd(unsigned int index);
+	int importBuffer(unsigned int index, int fd);
 
-	int streamOn();
-	int streamOff();
+	int streamOn() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
+	int streamOff() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
 
-	int qbuf(unsigned int index);
+	int qbuf(unsigned int index) LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
 
 	void waitForBufferAvailable() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
 	bool isBufferAvailable() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
@@ -69,28 +137,48 @@ public:
 	bool isRunning();
 
 private:
-	void requestComplete(libcamera::Request *request)
-		LIBCAMERA_TSA_EXCLUDES(bufferLock_);
+	friend class V4L2CameraSession;
 
-	std::shared_ptr<libcamera::Camera> camera_;
-	std::unique_ptr<libcamera::CameraConfiguration> config_;
+	void requestComplete(libcamera::Request *request)
+		LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
+	void consumeBuffer() LIBCAMERA_TSA_REQUIRES(bufferMutex_);
+	void clearBuffers() LIBCAMERA_TSA_REQUIRES(bufferMutex_);
+	int createRequests(unsigned int count);
+	int queueRequest(libcamera::Request *request)
+		LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
+
+	std::shared_ptr<V4L2CameraSession> session_;
+	unsigned int index_;
+
+	/*
+	 * Configuration of the stream, and stream once configured. The
+	 * configuration is changed by the session when another stream of the
+	 * camera is configured, which is flagged by configUpdated_.
+	 */
+	libcamera::StreamConfiguration streamConfig_;
+	libcamera::Stream *stream_;
+	bool configUpdated_;
 
 	libcamera::ControlList controls_;
 
 	bool isRunning_;
 
-	libcamera::Mutex bufferLock_;
-	libcamera::FrameBufferAllocator *bufferAllocator_;
+	std::vector<std::unique_ptr<libcamera::FrameBuffer>> importedBuffers_;
 
 	std::vector<std::unique_ptr<libcamera::Request>> requestPool_;
 
 	std::deque<libcamera::Request *> pendingRequests_;
-	std::deque<std::unique_ptr<Buffer>> completedBuffers_
-		LIBCAMERA_TSA_GUARDED_BY(bufferLock_);
 
-	int efd_;
+	/*
+	 * The eventfd is readable when at least one completed buffer hasn't
+	 * been dequeued. It is only written when the first buffer becomes
+	 * available, and read when the last one is consumed.
+	 */
+	int efd_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
 
 	libcamera::Mutex bufferMutex_;
 	libcamera::ConditionVariable bufferCV_;
+	std::vector<Buffer> completedBuffers_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
 	unsigned int bufferAvailableCount_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
+	unsigned int queuedCount_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
 };
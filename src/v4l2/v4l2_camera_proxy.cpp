@@ -40,11 +40,20 @@ using namespace std::literals::chrono_literals;
 LOG_DECLARE_CATEGORY(V4L2Compat)
 
 V4L2CameraProxy::V4L2CameraProxy(unsigned int index,
-				 std::shared_ptr<Camera> camera)
-	: refcount_(0), index_(index), bufferCount_(0), currentBuf_(0),
-	  vcam_(std::make_unique<V4L2Camera>(camera)), owner_(nullptr)
+				 std::shared_ptr<V4L2CameraSession> session,
+				 unsigned int stream)
+	: refcount_(0), index_(index), bufferCount_(0),
+	  memory_(V4L2_MEMORY_MMAP), latencyFrames_(0),
+	  vcam_(std::make_unique<V4L2Camera>(session, stream)), owner_(nullptr)
 {
-	querycap(camera);
+	querycap(session->camera(), stream);
+}
+
+bool V4L2CameraProxy::isOpen()
+{
+	MutexLocker locker(proxyMutex_);
+
+	return refcount_ > 0;
 }
 
 int V4L2CameraProxy::open(V4L2CameraFile *file)
@@ -175,7 +184,7 @@ bool V4L2CameraProxy::validateBufferType(uint32_t type)
 
 bool V4L2CameraProxy::validateMemoryType(uint32_t memory)
 {
-	return memory == V4L2_MEMORY_MMAP;
+	return memory == V4L2_MEMORY_MMAP || memory == V4L2_MEMORY_DMABUF;
 }
 
 void V4L2CameraProxy::setFmtFromConfig(const StreamConfiguration &streamConfig)
@@ -220,14 +229,37 @@ void V4L2CameraProxy::setFmtFromConfig(const StreamConfiguration &streamConfig)
 	}
 }
 
-void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera)
+void V4L2CameraProxy::updateFmt()
+{
+	/*
+	 * Configuring another stream of the camera may have adjusted the
+	 * configuration of this stream.
+	 */
+	if (vcam_->configurationChanged(&streamConfig_))
+		setFmtFromConfig(streamConfig_);
+}
+
+void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera,
+			       unsigned int stream)
 {
 	std::string driver = "libcamera";
 	std::string bus_info = driver + ":" + std::to_string(index_);
 
+	/*
+	 * All streams of a camera share the same bus info. Secondary streams
+	 * are identified by a suffix in the card name, truncating the camera
+	 * ID if needed to keep the suffix.
+	 */
+	std::string card = camera->id();
+	if (stream) {
+		std::string suffix = " #" + std::to_string(stream);
+		card = card.substr(0, sizeof(capabilities_.card) - 1 - suffix.size())
+		     + suffix;
+	}
+
 	utils::strlcpy(reinterpret_cast<char *>(capabilities_.driver), driver.c_str(),
 		       sizeof(capabilities_.driver));
-	utils::strlcpy(reinterpret_cast<char *>(capabilities_.card), camera->id().c_str(),
+	utils::strlcpy(reinterpret_cast<char *>(capabilities_.card), card.c_str(),
 		       sizeof(capabilities_.card));
 	utils::strlcpy(reinterpret_cast<char *>(capabilities_.bus_info), bus_info.c_str(),
 		       sizeof(capabilities_.bus_info));
@@ -244,7 +276,7 @@ void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera)
 void V4L2CameraProxy::updateBuffers()
 {
 	std::vector<V4L2Camera::Buffer> completedBuffers = vcam_->completedBuffers();
-	for (const V4L2Camera::Buffer &buffer : completedBuffers) {
+	for (V4L2Camera::Buffer &buffer : completedBuffers) {
 		const FrameMetadata &fmd = buffer.data_;
 		struct v4l2_buffer &buf = buffers_[buffer.index_];
 
@@ -268,9 +300,46 @@ void V4L2CameraProxy::updateBuffers()
 		default:
 			break;
 		}
+
+		doneBuffers_.push_back(std::move(buffer));
 	}
 }
 
+/*
+ * Measure the frame delivery latency over a number of frames, after skipping
+ * the first frames to let the pipeline settle. The completion latency is the
+ * latency seen by native libcamera applications in their requestCompleted
+ * handler, the delivery latency the one seen by the V4L2 application when it
+ * dequeues the buffer. The difference is the overhead of the V4L2 adaptation
+ * layer.
+ */
+void V4L2CameraProxy::measureLatency(const V4L2Camera::Buffer &buffer)
+{
+	if (latencyFrames_ >= kLatencySkipFrames + kLatencyMeasureFrames)
+		return;
+
+	if (latencyFrames_++ < kLatencySkipFrames || !buffer.data_.timestamp)
+		return;
+
+	/* Sensor timestamps are expressed in the CLOCK_MONOTONIC time base. */
+	utils::time_point sensorTime{ std::chrono::nanoseconds(buffer.data_.timestamp) };
+
+	completionLatency_ += buffer.completed_ - sensorTime;
+	deliveryLatency_ += utils::clock::now() - sensorTime;
+
+	if (latencyFrames_ < kLatencySkipFrames + kLatencyMeasureFrames)
+		return;
+
+	utils::Duration native = completionLatency_ / kLatencyMeasureFrames;
+	utils::Duration delivery = deliveryLatency_ / kLatencyMeasureFrames;
+
+	LOG(V4L2Compat, Debug)
+		<< "Frame latency over " << kLatencyMeasureFrames << " frames: "
+		<< native.get<std::micro>() << " us native, "
+		<< delivery.get<std::micro>() << " us through V4L2, "
+		<< utils::Duration(delivery - native).get<std::micro>() << " us overhead";
+}
+
 int V4L2CameraProxy::vidioc_querycap(V4L2CameraFile *file, struct v4l2_capability *arg)
 {
 	LOG(V4L2Compat, Debug)
@@ -395,7 +464,7 @@ int V4L2CameraProxy::vidioc_s_fmt(V4L2CameraFile *file, struct v4l2_format *arg)
 	ret = vcam_->configure(&streamConfig_, size, v4l2Format.toPixelFormat(),
 			       bufferCount_);
 	if (ret < 0)
-		return -EINVAL;
+		return ret == -EBUSY ? ret : -EINVAL;
 
 	setFmtFromConfig(streamConfig_);
 
@@ -495,6 +564,7 @@ void V4L2CameraProxy::freeBuffers()
 {
 	vcam_->freeBuffers();
 	buffers_.clear();
+	doneBuffers_.clear();
 	bufferCount_ = 0;
 }
 
@@ -515,7 +585,8 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 	if (!hasOwnership(file) && owner_)
 		return -EBUSY;
 
-	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP;
+	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP
+			  | V4L2_BUF_CAP_SUPPORTS_DMABUF;
 	arg->flags = 0;
 	memset(arg->reserved, 0, sizeof(arg->reserved));
 
@@ -541,14 +612,22 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 	int ret = vcam_->configure(&streamConfig_, size,
 				   v4l2Format.toPixelFormat(), arg->count);
 	if (ret < 0)
-		return -EINVAL;
+		return ret == -EBUSY ? ret : -EINVAL;
 
 	setFmtFromConfig(streamConfig_);
 
 	arg->count = streamConfig_.bufferCount;
 	bufferCount_ = arg->count;
+	memory_ = arg->memory;
 
-	ret = vcam_->allocBuffers(arg->count);
+	/*
+	 * With DMABUF, the buffers are provided by the application when queued
+	 * and imported in the camera.
+	 */
+	if (memory_ == V4L2_MEMORY_DMABUF)
+		ret = vcam_->importBuffers(arg->count);
+	else
+		ret = vcam_->allocBuffers(arg->count);
 	if (ret < 0) {
 		arg->count = 0;
 		return ret;
@@ -559,8 +638,9 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 		struct v4l2_buffer buf = {};
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.length = v4l2PixFormat_.sizeimage;
-		buf.memory = V4L2_MEMORY_MMAP;
-		buf.m.offset = i * v4l2PixFormat_.sizeimage;
+		buf.memory = memory_;
+		if (memory_ == V4L2_MEMORY_MMAP)
+			buf.m.offset = i * v4l2PixFormat_.sizeimage;
 		buf.index = i;
 		buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 
@@ -609,7 +689,7 @@ int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
 	struct v4l2_buffer &buffer = buffers_[arg->index];
@@ -618,6 +698,14 @@ int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer
 	    buffer.flags & V4L2_BUF_FLAG_PREPARED)
 		return -EINVAL;
 
+	if (memory_ == V4L2_MEMORY_DMABUF) {
+		int ret = vcam_->importBuffer(arg->index, arg->m.fd);
+		if (ret < 0)
+			return ret;
+
+		buffer.m.fd = arg->m.fd;
+	}
+
 	buffer.flags |= V4L2_BUF_FLAG_PREPARED;
 
 	arg->flags = buffer.flags;
@@ -641,11 +729,20 @@ int V4L2CameraProxy::vidioc_qbuf(V4L2CameraFile *file, struct v4l2_buffer *arg)
 		return -EBUSY;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory) ||
+	    arg->memory != memory_ ||
 	    arg->index >= bufferCount_)
 		return -EINVAL;
 
-	int ret = vcam_->qbuf(arg->index);
+	int ret;
+	if (memory_ == V4L2_MEMORY_DMABUF) {
+		ret = vcam_->importBuffer(arg->index, arg->m.fd);
+		if (ret < 0)
+			return ret;
+
+		buffers_[arg->index].m.fd = arg->m.fd;
+	}
+
+	ret = vcam_->qbuf(arg->index);
 	if (ret < 0)
 		return ret;
 
@@ -672,7 +769,7 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
 	if (!file->nonBlocking()) {
@@ -691,18 +788,22 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 
 	updateBuffers();
 
-	struct v4l2_buffer &buf = buffers_[currentBuf_];
+	/*
+	 * Dequeue buffers in completion order, which may differ from the order
+	 * in which they have been queued.
+	 */
+	if (doneBuffers_.empty())
+		return -EINVAL;
+
+	const V4L2Camera::Buffer &done = doneBuffers_.front();
+	struct v4l2_buffer &buf = buffers_[done.index_];
 
 	buf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_PREPARED);
 	buf.length = sizeimage_;
 	*arg = buf;
 
-	currentBuf_ = (currentBuf_ + 1) % bufferCount_;
-
-	uint64_t data;
-	int ret = ::read(file->efd(), &data, sizeof(data));
-	if (ret != sizeof(data))
-		LOG(V4L2Compat, Error) << "Failed to clear eventfd POLLIN";
+	measureLatency(done);
+	doneBuffers_.pop_front();
 
 	return 0;
 }
@@ -715,21 +816,29 @@ int V4L2CameraProxy::vidioc_expbuf(V4L2CameraFile *file, struct v4l2_exportbuffe
 	if (!hasOwnership(file))
 		return -EBUSY;
 
-	/* \todo Verify that the memory type is MMAP when adding DMABUF support */
 	if (!validateBufferType(arg->type))
 		return -EINVAL;
 
+	/* Only buffers allocated by the camera can be exported. */
+	if (memory_ != V4L2_MEMORY_MMAP)
+		return -EINVAL;
+
 	if (arg->index >= bufferCount_)
 		return -EINVAL;
 
 	if (arg->flags & ~(O_CLOEXEC | O_ACCMODE))
 		return -EINVAL;
 
+	int fd = vcam_->getBufferFd(arg->index);
+	if (fd < 0)
+		return -EINVAL;
+
 	memset(arg->reserved, 0, sizeof(arg->reserved));
 
 	/* \todo honor the O_ACCMODE flags passed to this function */
-	arg->fd = fcntl(vcam_->getBufferFd(arg->index),
-			arg->flags & O_CLOEXEC ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+	arg->fd = fcntl(fd, arg->flags & O_CLOEXEC ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+	if (arg->fd < 0)
+		return -errno;
 
 	return 0;
 }
@@ -754,7 +863,9 @@ int V4L2CameraProxy::vidioc_streamon(V4L2CameraFile *file, int *arg)
 	if (vcam_->isRunning())
 		return 0;
 
-	currentBuf_ = 0;
+	latencyFrames_ = 0;
+	completionLatency_ = {};
+	deliveryLatency_ = {};
 
 	return vcam_->streamOn();
 }
@@ -775,6 +886,7 @@ int V4L2CameraProxy::vidioc_streamoff(V4L2CameraFile *file, int *arg)
 
 	int ret = vcam_->streamOff();
 
+	doneBuffers_.clear();
 	for (struct v4l2_buffer &buf : buffers_)
 		buf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE);
 
@@ -883,6 +995,8 @@ int V4L2CameraProxy::ioctl(V4L2CameraFile *file, unsigned long longRequest, void
 		return -1;
 	}
 
+	updateFmt();
+
 	int ret;
 	switch (request) {
 	case VIDIOC_QUERYCAP:
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <deque>
 #include <linux/videodev2.h>
 #include <map>
 #include <memory>
@@ -15,6 +16,7 @@
 #include <vector>
 
 #include <libcamera/base/mutex.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
 
@@ -25,7 +27,11 @@ class V4L2CameraFile;
 class V4L2CameraProxy
 {
 public:
-	V4L2CameraProxy(unsigned int index, std::shared_ptr<libcamera::Camera> camera);
+	V4L2CameraProxy(unsigned int index,
+			std::shared_ptr<V4L2CameraSession> session,
+			unsigned int stream);
+
+	bool isOpen() LIBCAMERA_TSA_EXCLUDES(proxyMutex_);
 
 	int open(V4L2CameraFile *file) LIBCAMERA_TSA_EXCLUDES(proxyMutex_);
 	void close(V4L2CameraFile *file) LIBCAMERA_TSA_EXCLUDES(proxyMutex_);
@@ -41,11 +47,14 @@ private:
 	bool validateBufferType(uint32_t type);
 	bool validateMemoryType(uint32_t memory);
 	void setFmtFromConfig(const libcamera::StreamConfiguration &streamConfig);
-	void querycap(std::shared_ptr<libcamera::Camera> camera);
+	void updateFmt();
+	void querycap(std::shared_ptr<libcamera::Camera> camera,
+		      unsigned int stream);
 	int tryFormat(struct v4l2_format *arg);
 	enum v4l2_priority maxPriority();
 	void updateBuffers();
 	void freeBuffers();
+	void measureLatency(const V4L2Camera::Buffer &buffer);
 
 	int vidioc_querycap(V4L2CameraFile *file, struct v4l2_capability *arg);
 	int vidioc_enum_framesizes(V4L2CameraFile *file, struct v4l2_frmsizeenum *arg);
@@ -76,12 +85,15 @@ private:
 
 	static const std::set<unsigned long> supportedIoctls_;
 
+	static constexpr unsigned int kLatencySkipFrames = 30;
+	static constexpr unsigned int kLatencyMeasureFrames = 30;
+
 	unsigned int refcount_;
 	unsigned int index_;
 
 	libcamera::StreamConfiguration streamConfig_;
 	unsigned int bufferCount_;
-	unsigned int currentBuf_;
+	uint32_t memory_;
 	unsigned int sizeimage_;
 
 	struct v4l2_capability capabilities_;
@@ -91,6 +103,18 @@ private:
 	std::vector<struct v4l2_buffer> buffers_;
 	std::map<void *, unsigned int> mmaps_;
 
+	/* Completed buffers not dequeued yet, in completion order */
+	std::deque<V4L2Camera::Buffer> doneBuffers_;
+
+	/*
+	 * Latency from the sensor timestamp to the request completion, as seen
+	 * by native libcamera applications, and to the buffer being dequeued
+	 * by the V4L2 application.
+	 */
+	unsigned int latencyFrames_;
+	libcamera::utils::Duration completionLatency_;
+	libcamera::utils::Duration deliveryLatency_;
+
 	std::set<V4L2CameraFile *> files_;
 
 	std::unique_ptr<V4L2Camera> vcam_;
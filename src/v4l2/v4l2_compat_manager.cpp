@@ -7,6 +7,7 @@
 
 #include "v4l2_compat_manager.h"
 
+#include <algorithm>
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <map>
@@ -80,12 +81,18 @@ int V4L2CompatManager::start()
 
 	/*
 	 * For each Camera registered in the system, a V4L2CameraProxy gets
-	 * created here to wrap a camera device.
+	 * created here for each stream the camera can capture concurrently.
+	 * The proxies of a camera share the camera through a session.
 	 */
 	auto cameras = cm_->cameras();
 	for (auto [index, camera] : utils::enumerate(cameras)) {
-		V4L2CameraProxy *proxy = new V4L2CameraProxy(index, camera);
-		proxies_.emplace_back(proxy);
+		auto session = std::make_shared<V4L2CameraSession>(camera);
+		std::vector<std::unique_ptr<V4L2CameraProxy>> &proxies =
+			proxies_.emplace_back();
+
+		for (unsigned int stream = 0; stream < session->roles().size(); stream++)
+			proxies.push_back(std::make_unique<V4L2CameraProxy>(index, session,
+									    stream));
 	}
 
 	return 0;
@@ -106,12 +113,12 @@ std::shared_ptr<V4L2CameraFile> V4L2CompatManager::cameraFile(int fd)
 	return file->second;
 }
 
-int V4L2CompatManager::getCameraIndex(int fd)
+V4L2CameraProxy *V4L2CompatManager::getProxy(int fd)
 {
 	struct stat statbuf;
 	int ret = fstat(fd, &statbuf);
 	if (ret < 0)
-		return -1;
+		return nullptr;
 
 	const dev_t devnum = statbuf.st_rdev;
 
@@ -129,22 +136,42 @@ int V4L2CompatManager::getCameraIndex(int fd)
 		 * While there may be multiple cameras that could reference the
 		 * same device node, we take a first match as a best effort for
 		 * now.
-		 *
-		 * \todo Each camera can be accessed through any of the video
-		 * device nodes that it uses. This may confuse applications.
-		 * Consider reworking the V4L2 adaptation layer to instead
-		 * expose each Camera instance through a single video device
-		 * node (with a consistent and stable mapping). The other
-		 * device nodes could possibly be hidden from the application
-		 * by intercepting additional calls to the C library.
 		 */
-		for (const int64_t dev : devices) {
-			if (dev == static_cast<int64_t>(devnum))
-				return index;
+		auto device = std::find(devices.begin(), devices.end(),
+					static_cast<int64_t>(devnum));
+		if (device == devices.end())
+			continue;
+
+		/*
+		 * The position of a node in the SystemDevices doesn't identify
+		 * a stream, as the list contains all the capture nodes of the
+		 * media graph, including statistics nodes or nodes of other
+		 * sensors. Streams are instead assigned to device nodes as they
+		 * are opened. A node that is open keeps its stream, and another
+		 * node gets the first stream that isn't open, or the primary
+		 * stream if all streams are open.
+		 */
+		auto node = nodes_.find(devnum);
+		if (node != nodes_.end() && node->second->isOpen())
+			return node->second;
+
+		std::vector<std::unique_ptr<V4L2CameraProxy>> &proxies =
+			proxies_[index];
+		V4L2CameraProxy *proxy = proxies[0].get();
+
+		for (const std::unique_ptr<V4L2CameraProxy> &candidate : proxies) {
+			if (!candidate->isOpen()) {
+				proxy = candidate.get();
+				break;
+			}
 		}
+
+		nodes_[devnum] = proxy;
+
+		return proxy;
 	}
 
-	return -1;
+	return nullptr;
 }
 
 int V4L2CompatManager::openat(int dirfd, const char *path, int oflag, mode_t mode)
@@ -162,8 +189,8 @@ int V4L2CompatManager::openat(int dirfd, const char *path, int oflag, mode_t mod
 	if (!cm_)
 		start();
 
-	ret = getCameraIndex(fd);
-	if (ret < 0) {
+	V4L2CameraProxy *proxy = getProxy(fd);
+	if (!proxy) {
 		LOG(V4L2Compat, Debug) << "No camera found for " << path;
 		return fd;
 	}
@@ -176,7 +203,6 @@ int V4L2CompatManager::openat(int dirfd, const char *path, int oflag, mode_t mod
 	if (efd < 0)
 		return efd;
 
-	V4L2CameraProxy *proxy = proxies_[ret].get();
 	files_.emplace(efd, std::make_shared<V4L2CameraFile>(dirfd, path, efd,
 							     oflag & O_NONBLOCK,
 							     proxy));
@@ -56,14 +56,17 @@ private:
 	~V4L2CompatManager();
 
 	int start();
-	int getCameraIndex(int fd);
+	V4L2CameraProxy *getProxy(int fd);
 	std::shared_ptr<V4L2CameraFile> cameraFile(int fd);
 
 	FileOperations fops_;
 
 	libcamera::CameraManager *cm_;
 
-	std::vector<std::unique_ptr<V4L2CameraProxy>> proxies_;
+	/* Proxies for each camera, one per stream */
+	std::vector<std::vector<std::unique_ptr<V4L2CameraProxy>>> proxies_;
+	/* Proxy each device node has last been opened with */
+	std::map<dev_t, V4L2CameraProxy *> nodes_;
 	std::map<int, std::shared_ptr<V4L2CameraFile>> files_;
 	std::map<void *, std::shared_ptr<V4L2CameraFile>> mmaps_;
 };
@@ -0,0 +1,463 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Android HAL libjpeg encoder and thumbnailer test and benchmark
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include <libcamera/base/memfd.h>
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/span.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/geometry.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "jpeg/encoder_libjpeg.h"
+#include "jpeg/thumbnailer.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+/*
+ * Reference encoder using the scanline API, with the NV12 samples
+ * interleaved to a YCbCr row buffer, as the HAL did before switching to the
+ * raw data API.
+ */
+std::vector<uint8_t> encodeReference(const std::vector<uint8_t> &image,
+				     const Size &size, unsigned int quality)
+{
+	struct jpeg_compress_struct compress;
+	struct jpeg_error_mgr jerr;
+
+	compress.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&compress);
+
+	unsigned char *data = nullptr;
+	unsigned long length = 0;
+	jpeg_mem_dest(&compress, &data, &length);
+
+	compress.image_width = size.width;
+	compress.image_height = size.height;
+	compress.input_components = 3;
+	compress.in_color_space = JCS_YCbCr;
+
+	jpeg_set_defaults(&compress);
+	jpeg_set_quality(&compress, quality, TRUE);
+	jpeg_start_compress(&compress, TRUE);
+
+	const uint8_t *luma = image.data();
+	const uint8_t *chroma = luma + size.width * size.height;
+	std::vector<uint8_t> line(size.width * 3);
+
+	while (compress.next_scanline < compress.image_height) {
+		unsigned int y = compress.next_scanline;
+		const uint8_t *src = luma + y * size.width;
+		const uint8_t *src_c = chroma + y / 2 * size.width;
+
+		for (unsigned int x = 0; x < size.width; x++) {
+			line[x * 3] = src[x];
+			line[x * 3 + 1] = src_c[x & ~1];
+			line[x * 3 + 2] = src_c[x | 1];
+		}
+
+		JSAMPROW row = line.data();
+		jpeg_write_scanlines(&compress, &row, 1);
+	}
+
+	jpeg_finish_compress(&compress);
+	jpeg_destroy_compress(&compress);
+
+	std::vector<uint8_t> jpeg(data, data + length);
+	free(data);
+
+	return jpeg;
+}
+
+/*
+ * Reference thumbnailer using nearest-neighbour sampling, as the HAL did
+ * before switching to libyuv, extended to the chroma subsampling of all
+ * semi-planar formats.
+ */
+void thumbnailReference(const uint8_t *luma, const uint8_t *chroma,
+			const PixelFormatInfo &info, const Size &size,
+			const Size &target, std::vector<uint8_t> *destination)
+{
+	const unsigned int sw = size.width;
+	const unsigned int sh = size.height;
+	const unsigned int tw = target.width;
+	const unsigned int th = target.height;
+	const unsigned int strideC = info.stride(sw, 1);
+	const unsigned int cw = strideC / 2;
+
+	destination->resize(tw * th * 3 / 2);
+	uint8_t *dst = destination->data();
+	uint8_t *dstC = dst + tw * th;
+
+	for (unsigned int y = 0; y < th; y += 2) {
+		unsigned int sourceY = (sh * y + th / 2) / th;
+		const uint8_t *srcY = luma + sw * sourceY;
+		const uint8_t *srcC = chroma + sourceY / info.planes[1].verticalSubSampling * strideC;
+		uint8_t *dstY = dst + y * tw;
+
+		for (unsigned int x = 0; x < tw; x += 2) {
+			unsigned int sourceX = (sw * x + tw / 2) / tw;
+			unsigned int sourceC = sourceX * cw / sw;
+
+			dstY[x] = srcY[sourceX];
+			dstY[tw + x] = srcY[sw + sourceX];
+			dstY[x + 1] = srcY[sourceX + 1];
+			dstY[tw + x + 1] = srcY[sw + sourceX + 1];
+
+			dstC[(y / 2) * tw + x] = srcC[sourceC * 2];
+			dstC[(y / 2) * tw + x + 1] = srcC[sourceC * 2 + 1];
+		}
+	}
+}
+
+class JpegEncoderTest : public Test
+{
+protected:
+	int run() override
+	{
+		/* Below and above the size threshold for parallel encoding. */
+		for (const Size &size : { Size(640, 480), Size(1920, 1088),
+					  Size(4000, 3000) }) {
+			int ret = testEncode(size);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		/*
+		 * Thumbnails are produced in 4:2:0, preserving the chroma order
+		 * of the source.
+		 */
+		const std::vector<std::pair<PixelFormat, PixelFormat>> thumbnailFormats = {
+			{ formats::NV12, formats::NV12 },
+			{ formats::NV21, formats::NV21 },
+			{ formats::NV16, formats::NV12 },
+			{ formats::NV61, formats::NV21 },
+			{ formats::NV24, formats::NV12 },
+			{ formats::NV42, formats::NV21 },
+		};
+
+		/* 8MP and 12MP sources. */
+		for (const Size &size : { Size(3264, 2448), Size(4032, 3024) }) {
+			for (const auto &[format, thumbnailFormat] : thumbnailFormats) {
+				int ret = testThumbnail(size, format, thumbnailFormat);
+				if (ret != TestPass)
+					return ret;
+			}
+		}
+
+		return TestPass;
+	}
+
+private:
+	/*
+	 * Generate a NV12 image with smooth gradients and a few sharp edges,
+	 * to exercise both the DC and AC coefficients.
+	 */
+	std::vector<uint8_t> generate(const Size &size)
+	{
+		std::vector<uint8_t> image(size.width * size.height * 3 / 2);
+		uint8_t *chroma = image.data() + size.width * size.height;
+
+		for (unsigned int y = 0; y < size.height; y++) {
+			for (unsigned int x = 0; x < size.width; x++) {
+				uint8_t value = (x + y) * 255 / (size.width + size.height);
+				if ((x / 64 + y / 64) % 5 == 0)
+					value = 255 - value;
+				image[y * size.width + x] = value;
+			}
+		}
+
+		for (unsigned int y = 0; y < size.height / 2; y++) {
+			for (unsigned int x = 0; x < size.width / 2; x++) {
+				chroma[y * size.width + x * 2] = x * 255 / size.width + 64;
+				chroma[y * size.width + x * 2 + 1] = y * 255 / size.height + 64;
+			}
+		}
+
+		return image;
+	}
+
+	/* Decode a JPEG image and compute the PSNR of its luma against the source. */
+	double decodePsnr(Span<const uint8_t> jpeg, const std::vector<uint8_t> &image,
+			  const Size &size)
+	{
+		struct jpeg_decompress_struct decompress;
+		struct jpeg_error_mgr jerr;
+
+		decompress.err = jpeg_std_error(&jerr);
+		jpeg_create_decompress(&decompress);
+
+		jpeg_mem_src(&decompress, jpeg.data(), jpeg.size());
+
+		if (jpeg_read_header(&decompress, TRUE) != JPEG_HEADER_OK ||
+		    decompress.image_width != size.width ||
+		    decompress.image_height != size.height) {
+			jpeg_destroy_decompress(&decompress);
+			return 0.0;
+		}
+
+		decompress.out_color_space = JCS_YCbCr;
+		jpeg_start_decompress(&decompress);
+
+		std::vector<uint8_t> line(size.width * 3);
+		double error = 0.0;
+
+		while (decompress.output_scanline < decompress.output_height) {
+			unsigned int y = decompress.output_scanline;
+			JSAMPROW row = line.data();
+			jpeg_read_scanlines(&decompress, &row, 1);
+
+			for (unsigned int x = 0; x < size.width; x++) {
+				double diff = line[x * 3] - image[y * size.width + x];
+				error += diff * diff;
+			}
+		}
+
+		jpeg_finish_decompress(&decompress);
+
+		/* Corrupt data, such as invalid restart markers, are warnings. */
+		long warnings = jerr.num_warnings;
+		jpeg_destroy_decompress(&decompress);
+
+		if (warnings)
+			return 0.0;
+
+		double mse = error / (size.width * size.height);
+		return mse ? 10 * log10(255 * 255 / mse) : 100.0;
+	}
+
+	int testEncode(const Size &size)
+	{
+		std::vector<uint8_t> image = generate(size);
+		unsigned int lumaSize = size.width * size.height;
+
+		std::vector<Span<uint8_t>> planes = {
+			{ image.data(), lumaSize },
+			{ image.data() + lumaSize, lumaSize / 2 },
+		};
+
+		StreamConfiguration cfg;
+		cfg.pixelFormat = formats::NV12;
+		cfg.size = size;
+
+		EncoderLibJpeg encoder;
+		if (encoder.configure(cfg)) {
+			cout << "Failed to configure the encoder for " << size << endl;
+			return TestFail;
+		}
+
+		std::vector<uint8_t> output(lumaSize * 2);
+		microseconds elapsed{};
+		int length = 0;
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			auto start = steady_clock::now();
+			length = encoder.encode(planes, output, {}, kQuality);
+			elapsed += duration_cast<microseconds>(steady_clock::now() - start);
+
+			if (length <= 0) {
+				cout << "Failed to encode " << size << endl;
+				return TestFail;
+			}
+		}
+
+		microseconds reference{};
+		std::vector<uint8_t> referenceJpeg;
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			auto start = steady_clock::now();
+			referenceJpeg = encodeReference(image, size, kQuality);
+			reference += duration_cast<microseconds>(steady_clock::now() - start);
+		}
+
+		double psnr = decodePsnr({ output.data(), static_cast<size_t>(length) },
+					 image, size);
+		double referencePsnr = decodePsnr(referenceJpeg, image, size);
+
+		cout << size << " NV12: raw data API " << elapsed.count() / kIterations
+		     << "us, " << psnr << "dB, scanline API "
+		     << reference.count() / kIterations << "us, "
+		     << referencePsnr << "dB" << endl;
+
+		if (!psnr || psnr < referencePsnr - 0.5) {
+			cout << "Encoded image quality too low" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Create a semi-planar frame buffer with a one pixel luma checkerboard,
+	 * which aliases when subsampled, and a constant chroma.
+	 */
+	std::unique_ptr<FrameBuffer> createCheckerboard(const PixelFormatInfo &info,
+							const Size &size)
+	{
+		const unsigned int lumaSize = info.stride(size.width, 0) * size.height;
+		const unsigned int chromaSize = info.stride(size.width, 1) * size.height /
+						info.planes[1].verticalSubSampling;
+
+		UniqueFD fd = MemFd::create("thumbnailer-test", lumaSize + chromaSize);
+		if (!fd.isValid())
+			return nullptr;
+
+		SharedFD sharedFd(std::move(fd));
+		std::vector<FrameBuffer::Plane> planes(2);
+		planes[0].fd = sharedFd;
+		planes[0].offset = 0;
+		planes[0].length = lumaSize;
+		planes[1].fd = sharedFd;
+		planes[1].offset = lumaSize;
+		planes[1].length = chromaSize;
+
+		auto buffer = std::make_unique<FrameBuffer>(planes);
+
+		MappedFrameBuffer map(buffer.get(), MappedFrameBuffer::MapFlag::Write);
+		if (!map.isValid())
+			return nullptr;
+
+		const unsigned int stride = info.stride(size.width, 0);
+		uint8_t *luma = map.planes()[0].data();
+		for (unsigned int y = 0; y < size.height; y++) {
+			for (unsigned int x = 0; x < size.width; x++)
+				luma[y * stride + x] = (x + y) % 2 ? 255 : 0;
+		}
+
+		Span<uint8_t> chroma = map.planes()[1];
+		for (unsigned int i = 0; i < chroma.size(); i += 2) {
+			chroma[i] = kChroma[0];
+			chroma[i + 1] = kChroma[1];
+		}
+
+		return buffer;
+	}
+
+	/*
+	 * Compute the maximum deviation of the thumbnail luma from the average
+	 * of the checkerboard. Return a negative value if the chroma hasn't
+	 * been preserved, allowing for the rounding errors of the box filter.
+	 */
+	int thumbnailError(const std::vector<uint8_t> &thumbnail, const Size &target)
+	{
+		const unsigned int lumaSize = target.width * target.height;
+		int error = 0;
+
+		if (thumbnail.size() != lumaSize * 3 / 2)
+			return -1;
+
+		for (unsigned int i = 0; i < lumaSize; i++)
+			error = std::max(error, abs(2 * thumbnail[i] - 255) / 2);
+
+		for (unsigned int i = lumaSize; i < thumbnail.size(); i += 2) {
+			if (abs(thumbnail[i] - kChroma[0]) > kMaxChromaError ||
+			    abs(thumbnail[i + 1] - kChroma[1]) > kMaxChromaError)
+				return -1;
+		}
+
+		return error;
+	}
+
+	int testThumbnail(const Size &size, const PixelFormat &format,
+			  const PixelFormat &thumbnailFormat)
+	{
+		const PixelFormatInfo &info = PixelFormatInfo::info(format);
+		const Size target(320, 240);
+
+		std::unique_ptr<FrameBuffer> buffer = createCheckerboard(info, size);
+		if (!buffer) {
+			cout << "Failed to create " << size << " " << format
+			     << " buffer" << endl;
+			return TestFail;
+		}
+
+		Thumbnailer thumbnailer;
+		thumbnailer.configure(size, format);
+
+		std::vector<unsigned char> thumbnail;
+		microseconds elapsed{};
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			auto start = steady_clock::now();
+			thumbnailer.createThumbnail(*buffer, target, &thumbnail);
+			elapsed += duration_cast<microseconds>(steady_clock::now() - start);
+		}
+
+		MappedFrameBuffer map(buffer.get(), MappedFrameBuffer::MapFlag::Read);
+		if (!map.isValid()) {
+			cout << "Failed to map " << size << " " << format
+			     << " buffer" << endl;
+			return TestFail;
+		}
+
+		std::vector<uint8_t> reference;
+		microseconds referenceElapsed{};
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			auto start = steady_clock::now();
+			thumbnailReference(map.planes()[0].data(), map.planes()[1].data(),
+					   info, size, target, &reference);
+			referenceElapsed += duration_cast<microseconds>(steady_clock::now() - start);
+		}
+
+		int error = thumbnailError(thumbnail, target);
+		int referenceError = thumbnailError(reference, target);
+
+		cout << size << " " << format << " thumbnail: box filter "
+		     << elapsed.count() / kIterations << "us, luma error "
+		     << error << ", nearest neighbour "
+		     << referenceElapsed.count() / kIterations
+		     << "us, luma error " << referenceError << endl;
+
+		if (thumbnailer.pixelFormat() != thumbnailFormat) {
+			cout << "Unexpected thumbnail format "
+			     << thumbnailer.pixelFormat() << endl;
+			return TestFail;
+		}
+
+		if (error < 0 || error > kMaxThumbnailError) {
+			cout << "Thumbnail aliased or chroma not preserved" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	static constexpr unsigned int kIterations = 5;
+	static constexpr unsigned int kQuality = 95;
+
+	static constexpr uint8_t kChroma[2] = { 64, 192 };
+	static constexpr int kMaxThumbnailError = 8;
+	static constexpr int kMaxChromaError = 4;
+};
+
+} /* namespace */
+
+TEST_REGISTER(JpegEncoderTest)
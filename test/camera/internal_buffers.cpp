@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * libcamera internal buffers usage test
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <libcamera/formats.h>
+
+#include "libcamera/internal/formats.h"
+
+#include "camera_test.h"
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class InternalBuffersTest : public CameraTest, public Test
+{
+public:
+	InternalBuffersTest()
+		: CameraTest("VirtualRaw")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		return status_;
+	}
+
+	void cleanup() override
+	{
+		camera_->release();
+	}
+
+	int run() override
+	{
+		/* A camera that isn't acquired reports no internal buffer. */
+		if (!camera_->internalBufferUsage().empty()) {
+			cout << "Camera not acquired reports internal buffers" << endl;
+			return TestFail;
+		}
+
+		if (camera_->acquire()) {
+			cout << "Failed to acquire the camera" << endl;
+			return TestFail;
+		}
+
+		std::unique_ptr<CameraConfiguration> config =
+			camera_->generateConfiguration({ StreamRole::VideoRecording });
+		if (!config || config->validate() == CameraConfiguration::Invalid ||
+		    camera_->configure(config.get())) {
+			cout << "Failed to configure the camera" << endl;
+			return TestFail;
+		}
+
+		/* The raw buffers are only allocated when the camera starts. */
+		if (!camera_->internalBufferUsage().empty()) {
+			cout << "Internal buffers reported before start" << endl;
+			return TestFail;
+		}
+
+		std::vector<BufferPoolUsage> pools;
+		int ret = capture(&pools);
+		if (ret != TestPass)
+			return ret;
+
+		if (pools.size() != 1) {
+			cout << "Expected one internal buffer pool, got "
+			     << pools.size() << endl;
+			return TestFail;
+		}
+
+		const BufferPoolUsage &pool = pools[0];
+		if (pool.name.empty() || pool.allocator.rfind("/dev/", 0) != 0) {
+			cout << "Invalid pool name '" << pool.name
+			     << "' or allocator '" << pool.allocator << "'" << endl;
+			return TestFail;
+		}
+
+		const PixelFormatInfo &info = PixelFormatInfo::info(formats::SRGGB10_CSI2P);
+		size_t frameSize = info.frameSize({ 640, 480 });
+
+		if (!pool.count || pool.size < pool.count * frameSize) {
+			cout << "Pool of " << pool.count << " buffers reports "
+			     << pool.size << " bytes, expected at least "
+			     << pool.count * frameSize << endl;
+			return TestFail;
+		}
+
+		/* The buffers are kept when the camera stops... */
+		if (!samePools(camera_->internalBufferUsage(), pools)) {
+			cout << "Internal buffers not kept after stop" << endl;
+			return TestFail;
+		}
+
+		/* ...and when it is reconfigured identically. */
+		if (camera_->configure(config.get())) {
+			cout << "Failed to reconfigure the camera" << endl;
+			return TestFail;
+		}
+
+		if (!samePools(camera_->internalBufferUsage(), pools)) {
+			cout << "Internal buffers reallocated by identical configuration"
+			     << endl;
+			return TestFail;
+		}
+
+		std::vector<BufferPoolUsage> restartPools;
+		ret = capture(&restartPools);
+		if (ret != TestPass)
+			return ret;
+
+		if (!samePools(restartPools, pools)) {
+			cout << "Internal buffers reallocated at restart" << endl;
+			return TestFail;
+		}
+
+		/* A configuration that needs a smaller sensor size frees them. */
+		StreamConfiguration &cfg = config->at(0);
+		std::vector<Size> sizes = cfg.formats().sizes(cfg.pixelFormat);
+		if (sizes.empty()) {
+			cout << "No size supported for " << cfg.pixelFormat << endl;
+			return TestFail;
+		}
+
+		cfg.size = sizes.front();
+		if (config->validate() == CameraConfiguration::Invalid ||
+		    camera_->configure(config.get())) {
+			cout << "Failed to configure the camera with size "
+			     << cfg.size << endl;
+			return TestFail;
+		}
+
+		if (!camera_->internalBufferUsage().empty()) {
+			cout << "Internal buffers kept after configuration change"
+			     << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	int capture(std::vector<BufferPoolUsage> *pools)
+	{
+		if (camera_->start()) {
+			cout << "Failed to start the camera" << endl;
+			return TestFail;
+		}
+
+		*pools = camera_->internalBufferUsage();
+
+		if (camera_->stop()) {
+			cout << "Failed to stop the camera" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	static bool samePools(const std::vector<BufferPoolUsage> &a,
+			      const std::vector<BufferPoolUsage> &b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+				  [](const BufferPoolUsage &x, const BufferPoolUsage &y) {
+					  return x.name == y.name &&
+						 x.allocator == y.allocator &&
+						 x.count == y.count &&
+						 x.size == y.size;
+				  });
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(InternalBuffersTest)
@@ -0,0 +1,266 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * libcamera camera synchronization group test
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <libcamera/camera_sync_group.h>
+#include <libcamera/control_ids.h>
+#include <libcamera/framebuffer_allocator.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "camera_test.h"
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+class SyncGroupTest : public CameraTest, public Test
+{
+public:
+	SyncGroupTest()
+		: CameraTest("Virtual0")
+	{
+	}
+
+protected:
+	void fail(const string &message)
+	{
+		if (error_.empty())
+			error_ = message;
+	}
+
+	void frameCompleted(const CameraSyncGroup::Frame &frame)
+	{
+		MutexLocker locker(mutex_);
+
+		if (frame.requests.size() != group_->cameras().size()) {
+			fail("Frame has an invalid number of requests");
+			return;
+		}
+
+		bool complete = true;
+		int64_t minTimestamp = INT64_MAX;
+		int64_t maxTimestamp = INT64_MIN;
+
+		for (unsigned int i = 0; i < frame.requests.size(); ++i) {
+			Request *request = frame.requests[i];
+			if (!request) {
+				complete = false;
+				continue;
+			}
+
+			/* Each request must be reported once, in its camera's slot. */
+			if (!queued_.erase(request))
+				fail("Request reported twice or never queued");
+
+			Camera *camera = cameras_.at(request);
+			if (camera != group_->cameras()[i].get())
+				fail("Request reported for the wrong camera");
+
+			if (request->status() != Request::RequestComplete) {
+				complete = false;
+				continue;
+			}
+
+			const auto timestamp = request->metadata().get(controls::SensorTimestamp);
+			if (!timestamp) {
+				fail("Completed request has no sensor timestamp");
+				continue;
+			}
+
+			minTimestamp = std::min(minTimestamp, *timestamp);
+			maxTimestamp = std::max(maxTimestamp, *timestamp);
+
+			/* Requeue the request to its camera. */
+			const Stream *stream = request->buffers().begin()->first;
+			FrameBuffer *buffer = request->buffers().begin()->second;
+
+			request->reuse();
+			request->addBuffer(stream, buffer);
+			if (!camera->queueRequest(request))
+				queued_.insert(request);
+		}
+
+		if (complete) {
+			syncedFrames_++;
+
+			if (frame.skew != maxTimestamp - minTimestamp)
+				fail("Frame skew " + to_string(frame.skew) +
+				     "ns differs from sensor timestamps skew " +
+				     to_string(maxTimestamp - minTimestamp) + "ns");
+		} else if (frame.skew != 0) {
+			fail("Unpaired frame reports a skew");
+		}
+
+		dispatcher_->interrupt();
+	}
+
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		second_ = cm_->get("Virtual1");
+		if (!second_) {
+			cout << "Can not find 'Virtual1' camera" << endl;
+			return TestSkip;
+		}
+
+		dispatcher_ = Thread::current()->eventDispatcher();
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		requests_.clear();
+		allocators_.clear();
+
+		if (second_)
+			second_->release();
+	}
+
+	int setupCamera(const std::shared_ptr<Camera> &camera)
+	{
+		if (camera->acquire()) {
+			cout << "Failed to acquire the camera" << endl;
+			return TestFail;
+		}
+
+		std::unique_ptr<CameraConfiguration> config =
+			camera->generateConfiguration({ StreamRole::VideoRecording });
+		if (!config || config->validate() == CameraConfiguration::Invalid ||
+		    camera->configure(config.get())) {
+			cout << "Failed to configure the camera" << endl;
+			return TestFail;
+		}
+
+		Stream *stream = config->at(0).stream();
+		auto allocator = std::make_unique<FrameBufferAllocator>(camera);
+		if (allocator->allocate(stream) < 0)
+			return TestFail;
+
+		for (const std::unique_ptr<FrameBuffer> &buffer : allocator->buffers(stream)) {
+			std::unique_ptr<Request> request = camera->createRequest();
+			if (!request || request->addBuffer(stream, buffer.get())) {
+				cout << "Failed to create request" << endl;
+				return TestFail;
+			}
+
+			cameras_[request.get()] = camera.get();
+			requests_.push_back(std::move(request));
+		}
+
+		allocators_.push_back(std::move(allocator));
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		std::vector<std::shared_ptr<Camera>> cameras = { camera_, second_ };
+
+		for (const std::shared_ptr<Camera> &camera : cameras) {
+			int ret = setupCamera(camera);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		CameraSyncGroup group(cameras);
+		group.frameCompleted.connect(this, &SyncGroupTest::frameCompleted);
+		group_ = &group;
+
+		syncedFrames_ = 0;
+
+		if (group.start()) {
+			cout << "Failed to start the synchronization group" << endl;
+			return TestFail;
+		}
+
+		if (!group.frameDuration().count()) {
+			cout << "Cameras should run at a common frame duration" << endl;
+			return TestFail;
+		}
+
+		for (std::unique_ptr<Request> &request : requests_) {
+			MutexLocker locker(mutex_);
+
+			if (cameras_[request.get()]->queueRequest(request.get())) {
+				cout << "Failed to queue request" << endl;
+				return TestFail;
+			}
+
+			queued_.insert(request.get());
+		}
+
+		constexpr unsigned int kNumFrames = 10;
+
+		Timer timer;
+		timer.start(5s);
+		while (timer.isRunning() && syncedFrames_ < kNumFrames)
+			dispatcher_->processEvents();
+
+		if (group.stop()) {
+			cout << "Failed to stop the synchronization group" << endl;
+			return TestFail;
+		}
+
+		MutexLocker locker(mutex_);
+
+		if (!error_.empty()) {
+			cout << error_ << endl;
+			return TestFail;
+		}
+
+		/* Stopping the group must return all the requests. */
+		if (!queued_.empty()) {
+			cout << queued_.size() << " requests not reported" << endl;
+			return TestFail;
+		}
+
+		if (syncedFrames_ < kNumFrames) {
+			cout << "Failed to capture enough synchronized frames (got "
+			     << syncedFrames_ << " expected at least "
+			     << kNumFrames << ")" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	EventDispatcher *dispatcher_;
+	std::shared_ptr<Camera> second_;
+	CameraSyncGroup *group_;
+
+	std::vector<std::unique_ptr<FrameBufferAllocator>> allocators_;
+	std::vector<std::unique_ptr<Request>> requests_;
+	std::map<const Request *, Camera *> cameras_;
+
+	Mutex mutex_;
+	std::set<Request *> queued_;
+	string error_;
+
+	std::atomic<unsigned int> syncedFrames_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(SyncGroupTest)
@@ -0,0 +1,345 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * FrameInfoTracker consistency checks tests
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/framebuffer_allocator.h>
+#include <libcamera/logging.h>
+
+#include "libcamera/internal/frame_info_tracker.h"
+
+#include "camera_test.h"
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+struct TestFrameInfo : public FrameInfo {
+	unsigned int value;
+};
+
+class FrameInfoTrackerTest : public CameraTest, public Test
+{
+public:
+	FrameInfoTrackerTest()
+		: CameraTest("Virtual0")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		if (camera_->acquire()) {
+			cout << "Failed to acquire the camera" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		requests_.clear();
+		allocator_.reset();
+		camera_->release();
+	}
+
+	/*
+	 * The tracker indexes requests by sequence number, which is assigned
+	 * when requests are queued to the camera. Queue requests and stop the
+	 * camera to obtain requests with consecutive sequence numbers.
+	 */
+	int createRequests()
+	{
+		std::unique_ptr<CameraConfiguration> config =
+			camera_->generateConfiguration({ StreamRole::VideoRecording });
+		if (!config)
+			return TestFail;
+
+		config->at(0).bufferCount = kNumRequests;
+		if (config->validate() == CameraConfiguration::Invalid ||
+		    camera_->configure(config.get())) {
+			cout << "Failed to configure the camera" << endl;
+			return TestFail;
+		}
+
+		Stream *stream = config->at(0).stream();
+		allocator_ = std::make_unique<FrameBufferAllocator>(camera_);
+		if (allocator_->allocate(stream) < static_cast<int>(kNumRequests)) {
+			cout << "Failed to allocate buffers" << endl;
+			return TestFail;
+		}
+
+		for (const std::unique_ptr<FrameBuffer> &buffer : allocator_->buffers(stream)) {
+			std::unique_ptr<Request> request = camera_->createRequest();
+			if (!request || request->addBuffer(stream, buffer.get())) {
+				cout << "Failed to create request" << endl;
+				return TestFail;
+			}
+
+			requests_.push_back(std::move(request));
+		}
+
+		if (camera_->start()) {
+			cout << "Failed to start the camera" << endl;
+			return TestFail;
+		}
+
+		for (std::unique_ptr<Request> &request : requests_) {
+			if (camera_->queueRequest(request.get())) {
+				cout << "Failed to queue request" << endl;
+				return TestFail;
+			}
+		}
+
+		if (camera_->stop()) {
+			cout << "Failed to stop the camera" << endl;
+			return TestFail;
+		}
+
+		std::sort(requests_.begin(), requests_.end(),
+			  [](const auto &a, const auto &b) {
+				  return a->sequence() < b->sequence();
+			  });
+
+		for (unsigned int i = 0; i < requests_.size(); i++) {
+			if (requests_[i]->sequence() != i) {
+				cout << "Unexpected request sequence "
+				     << requests_[i]->sequence() << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	/* Check that the log contains exactly the expected messages, and clear it. */
+	bool checkLog(const std::vector<string> &messages)
+	{
+		string output = log_.str();
+		log_.str("");
+
+		size_t lines = std::count(output.begin(), output.end(), '\n');
+		if (lines != messages.size()) {
+			cout << "Expected " << messages.size() << " messages, got:"
+			     << endl << output;
+			return false;
+		}
+
+		for (const string &message : messages) {
+			if (output.find(message) == string::npos) {
+				cout << "Message '" << message << "' not found in:"
+				     << endl << output;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	Request *request(unsigned int sequence)
+	{
+		return requests_[sequence].get();
+	}
+
+	int testInOrder(FrameInfoTracker<TestFrameInfo> &tracker)
+	{
+		/* Complete frames in order, wrapping around the ring. */
+		for (unsigned int i = 0; i < kNumRequests; i++) {
+			TestFrameInfo *info = tracker.create(i, request(i));
+			if (!info) {
+				cout << "Failed to create frame " << i << endl;
+				return TestFail;
+			}
+
+			info->value = i;
+
+			if (tracker.find(i) != info || tracker.find(request(i)) != info) {
+				cout << "Failed to find frame " << i << endl;
+				return TestFail;
+			}
+
+			tracker.destroy(info);
+
+			if (tracker.find(i) || tracker.find(request(i))) {
+				cout << "Frame " << i << " found after destruction" << endl;
+				return TestFail;
+			}
+		}
+
+		if (!tracker.empty() || tracker.capacity() != kCapacity) {
+			cout << "Invalid tracker state after in-order completion" << endl;
+			return TestFail;
+		}
+
+		if (!checkLog({}))
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int testOutOfOrder(FrameInfoTracker<TestFrameInfo> &tracker)
+	{
+		std::vector<TestFrameInfo *> infos;
+
+		/* Frames 100 to 103 use the same slots as requests 0 to 3. */
+		for (unsigned int i = 0; i < kCapacity; i++) {
+			TestFrameInfo *info = tracker.create(100 + i, request(i));
+			if (!info) {
+				cout << "Failed to create frame " << 100 + i << endl;
+				return TestFail;
+			}
+
+			info->value = i;
+			infos.push_back(info);
+		}
+
+		/* Completing frame 101 before frame 100 is reported. */
+		tracker.destroy(infos[1]);
+		if (!checkLog({ "Frame 101 completed before frame 100" }))
+			return TestFail;
+
+		/* Destroying frame 101 again is detected and ignored. */
+		tracker.destroy(infos[1]);
+		if (tracker.size() != 3) {
+			cout << "Double destruction corrupted the tracker" << endl;
+			return TestFail;
+		}
+
+		if (!checkLog({ "Frame 101 not tracked" }))
+			return TestFail;
+
+		for (unsigned int i : { 0, 2, 3 }) {
+			TestFrameInfo *info = tracker.find(100 + i);
+			if (info != infos[i] || info->value != i ||
+			    tracker.find(request(i)) != info) {
+				cout << "Frame " << 100 + i
+				     << " not found after out-of-order completion"
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		/* Frame 105 wraps around the ring to the slot of frame 101. */
+		TestFrameInfo *info = tracker.create(105, request(5));
+		if (!info || tracker.capacity() != kCapacity) {
+			cout << "Failed to create frame 105 in the free slot" << endl;
+			return TestFail;
+		}
+
+		/* Stale lookups of frame 101 find the slot used by frame 105. */
+		if (tracker.find(101) || tracker.find(request(1))) {
+			cout << "Stale lookup of frame 101 succeeded" << endl;
+			return TestFail;
+		}
+
+		if (!checkLog({ "Frame 101 looked up while tracking newer frame 105",
+				"Request 1 looked up while tracking request 5" }))
+			return TestFail;
+
+		/* Frame 104 isn't tracked, its slot is held by frame 100. */
+		if (tracker.find(104)) {
+			cout << "Untracked frame 104 found" << endl;
+			return TestFail;
+		}
+
+		if (!checkLog({ "Frame 104 looked up while tracking older frame 100" }))
+			return TestFail;
+
+		tracker.destroy(infos[0]);
+		tracker.destroy(infos[2]);
+		tracker.destroy(infos[3]);
+		tracker.destroy(info);
+
+		if (!tracker.empty() || !checkLog({}))
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int testSequenceWrap(FrameInfoTracker<TestFrameInfo> &tracker)
+	{
+		/* Frame numbers wrap around 2^32. */
+		const std::vector<uint32_t> frames = { 0xfffffffe, 0xffffffff, 0, 1 };
+		std::vector<TestFrameInfo *> infos;
+
+		for (unsigned int i = 0; i < frames.size(); i++) {
+			TestFrameInfo *info = tracker.create(frames[i], request(i + 2));
+			if (!info) {
+				cout << "Failed to create frame " << frames[i] << endl;
+				return TestFail;
+			}
+
+			infos.push_back(info);
+		}
+
+		if (!checkLog({}))
+			return TestFail;
+
+		/* Frame 0 completes before frame 4294967295. */
+		tracker.destroy(infos[0]);
+		tracker.destroy(infos[2]);
+		if (!checkLog({ "Frame 0 completed before frame 4294967295" }))
+			return TestFail;
+
+		tracker.destroy(infos[1]);
+		tracker.destroy(infos[3]);
+
+		if (!tracker.empty() || !checkLog({}))
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = createRequests();
+		if (ret != TestPass)
+			return ret;
+
+		logSetLevel("FrameInfoTracker", "WARN");
+		logSetStream(&log_);
+
+		FrameInfoTracker<TestFrameInfo> tracker(kCapacity);
+
+		ret = testInOrder(tracker);
+		if (ret != TestPass)
+			return ret;
+
+		ret = testOutOfOrder(tracker);
+		if (ret != TestPass)
+			return ret;
+
+		ret = testSequenceWrap(tracker);
+		if (ret != TestPass)
+			return ret;
+
+		return TestPass;
+	}
+
+private:
+	static constexpr unsigned int kCapacity = 4;
+	static constexpr unsigned int kNumRequests = 12;
+
+	std::unique_ptr<FrameBufferAllocator> allocator_;
+	std::vector<std::unique_ptr<Request>> requests_;
+	stringstream log_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(FrameInfoTrackerTest)
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * GStreamer copied frames counter test
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include <gst/app/app.h>
+#include <gst/gst.h>
+
+#include "gstreamer_test.h"
+#include "test.h"
+
+using namespace std;
+
+class GstreamerCopiedFramesTest : public GstreamerTest, public Test
+{
+public:
+	GstreamerCopiedFramesTest()
+		: GstreamerTest()
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		/*
+		 * appsink doesn't support video meta, frames are copied if the
+		 * camera stride differs from the GStreamer default stride.
+		 */
+		appsink_ = gst_element_factory_make("appsink", nullptr);
+		if (!appsink_) {
+			g_printerr("Your installation is missing 'appsink'\n");
+			return TestFail;
+		}
+		g_object_ref_sink(appsink_);
+
+		return createPipeline();
+	}
+
+	int run() override
+	{
+		/* Build the pipeline */
+		gst_bin_add_many(GST_BIN(pipeline_), libcameraSrc_, appsink_, nullptr);
+		if (gst_element_link(libcameraSrc_, appsink_) != TRUE) {
+			g_printerr("Elements could not be linked.\n");
+			return TestFail;
+		}
+
+		g_autoptr(GstPad) pad = gst_element_get_static_pad(libcameraSrc_, "src");
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+				  [](GstPad *, GstPadProbeInfo *, gpointer data) {
+					  g_atomic_int_inc(static_cast<gint *>(data));
+					  return GST_PAD_PROBE_OK;
+				  },
+				  &pushedFrames_, nullptr);
+
+		if (copiedFrames() != 0) {
+			g_printerr("Frames copied before streaming\n");
+			return TestFail;
+		}
+
+		/*
+		 * The counter is reset when streaming starts, run two sessions
+		 * to check that it doesn't accumulate.
+		 */
+		for (unsigned int session = 0; session < 2; session++) {
+			int ret = capture();
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		g_clear_object(&appsink_);
+	}
+
+private:
+	guint64 copiedFrames()
+	{
+		guint64 copiedFrames;
+		g_object_get(libcameraSrc_, "copied-frames", &copiedFrames, nullptr);
+		return copiedFrames;
+	}
+
+	int capture()
+	{
+		g_atomic_int_set(&pushedFrames_, 0);
+
+		if (startPipeline() != TestPass)
+			return TestFail;
+
+		for (unsigned int i = 0; i < kNumFrames; i++) {
+			g_autoptr(GstSample) sample =
+				gst_app_sink_try_pull_sample(GST_APP_SINK(appsink_),
+							     GST_SECOND * 2);
+			if (!sample) {
+				g_printerr("Streaming stalled after %u frames\n", i);
+				gst_element_set_state(pipeline_, GST_STATE_NULL);
+				return TestFail;
+			}
+		}
+
+		gst_element_set_state(pipeline_, GST_STATE_NULL);
+
+		/*
+		 * Whether frames need to be copied is decided at negotiation
+		 * time, so either all or none of the pushed frames are copied.
+		 */
+		guint64 copied = copiedFrames();
+		guint64 pushed = g_atomic_int_get(&pushedFrames_);
+		if (copied != 0 && copied != pushed) {
+			g_printerr("%" G_GUINT64_FORMAT " frames copied out of %" G_GUINT64_FORMAT " pushed\n",
+				   copied, pushed);
+			return TestFail;
+		}
+
+		g_print("Copied %" G_GUINT64_FORMAT " out of %" G_GUINT64_FORMAT " frames\n",
+			copied, pushed);
+
+		return TestPass;
+	}
+
+	static constexpr unsigned int kNumFrames = 10;
+
+	GstElement *appsink_;
+	gint pushedFrames_ = 0;
+};
+
+TEST_REGISTER(GstreamerCopiedFramesTest)
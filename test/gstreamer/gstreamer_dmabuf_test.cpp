@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * GStreamer DMABuf caps negotiation test
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include <gst/allocators/allocators.h>
+#include <gst/app/app.h>
+#include <gst/gst.h>
+
+#include "gstreamer_test.h"
+#include "test.h"
+
+using namespace std;
+
+class GstreamerDmabufTest : public GstreamerTest, public Test
+{
+public:
+	GstreamerDmabufTest()
+		: GstreamerTest()
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+#if !GST_CHECK_VERSION(1, 24, 0)
+		g_printerr("DMA_DRM caps require GStreamer 1.24 or newer\n");
+		return TestSkip;
+#endif
+
+		appsink_ = gst_element_factory_make("appsink", nullptr);
+		if (!appsink_) {
+			g_printerr("Your installation is missing 'appsink'\n");
+			return TestFail;
+		}
+		g_object_ref_sink(appsink_);
+
+		/* Only accept DMABuf caps, without constraining the format. */
+		g_autoptr(GstCaps) caps =
+			gst_caps_from_string("video/x-raw(memory:DMABuf), format=(string)DMA_DRM");
+		g_object_set(appsink_, "caps", caps, nullptr);
+
+		return createPipeline();
+	}
+
+	int run() override
+	{
+		/* Build the pipeline */
+		gst_bin_add_many(GST_BIN(pipeline_), libcameraSrc_, appsink_, nullptr);
+		if (gst_element_link(libcameraSrc_, appsink_) != TRUE) {
+			g_printerr("Elements could not be linked.\n");
+			return TestFail;
+		}
+
+		if (startPipeline() != TestPass)
+			return TestFail;
+
+		int ret = checkSample();
+
+		gst_element_set_state(pipeline_, GST_STATE_NULL);
+
+		return ret;
+	}
+
+	void cleanup() override
+	{
+		g_clear_object(&appsink_);
+	}
+
+private:
+	int checkSample()
+	{
+		g_autoptr(GstSample) sample =
+			gst_app_sink_try_pull_sample(GST_APP_SINK(appsink_), GST_SECOND * 5);
+		if (!sample) {
+			g_printerr("No sample received with DMABuf caps\n");
+			return TestFail;
+		}
+
+		/* The negotiated caps must describe the format with drm-format. */
+		GstCaps *caps = gst_sample_get_caps(sample);
+		GstCapsFeatures *features = gst_caps_get_features(caps, 0);
+		GstStructure *s = gst_caps_get_structure(caps, 0);
+
+		if (!gst_caps_features_contains(features, "memory:DMABuf") ||
+		    g_strcmp0(gst_structure_get_string(s, "format"), "DMA_DRM") ||
+		    !gst_structure_get_string(s, "drm-format")) {
+			g_autofree gchar *str = gst_caps_to_string(caps);
+			g_printerr("Unexpected caps %s\n", str);
+			return TestFail;
+		}
+
+		/* Frames must be pushed as dmabuf memory, without copies. */
+		GstBuffer *buffer = gst_sample_get_buffer(sample);
+		if (!gst_is_dmabuf_memory(gst_buffer_peek_memory(buffer, 0))) {
+			g_printerr("Buffer memory isn't a dmabuf\n");
+			return TestFail;
+		}
+
+		guint64 copiedFrames;
+		g_object_get(libcameraSrc_, "copied-frames", &copiedFrames, nullptr);
+		if (copiedFrames) {
+			g_printerr("%" G_GUINT64_FORMAT " frames copied with DMABuf caps\n",
+				   copiedFrames);
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	GstElement *appsink_;
+};
+
+TEST_REGISTER(GstreamerDmabufTest)
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * GStreamer low-latency mode test
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include <gst/app/app.h>
+#include <gst/gst.h>
+
+#include "gstreamer_test.h"
+#include "test.h"
+
+using namespace std;
+
+class GstreamerLowLatencyTest : public GstreamerTest, public Test
+{
+public:
+	GstreamerLowLatencyTest()
+		: GstreamerTest()
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		appsink_ = gst_element_factory_make("appsink", nullptr);
+		if (!appsink_) {
+			g_printerr("Your installation is missing 'appsink'\n");
+			return TestFail;
+		}
+		g_object_ref_sink(appsink_);
+
+		int ret = createPipeline();
+		if (ret != TestPass)
+			return ret;
+
+		g_object_set(libcameraSrc_, "low-latency", TRUE, nullptr);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* Build the pipeline */
+		gst_bin_add_many(GST_BIN(pipeline_), libcameraSrc_, appsink_, nullptr);
+		if (gst_element_link(libcameraSrc_, appsink_) != TRUE) {
+			g_printerr("Elements could not be linked.\n");
+			return TestFail;
+		}
+
+		/*
+		 * Slow down the streaming thread so that frames complete while
+		 * the previous one is being pushed.
+		 */
+		g_autoptr(GstPad) pad = gst_element_get_static_pad(libcameraSrc_, "src");
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+				  [](GstPad *, GstPadProbeInfo *, gpointer) {
+					  g_usleep(kPushDelay);
+					  return GST_PAD_PROBE_OK;
+				  },
+				  nullptr, nullptr);
+
+		if (startPipeline() != TestPass)
+			return TestFail;
+
+		int ret = checkFrames();
+
+		gst_element_set_state(pipeline_, GST_STATE_NULL);
+
+		return ret;
+	}
+
+	void cleanup() override
+	{
+		g_clear_object(&appsink_);
+	}
+
+private:
+	int checkFrames()
+	{
+		guint64 lastSequence = GST_BUFFER_OFFSET_NONE;
+		unsigned int dropped = 0;
+
+		for (unsigned int i = 0; i < kNumFrames; i++) {
+			g_autoptr(GstSample) sample =
+				gst_app_sink_try_pull_sample(GST_APP_SINK(appsink_),
+							     GST_SECOND * 2);
+			if (!sample) {
+				g_printerr("Streaming stalled after %u frames\n", i);
+				return TestFail;
+			}
+
+			/* The buffer offset carries the frame sequence. */
+			guint64 sequence = GST_BUFFER_OFFSET(gst_sample_get_buffer(sample));
+			if (lastSequence != GST_BUFFER_OFFSET_NONE) {
+				if (sequence <= lastSequence) {
+					g_printerr("Frame %" G_GUINT64_FORMAT " pushed after frame %" G_GUINT64_FORMAT "\n",
+						   sequence, lastSequence);
+					return TestFail;
+				}
+
+				dropped += sequence - lastSequence - 1;
+			}
+
+			lastSequence = sequence;
+		}
+
+		/* Stale frames must have been dropped instead of pushed late. */
+		if (!dropped) {
+			g_printerr("No frame dropped with a slow downstream\n");
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/* Longer than the frame duration of all supported cameras. */
+	static constexpr gulong kPushDelay = 100000;
+	static constexpr unsigned int kNumFrames = 10;
+
+	GstElement *appsink_;
+};
+
+TEST_REGISTER(GstreamerLowLatencyTest)
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * GStreamer request queue depth test
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include <gst/app/app.h>
+#include <gst/gst.h>
+
+#include "gstreamer_test.h"
+#include "test.h"
+
+using namespace std;
+
+class GstreamerQueueDepthTest : public GstreamerTest, public Test
+{
+public:
+	GstreamerQueueDepthTest()
+		: GstreamerTest()
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		appsink_ = gst_element_factory_make("appsink", nullptr);
+		if (!appsink_) {
+			g_printerr("Your installation is missing 'appsink'\n");
+			return TestFail;
+		}
+		g_object_ref_sink(appsink_);
+
+		int ret = createPipeline();
+		if (ret != TestPass)
+			return ret;
+
+		/*
+		 * With a single request in flight, the task has to be paused
+		 * when the queue depth is reached and resumed when the request
+		 * completes, for every frame.
+		 */
+		g_object_set(libcameraSrc_, "queue-depth", kQueueDepth, nullptr);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		guint queueDepth;
+		g_object_get(libcameraSrc_, "queue-depth", &queueDepth, nullptr);
+		if (queueDepth != kQueueDepth) {
+			g_printerr("Queue depth %u, expected %u\n", queueDepth, kQueueDepth);
+			return TestFail;
+		}
+
+		/* Build the pipeline */
+		gst_bin_add_many(GST_BIN(pipeline_), libcameraSrc_, appsink_, nullptr);
+		if (gst_element_link(libcameraSrc_, appsink_) != TRUE) {
+			g_printerr("Elements could not be linked.\n");
+			return TestFail;
+		}
+
+		if (startPipeline() != TestPass)
+			return TestFail;
+
+		int ret = TestPass;
+
+		/* Streaming stalls if the task isn't resumed. */
+		for (unsigned int i = 0; i < kNumFrames; i++) {
+			g_autoptr(GstSample) sample =
+				gst_app_sink_try_pull_sample(GST_APP_SINK(appsink_),
+							     GST_SECOND * 2);
+			if (!sample) {
+				g_printerr("Streaming stalled after %u frames\n", i);
+				ret = TestFail;
+				break;
+			}
+		}
+
+		gst_element_set_state(pipeline_, GST_STATE_NULL);
+
+		return ret;
+	}
+
+	void cleanup() override
+	{
+		g_clear_object(&appsink_);
+	}
+
+private:
+	static constexpr guint kQueueDepth = 1;
+	static constexpr unsigned int kNumFrames = 10;
+
+	GstElement *appsink_;
+};
+
+TEST_REGISTER(GstreamerQueueDepthTest)
@@ -0,0 +1,322 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * uvcvideo MJPEG decoder test
+ */
+
+#include <iostream>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/memfd.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/logging.h>
+
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "mjpeg_decoder.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+/*
+ * The test image is made of 16x16 blocks of constant colour, aligned on the
+ * JPEG MCUs, so that the decoded values match the encoded values up to
+ * rounding errors. The luma changes every 16 lines and the chroma every 32
+ * columns, to catch lines or chroma samples written at the wrong location.
+ */
+uint8_t lumaAt([[maybe_unused]] unsigned int x, unsigned int y)
+{
+	return 40 + (y / 16) * 60;
+}
+
+uint8_t cbAt(unsigned int x, [[maybe_unused]] unsigned int y)
+{
+	return x < 32 ? 90 : 160;
+}
+
+uint8_t crAt(unsigned int x, [[maybe_unused]] unsigned int y)
+{
+	return x < 32 ? 200 : 70;
+}
+
+bool matches(uint8_t value, uint8_t expected)
+{
+	return abs(static_cast<int>(value) - static_cast<int>(expected)) <= 2;
+}
+
+class MjpegDecoderTest : public Test
+{
+protected:
+	int init() override
+	{
+		if (!MjpegDecoder::isAvailable()) {
+			cout << "MJPEG decoding not available" << endl;
+			return TestSkip;
+		}
+
+		jpeg_ = encode();
+		if (jpeg_.empty()) {
+			cout << "Failed to encode the test image" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		for (const PixelFormat &format : MjpegDecoder::formats()) {
+			int ret = testDecode(format);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return testCorrupted();
+	}
+
+private:
+	std::vector<uint8_t> encode()
+	{
+		struct jpeg_compress_struct cinfo;
+		struct jpeg_error_mgr jerr;
+
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_compress(&cinfo);
+
+		unsigned char *data = nullptr;
+		unsigned long length = 0;
+		jpeg_mem_dest(&cinfo, &data, &length);
+
+		cinfo.image_width = kSize.width;
+		cinfo.image_height = kSize.height;
+		cinfo.input_components = 3;
+		cinfo.in_color_space = JCS_YCbCr;
+
+		jpeg_set_defaults(&cinfo);
+		jpeg_set_quality(&cinfo, 100, TRUE);
+		jpeg_start_compress(&cinfo, TRUE);
+
+		std::vector<uint8_t> line(kSize.width * 3);
+		while (cinfo.next_scanline < cinfo.image_height) {
+			unsigned int y = cinfo.next_scanline;
+
+			for (unsigned int x = 0; x < kSize.width; ++x) {
+				line[x * 3] = lumaAt(x, y);
+				line[x * 3 + 1] = cbAt(x, y);
+				line[x * 3 + 2] = crAt(x, y);
+			}
+
+			JSAMPROW row = line.data();
+			jpeg_write_scanlines(&cinfo, &row, 1);
+		}
+
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+
+		std::vector<uint8_t> jpeg(data, data + length);
+		free(data);
+
+		return jpeg;
+	}
+
+	std::unique_ptr<FrameBuffer> createBuffer(unsigned int length)
+	{
+		UniqueFD fd = MemFd::create("mjpeg-decoder-test", length);
+		if (!fd.isValid())
+			return nullptr;
+
+		FrameBuffer::Plane plane;
+		plane.fd = SharedFD(std::move(fd));
+		plane.offset = 0;
+		plane.length = length;
+
+		return std::make_unique<FrameBuffer>(std::vector<FrameBuffer::Plane>{ plane });
+	}
+
+	FrameBuffer *decode(MjpegDecoder &decoder, const std::vector<uint8_t> &jpeg,
+			    FrameBuffer *output)
+	{
+		std::unique_ptr<FrameBuffer> input = createBuffer(jpeg.size());
+		if (!input)
+			return nullptr;
+
+		{
+			MappedFrameBuffer map(input.get(), MappedFrameBuffer::MapFlag::Write);
+			if (!map.isValid())
+				return nullptr;
+
+			memcpy(map.planes()[0].data(), jpeg.data(), jpeg.size());
+		}
+
+		FrameMetadata &metadata = input->_d()->metadata();
+		metadata.status = FrameMetadata::FrameSuccess;
+		metadata.sequence = 0;
+		metadata.timestamp = 0;
+		metadata.planes()[0].bytesused = jpeg.size();
+
+		/*
+		 * The test uses memfd buffers, which the decoder can't sync as
+		 * dma-bufs. Silence the resulting errors.
+		 */
+		logSetLevel("DmaBufAllocator", "FATAL");
+
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		FrameBuffer *decoded = nullptr;
+
+		decoder.outputBufferReady.connect(this, [&](FrameBuffer *buffer) {
+			decoded = buffer;
+			dispatcher->interrupt();
+		});
+
+		decoder.start();
+
+		if (decoder.queueBuffers(input.get(), output)) {
+			decoder.stop();
+			return nullptr;
+		}
+
+		Timer timeout;
+
+		timeout.start(1000ms);
+		while (timeout.isRunning() && !decoded)
+			dispatcher->processEvents();
+
+		decoder.stop();
+		decoder.outputBufferReady.disconnect(this);
+
+		return decoded;
+	}
+
+	int testDecode(const PixelFormat &format)
+	{
+		MjpegDecoder decoder;
+
+		if (decoder.configure(format, kSize)) {
+			cout << "Failed to configure the decoder for " << format << endl;
+			return TestFail;
+		}
+
+		std::unique_ptr<FrameBuffer> output =
+			createBuffer(MjpegDecoder::frameSize(format, kSize));
+		if (!output) {
+			cout << "Failed to create the output buffer" << endl;
+			return TestFail;
+		}
+
+		FrameBuffer *decoded = decode(decoder, jpeg_, output.get());
+		if (decoded != output.get()) {
+			cout << "Failed to decode to " << format << endl;
+			return TestFail;
+		}
+
+		if (decoded->metadata().status != FrameMetadata::FrameSuccess) {
+			cout << "Decoding to " << format << " reported an error" << endl;
+			return TestFail;
+		}
+
+		MappedFrameBuffer map(decoded, MappedFrameBuffer::MapFlag::Read);
+		if (!map.isValid()) {
+			cout << "Failed to map the output buffer" << endl;
+			return TestFail;
+		}
+
+		const uint8_t *data = map.planes()[0].data();
+		unsigned int stride = MjpegDecoder::stride(format, kSize);
+
+		for (unsigned int y = 0; y < kSize.height; ++y) {
+			for (unsigned int x = 0; x < kSize.width; x += 2) {
+				uint8_t luma[2], cb, cr;
+
+				if (format == formats::YUYV) {
+					const uint8_t *pixel = data + y * stride + x * 2;
+					luma[0] = pixel[0];
+					cb = pixel[1];
+					luma[1] = pixel[2];
+					cr = pixel[3];
+				} else {
+					const uint8_t *chroma = data + stride * kSize.height
+							      + y / 2 * stride + x;
+					luma[0] = data[y * stride + x];
+					luma[1] = data[y * stride + x + 1];
+					cb = chroma[0];
+					cr = chroma[1];
+				}
+
+				if (!matches(luma[0], lumaAt(x, y)) ||
+				    !matches(luma[1], lumaAt(x + 1, y)) ||
+				    !matches(cb, cbAt(x, y)) ||
+				    !matches(cr, crAt(x, y))) {
+					cout << "Invalid " << format << " pixel at ("
+					     << x << ", " << y << "): "
+					     << static_cast<unsigned int>(luma[0]) << "/"
+					     << static_cast<unsigned int>(luma[1]) << "/"
+					     << static_cast<unsigned int>(cb) << "/"
+					     << static_cast<unsigned int>(cr) << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+	int testCorrupted()
+	{
+		MjpegDecoder decoder;
+
+		if (decoder.configure(formats::NV12, kSize)) {
+			cout << "Failed to configure the decoder" << endl;
+			return TestFail;
+		}
+
+		std::unique_ptr<FrameBuffer> output =
+			createBuffer(MjpegDecoder::frameSize(formats::NV12, kSize));
+		if (!output) {
+			cout << "Failed to create the output buffer" << endl;
+			return TestFail;
+		}
+
+		/* Corrupt the start of image marker. */
+		std::vector<uint8_t> jpeg = jpeg_;
+		jpeg[1] = 0x00;
+
+		FrameBuffer *decoded = decode(decoder, jpeg, output.get());
+		if (decoded != output.get()) {
+			cout << "Corrupted frame not completed" << endl;
+			return TestFail;
+		}
+
+		if (decoded->metadata().status != FrameMetadata::FrameError) {
+			cout << "Corrupted frame not reported as an error" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	static constexpr Size kSize{ 64, 32 };
+
+	std::vector<uint8_t> jpeg_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(MjpegDecoderTest)
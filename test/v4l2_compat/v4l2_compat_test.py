@@ -78,6 +78,36 @@ def test_v4l2_compliance(v4l2_compliance, ld_preload, device, base_driver):
     return TestFail, output
 
 
+def test_dmabuf(ld_preload, device):
+    client = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          'v4l2_dmabuf_client.py')
+    ret, output = run_with_stdout(sys.executable, client, device,
+                                  env={'LD_PRELOAD': ld_preload})
+    if ret < 0:
+        output.append(f'DMABUF test for {device} terminated due to signal {signal.Signals(-ret).name}')
+        return TestFail, output
+
+    if ret == TestSkip:
+        return TestSkip, output
+
+    return (TestPass if ret == 0 else TestFail), output
+
+
+def test_streams(ld_preload, devices):
+    client = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          'v4l2_streams_client.py')
+    ret, output = run_with_stdout(sys.executable, client, *devices,
+                                  env={'LD_PRELOAD': ld_preload})
+    if ret < 0:
+        output.append(f'Streams test for {devices} terminated due to signal {signal.Signals(-ret).name}')
+        return TestFail, output
+
+    if ret == TestSkip:
+        return TestSkip, output
+
+    return (TestPass if ret == 0 else TestFail), output
+
+
 def main(argv):
     parser = argparse.ArgumentParser()
     parser.add_argument('-a', '--all', action='store_true',
@@ -125,6 +155,9 @@ def main(argv):
 
     failed = []
     drivers_tested = {}
+    compliance_tested = {}
+    dmabuf_tested = {}
+    cameras = {}
     for device in dev_nodes:
         ret, out = run_with_stdout(v4l2_ctl, '-D', '-d', device, env={'LD_PRELOAD': ld_preload})
         if ret < 0:
@@ -134,6 +167,7 @@ def main(argv):
         driver = grep('Driver name', out)[0].split(':')[-1].strip()
         if driver != "libcamera":
             continue
+        bus_info = grep('Bus info', out)[0].split(':', 1)[-1].strip()
 
         ret, out = run_with_stdout(v4l2_ctl, '-D', '-d', device)
         if ret < 0:
@@ -144,11 +178,32 @@ def main(argv):
         if driver not in supported_pipelines:
             continue
 
+        # Group the nodes of each camera to test capture from two nodes.
+        cameras.setdefault(bus_info, (driver, []))[1].append(device)
+
+        # The DMABUF client doesn't need scaling, test it on vimc too.
+        if args.all or driver not in dmabuf_tested:
+            print(f'Testing DMABUF on {device} with {driver} driver... ', end='')
+            ret, msg = test_dmabuf(ld_preload, device)
+            if ret == TestFail:
+                failed.append(device)
+                print('failed')
+            elif ret == TestSkip:
+                print('skipped')
+            else:
+                print('success')
+
+            if ret == TestFail or args.verbose:
+                print('\n'.join(msg))
+
+            dmabuf_tested[driver] = True
+            drivers_tested[driver] = True
+
         # TODO: Add kernel version check when vimc supports scaling
         if driver == "vimc":
             continue
 
-        if not args.all and driver in drivers_tested:
+        if not args.all and driver in compliance_tested:
             continue
 
         print(f'Testing {device} with {driver} driver... ', end='')
@@ -162,7 +217,29 @@ def main(argv):
         if ret == TestFail or args.verbose:
             print('\n'.join(msg))
 
+        compliance_tested[driver] = True
+        drivers_tested[driver] = True
+
+    for driver, devices in cameras.values():
+        if len(devices) < 2:
+            continue
+
+        devices = devices[:2]
+        print(f'Testing streams on {devices[0]} and {devices[1]} with {driver} driver... ', end='')
+        ret, msg = test_streams(ld_preload, devices)
+        if ret == TestFail:
+            failed += devices
+            print('failed')
+        elif ret == TestSkip:
+            print('skipped')
+        else:
+            print('success')
+
+        if ret == TestFail or args.verbose:
+            print('\n'.join(msg))
+
         drivers_tested[driver] = True
+        break
 
     if len(drivers_tested) == 0:
         print(f'No compatible drivers found')
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+# Copyright (C) 2025, Ideas On Board Oy
+#
+# Capture frames with DMABUF buffers exported by VIDIOC_EXPBUF
+#
+# This is run by v4l2_compat_test.py with the V4L2 compatibility layer
+# preloaded. Buffers are first allocated with MMAP and exported, then the
+# exported dmabufs are imported back with DMABUF and used for capture.
+
+import fcntl
+import os
+import struct
+import sys
+
+TestPass = 0
+TestFail = -1
+TestSkip = 77
+
+V4L2_BUF_TYPE_VIDEO_CAPTURE = 1
+V4L2_MEMORY_MMAP = 1
+V4L2_MEMORY_DMABUF = 4
+V4L2_BUF_CAP_SUPPORTS_DMABUF = 1 << 2
+
+# struct v4l2_requestbuffers
+requestbuffers_fmt = '=5I'
+# struct v4l2_exportbuffer
+exportbuffer_fmt = '=4Ii11I'
+# struct v4l2_buffer, for 64-bit platforms only
+buffer_fmt = '=5I4x2q2I8B2Ii4x3I4x'
+
+
+def _IOC(dir, nr, size):
+    return (dir << 30) | (size << 16) | (ord('V') << 8) | nr
+
+
+def _IOW(nr, size):
+    return _IOC(1, nr, size)
+
+
+def _IOWR(nr, size):
+    return _IOC(3, nr, size)
+
+
+VIDIOC_REQBUFS = _IOWR(8, struct.calcsize(requestbuffers_fmt))
+VIDIOC_QBUF = _IOWR(15, struct.calcsize(buffer_fmt))
+VIDIOC_EXPBUF = _IOWR(16, struct.calcsize(exportbuffer_fmt))
+VIDIOC_DQBUF = _IOWR(17, struct.calcsize(buffer_fmt))
+VIDIOC_STREAMON = _IOW(18, 4)
+VIDIOC_STREAMOFF = _IOW(19, 4)
+
+
+def reqbufs(fd, count, memory):
+    arg = bytearray(struct.pack(requestbuffers_fmt, count,
+                                V4L2_BUF_TYPE_VIDEO_CAPTURE, memory, 0, 0))
+    fcntl.ioctl(fd, VIDIOC_REQBUFS, arg, True)
+    count, _, _, caps, _ = struct.unpack(requestbuffers_fmt, arg)
+    return count, caps
+
+
+def expbuf(fd, index):
+    arg = bytearray(struct.pack(exportbuffer_fmt, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                index, 0, os.O_CLOEXEC, -1, *[0] * 11))
+    fcntl.ioctl(fd, VIDIOC_EXPBUF, arg, True)
+    return struct.unpack(exportbuffer_fmt, arg)[4]
+
+
+def buffer(index, memory, dmabuf):
+    return bytearray(struct.pack(buffer_fmt, index, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                 0, 0, 0, 0, 0, 0, 0, *[0] * 8, 0, memory,
+                                 dmabuf, 0, 0, 0))
+
+
+def qbuf(fd, index, dmabuf):
+    fcntl.ioctl(fd, VIDIOC_QBUF, buffer(index, V4L2_MEMORY_DMABUF, dmabuf), True)
+
+
+def dqbuf(fd):
+    arg = buffer(0, V4L2_MEMORY_DMABUF, -1)
+    fcntl.ioctl(fd, VIDIOC_DQBUF, arg, True)
+    fields = struct.unpack(buffer_fmt, arg)
+    # Return the index and bytesused fields
+    return fields[0], fields[2]
+
+
+def streamon(fd, on):
+    arg = bytearray(struct.pack('=I', V4L2_BUF_TYPE_VIDEO_CAPTURE))
+    fcntl.ioctl(fd, VIDIOC_STREAMON if on else VIDIOC_STREAMOFF, arg, True)
+
+
+def main(argv):
+    if len(argv) != 2:
+        print(f'Usage: {argv[0]} device')
+        return TestFail
+
+    if struct.calcsize('P') != 8:
+        print('DMABUF test only supported on 64-bit platforms')
+        return TestSkip
+
+    fd = os.open(argv[1], os.O_RDWR)
+
+    try:
+        count, caps = reqbufs(fd, 4, V4L2_MEMORY_MMAP)
+        if not caps & V4L2_BUF_CAP_SUPPORTS_DMABUF:
+            print('DMABUF not supported')
+            return TestFail
+
+        dmabufs = [expbuf(fd, i) for i in range(count)]
+        reqbufs(fd, 0, V4L2_MEMORY_MMAP)
+
+        count, _ = reqbufs(fd, len(dmabufs), V4L2_MEMORY_DMABUF)
+        if count != len(dmabufs):
+            print(f'Expected {len(dmabufs)} DMABUF buffers, got {count}')
+            return TestFail
+
+        for index, dmabuf in enumerate(dmabufs):
+            qbuf(fd, index, dmabuf)
+
+        streamon(fd, True)
+
+        for _ in range(count * 2):
+            index, bytesused = dqbuf(fd)
+            if bytesused == 0:
+                print(f'Buffer {index} is empty')
+                return TestFail
+            qbuf(fd, index, dmabufs[index])
+
+        streamon(fd, False)
+        reqbufs(fd, 0, V4L2_MEMORY_DMABUF)
+
+        for dmabuf in dmabufs:
+            os.close(dmabuf)
+    except OSError as err:
+        print(f'DMABUF capture failed: {err}')
+        return TestFail
+    finally:
+        os.close(fd)
+
+    return TestPass
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
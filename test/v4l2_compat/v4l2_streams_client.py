@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+# Copyright (C) 2025, Ideas On Board Oy
+#
+# Capture from two video device nodes of the same camera
+#
+# This is run by v4l2_compat_test.py with the V4L2 compatibility layer
+# preloaded. When the two nodes give access to the same stream, only the node
+# that holds buffers can set the format. When they give access to different
+# streams, the format of the second node must be set before buffers are
+# requested on any node, and both streams are then captured concurrently.
+
+import errno
+import fcntl
+import os
+import struct
+import sys
+
+TestPass = 0
+TestFail = -1
+TestSkip = 77
+
+V4L2_BUF_TYPE_VIDEO_CAPTURE = 1
+V4L2_MEMORY_MMAP = 1
+
+# struct v4l2_capability
+capability_fmt = '=16s32s32s3I3I'
+# struct v4l2_format, with the v4l2_pix_format member, for 64-bit platforms only
+format_fmt = '=I4x12I152x'
+# struct v4l2_requestbuffers
+requestbuffers_fmt = '=5I'
+# struct v4l2_buffer, for 64-bit platforms only
+buffer_fmt = '=5I4x2q2I8B2Ii4x3I4x'
+
+
+def _IOC(dir, nr, size):
+    return (dir << 30) | (size << 16) | (ord('V') << 8) | nr
+
+
+def _IOR(nr, size):
+    return _IOC(2, nr, size)
+
+
+def _IOW(nr, size):
+    return _IOC(1, nr, size)
+
+
+def _IOWR(nr, size):
+    return _IOC(3, nr, size)
+
+
+VIDIOC_QUERYCAP = _IOR(0, struct.calcsize(capability_fmt))
+VIDIOC_G_FMT = _IOWR(4, struct.calcsize(format_fmt))
+VIDIOC_S_FMT = _IOWR(5, struct.calcsize(format_fmt))
+VIDIOC_REQBUFS = _IOWR(8, struct.calcsize(requestbuffers_fmt))
+VIDIOC_QUERYBUF = _IOWR(9, struct.calcsize(buffer_fmt))
+VIDIOC_QBUF = _IOWR(15, struct.calcsize(buffer_fmt))
+VIDIOC_DQBUF = _IOWR(17, struct.calcsize(buffer_fmt))
+VIDIOC_STREAMON = _IOW(18, 4)
+VIDIOC_STREAMOFF = _IOW(19, 4)
+
+
+def querycap(fd):
+    arg = bytearray(struct.calcsize(capability_fmt))
+    fcntl.ioctl(fd, VIDIOC_QUERYCAP, arg, True)
+    _, card, bus_info, *_ = struct.unpack(capability_fmt, arg)
+    return card.rstrip(b'\0'), bus_info.rstrip(b'\0')
+
+
+def g_fmt(fd):
+    arg = bytearray(struct.pack(format_fmt, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                *[0] * 12))
+    fcntl.ioctl(fd, VIDIOC_G_FMT, arg, True)
+    # Return the width, height, pixelformat, bytesperline and sizeimage fields
+    fields = struct.unpack(format_fmt, arg)
+    return fields[1:4] + fields[5:7]
+
+
+def s_fmt(fd, width, height, pixelformat):
+    arg = bytearray(struct.pack(format_fmt, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                width, height, pixelformat, *[0] * 9))
+    fcntl.ioctl(fd, VIDIOC_S_FMT, arg, True)
+    fields = struct.unpack(format_fmt, arg)
+    return fields[1:4] + fields[5:7]
+
+
+def reqbufs(fd, count):
+    arg = bytearray(struct.pack(requestbuffers_fmt, count,
+                                V4L2_BUF_TYPE_VIDEO_CAPTURE, V4L2_MEMORY_MMAP,
+                                0, 0))
+    fcntl.ioctl(fd, VIDIOC_REQBUFS, arg, True)
+    return struct.unpack(requestbuffers_fmt, arg)[0]
+
+
+def buffer(index):
+    return bytearray(struct.pack(buffer_fmt, index, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+                                 0, 0, 0, 0, 0, 0, 0, *[0] * 8, 0,
+                                 V4L2_MEMORY_MMAP, 0, 0, 0, 0))
+
+
+def querybuf(fd, index):
+    arg = buffer(index)
+    fcntl.ioctl(fd, VIDIOC_QUERYBUF, arg, True)
+    # Return the length field
+    return struct.unpack(buffer_fmt, arg)[-3]
+
+
+def qbuf(fd, index):
+    fcntl.ioctl(fd, VIDIOC_QBUF, buffer(index), True)
+
+
+def dqbuf(fd):
+    arg = buffer(0)
+    fcntl.ioctl(fd, VIDIOC_DQBUF, arg, True)
+    fields = struct.unpack(buffer_fmt, arg)
+    # Return the index and bytesused fields
+    return fields[0], fields[2]
+
+
+def streamon(fd, on):
+    arg = bytearray(struct.pack('=I', V4L2_BUF_TYPE_VIDEO_CAPTURE))
+    fcntl.ioctl(fd, VIDIOC_STREAMON if on else VIDIOC_STREAMOFF, arg, True)
+
+
+def expect_ebusy(name, func, *args):
+    try:
+        func(*args)
+    except OSError as err:
+        if err.errno == errno.EBUSY:
+            return True
+        print(f'{name} failed with {err}, expected EBUSY')
+        return False
+
+    print(f'{name} succeeded, expected EBUSY')
+    return False
+
+
+def capture(fds, counts):
+    for fd, count in zip(fds, counts):
+        for index in range(count):
+            qbuf(fd, index)
+
+    for fd in fds:
+        streamon(fd, True)
+
+    for _ in range(max(counts) * 2):
+        for fd in fds:
+            index, bytesused = dqbuf(fd)
+            if bytesused == 0:
+                print(f'Buffer {index} is empty')
+                return False
+            qbuf(fd, index)
+
+    for fd in fds:
+        streamon(fd, False)
+
+    return True
+
+
+def test_shared_stream(first, second):
+    # The node that requests buffers first owns the stream.
+    count = reqbufs(first, 4)
+
+    width, height, pixelformat, _, _ = g_fmt(first)
+    if not expect_ebusy('S_FMT on second node', s_fmt, second, width,
+                        height, pixelformat):
+        return TestFail
+    if not expect_ebusy('REQBUFS on second node', reqbufs, second, 4):
+        return TestFail
+
+    if not capture([first], [count]):
+        return TestFail
+
+    # Releasing the buffers releases the ownership.
+    reqbufs(first, 0)
+    s_fmt(second, width, height, pixelformat)
+
+    return TestPass
+
+
+def test_separate_streams(first, second):
+    width, height, pixelformat, _, _ = g_fmt(second)
+
+    # Formats must be set on all nodes before buffers are requested.
+    fmt = s_fmt(second, width // 2, height // 2, pixelformat)
+    counts = [reqbufs(first, 4)]
+
+    if not expect_ebusy('S_FMT with a new size on second node', s_fmt, second,
+                        fmt[0] // 2, fmt[1] // 2, pixelformat):
+        return TestFail
+
+    s_fmt(second, *fmt[:3])
+    counts.append(reqbufs(second, 4))
+
+    # The configuration of the second stream may have adjusted the first one.
+    for name, fd in [('first', first), ('second', second)]:
+        sizeimage = g_fmt(fd)[4]
+        length = querybuf(fd, 0)
+        if sizeimage != length:
+            print(f'{name} node reports size {sizeimage} for buffers of {length} bytes')
+            return TestFail
+
+    if not capture([first, second], counts):
+        return TestFail
+
+    reqbufs(second, 0)
+    reqbufs(first, 0)
+
+    return TestPass
+
+
+def main(argv):
+    if len(argv) != 3:
+        print(f'Usage: {argv[0]} device device')
+        return TestFail
+
+    if struct.calcsize('P') != 8:
+        print('Streams test only supported on 64-bit platforms')
+        return TestSkip
+
+    first = os.open(argv[1], os.O_RDWR)
+    second = os.open(argv[2], os.O_RDWR)
+
+    try:
+        first_card, first_bus = querycap(first)
+        second_card, second_bus = querycap(second)
+        if first_bus != second_bus:
+            print(f'{argv[1]} and {argv[2]} belong to different cameras')
+            return TestFail
+
+        # Nodes that give access to different streams have different cards.
+        if first_card == second_card:
+            return test_shared_stream(first, second)
+        else:
+            return test_separate_streams(first, second)
+    except OSError as err:
+        print(f'Streams capture failed: {err}')
+        return TestFail
+    finally:
+        os.close(second)
+        os.close(first)
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,268 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2025, Ideas On Board Oy
+ *
+ * Compare the buffer cache against a linear scan reference implementation
+ */
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <libcamera/base/memfd.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std::chrono;
+
+namespace {
+
+/*
+ * Reference implementation of the buffer cache, scanning all entries and
+ * comparing all planes on every lookup.
+ */
+class LinearBufferCache
+{
+public:
+	LinearBufferCache(unsigned int numEntries)
+		: lastUsedCounter_(1), missCounter_(0), cache_(numEntries)
+	{
+	}
+
+	int get(const FrameBuffer &buffer)
+	{
+		bool hit = false;
+		int use = -1;
+		uint64_t oldest = std::numeric_limits<uint64_t>::max();
+
+		for (unsigned int index = 0; index < cache_.size(); index++) {
+			const Entry &entry = cache_[index];
+
+			if (!entry.free)
+				continue;
+
+			if (entry.matches(buffer)) {
+				hit = true;
+				use = index;
+				break;
+			}
+
+			if (entry.lastUsed < oldest) {
+				use = index;
+				oldest = entry.lastUsed;
+			}
+		}
+
+		if (!hit)
+			missCounter_++;
+
+		if (use < 0)
+			return -ENOENT;
+
+		Entry &entry = cache_[use];
+		entry.free = false;
+		entry.lastUsed = lastUsedCounter_++;
+		entry.planes.clear();
+		for (const FrameBuffer::Plane &plane : buffer.planes())
+			entry.planes.push_back({ plane.fd.get(), plane.length });
+
+		return use;
+	}
+
+	void put(unsigned int index)
+	{
+		cache_[index].free = true;
+	}
+
+	uint64_t misses() const { return missCounter_; }
+
+private:
+	struct Entry {
+		bool matches(const FrameBuffer &buffer) const
+		{
+			const std::vector<FrameBuffer::Plane> &bufferPlanes = buffer.planes();
+
+			if (planes.size() != bufferPlanes.size())
+				return false;
+
+			for (unsigned int i = 0; i < planes.size(); i++)
+				if (planes[i].first != bufferPlanes[i].fd.get() ||
+				    planes[i].second != bufferPlanes[i].length)
+					return false;
+			return true;
+		}
+
+		bool free = true;
+		uint64_t lastUsed = 0;
+		std::vector<std::pair<int, unsigned int>> planes;
+	};
+
+	uint64_t lastUsedCounter_;
+	uint64_t missCounter_;
+	std::vector<Entry> cache_;
+};
+
+class BufferCacheLookupTest : public Test
+{
+protected:
+	int init() override
+	{
+		std::random_device rd;
+		unsigned int seed = rd();
+
+		std::cout << "Random seed is " << seed << std::endl;
+
+		generator_.seed(seed);
+
+		/* Create multi-planar buffers backed by distinct memfds. */
+		for (unsigned int i = 0; i < kNumBuffers; i++) {
+			std::vector<FrameBuffer::Plane> planes;
+
+			for (unsigned int p = 0; p < kNumPlanes; p++) {
+				UniqueFD fd = MemFd::create("buffer", kPlaneSize);
+				if (!fd.isValid()) {
+					std::cout << "Failed to create memfd" << std::endl;
+					return TestFail;
+				}
+
+				FrameBuffer::Plane plane;
+				plane.fd = SharedFD(std::move(fd));
+				plane.offset = 0;
+				plane.length = kPlaneSize;
+				planes.push_back(std::move(plane));
+			}
+
+			buffers_.push_back(std::make_unique<FrameBuffer>(planes));
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Run the same random queue/dequeue workload on both caches, keeping
+	 * up to \a depth buffers in flight, and check they make the same
+	 * decisions.
+	 */
+	int compare(unsigned int numEntries, unsigned int depth)
+	{
+		V4L2BufferCache cache(numEntries);
+		LinearBufferCache reference(numEntries);
+
+		std::uniform_int_distribution<> dist(0, buffers_.size() - 1);
+		std::vector<std::pair<unsigned int, unsigned int>> queued;
+		std::vector<bool> busy(buffers_.size(), false);
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			/* A buffer can't be queued twice, pick an idle one. */
+			unsigned int nBuffer = dist(generator_);
+			while (busy[nBuffer])
+				nBuffer = (nBuffer + 1) % buffers_.size();
+
+			const FrameBuffer &buffer = *buffers_[nBuffer];
+
+			int index = cache.get(buffer);
+			int expected = reference.get(buffer);
+			if (index != expected) {
+				std::cout << "Expected index " << expected
+					  << " got " << index << std::endl;
+				return TestFail;
+			}
+
+			if (index >= 0) {
+				queued.emplace_back(index, nBuffer);
+				busy[nBuffer] = true;
+			}
+
+			if (queued.size() < depth && index >= 0)
+				continue;
+
+			/* Complete buffers mostly in order. */
+			unsigned int pos = dist(generator_) % 4 ? 0
+				: dist(generator_) % queued.size();
+			cache.put(queued[pos].first);
+			reference.put(queued[pos].first);
+			busy[queued[pos].second] = false;
+			queued.erase(queued.begin() + pos);
+		}
+
+		if (cache.misses() != reference.misses()) {
+			std::cout << "Expected " << reference.misses()
+				  << " misses, got " << cache.misses() << std::endl;
+			return TestFail;
+		}
+
+		if (cache.hits() + cache.misses() != kIterations) {
+			std::cout << "Inconsistent hit and miss counters"
+				  << std::endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	template<typename Cache>
+	microseconds benchmark(Cache &cache)
+	{
+		auto start = steady_clock::now();
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			const FrameBuffer &buffer = *buffers_[i % buffers_.size()];
+			int index = cache.get(buffer);
+			if (index >= 0)
+				cache.put(index);
+		}
+
+		return duration_cast<microseconds>(steady_clock::now() - start);
+	}
+
+	int run() override
+	{
+		if (compare(kNumBuffers, 4) != TestPass)
+			return TestFail;
+
+		if (compare(kNumBuffers / 2, 4) != TestPass)
+			return TestFail;
+
+		if (compare(kNumBuffers / 2, kNumBuffers / 2) != TestPass)
+			return TestFail;
+
+		V4L2BufferCache cache(kNumBuffers);
+		LinearBufferCache reference(kNumBuffers);
+
+		microseconds indexed = benchmark(cache);
+		microseconds linear = benchmark(reference);
+
+		std::cout << kIterations << " lookups with " << kNumBuffers
+			  << " buffers: indexed " << indexed.count()
+			  << "us, linear scan " << linear.count() << "us"
+			  << std::endl;
+
+		if (cache.misses() != kNumBuffers) {
+			std::cout << "Unexpected cache misses: "
+				  << cache.misses() << std::endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	static constexpr unsigned int kNumBuffers = 32;
+	static constexpr unsigned int kNumPlanes = 3;
+	static constexpr unsigned int kPlaneSize = 4096;
+	static constexpr unsigned int kIterations = 100000;
+
+	std::mt19937 generator_;
+	std::vector<std::unique_ptr<FrameBuffer>> buffers_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(BufferCacheLookupTest)
@@ -175,6 +175,29 @@ protected:
 			return TestFail;
 		}
 
+		/*
+		 * Exported buffers are all in the capture device cache, while
+		 * the output device associates each imported buffer with a
+		 * V4L2 buffer the first time it is queued.
+		 */
+		if (capture_->bufferCacheHits() != bufferCount + framesOutput_ ||
+		    capture_->bufferCacheMisses() != 0) {
+			std::cout << "Unexpected capture cache statistics: "
+				  << capture_->bufferCacheHits() << " hits, "
+				  << capture_->bufferCacheMisses() << " misses"
+				  << std::endl;
+			return TestFail;
+		}
+
+		if (output_->bufferCacheHits() != framesCaptured_ - bufferCount ||
+		    output_->bufferCacheMisses() != bufferCount) {
+			std::cout << "Unexpected output cache statistics: "
+				  << output_->bufferCacheHits() << " hits, "
+				  << output_->bufferCacheMisses() << " misses"
+				  << std::endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
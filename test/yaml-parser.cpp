@@ -175,6 +175,20 @@ protected:
 			return TestFail;
 		}
 
+		if (!isIntegerUpTo32 && obj.get<int64_t>()) {
+			std::cerr
+				<< "Object " << name << " didn't fail to parse as "
+				<< "int64_t" << std::endl;
+			return TestFail;
+		}
+
+		if ((!isIntegerUpTo32 || isSigned) && obj.get<uint64_t>()) {
+			std::cerr
+				<< "Object " << name << " didn't fail to parse as "
+				<< "uint64_t" << std::endl;
+			return TestFail;
+		}
+
 		if (!isIntegerUpTo32 && type != Type::Double && obj.get<double>()) {
 			std::cerr
 				<< "Object " << name << " didn't fail to parse as "
@@ -278,6 +292,24 @@ protected:
 			}
 		}
 
+		if (obj.get<int64_t>().value_or(0) != value ||
+		    obj.get<int64_t>(0) != value) {
+			std::cerr
+				<< "Object " << name << " failed to parse as "
+				<< "int64_t" << std::endl;
+			return TestFail;
+		}
+
+		if (!isSigned) {
+			if (obj.get<uint64_t>().value_or(0) != unsignedValue ||
+			    obj.get<uint64_t>(0) != unsignedValue) {
+				std::cerr
+					<< "Object " << name << " failed to parse as "
+					<< "uint64_t" << std::endl;
+				return TestFail;
+			}
+		}
+
 		return TestPass;
 	}
 
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+# Copyright (C) 2025, Ideas On Board Oy
+#
+# Compute per-stage buffer latency statistics from libcamera lttng traces
+
+import argparse
+import bt2
+import sys
+
+# stage -> samples[]
+samples = {}
+
+
+def add_sample(stage, value):
+    if stage not in samples:
+        samples[stage] = []
+    samples[stage].append(value)
+
+
+def percentile(values, pct):
+    index = min(len(values) - 1, int(len(values) * pct / 100))
+    return values[index]
+
+
+def clock_ns(msg):
+    # Use the raw clock value, which matches the monotonic clock used by V4L2
+    # buffer timestamps, instead of the offset from the clock origin.
+    snapshot = msg.default_clock_snapshot
+    return snapshot.value * 1000000000 // snapshot.clock_class.frequency
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(
+            description='Compute latency percentiles for each stage of buffer processing')
+    parser.add_argument('-d', '--device', type=str,
+                        help='Name of video device node to filter for')
+    parser.add_argument('trace_path', type=str,
+                        help='Path to lttng trace (eg. ~/lttng-traces/demo-20201029-184003)')
+    args = parser.parse_args(argv[1:])
+
+    # (device, buffer) -> queue timestamp
+    queued = {}
+    # buffer -> (device, sensor timestamp, dequeue timestamp)
+    dequeued = {}
+    # (pipeline, function, frame) -> begin timestamp
+    ipa_calls = {}
+
+    traces = bt2.TraceCollectionMessageIterator(args.trace_path)
+    for msg in traces:
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+
+        event = msg.event.name
+        payload = msg.event.payload_field
+        timestamp_ns = clock_ns(msg)
+
+        if event in ['libcamera:v4l2_buffer_queue', 'libcamera:v4l2_buffer_dequeue']:
+            device = str(payload['device'])
+            if args.device is not None and device != args.device:
+                continue
+
+            buffer = int(payload['buffer'])
+
+            if event == 'libcamera:v4l2_buffer_queue':
+                queued[(device, buffer)] = timestamp_ns
+                continue
+
+            sensor_ns = int(payload['timestamp'])
+            if sensor_ns:
+                add_sample(f'{device}:sensor-to-dequeue', timestamp_ns - sensor_ns)
+
+            ts = queued.pop((device, buffer), None)
+            if ts is not None:
+                add_sample(f'{device}:queue-to-dequeue', timestamp_ns - ts)
+
+            dequeued[buffer] = (device, sensor_ns, timestamp_ns)
+
+        elif event == 'libcamera:ipa_frame_begin':
+            key = (str(payload['pipeline_name']), str(payload['function_name']),
+                   int(payload['frame']))
+            ipa_calls[key] = timestamp_ns
+
+        elif event == 'libcamera:ipa_frame_end':
+            key = (str(payload['pipeline_name']), str(payload['function_name']),
+                   int(payload['frame']))
+            ts = ipa_calls.pop(key, None)
+            if ts is not None:
+                add_sample(f'{key[0]}:ipa:{key[1]}', timestamp_ns - ts)
+
+        elif event == 'libcamera:request_complete_buffer':
+            info = dequeued.pop(int(payload['buffer']), None)
+            if info is None:
+                continue
+
+            device, sensor_ns, dequeue_ns = info
+            add_sample(f'{device}:dequeue-to-complete', timestamp_ns - dequeue_ns)
+            if sensor_ns:
+                add_sample(f'{device}:sensor-to-complete', timestamp_ns - sensor_ns)
+
+    # Compute stats, in microseconds
+    rows = []
+    rows.append(['stage', 'count', 'min', 'p50', 'p90', 'p99', 'max'])
+    for k, v in sorted(samples.items()):
+        v = sorted(v)
+        rows.append([k, str(len(v))] +
+                    [str(x // 1000) for x in [v[0], percentile(v, 50),
+                                              percentile(v, 90),
+                                              percentile(v, 99), v[-1]]])
+
+    # Get maximum string width for every column
+    widths = []
+    for i in range(len(rows[0])):
+        widths.append(max([len(row[i]) for row in rows]))
+
+    # Print stats table
+    print('Latencies in microseconds')
+    for row in rows:
+        fmt = [row[i].rjust(widths[i]) for i in range(1, 7)]
+        print('{} {} {} {} {} {} {}'.format(row[0].ljust(widths[0]), *fmt))
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))